@@ -0,0 +1,461 @@
+
+// Round trip benchmark of the transports: every connection echoes messages of a fixed size back to a client
+// thread that sends the next one as soon as the last has returned. Reports throughput and latency percentiles,
+// one line per transport, message size and connection count, as JSON Lines (default) or CSV.
+//
+// simple_socket_bench [--transports=tcp,unix,udp,shm,ws,modbus] [--sizes=64,1024,16384,65536]
+//                     [--connections=1,8] [--duration=1000] [--format=json|csv]
+
+#include "simple_socket/SharedMemoryConnection.hpp"
+#include "simple_socket/TCPSocket.hpp"
+#include "simple_socket/UDPSocket.hpp"
+#include "simple_socket/UnixDomainSocket.hpp"
+#include "simple_socket/WebSocket.hpp"
+#include "simple_socket/modbus/HoldingRegister.hpp"
+#include "simple_socket/modbus/ModbusClient.hpp"
+#include "simple_socket/modbus/ModbusServer.hpp"
+#include "simple_socket/util/port_query.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <semaphore>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace simple_socket;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Messages are zeros. A single byte of this tells the echo side of a message transport, which does not see
+    // the client close, to stop.
+    constexpr uint8_t endMarker = 0xFF;
+
+    bool isEnd(std::span<const uint8_t> message) {
+        return message.size() == 1 && message[0] == endMarker;
+    }
+
+    // The client side of a connection: sends a message and waits for it to come back
+    struct Endpoint {
+        virtual bool roundTrip(std::span<const uint8_t> message) = 0;
+        virtual ~Endpoint() = default;
+    };
+
+    // The server side of a transport, connecting clients to it. Destroyed after its endpoints.
+    struct Transport {
+        virtual std::unique_ptr<Endpoint> connect(size_t messageSize) = 0;
+
+        virtual ~Transport() {
+            for (auto& t : echoThreads) t.join();
+        }
+
+    protected:
+        std::vector<std::thread> echoThreads;
+
+        // Sends every message back, until the connection closes or the end marker arrives
+        void echo(std::unique_ptr<SimpleConnection> conn, size_t messageSize) {
+            echoThreads.emplace_back([conn = std::move(conn), messageSize] {
+                std::vector<uint8_t> buffer(std::max<size_t>(messageSize, 64 * 1024));
+                int n;
+                while ((n = conn->read(buffer)) > 0) {
+                    const std::span<const uint8_t> message(buffer.data(), static_cast<size_t>(n));
+                    if (isEnd(message) || !conn->write(message.data(), message.size())) break;
+                }
+                conn->close();
+            });
+        }
+    };
+
+    std::optional<uint16_t> freePort() {
+        static uint16_t next = 20000;
+        const auto port = getAvailablePort(next, 30000);
+        if (port) next = static_cast<uint16_t>(*port + 1);
+        return port;
+    }
+
+    // A stream is read back until the whole message has arrived, a datagram or shared memory message at once
+    struct ConnectionEndpoint: Endpoint {
+
+        // owner is what the connection must not outlive, if anything
+        ConnectionEndpoint(std::unique_ptr<SimpleConnection> conn, bool stream, std::shared_ptr<void> owner = nullptr)
+            : owner(std::move(owner)), conn(std::move(conn)), stream(stream) {}
+
+        bool roundTrip(std::span<const uint8_t> message) override {
+            reply.resize(std::max<size_t>(message.size(), 1));
+            if (!conn->write(message.data(), message.size())) return false;
+            if (stream) return conn->readExact(reply.data(), message.size());
+            return conn->read(reply.data(), reply.size()) == static_cast<int>(message.size());
+        }
+
+        ~ConnectionEndpoint() override {
+            if (!stream) conn->write(&endMarker, 1);
+            conn->close();
+        }
+
+        std::shared_ptr<void> owner;
+        std::unique_ptr<SimpleConnection> conn;
+        bool stream;
+        std::vector<uint8_t> reply;
+    };
+
+    struct TcpTransport: Transport {
+
+        explicit TcpTransport(uint16_t port)
+            : port(port), server(port) {}
+
+        std::unique_ptr<Endpoint> connect(size_t messageSize) override {
+            auto conn = ctx.connect("127.0.0.1", port);
+            echo(server.accept(), messageSize);
+            return std::make_unique<ConnectionEndpoint>(std::move(conn), true);
+        }
+
+        ~TcpTransport() override {
+            server.close();
+        }
+
+        uint16_t port;
+        TCPServer server;
+        TCPClientContext ctx;
+    };
+
+    struct UnixTransport: Transport {
+
+        explicit UnixTransport(const std::string& domain)
+            : domain(domain), server(domain, 64) {}
+
+        std::unique_ptr<Endpoint> connect(size_t messageSize) override {
+            auto conn = ctx.connect(domain);
+            echo(server.accept(), messageSize);
+            return std::make_unique<ConnectionEndpoint>(std::move(conn), true);
+        }
+
+        ~UnixTransport() override {
+            server.close();
+        }
+
+        std::string domain;
+        UnixDomainServer server;
+        UnixDomainClientContext ctx;
+    };
+
+    // Every client gets a server socket of its own, on a loopback that does not lose datagrams
+    struct UdpTransport: Transport {
+
+        std::unique_ptr<Endpoint> connect(size_t messageSize) override {
+            const auto serverPort = freePort();
+            const auto clientPort = freePort();
+            if (!serverPort || !clientPort) throw std::runtime_error("No free UDP port");
+
+            auto server = std::make_unique<UDPSocket>(*serverPort);
+            echoThreads.emplace_back([server = std::move(server), messageSize] {
+                std::vector<uint8_t> buffer(std::max<size_t>(messageSize, 1));
+                while (true) {
+                    const auto [n, from] = server->recvFrom(buffer);
+                    if (n <= 0) break;
+                    const std::span<const uint8_t> message(buffer.data(), static_cast<size_t>(n));
+                    if (isEnd(message)) break;
+                    server->sendTo(from, message);
+                }
+            });
+            auto client = std::make_shared<UDPSocket>(*clientPort);
+            auto conn = client->makeConnection("127.0.0.1", *serverPort);
+            return std::make_unique<ConnectionEndpoint>(std::move(conn), false, std::move(client));
+        }
+    };
+
+    struct SharedMemoryTransport: Transport {
+
+        std::unique_ptr<Endpoint> connect(size_t messageSize) override {
+#ifdef _WIN32
+            const auto name = "simple_socket_bench_" + std::to_string(next++);
+#else
+            const auto name = "simple_socket_bench_" + std::to_string(getpid()) + "_" + std::to_string(next++);
+#endif
+            SharedMemoryOptions options;
+            options.slots = 16;
+            // the server creates the segment the client attaches to
+            auto server = std::make_unique<SharedMemoryConnection>(name, std::max<size_t>(messageSize, 1), true, options);
+            auto client = std::make_unique<SharedMemoryConnection>(name, std::max<size_t>(messageSize, 1), false, options);
+            echo(std::move(server), messageSize);
+            return std::make_unique<ConnectionEndpoint>(std::move(client), false);
+        }
+
+        size_t next = 0;
+    };
+
+    struct WebSocketEndpoint: Endpoint {
+
+        explicit WebSocketEndpoint(uint16_t port) {
+            client.onBinaryMessage = [this](WebSocketConnection*, std::span<const uint8_t> data) {
+                received = data.size();
+                arrived.release();
+            };
+            client.connect("ws://127.0.0.1:" + std::to_string(port));
+        }
+
+        bool roundTrip(std::span<const uint8_t> message) override {
+            client.sendBinary(message);
+            if (!arrived.try_acquire_for(std::chrono::seconds(5))) return false;
+            return received == message.size();
+        }
+
+        ~WebSocketEndpoint() override {
+            client.close();
+        }
+
+        WebSocketClient client;
+        std::binary_semaphore arrived{0};
+        size_t received = 0;
+    };
+
+    struct WebSocketTransport: Transport {
+
+        explicit WebSocketTransport(uint16_t port, size_t connections)
+            : port(port), server(port, "", "", std::min<size_t>(connections, std::thread::hardware_concurrency())) {
+            server.onBinaryMessage = [](WebSocketConnection* conn, std::span<const uint8_t> data) {
+                conn->sendBinary(data);
+            };
+            server.start();
+        }
+
+        std::unique_ptr<Endpoint> connect(size_t) override {
+            return std::make_unique<WebSocketEndpoint>(port);
+        }
+
+        ~WebSocketTransport() override {
+            server.stop();
+        }
+
+        uint16_t port;
+        WebSocket server;
+    };
+
+    // A message is the payload of a holding register read
+    struct ModbusEndpoint: Endpoint {
+
+        explicit ModbusEndpoint(uint16_t port)
+            : client("127.0.0.1", port) {}
+
+        bool roundTrip(std::span<const uint8_t> message) override {
+            const auto count = static_cast<uint16_t>(message.size() / 2);
+            return client.read_holding_registers(0, count).size() == count;
+        }
+
+        ModbusClient client;
+    };
+
+    struct ModbusTransport: Transport {
+
+        explicit ModbusTransport(uint16_t port)
+            : port(port), registers(125), server(registers, port) {
+            server.start();
+        }
+
+        std::unique_ptr<Endpoint> connect(size_t) override {
+            return std::make_unique<ModbusEndpoint>(port);
+        }
+
+        ~ModbusTransport() override {
+            server.stop();
+        }
+
+        uint16_t port;
+        HoldingRegister registers;
+        ModbusServer server;
+    };
+
+    // The largest message a transport carries, 0 for no limit
+    size_t maxMessageSize(const std::string& transport) {
+        if (transport == "udp") return 65507;
+        if (transport == "modbus") return 250;// 125 registers
+        return 0;
+    }
+
+    std::unique_ptr<Transport> makeTransport(const std::string& name, size_t connections) {
+        if (name == "udp") return std::make_unique<UdpTransport>();
+        if (name == "shm") return std::make_unique<SharedMemoryTransport>();
+        if (name == "unix") {
+#ifdef _WIN32
+            return std::make_unique<UnixTransport>("simple_socket_bench");
+#else
+            const auto domain = "/tmp/simple_socket_bench_" + std::to_string(getpid());
+            unlink(domain.c_str());
+            return std::make_unique<UnixTransport>(domain);
+#endif
+        }
+
+        const auto port = freePort();
+        if (!port) throw std::runtime_error("No free TCP port");
+        if (name == "tcp") return std::make_unique<TcpTransport>(*port);
+        if (name == "ws") return std::make_unique<WebSocketTransport>(*port, connections);
+        if (name == "modbus") return std::make_unique<ModbusTransport>(*port);
+        throw std::invalid_argument("Unknown transport: " + name);
+    }
+
+    struct Result {
+        std::string transport;
+        size_t size = 0;
+        size_t connections = 0;
+        size_t messages = 0;
+        size_t errors = 0;
+        double seconds = 0;
+        std::chrono::nanoseconds p50{}, p99{}, p999{};
+    };
+
+    // Round trips on every connection for duration, after a warm-up that is not measured
+    Result run(const std::string& name, size_t size, size_t connections, std::chrono::milliseconds duration) {
+        const auto transport = makeTransport(name, connections);
+        std::vector<std::unique_ptr<Endpoint>> endpoints;
+        for (size_t i = 0; i < connections; ++i) {
+            endpoints.push_back(transport->connect(size));
+        }
+
+        std::atomic_bool measuring{false};
+        std::atomic_bool done{false};
+        std::atomic_size_t errors{0};
+        std::vector<std::vector<std::chrono::nanoseconds>> latencies(connections);
+
+        std::vector<std::thread> clients;
+        for (size_t i = 0; i < connections; ++i) {
+            clients.emplace_back([&, i] {
+                const std::vector<uint8_t> message(size);
+                auto& samples = latencies[i];
+                samples.reserve(1 << 16);
+                while (!done) {
+                    const auto start = Clock::now();
+                    if (!endpoints[i]->roundTrip(message)) {
+                        ++errors;
+                        break;
+                    }
+                    if (measuring) samples.push_back(Clock::now() - start);
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::min(duration / 10, std::chrono::milliseconds(200)));
+        const auto start = Clock::now();
+        measuring = true;
+        std::this_thread::sleep_for(duration);
+        measuring = false;
+        const std::chrono::duration<double> elapsed = Clock::now() - start;
+        done = true;
+        for (auto& t : clients) t.join();
+        endpoints.clear();
+
+        std::vector<std::chrono::nanoseconds> all;
+        for (const auto& samples : latencies) all.insert(all.end(), samples.begin(), samples.end());
+        std::sort(all.begin(), all.end());
+        const auto percentile = [&](double p) {
+            if (all.empty()) return std::chrono::nanoseconds(0);
+            return all[std::min(all.size() - 1, static_cast<size_t>(p * static_cast<double>(all.size())))];
+        };
+
+        return {name, size, connections, all.size(), errors, elapsed.count(), percentile(0.5), percentile(0.99), percentile(0.999)};
+    }
+
+    void print(const Result& r, const std::string& format) {
+        const auto mps = static_cast<double>(r.messages) / r.seconds;
+        const auto mibps = mps * static_cast<double>(r.size) / (1024 * 1024);
+        const auto us = [](std::chrono::nanoseconds ns) { return static_cast<double>(ns.count()) / 1000; };
+
+        if (format == "csv") {
+            std::printf("%s,%zu,%zu,%zu,%.3f,%.1f,%.2f,%.2f,%.2f,%.2f,%zu\n",
+                        r.transport.c_str(), r.size, r.connections, r.messages, r.seconds, mps, mibps,
+                        us(r.p50), us(r.p99), us(r.p999), r.errors);
+        } else {
+            std::printf("{\"transport\":\"%s\",\"size\":%zu,\"connections\":%zu,\"messages\":%zu,\"seconds\":%.3f,"
+                        "\"messages_per_second\":%.1f,\"mib_per_second\":%.2f,"
+                        "\"p50_us\":%.2f,\"p99_us\":%.2f,\"p999_us\":%.2f,\"errors\":%zu}\n",
+                        r.transport.c_str(), r.size, r.connections, r.messages, r.seconds, mps, mibps,
+                        us(r.p50), us(r.p99), us(r.p999), r.errors);
+        }
+        std::fflush(stdout);
+    }
+
+    std::vector<std::string> split(const std::string& s) {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        while (start <= s.size()) {
+            const auto pos = std::min(s.find(',', start), s.size());
+            if (pos > start) parts.push_back(s.substr(start, pos - start));
+            start = pos + 1;
+        }
+        return parts;
+    }
+
+    std::vector<size_t> numbers(const std::string& s) {
+        std::vector<size_t> values;
+        for (const auto& part : split(s)) values.push_back(std::stoul(part));
+        return values;
+    }
+
+}// namespace
+
+int main(int argc, char** argv) {
+
+    std::map<std::string, std::string> args{
+            {"transports", "tcp,unix,udp,shm,ws,modbus"},
+            {"sizes", "64,1024,16384,65536"},
+            {"connections", "1,8"},
+            {"duration", "1000"},
+            {"format", "json"}};
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const auto eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == std::string::npos || !args.contains(arg.substr(2, eq - 2))) {
+            std::cerr << "usage: " << argv[0] << " [--transports=tcp,unix,udp,shm,ws,modbus] [--sizes=64,1024,16384,65536]"
+                      << " [--connections=1,8] [--duration=1000] [--format=json|csv]" << std::endl;
+            return 1;
+        }
+        args[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+
+    const auto transports = split(args["transports"]);
+    const auto sizes = numbers(args["sizes"]);
+    const auto connectionCounts = numbers(args["connections"]);
+    const std::chrono::milliseconds duration(std::stol(args["duration"]));
+    const auto& format = args["format"];
+
+    if (format == "csv") {
+        std::printf("transport,size,connections,messages,seconds,messages_per_second,mib_per_second,p50_us,p99_us,p999_us,errors\n");
+    }
+
+    int status = 0;
+    for (const auto& name : transports) {
+        for (const auto size : sizes) {
+            const auto limit = maxMessageSize(name);
+            if (limit > 0 && size > limit) {
+                std::cerr << name << ": skipping " << size << " bytes, larger than " << limit << std::endl;
+                continue;
+            }
+            for (const auto connections : connectionCounts) {
+                try {
+                    const auto result = run(name, size, connections, duration);
+                    if (result.errors > 0) status = 2;
+                    print(result, format);
+                } catch (const std::exception& e) {
+                    std::cerr << name << " (" << size << " bytes, " << connections << " connections): " << e.what() << std::endl;
+                    status = 2;
+                }
+            }
+        }
+    }
+
+    return status;
+}
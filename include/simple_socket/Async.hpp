@@ -0,0 +1,87 @@
+
+#ifndef SIMPLE_SOCKET_ASYNC_HPP
+#define SIMPLE_SOCKET_ASYNC_HPP
+
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/SimpleConnection.hpp"
+#include "simple_socket/Task.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <span>
+#include <string_view>
+
+// Coroutine versions of the blocking connection calls, driven by an EventLoop: a coroutine waiting for a socket
+// is suspended instead of blocking its thread, so a few loop threads can serve many thousands of connections.
+// Connections must be socket based (see EventLoop::watch); TCPServer::asyncAccept and TCPClientContext::asyncConnect
+// create them. A connection a coroutine waits on must not be closed by anyone else meanwhile.
+namespace simple_socket {
+
+    // Suspends until conn can be read (or written, with writable), see EventLoop::whenReady.
+    // The coroutine resumes on a loop thread, the one it was running on if it was.
+    class ReadyAwaiter {
+    public:
+        ReadyAwaiter(EventLoop& loop, SimpleConnection& conn, bool writable)
+            : loop_(loop), conn_(conn), writable_(writable) {}
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            loop_.whenReady(conn_, writable_, [handle] { handle.resume(); });
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        EventLoop& loop_;
+        SimpleConnection& conn_;
+        bool writable_;
+    };
+
+    // Suspends for delay, then resumes on a loop thread (the current one if called from one)
+    class SleepAwaiter {
+    public:
+        SleepAwaiter(EventLoop& loop, std::chrono::milliseconds delay)
+            : loop_(loop), delay_(delay) {}
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            const auto thread = loop_.currentThread();
+            if (thread) {
+                loop_.schedule(delay_, [handle] { handle.resume(); }, *thread);
+            } else {
+                loop_.schedule(delay_, [handle] { handle.resume(); });
+            }
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        EventLoop& loop_;
+        std::chrono::milliseconds delay_;
+    };
+
+    inline SleepAwaiter asyncSleep(EventLoop& loop, std::chrono::milliseconds delay) {
+        return {loop, delay};
+    }
+
+    // Like read(): the number of bytes read, as soon as any have arrived, or -1 once the connection is closed
+    Task<int> asyncRead(EventLoop& loop, SimpleConnection& conn, std::span<uint8_t> buffer);
+
+    // Like readExact(): false if the connection closed before buffer was filled
+    Task<bool> asyncReadExact(EventLoop& loop, SimpleConnection& conn, std::span<uint8_t> buffer);
+
+    // Like write(): completes once all of data has been handed to the OS, false if the connection failed.
+    // data must stay valid until then.
+    Task<bool> asyncWrite(EventLoop& loop, SimpleConnection& conn, std::span<const uint8_t> data);
+
+    Task<bool> asyncWrite(EventLoop& loop, SimpleConnection& conn, std::string_view data);
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_ASYNC_HPP
@@ -0,0 +1,113 @@
+
+#ifndef SIMPLE_SOCKET_BUFFERPOOL_HPP
+#define SIMPLE_SOCKET_BUFFERPOOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace simple_socket {
+
+    namespace detail {
+        struct BufferPoolState;
+    }
+
+    // A buffer drawn from a BufferPool, handed back to it when destroyed (also if the pool is gone by then). Move-only.
+    // Its contents start out uninitialized.
+    class PooledBuffer {
+    public:
+        PooledBuffer() = default;
+
+        PooledBuffer(PooledBuffer&& other) noexcept;
+        PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+
+        PooledBuffer(const PooledBuffer&) = delete;
+        PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+        [[nodiscard]] uint8_t* data() {
+            return data_;
+        }
+
+        [[nodiscard]] const uint8_t* data() const {
+            return data_;
+        }
+
+        uint8_t& operator[](size_t index) {
+            return data_[index];
+        }
+
+        const uint8_t& operator[](size_t index) const {
+            return data_[index];
+        }
+
+        [[nodiscard]] size_t size() const {
+            return size_;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return size_ == 0;
+        }
+
+        // The size of its size class, what the buffer can be resized to
+        [[nodiscard]] size_t capacity() const {
+            return capacity_;
+        }
+
+        // Throws std::length_error beyond capacity()
+        void resize(size_t size);
+
+        [[nodiscard]] std::span<uint8_t> span() {
+            return {data_, size_};
+        }
+
+        [[nodiscard]] std::span<const uint8_t> span() const {
+            return {data_, size_};
+        }
+
+        ~PooledBuffer();
+
+    private:
+        friend class BufferPool;
+
+        PooledBuffer(uint8_t* data, size_t size, size_t capacity, std::shared_ptr<detail::BufferPoolState> pool)
+            : data_(data), size_(size), capacity_(capacity), pool_(std::move(pool)) {}
+
+        void release();
+
+        uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+        size_t capacity_ = 0;
+        std::shared_ptr<detail::BufferPoolState> pool_;// empty for buffers too large to pool
+    };
+
+    // Free lists of buffers in power of two size classes (64 bytes and up), so traffic of similarly sized messages stops
+    // allocating once the lists are warm. Thread safe. Each thread keeps a few free buffers of the classes up to 64 KiB
+    // to itself, so a buffer acquired and released on the same thread never takes the pool's lock.
+    class BufferPool {
+    public:
+        struct Stats {
+            uint64_t acquired = 0; // acquire() calls for a non-empty buffer
+            uint64_t allocated = 0;// of those, how many had to allocate memory, 0 per message once the pool is warm
+        };
+
+        // Each size class keeps up to maxCachedPerClass free buffers shared between threads. Requests above
+        // maxPooledSize are allocated and freed directly, so one huge message does not pin its memory.
+        explicit BufferPool(size_t maxCachedPerClass = 64, size_t maxPooledSize = size_t{1} << 20);
+
+        // A buffer of size bytes (capacity rounded up to the size class)
+        [[nodiscard]] PooledBuffer acquire(size_t size);
+
+        // Counted since the pool was created
+        [[nodiscard]] Stats stats() const;
+
+        // Shared by the library's connections, unless they are given a pool of their own
+        static BufferPool& global();
+
+    private:
+        std::shared_ptr<detail::BufferPoolState> state_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_BUFFERPOOL_HPP
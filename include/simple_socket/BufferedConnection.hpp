@@ -0,0 +1,73 @@
+#ifndef SIMPLE_SOCKET_BUFFERED_CONNECTION_HPP
+#define SIMPLE_SOCKET_BUFFERED_CONNECTION_HPP
+
+#include "simple_socket/SimpleConnection.hpp"
+
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace simple_socket {
+
+    // Decorator that reads as much as the underlying connection has available into a user space buffer,
+    // so that small reads (readExact of a header, peek, readUntil) don't each cost a syscall.
+    // Not thread safe, reads must happen from one thread at a time.
+    class BufferedConnection: public SimpleConnection {
+    public:
+        explicit BufferedConnection(std::unique_ptr<SimpleConnection> conn, size_t bufferSize = 8192);
+
+        BufferedConnection(const BufferedConnection&) = delete;
+        BufferedConnection& operator=(const BufferedConnection&) = delete;
+
+        using SimpleConnection::read;
+        using SimpleConnection::tryRead;
+        using SimpleConnection::write;
+        using SimpleConnection::sendFile;
+
+        int read(uint8_t* buffer, size_t size) override;
+        // Serves buffered bytes first, then tries the underlying connection
+        int tryRead(uint8_t* buffer, size_t size) override;
+        bool write(const uint8_t* data, size_t size) override;
+        int tryWrite(const uint8_t* data, size_t size) override;
+        bool writev(std::span<const std::span<const uint8_t>> buffers) override;
+        // Forwarded, so the underlying connection's kernel path is kept
+        bool sendFile(int fd, uint64_t offset, uint64_t length) override;
+
+        // Returns the next size bytes without consuming them, blocking until they have arrived.
+        // The view is shorter if the connection closed first, and is valid until the next read.
+        // size is capped at the buffer size.
+        std::span<const uint8_t> peek(size_t size);
+
+        // Reads up to and including delimiter, the view is valid until the next read.
+        // Returns an empty view if the connection closed, or the buffer filled up before the delimiter was found.
+        std::span<const uint8_t> readUntil(std::string_view delimiter);
+
+        // Discards up to size buffered bytes, typically after a peek.
+        void consume(size_t size);
+
+        // Number of bytes that can be read without touching the underlying connection.
+        [[nodiscard]] size_t available() const;
+
+        // Issues a single read on the underlying connection. Returns the number of bytes buffered by it,
+        // 0 if the buffer is full, or -1 if the connection was closed.
+        int fill();
+
+        [[nodiscard]] size_t capacity() const;
+
+        [[nodiscard]] SimpleConnection& next() const;
+
+        // Those of the underlying connection
+        [[nodiscard]] ConnectionStats stats() const override;
+
+        void close() override;
+
+        ~BufferedConnection() override;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif// SIMPLE_SOCKET_BUFFERED_CONNECTION_HPP
@@ -0,0 +1,97 @@
+#ifndef SIMPLE_SOCKET_CONNECTION_POOL_HPP
+#define SIMPLE_SOCKET_CONNECTION_POOL_HPP
+
+#include "simple_socket/TCPSocket.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace simple_socket {
+
+    struct ConnectionPoolOptions {
+        // Connections per host:port, whether in use or idle
+        size_t maxPerHost = 4;
+        // Idle connections are closed once they have been unused this long
+        std::chrono::milliseconds maxIdle{std::chrono::seconds(60)};
+        // How long acquire() waits for a connection to be returned when maxPerHost are in use
+        std::chrono::milliseconds acquireTimeout{std::chrono::seconds(10)};
+        TCPConnectOptions connect;
+    };
+
+    // Keeps TCP (or TLS) connections open between uses, keyed by host and port. An idle connection is checked
+    // before it is handed out again, and replaced by a new one if the peer closed it or it is out of step.
+    // Thread safe. Leases may outlive the pool, their connections are then closed instead of returned.
+    class ConnectionPool {
+        struct Impl;
+
+    public:
+        // Exclusive use of a pooled connection, returned to the pool when the lease goes away
+        class Lease {
+        public:
+            Lease() = default;
+
+            Lease(Lease&& other) noexcept;
+            Lease& operator=(Lease&& other) noexcept;
+
+            [[nodiscard]] explicit operator bool() const {
+                return conn_ != nullptr;
+            }
+
+            [[nodiscard]] SimpleConnection* get() const {
+                return conn_.get();
+            }
+
+            SimpleConnection& operator*() const {
+                return *conn_;
+            }
+
+            SimpleConnection* operator->() const {
+                return conn_.get();
+            }
+
+            // Marks the connection as broken, it is closed instead of returned
+            void invalidate();
+
+            ~Lease();
+
+        private:
+            friend class ConnectionPool;
+
+            std::weak_ptr<Impl> pool_;
+            std::string key_;
+            std::unique_ptr<SimpleConnection> conn_;
+
+            Lease(std::weak_ptr<Impl> pool, std::string key, std::unique_ptr<SimpleConnection> conn);
+
+            void reset();
+        };
+
+        explicit ConnectionPool(const ConnectionPoolOptions& options = {});
+
+        ConnectionPool(const ConnectionPool&) = delete;
+        ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+        // A healthy idle connection to host:port, or a new one. Waits up to acquireTimeout while maxPerHost
+        // connections are in use. Returns an empty lease if no connection could be made.
+        [[nodiscard]] Lease acquire(const std::string& host, uint16_t port);
+
+        // Closes idle connections that have been unused for longer than maxIdle. Also happens as part of acquire().
+        void evictIdle();
+
+        // Closes all idle connections
+        void clear();
+
+        [[nodiscard]] size_t idleCount() const;
+
+        [[nodiscard]] TCPClientContext& context();
+
+        ~ConnectionPool();
+
+    private:
+        std::shared_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif// SIMPLE_SOCKET_CONNECTION_POOL_HPP
@@ -0,0 +1,83 @@
+
+#ifndef SIMPLE_SOCKET_EVENTLOOP_HPP
+#define SIMPLE_SOCKET_EVENTLOOP_HPP
+
+#include "simple_socket/SimpleConnection.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace simple_socket {
+
+    // A fixed set of threads, each running a readiness reactor (epoll/kqueue/WSAPoll).
+    // Watched connections are put in non-blocking mode and assigned round-robin to a thread,
+    // on which all of their callbacks are subsequently invoked.
+    class EventLoop {
+    public:
+        // With pinThreads, loop thread i is bound to CPU i (modulo the number of CPUs) where the platform allows it.
+        explicit EventLoop(size_t numThreads = 1, bool pinThreads = false);
+
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+        EventLoop(EventLoop&&) = delete;
+        EventLoop& operator=(EventLoop&&) = delete;
+
+        [[nodiscard]] size_t size() const;
+
+        // Runs task on one of the loop threads, or on a specific one (0 <= thread < size()).
+        void post(std::function<void()> task);
+
+        void post(std::function<void()> task, size_t thread);
+
+        // The index of the loop thread calling this, empty when called from any other thread
+        [[nodiscard]] std::optional<size_t> currentThread() const;
+
+        // Runs task on one of the loop threads once delay has passed, or on a specific one (0 <= thread < size()).
+        // Timers still pending when the loop stops never fire.
+        void schedule(std::chrono::milliseconds delay, std::function<void()> task);
+
+        void schedule(std::chrono::milliseconds delay, std::function<void()> task, size_t thread);
+
+        // Invokes onReadable whenever conn has data available (or has been closed by the peer).
+        // conn must be backed by a socket, i.e. created by TCPServer, TCPClientContext, UnixDomainServer or UnixDomainClientContext.
+        void watch(SimpleConnection& conn, std::function<void()> onReadable);
+
+        // As above, but on a specific loop thread (0 <= thread < size())
+        void watch(SimpleConnection& conn, std::function<void()> onReadable, size_t thread);
+
+        // Hands each connection accepted on listener, a listening socket such as the one of a TCPServer, to onAccepted
+        // until unwatch(listener), or nullptr for an accept that failed. Called on one loop thread, or a specific one.
+        // With the io_uring reactor the kernel completes the accepts, otherwise they are made once listener is readable.
+        void accept(SimpleConnection& listener, std::function<void(std::unique_ptr<SimpleConnection>)> onAccepted);
+
+        void accept(SimpleConnection& listener, std::function<void(std::unique_ptr<SimpleConnection>)> onAccepted, size_t thread);
+
+        // Invokes onWritable once, on the loop thread of the watched conn, when it can be written without blocking
+        // (or has failed). For output that is queued and written from the loop thread, such as a SendQueue; one
+        // notification may be pending per connection. Returns false, without effect, if conn is not watched.
+        bool whenWritable(SimpleConnection& conn, std::function<void()> onWritable);
+
+        // Stops callbacks for conn, and drops its pending whenReady notifications. Must be called before conn is closed or destroyed.
+        void unwatch(SimpleConnection& conn);
+
+        // Invokes onReady once, on a loop thread, when conn can be read (or written, with writable) without blocking,
+        // or has failed. Called from a loop thread, onReady runs on that same thread. This is what the coroutine operations
+        // in Async.hpp suspend on: one read and one write notification may be pending per connection at a time.
+        // Not to be combined with watch() for the same connection, which must not be closed while a notification is pending.
+        void whenReady(SimpleConnection& conn, bool writable, std::function<void()> onReady);
+
+        // Stops and joins all loop threads.
+        void stop();
+
+        ~EventLoop();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_EVENTLOOP_HPP
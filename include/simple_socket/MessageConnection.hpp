@@ -0,0 +1,70 @@
+
+#ifndef SIMPLE_SOCKET_MESSAGECONNECTION_HPP
+#define SIMPLE_SOCKET_MESSAGECONNECTION_HPP
+
+#include "simple_socket/BufferPool.hpp"
+#include "simple_socket/SimpleConnection.hpp"
+
+#include <bit>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace simple_socket {
+
+    struct MessageConnectionOptions {
+        // Longer messages are refused on both ends, guarding against corrupt or hostile length prefixes
+        size_t maxMessageSize = size_t{16} << 20;
+        // Of the 4 byte length prefix
+        std::endian byteOrder = std::endian::big;
+        // User space read buffer, so that small messages arriving together are read with one call into the connection
+        size_t readBufferSize = 8192;
+        // queue() writes the batch once this many bytes are waiting
+        size_t batchSize = 64 * 1024;
+        // Where received messages are drawn from, BufferPool::global() if null. Must outlive the connection.
+        BufferPool* pool = nullptr;
+    };
+
+    // Sends and receives whole messages over a stream connection, each prefixed by its length (4 bytes, uint32).
+    // One thread may read while another writes.
+    class MessageConnection {
+    public:
+        explicit MessageConnection(std::unique_ptr<SimpleConnection> conn, const MessageConnectionOptions& options = {});
+
+        MessageConnection(const MessageConnection&) = delete;
+        MessageConnection& operator=(const MessageConnection&) = delete;
+
+        // The next message, in a pooled buffer. Empty once the connection is closed, or if the peer announced a message
+        // longer than maxMessageSize (the stream can not be resynchronised then, so the connection is closed).
+        std::optional<PooledBuffer> read();
+
+        // Writes one message, prefix and payload in a single call. Queued messages are written ahead of it.
+        bool write(std::span<const uint8_t> message);
+
+        // Writes several messages back to back in a single call (writev)
+        bool write(std::span<const std::span<const uint8_t>> messages);
+
+        // Copies message into the batch, which is written once it reaches batchSize or on flush().
+        // Fails if the message is too long or writing the batch failed.
+        bool queue(std::span<const uint8_t> message);
+
+        // Writes the batch, if there is one
+        bool flush();
+
+        // Bytes waiting in the batch, prefixes included
+        [[nodiscard]] size_t queued() const;
+
+        [[nodiscard]] SimpleConnection& next() const;
+
+        void close();
+
+        ~MessageConnection();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_MESSAGECONNECTION_HPP
@@ -0,0 +1,119 @@
+
+#ifndef SIMPLE_SOCKET_METRICS_HPP
+#define SIMPLE_SOCKET_METRICS_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace simple_socket {
+
+    // True if the library was built with SIMPLE_SOCKET_WITH_METRICS. Otherwise counting is compiled out and every
+    // snapshot reads zero, apart from gauges such as queued bytes which are read off the live objects.
+    [[nodiscard]] bool metricsEnabled();
+
+    // Durations in power of two buckets: bucket i counts those shorter than 2^i ns and, but for bucket 0,
+    // at least 2^(i-1) ns. The last bucket also takes everything longer.
+    struct LatencySnapshot {
+        static constexpr size_t buckets = 40;// 2^39 ns is about 9 minutes
+
+        std::array<uint64_t, buckets> counts{};
+        uint64_t count = 0;
+        std::chrono::nanoseconds sum{0};
+
+        // The upper bound of the bucket the q-quantile (0 to 1) falls in, 0 if nothing was recorded
+        [[nodiscard]] std::chrono::nanoseconds quantile(double q) const;
+
+        [[nodiscard]] std::chrono::nanoseconds mean() const;
+
+        // What bucket holds is shorter than this
+        [[nodiscard]] static std::chrono::nanoseconds upperBound(size_t bucket);
+    };
+
+    struct ConnectionStats {
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
+        // System calls, including those that found nothing to read or no room to write. For TLS connections the
+        // calls into OpenSSL, which make as many system calls as they need.
+        uint64_t readCalls = 0;
+        uint64_t writeCalls = 0;
+        // Of message based connections (WebSocket)
+        uint64_t messagesReceived = 0;
+        uint64_t messagesSent = 0;
+        // Waiting in the send queue right now
+        uint64_t queuedBytes = 0;
+
+        ConnectionStats& operator+=(const ConnectionStats& other) {
+            bytesRead += other.bytesRead;
+            bytesWritten += other.bytesWritten;
+            readCalls += other.readCalls;
+            writeCalls += other.writeCalls;
+            messagesReceived += other.messagesReceived;
+            messagesSent += other.messagesSent;
+            queuedBytes += other.queuedBytes;
+            return *this;
+        }
+    };
+
+    struct TCPServerStats {
+        uint64_t accepted = 0;
+        uint64_t acceptFailures = 0;
+        // Of accept() calls that returned a connection or failed, including socket options and the TLS handshake
+        LatencySnapshot acceptLatency;
+    };
+
+    struct WebSocketServerStats {
+        uint64_t accepted = 0;
+        uint64_t handshakesFailed = 0;
+        // Connections accepted and not yet closed, including ones still in their handshake
+        uint64_t open = 0;
+        // Summed over every connection the server had, queuedBytes over the open ones
+        ConnectionStats traffic;
+        // Time spent in onMessage and onBinaryMessage
+        LatencySnapshot messageHandling;
+    };
+
+    struct ModbusClientStats {
+        uint64_t transactions = 0;
+        // Requests that got no valid response
+        uint64_t failures = 0;
+        // Requests sent again on a new connection after the pooled one failed
+        uint64_t reconnects = 0;
+        // From sending the request to having the response, pipelined requests included
+        LatencySnapshot transactionLatency;
+    };
+
+    // Renders snapshots in the Prometheus text exposition format, as metrics named simple_socket_*.
+    // labels, e.g. R"(server="api")", tell several objects of a kind apart.
+    class PrometheusWriter {
+    public:
+        void write(const ConnectionStats& stats, std::string_view labels = {});
+        void write(const TCPServerStats& stats, std::string_view labels = {});
+        void write(const WebSocketServerStats& stats, std::string_view labels = {});
+        void write(const ModbusClientStats& stats, std::string_view labels = {});
+
+        // Everything written so far, each metric with its HELP and TYPE lines and all of its samples
+        [[nodiscard]] std::string str() const;
+
+    private:
+        struct Family {
+            std::string help;
+            std::string type;
+            std::string samples;
+        };
+        std::map<std::string, Family, std::less<>> families_;
+
+        void counter(std::string_view name, std::string_view help, std::string_view labels, uint64_t value);
+        void gauge(std::string_view name, std::string_view help, std::string_view labels, uint64_t value);
+        void histogram(std::string_view name, std::string_view help, std::string_view labels, const LatencySnapshot& snapshot);
+        Family& family(std::string_view name, std::string_view help, std::string_view type);
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_METRICS_HPP
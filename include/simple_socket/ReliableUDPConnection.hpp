@@ -0,0 +1,83 @@
+
+#ifndef SIMPLE_SOCKET_RELIABLE_UDP_CONNECTION_HPP
+#define SIMPLE_SOCKET_RELIABLE_UDP_CONNECTION_HPP
+
+#include "simple_socket/SimpleConnection.hpp"
+#include "simple_socket/UDPSocket.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <span>
+
+namespace simple_socket {
+
+    // How a message sent with ReliableUDPConnection::send is delivered
+    enum class UDPDelivery : uint8_t {
+        ReliableOrdered,  // retransmitted until acknowledged, delivered in order (what write() uses)
+        ReliableUnordered,// retransmitted until acknowledged, delivered as soon as it arrives
+        Unreliable        // sent once, may be lost
+    };
+
+    struct ReliableUDPOptions {
+        // Retransmission timeout before the round trip time has been measured, and the bounds of the measured one
+        std::chrono::milliseconds initialRto{100};
+        std::chrono::milliseconds minRto{10};
+        std::chrono::milliseconds maxRto{1000};
+
+        // The connection fails (reads return -1, writes false) once a message has been retransmitted this many times
+        size_t maxRetransmits = 30;
+
+        // Unacknowledged messages per reliable channel before write() blocks. Both ends must use the same window.
+        size_t window = 256;
+
+        // Payload bytes per datagram; write() splits larger data, send() rejects larger messages.
+        // Keep datagrams below the path MTU, the default fits IPv6's minimum of 1280 bytes.
+        size_t maxPayload = 1200;
+
+        // Receives messages sent with ReliableUnordered or Unreliable, on the connection's receive thread.
+        // Without it these are dropped.
+        std::function<void(UDPDelivery, std::span<const uint8_t>)> onMessage;
+
+        // Drops this share (0..1) of outgoing datagrams, for testing loss recovery
+        double simulatedLoss = 0;
+    };
+
+    // Reliable, ordered messaging over UDP between two fixed endpoints, with per-message sequence numbers,
+    // selective acknowledgements and retransmit timers driven by the measured round trip time.
+    // Lost datagrams are repaired as soon as later ones are acknowledged past them, and the unordered and unreliable
+    // channels are never held up by a loss on another channel, so tail latency on lossy links stays below TCP's.
+    // Both ends construct one, for each other's endpoint; there is no handshake.
+    class ReliableUDPConnection: public SimpleConnection {
+    public:
+        ReliableUDPConnection(int localPort, const UDPEndpoint& peer, const ReliableUDPOptions& options = {});
+        ~ReliableUDPConnection() override;
+
+        ReliableUDPConnection(const ReliableUDPConnection&) = delete;
+        ReliableUDPConnection& operator=(const ReliableUDPConnection&) = delete;
+
+        using SimpleConnection::read;
+        using SimpleConnection::tryRead;
+        using SimpleConnection::write;
+
+        // The ReliableOrdered channel as a byte stream, like a TCP connection.
+        // read() returns -1 once the connection is closed or failed and everything received has been read.
+        int read(uint8_t* buffer, size_t size) override;
+        int tryRead(uint8_t* buffer, size_t size) override;
+        bool write(const uint8_t* data, size_t size) override;
+
+        // One message of at most maxPayload bytes. Blocks while the channel's window is full (reliable channels only).
+        // ReliableOrdered messages become part of the stream read() returns, the others go to onMessage.
+        bool send(std::span<const uint8_t> message, UDPDelivery delivery);
+
+        // Returns immediately, messages not yet acknowledged are dropped. The peer is told (best effort) the connection is closed.
+        void close() override;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_RELIABLE_UDP_CONNECTION_HPP
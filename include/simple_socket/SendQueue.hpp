@@ -0,0 +1,78 @@
+
+#ifndef SIMPLE_SOCKET_SENDQUEUE_HPP
+#define SIMPLE_SOCKET_SENDQUEUE_HPP
+
+#include "simple_socket/BufferPool.hpp"
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/SimpleConnection.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace simple_socket {
+
+    // What becomes of a message pushed while more than highWatermark bytes are queued
+    enum class OverflowPolicy {
+        DropOldest,// queued messages are dropped, oldest first, to make room
+        DropNewest,// the message is dropped
+        Conflate,  // as DropNewest, keyed messages replace a queued one with the same key regardless
+        Disconnect // the connection is shut down
+    };
+
+    struct SendQueueOptions {
+        // With a flushDelay, queued messages are written once this many bytes are waiting, or when the delay has passed
+        size_t flushThreshold = 16 * 1024;
+        // How long messages wait for more to be written along with them. With 0 they are written on the next
+        // iteration of the loop, together with whatever else was queued until then.
+        std::chrono::milliseconds flushDelay{0};
+        // Messages are copied into one buffer of up to this size, which is written with a single call.
+        // Larger messages are written on their own, straight from where they are queued.
+        size_t batchSize = 64 * 1024;
+
+        // Bounds the bytes queued for a peer that does not keep up
+        size_t highWatermark = size_t{64} << 20;
+        size_t lowWatermark = size_t{16} << 20;
+        OverflowPolicy overflow = OverflowPolicy::Disconnect;
+        // Called on the loop thread once the queue, having gone above highWatermark, is down to lowWatermark
+        std::function<void()> onDrain;
+    };
+
+    // Outgoing messages of a connection watched by an EventLoop, written by the loop thread of the connection as
+    // the socket accepts them. Senders never block on a slow peer, and many small messages cost one write.
+    // Thread safe.
+    class SendQueue {
+    public:
+        SendQueue(EventLoop& loop, SimpleConnection& conn, const SendQueueOptions& options = {});
+
+        SendQueue(const SendQueue&) = delete;
+        SendQueue& operator=(const SendQueue&) = delete;
+
+        // Queues a copy of data. Returns false if the message was dropped, the queue is closed or writing has failed.
+        // With OverflowPolicy::Conflate, a message with a key replaces the one with the same key still waiting, if any.
+        bool push(std::span<const uint8_t> data, std::optional<uint64_t> key = std::nullopt);
+
+        bool push(PooledBuffer data, std::optional<uint64_t> key = std::nullopt);
+
+        // A message shared with other queues, e.g. a broadcast frame
+        bool push(std::shared_ptr<const PooledBuffer> data, std::optional<uint64_t> key = std::nullopt);
+
+        // Bytes waiting to be written
+        [[nodiscard]] size_t queued() const;
+
+        // Writes what it can of the queue without blocking and stops writing. Must be called before the connection
+        // is unwatched or closed; the destructor does it, too.
+        void close();
+
+        ~SendQueue();
+
+    private:
+        struct Impl;
+        std::shared_ptr<Impl> pimpl_;// shared with the loop callbacks
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_SENDQUEUE_HPP
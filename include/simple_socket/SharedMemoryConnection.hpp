@@ -4,13 +4,52 @@
 #include "simple_socket/SimpleConnection.hpp"
 
 #include <memory>
+#include <span>
 #include <string>
 
 namespace simple_socket {
 
+    // How a reader waits for a message, and a writer for room in the ring
+    enum class WaitPolicy {
+        Block,        // sleep on a semaphore right away
+        Spin,         // busy-poll, burning a core for the lowest and most predictable latency. Needs a core per spinner.
+        SpinThenYield,// busy-poll spinCount times, then keep polling but yield the core in between
+        SpinThenBlock // busy-poll spinCount times, then sleep on a semaphore
+    };
+
+    struct SharedMemoryOptions {
+        // Number of maximum sized messages each direction can hold before write() blocks.
+        // Smaller messages take less room, so more of them can be in flight.
+        size_t slots = 4;
+
+        // SharedMemoryPublisher only: how many subscribers can be attached at the same time
+        size_t maxSubscribers = 8;
+
+        // Local to each side, the peer may use a different policy
+        WaitPolicy waitPolicy = WaitPolicy::Block;
+        size_t spinCount = 10000;
+
+        // Memory placement. Creating the segment fails if an option can not be honoured.
+        // Back the segment with huge pages. On Linux from hugetlbfs mounted at hugePageDirectory (both sides must
+        // agree on it), or transparent huge pages when the directory is empty. On Windows with large pages,
+        // which needs SeLockMemoryPrivilege.
+        bool hugePages = false;
+        std::string hugePageDirectory = "/dev/hugepages";
+        // Fault in all pages when mapping, instead of on first touch
+        bool populate = false;
+        // Keep the mapping resident (mlock / VirtualLock)
+        bool lockMemory = false;
+        // Place the segment's memory on this NUMA node, set by the server. -1 leaves it to the OS.
+        int numaNode = -1;
+    };
+
+    // Message oriented connection between two processes on the same host. Each direction is a lock-free
+    // single-producer/single-consumer ring in the shared segment, semaphores are only touched when a reader
+    // finds the ring empty or a writer finds it full.
+    // The server creates the segment, the client attaches to it and takes its layout (slots) from the server.
     class SharedMemoryConnection: public SimpleConnection {
     public:
-        SharedMemoryConnection(const std::string& name, size_t size, bool isServer);
+        SharedMemoryConnection(const std::string& name, size_t size, bool isServer, const SharedMemoryOptions& options = {});
         ~SharedMemoryConnection() override;
 
         SharedMemoryConnection(const SharedMemoryConnection&) = delete;
@@ -19,8 +58,23 @@ namespace simple_socket {
         using SimpleConnection::read;
         using SimpleConnection::write;
 
+        // Reads one message. Returns -1, dropping the message, if it does not fit in buffer.
         int read(uint8_t* buffer, size_t size) override;
+        // Writes one message of at most the size given to the constructor
         bool write(const uint8_t* data, size_t size) override;
+
+        // Zero-copy writing: lends out room for a message of up to size bytes directly in the ring, blocking until
+        // there is room. Fill it, then commit() the number of bytes written. write() fails while a buffer is lent out.
+        // Returns an empty span if size exceeds the maximum message size or a buffer is already lent out.
+        std::span<uint8_t> acquireWriteBuffer(size_t size);
+        // Publishes the first size bytes of the lent buffer as one message, 0 hands the buffer back unsent
+        bool commit(size_t size);
+
+        // Zero-copy reading: the next message, in place in the ring, blocking until there is one.
+        // The view stays valid until release(), which frees the room for the writer. read() fails in between.
+        std::span<const uint8_t> acquireReadView();
+        void release();
+
         void close() override;
 
     private:
@@ -0,0 +1,94 @@
+#ifndef SIMPLE_SOCKET_SHARED_MEMORY_PUB_SUB_HPP
+#define SIMPLE_SOCKET_SHARED_MEMORY_PUB_SUB_HPP
+
+#include "simple_socket/SharedMemoryConnection.hpp"
+
+#include <memory>
+#include <span>
+#include <string>
+#include <type_traits>
+
+namespace simple_socket {
+
+    // One writer, many readers on the same host. Messages are written once into a ring in the shared segment,
+    // every subscriber reads them in place through its own cursor, so adding subscribers adds no copies.
+    // The publisher never overwrites a message an attached subscriber has yet to read: a full ring makes publish()
+    // wait for the slowest one, as the WaitPolicy says. Subscribers only see messages published after they attached,
+    // and with no subscribers attached messages are simply dropped.
+    // Subscribers whose process died without closing are detached when they hold the publisher back.
+    class SharedMemoryPublisher {
+    public:
+        // Creates the segment. options.slots and options.maxSubscribers size it, placement options apply as for
+        // SharedMemoryConnection.
+        SharedMemoryPublisher(const std::string& name, size_t maxMessageSize, const SharedMemoryOptions& options = {});
+
+        SharedMemoryPublisher(const SharedMemoryPublisher&) = delete;
+        SharedMemoryPublisher& operator=(const SharedMemoryPublisher&) = delete;
+
+        bool publish(const uint8_t* data, size_t size);
+
+        template<typename Container>
+        bool publish(const Container& data) {
+            static_assert(
+                    std::is_same<decltype(data.data()), const uint8_t*>::value ||
+                            std::is_same<decltype(data.data()), const char*>::value,
+                    "Container must provide contiguous data()");
+            return publish(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+        }
+
+        // Zero-copy publishing, see SharedMemoryConnection::acquireWriteBuffer
+        std::span<uint8_t> acquireWriteBuffer(size_t size);
+        bool commit(size_t size);
+
+        [[nodiscard]] size_t subscriberCount() const;
+
+        // Wakes up subscribers, which see the end of the stream once they have read what is left
+        void close();
+
+        ~SharedMemoryPublisher();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+    class SharedMemorySubscriber {
+    public:
+        // Attaches to a publisher's segment. Throws if there is none, or all its subscriber slots are taken.
+        // Only the wait policy and placement options (hugePages, populate, lockMemory) are used.
+        explicit SharedMemorySubscriber(const std::string& name, const SharedMemoryOptions& options = {});
+
+        SharedMemorySubscriber(const SharedMemorySubscriber&) = delete;
+        SharedMemorySubscriber& operator=(const SharedMemorySubscriber&) = delete;
+
+        // Reads the next message. Returns -1 once the publisher has closed and everything was read,
+        // or, dropping the message, if it does not fit in buffer.
+        int read(uint8_t* buffer, size_t size);
+
+        template<typename Container>
+        int read(Container& buffer) {
+            static_assert(
+                    std::is_same<decltype(buffer.data()), uint8_t*>::value ||
+                            std::is_same<decltype(buffer.data()), char*>::value,
+                    "Container must provide contiguous data()");
+            return read(reinterpret_cast<uint8_t*>(buffer.data()), buffer.size());
+        }
+
+        // Zero-copy reading, see SharedMemoryConnection::acquireReadView. The view stays valid until release(),
+        // holding the publisher back while it is kept. Empty once the publisher has closed and everything was read.
+        std::span<const uint8_t> acquireReadView();
+        void release();
+
+        // Detaches, so the publisher no longer waits for this subscriber
+        void close();
+
+        ~SharedMemorySubscriber();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif// SIMPLE_SOCKET_SHARED_MEMORY_PUB_SUB_HPP
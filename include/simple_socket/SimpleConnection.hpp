@@ -1,9 +1,17 @@
 #ifndef SIMPLE_SOCKET_SIMPLE_CONNECTION_HPP
 #define SIMPLE_SOCKET_SIMPLE_CONNECTION_HPP
 
+#include "simple_socket/Metrics.hpp"
+
+#include <algorithm>
 #include <cstdint>
 #include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 namespace simple_socket {
 
@@ -12,6 +20,19 @@ namespace simple_socket {
         virtual int read(uint8_t* buffer, size_t size) = 0;
         virtual bool write(const uint8_t* data, size_t size) = 0;
 
+        // Non-blocking read, meant for EventLoop callbacks: returns the number of bytes read, 0 if nothing can be read
+        // right now, or -1 once the connection is closed. Connections without a non-blocking mode fall back to read().
+        virtual int tryRead(uint8_t* buffer, size_t size) {
+            return read(buffer, size);
+        }
+
+        // Non-blocking write, the counterpart of tryRead: returns the number of bytes written, which may be fewer than size,
+        // 0 if nothing can be written right now, or -1 on failure. Connections without a non-blocking mode fall back to write().
+        virtual int tryWrite(const uint8_t* data, size_t size) {
+            size = std::min<size_t>(size, std::numeric_limits<int>::max());
+            return write(data, size) ? static_cast<int>(size) : -1;
+        }
+
         bool readExact(uint8_t* buffer, size_t size) {
             size_t totalBytesReceived = 0;
             while (totalBytesReceived < size) {
@@ -37,6 +58,16 @@ namespace simple_socket {
             return read(reinterpret_cast<uint8_t*>(buffer.data()), buffer.size());
         }
 
+        template <typename Container>
+        int tryRead(Container& buffer) {
+            static_assert(
+                std::is_same<decltype(buffer.data()), uint8_t*>::value ||
+                std::is_same<decltype(buffer.data()), char*>::value,
+                "Container must provide contiguous data()"
+            );
+            return tryRead(reinterpret_cast<uint8_t*>(buffer.data()), buffer.size());
+        }
+
         template <typename Container>
         bool readExact(Container& buffer) {
             return readExact(reinterpret_cast<uint8_t*>(buffer.data()), buffer.size());
@@ -63,6 +94,38 @@ namespace simple_socket {
             return write(reinterpret_cast<const uint8_t*>(data), length);
         }
 
+        // Writes the buffers back to back, as if they were one contiguous buffer.
+        // Socket based connections hand them to the OS in a single call (writev/WSASend),
+        // the default implementation coalesces them into one write, preserving message boundaries.
+        virtual bool writev(std::span<const std::span<const uint8_t>> buffers) {
+            if (buffers.size() == 1) {
+                return write(buffers.front().data(), buffers.front().size());
+            }
+
+            std::vector<uint8_t> data;
+            size_t size = 0;
+            for (const auto& buffer : buffers) size += buffer.size();
+            data.reserve(size);
+            for (const auto& buffer : buffers) data.insert(data.end(), buffer.begin(), buffer.end());
+
+            return write(data.data(), data.size());
+        }
+
+        // Writes length bytes of the open file fd (a POSIX, or on Windows CRT, file descriptor) from offset.
+        // Socket based connections have the kernel copy straight from the page cache (sendfile, TransmitFile),
+        // also TLS connections with kernel offload. Otherwise the file is read in chunks which are write()n.
+        // Returns false if writing fails or the file ends first.
+        virtual bool sendFile(int fd, uint64_t offset, uint64_t length);
+
+        // As above for the file at path. Without length, everything from offset to the end of the file is sent.
+        bool sendFile(const std::string& path, uint64_t offset = 0, std::optional<uint64_t> length = std::nullopt);
+
+        // What went through the connection so far. Socket based connections count their bytes and system calls,
+        // in builds with SIMPLE_SOCKET_WITH_METRICS, others report nothing.
+        [[nodiscard]] virtual ConnectionStats stats() const {
+            return {};
+        }
+
         virtual void close() = 0;
 
         virtual ~SimpleConnection() = default;
@@ -0,0 +1,49 @@
+
+#ifndef SIMPLE_SOCKET_SOCKETOPTIONS_HPP
+#define SIMPLE_SOCKET_SOCKETOPTIONS_HPP
+
+#include <chrono>
+#include <optional>
+
+namespace simple_socket {
+
+    // Kernel level tuning, applied when a socket is created (and to every connection a server accepts).
+    // Each option only applies to the kinds of socket it makes sense for, options a platform lacks are ignored.
+    struct SocketOptions {
+        // TCP: send small writes right away instead of waiting to coalesce them with later ones (disables Nagle).
+        // Writes are already coalesced into as few packets as possible, so this is on by default.
+        bool noDelay = true;
+
+        // TCP, Linux: acknowledge received data right away instead of delaying it. The kernel may return
+        // to delayed acknowledgements later on, so this mostly helps request/response exchanges right after connecting.
+        bool quickAck = false;
+
+        // SO_SNDBUF/SO_RCVBUF in bytes, the kernel default if unset. Set before connecting/listening,
+        // so TCP can scale its window to the receive buffer.
+        std::optional<int> sendBufferSize;
+        std::optional<int> receiveBufferSize;
+
+        // Linux: microseconds to busy-poll the device queue for incoming data before sleeping (SO_BUSY_POLL),
+        // trading CPU for receive latency. Values above the sysctl net.core.busy_read need CAP_NET_ADMIN.
+        std::optional<int> busyPollMicros;
+
+        // TCP: probe idle connections, to notice peers that went away without closing. Zero durations and counts
+        // keep the system defaults (two hours idle on most systems).
+        bool keepAlive = false;
+        std::chrono::seconds keepAliveIdle{0};
+        std::chrono::seconds keepAliveInterval{0};
+        int keepAliveProbes = 0;
+
+        // TCP Fast Open: lets a client that connected before send its first request in the SYN, saving a round trip.
+        // Servers accept it. Clients do not request it (TCP_FASTOPEN_CONNECT): their connect() would return before the
+        // server answered, leaving no way to fall back to another address or to time out the connect.
+        bool fastOpen = false;
+
+        // Linux: the CPU whose receive queue feeds the socket (SO_INCOMING_CPU). On SO_REUSEPORT listeners
+        // it steers connections arriving on that CPU to the listener, keeping them on one cache.
+        std::optional<int> incomingCpu;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_SOCKETOPTIONS_HPP
@@ -2,23 +2,89 @@
 #ifndef SIMPLE_SOCKET_TCPSOCKET_HPP
 #define SIMPLE_SOCKET_TCPSOCKET_HPP
 
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/Metrics.hpp"
 #include "simple_socket/SocketContext.hpp"
+#include "simple_socket/SocketOptions.hpp"
+#include "simple_socket/Task.hpp"
 
+#include <chrono>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
 
 namespace simple_socket {
 
+    struct TCPConnectOptions {
+        bool useTLS = false;
+        // Deadline for resolving the host and establishing the connection
+        std::chrono::milliseconds timeout{std::chrono::seconds(10)};
+        // Head start each resolved address gets before the next one is tried in parallel (happy eyeballs, RFC 8305)
+        std::chrono::milliseconds attemptDelay{250};
+        // With useTLS, lets the Linux kernel encrypt and decrypt records after the handshake (kTLS), saving a copy
+        // per byte. Needs OpenSSL built with kTLS and the tls kernel module, TLS stays in user space otherwise.
+        bool kernelTLS = false;
+        SocketOptions socketOptions;
+    };
+
     class TCPClientContext: public SocketContext {
     public:
+        // Resolved host names are reused for dnsCacheTtl, 0 disables the cache
+        explicit TCPClientContext(std::chrono::seconds dnsCacheTtl = std::chrono::seconds(30));
+
+        // host is a name, or an IPv4 or IPv6 address. Returns nullptr if no connection could be made in time.
+        [[nodiscard]] std::unique_ptr<SimpleConnection> connect(const std::string& host, uint16_t port, const TCPConnectOptions& options);
+
         [[nodiscard]] std::unique_ptr<SimpleConnection> connect(const std::string& ip, uint16_t port, bool useTLS = false);
 
         [[nodiscard]] std::unique_ptr<SimpleConnection> connect(const std::string& host) override;
+
+        // Connects on a separate thread, so many connections can be established in parallel
+        [[nodiscard]] std::future<std::unique_ptr<SimpleConnection>> connectAsync(const std::string& host, uint16_t port, const TCPConnectOptions& options = {});
+
+        // As connect, for coroutines: the connection attempts and the TLS handshake are driven by loop's readiness
+        // notifications, host names missing from the cache are resolved on a separate thread that loop polls.
+        // No loop thread blocks meanwhile. The TLS handshake gets timeout of its own. The awaiting coroutine
+        // resumes on a thread of loop (the one it was running on if it was) with the non-blocking connection.
+        Task<std::unique_ptr<SimpleConnection>> asyncConnect(EventLoop& loop, std::string host, uint16_t port, TCPConnectOptions options = {});
+
+        void clearDnsCache();
+
+        // Forgets the TLS sessions kept for resumption, the next connection to each server takes a full handshake
+        void clearTlsSessions();
+
+        ~TCPClientContext() override;
+
+    private:
+        struct Impl;
+        std::shared_ptr<Impl> pimpl_;
+    };
+
+    struct TCPServerOptions {
+        int backlog = 128;
+        bool useTLS = false;
+        std::string certFile;
+        std::string keyFile;
+        // Allows rebinding the port while old connections linger in TIME_WAIT (ignored on Windows)
+        bool reuseAddress = true;
+        // acceptAsync opens one SO_REUSEPORT listener per EventLoop thread, so the kernel spreads
+        // incoming connections across threads (Linux only, a single listener is used elsewhere)
+        bool reusePort = false;
+        // See TCPConnectOptions::kernelTLS
+        bool kernelTLS = false;
+        // Connections accepted by acceptAsync or asyncAccept complete their TLS handshake on the loop without
+        // blocking it, those that take longer are closed
+        std::chrono::milliseconds tlsHandshakeTimeout{10000};
+        // Applied to the listener and to every accepted connection
+        SocketOptions socketOptions;
     };
 
     class TCPServer {
     public:
-        explicit TCPServer(uint16_t port, int backlog = 1, bool useTLS = false, const std::string& cert_file = "", const std::string& key_file = "");
+        explicit TCPServer(uint16_t port, int backlog = 128, bool useTLS = false, const std::string& cert_file = "", const std::string& key_file = "");
+
+        TCPServer(uint16_t port, const TCPServerOptions& options);
 
         TCPServer(const TCPServer&) = delete;
         TCPServer& operator=(const TCPServer&) = delete;
@@ -27,6 +93,18 @@ namespace simple_socket {
 
         std::unique_ptr<SimpleConnection> accept();
 
+        // Accepts connections on a thread of loop instead of blocking in accept().
+        // onConnection is invoked on that loop thread for every new client. loop must outlive the server.
+        void acceptAsync(EventLoop& loop, std::function<void(std::unique_ptr<SimpleConnection>)> onConnection);
+
+        // Accepts the next connection from a coroutine, suspending while none is pending. Not to be combined with
+        // acceptAsync. Throws like accept() on failure. A pending accept is abandoned, never resumed, if the server closes.
+        // With TLS, the connection is returned once its handshake completed.
+        Task<std::unique_ptr<SimpleConnection>> asyncAccept(EventLoop& loop);
+
+        // Counted in builds with SIMPLE_SOCKET_WITH_METRICS
+        [[nodiscard]] TCPServerStats stats() const;
+
         void close();
 
         ~TCPServer();
@@ -0,0 +1,193 @@
+
+#ifndef SIMPLE_SOCKET_TASK_HPP
+#define SIMPLE_SOCKET_TASK_HPP
+
+#include "simple_socket/EventLoop.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace simple_socket {
+
+    template<class T = void>
+    class Task;
+
+    namespace detail {
+
+        struct TaskPromiseBase {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr error;
+
+            // resumes whoever awaited the task, on the thread that finished it
+            struct FinalAwaiter {
+                [[nodiscard]] bool await_ready() const noexcept {
+                    return false;
+                }
+
+                template<class Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+                    const auto continuation = h.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() noexcept {
+                return {};
+            }
+
+            void unhandled_exception() noexcept {
+                error = std::current_exception();
+            }
+
+            void rethrow() const {
+                if (error) std::rethrow_exception(error);
+            }
+        };
+
+        template<class T>
+        struct TaskPromise: TaskPromiseBase {
+            std::optional<T> value;
+
+            Task<T> get_return_object() noexcept;
+
+            template<class U>
+            void return_value(U&& v) {
+                value.emplace(std::forward<U>(v));
+            }
+
+            T result() {
+                rethrow();
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct TaskPromise<void>: TaskPromiseBase {
+            Task<void> get_return_object() noexcept;
+
+            void return_void() noexcept {}
+
+            void result() const {
+                rethrow();
+            }
+        };
+
+    }// namespace detail
+
+    // A lazily started coroutine producing a T. It runs when first co_awaited, and the awaiting coroutine resumes when
+    // it completes, on whichever thread it completed (for the Async.hpp operations, the loop thread that woke it up).
+    // Exceptions propagate to the awaiting coroutine. Tasks are awaited once; destroying one that never ran is fine,
+    // destroying a running one is not.
+    template<class T>
+    class [[nodiscard]] Task {
+    public:
+        using promise_type = detail::TaskPromise<T>;
+
+        Task(Task&& other) noexcept
+            : handle_(std::exchange(other.handle_, nullptr)) {}
+
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                if (handle_) handle_.destroy();
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        auto operator co_await() && noexcept {
+            struct Awaiter {
+                std::coroutine_handle<promise_type> handle;
+
+                [[nodiscard]] bool await_ready() const noexcept {
+                    return !handle || handle.done();
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+
+                T await_resume() {
+                    return handle.promise().result();
+                }
+            };
+            return Awaiter{handle_};
+        }
+
+        ~Task() {
+            if (handle_) handle_.destroy();
+        }
+
+    private:
+        friend promise_type;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+            : handle_(handle) {}
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    namespace detail {
+
+        template<class T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept {
+            return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+            return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+        }
+
+        // Owns itself: started by spawn, freed when it completes
+        struct Detached {
+            struct promise_type {
+                Detached get_return_object() noexcept {
+                    return Detached{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                std::suspend_always initial_suspend() noexcept {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept {
+                    return {};
+                }
+
+                void return_void() noexcept {}
+
+                void unhandled_exception() noexcept {}
+            };
+
+            std::coroutine_handle<promise_type> handle;
+        };
+
+        inline Detached runDetached(Task<void> task) {
+            // like exceptions from EventLoop callbacks, one escaping a spawned task is dropped
+            try {
+                co_await std::move(task);
+            } catch (...) {}
+        }
+
+    }// namespace detail
+
+    // Starts task on a loop thread without waiting for it, e.g. one per accepted connection.
+    // Tasks suspended when the loop stops are never resumed (their frames are leaked, like pending timers are dropped).
+    inline void spawn(EventLoop& loop, Task<void> task) {
+        const auto handle = detail::runDetached(std::move(task)).handle;
+        loop.post([handle] { handle.resume(); });
+    }
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_TASK_HPP
@@ -2,11 +2,17 @@
 #ifndef SIMPLE_SOCKET_UDPSOCKET_HPP
 #define SIMPLE_SOCKET_UDPSOCKET_HPP
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "simple_socket/SimpleConnection.hpp"
+#include "simple_socket/SocketOptions.hpp"
 
 #ifndef MAX_UDP_PACKET_SIZE
 #define MAX_UDP_PACKET_SIZE 65507
@@ -14,9 +20,62 @@
 
 namespace simple_socket {
 
+    // An IPv4 or IPv6 address and port, parsed once and kept in the form the socket API takes (a sockaddr_storage)
+    class UDPEndpoint {
+    public:
+        UDPEndpoint() = default;
+
+        // Numeric addresses only, no name resolution. Returns nothing if address is not one.
+        static std::optional<UDPEndpoint> parse(const std::string& address, uint16_t port);
+
+        // From a sockaddr of size bytes, as filled in by the socket API
+        static UDPEndpoint fromNative(const void* addr, size_t size);
+
+        [[nodiscard]] std::string address() const;
+
+        [[nodiscard]] uint16_t port() const;
+
+        [[nodiscard]] bool isV6() const;
+
+        // The sockaddr behind it, for use with the socket API
+        [[nodiscard]] const void* native() const {
+            return storage_.data();
+        }
+
+        [[nodiscard]] size_t nativeSize() const {
+            return size_;
+        }
+
+        bool operator==(const UDPEndpoint& other) const;
+
+    private:
+        alignas(8) std::array<uint8_t, 128> storage_{};
+        size_t size_ = 0;
+    };
+
+    // One datagram of a batch
+    struct UDPMessage {
+        // Sending: the payload. Receiving: room for the datagram, longer ones are truncated.
+        std::span<uint8_t> buffer;
+        // Receiving: bytes written to buffer
+        size_t size = 0;
+        // Sending: the destination. Receiving: the sender.
+        UDPEndpoint peer;
+        // Receiving: the datagram did not fit in buffer
+        bool truncated = false;
+        // Sending: if non-zero, buffer is sent as datagrams of this many bytes (the last may be shorter),
+        // segmented by the kernel (UDP GSO) where available. At most 64 segments and MAX_UDP_PACKET_SIZE bytes in all.
+        // Receiving: the size of the datagrams buffer holds, back to back (the last may be shorter).
+        // Only differs from size when several were coalesced, see UDPSocket::setGro.
+        size_t segmentSize = 0;
+    };
+
     class UDPSocket {
     public:
-        explicit UDPSocket(int localPort);
+        // With ipv6, the socket is dual-stack and reaches both IPv4 and IPv6 peers.
+        // With reuseAddress, several sockets on this host can bind localPort, e.g. to each receive a multicast group.
+        // Of options, the buffer sizes, busyPollMicros and incomingCpu apply.
+        explicit UDPSocket(int localPort, bool ipv6 = false, bool reuseAddress = false, const SocketOptions& options = {});
 
         bool sendTo(const std::string& address, uint16_t remotePort, const std::string& data);
 
@@ -24,14 +83,54 @@ namespace simple_socket {
 
         bool sendTo(const std::string& address, uint16_t remotePort, const uint8_t* data, size_t size);
 
+        bool sendTo(const UDPEndpoint& to, std::span<const uint8_t> data);
+
+        // The address and port arguments of the recvFrom overloads below are not used to filter,
+        // they receive from any sender. Prefer recvFrom(buffer), which reports it.
         int recvFrom(const std::string& address, uint16_t remotePort, std::vector<uint8_t>& buffer);
 
         int recvFrom(const std::string& address, uint16_t remotePort, uint8_t* buffer, size_t size);
 
         [[nodiscard]] std::string recvFrom(const std::string& address, uint16_t remotePort);
 
+        // Receives one datagram into buffer, returns its size (-1 on error) and its sender
+        std::pair<int, UDPEndpoint> recvFrom(std::span<uint8_t> buffer);
+
+        // Sends every message, with as few syscalls as the platform allows (sendmmsg on Linux).
+        // Returns how many were sent, stopping at the first that fails, or -1 if none could be.
+        int sendBatch(std::span<const UDPMessage> messages);
+
+        // Blocks until at least one datagram arrives, then fills in as many messages as there are datagrams queued,
+        // with as few syscalls as the platform allows (recvmmsg on Linux). Returns how many, or -1 on error.
+        int recvBatch(std::span<UDPMessage> messages);
+
+        // Lets the kernel coalesce consecutive datagrams from the same sender into one buffer (UDP GRO, Linux only),
+        // which recvBatch then reports through UDPMessage::segmentSize. Buffers should hold MAX_UDP_PACKET_SIZE bytes.
+        // Returns false if not supported.
+        bool setGro(bool enable);
+
+        // Multicast: one datagram sent to a group reaches every socket that joined it, bound to the port it was sent to.
+        // group is an IPv4 or IPv6 multicast address (IPv6 ones need an ipv6 socket). interfaceIndex selects
+        // the interface (see if_nametoindex), 0 lets the OS choose.
+        bool joinGroup(const std::string& group, unsigned interfaceIndex = 0);
+
+        bool leaveGroup(const std::string& group, unsigned interfaceIndex = 0);
+
+        // How many routers datagrams sent to a group may cross, the default 1 keeps them on the local network
+        bool setMulticastTtl(int ttl);
+
+        // Whether datagrams sent to a group also reach members on this host (the default)
+        bool setMulticastLoopback(bool enable);
+
+        // The interface datagrams sent to a group leave through
+        bool setMulticastInterface(unsigned interfaceIndex);
+
+        // Connects the socket to the peer, after which it only exchanges datagrams with it, using send/recv.
+        // The connection must not outlive the socket.
         std::unique_ptr<SimpleConnection> makeConnection(const std::string& address, uint16_t remotePort);
 
+        std::unique_ptr<SimpleConnection> makeConnection(const UDPEndpoint& peer);
+
         void close();
 
         ~UDPSocket();
@@ -3,20 +3,38 @@
 #define SIMPLE_SOCKET_UNIXDOMAINSOCKET_HPP
 
 #include "simple_socket/SocketContext.hpp"
+#include "simple_socket/SocketOptions.hpp"
 
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace simple_socket {
 
+    enum class UnixSocketType {
+        Stream,  // a byte stream, like TCP
+        SeqPacket// preserves message boundaries: every write() is read() as one message, truncated if the buffer is
+                 // too small. Messages must not be empty. Not available on Windows or macOS.
+    };
+
     class UnixDomainClientContext: public SocketContext {
     public:
+        // type must match the server's
+        explicit UnixDomainClientContext(UnixSocketType type = UnixSocketType::Stream);
+
         [[nodiscard]] std::unique_ptr<SimpleConnection> connect(const std::string& domain) override;
+
+    private:
+        UnixSocketType type_;
     };
 
     class UnixDomainServer {
     public:
-        explicit UnixDomainServer(const std::string& domain, int backlog = 1);
+        // Only the buffer sizes of options apply, to the listener and every accepted connection
+        explicit UnixDomainServer(const std::string& domain, int backlog = 1, const SocketOptions& options = {});
+
+        UnixDomainServer(const std::string& domain, UnixSocketType type, int backlog = 1, const SocketOptions& options = {});
 
         [[nodiscard]] std::unique_ptr<SimpleConnection> accept();
 
@@ -29,6 +47,20 @@ namespace simple_socket {
         std::unique_ptr<Impl> pimpl_;
     };
 
+    // Open file descriptors can be handed to the peer of a Unix domain connection (SCM_RIGHTS), e.g. a memfd or shared
+    // memory segment, which both processes then use without copying. conn must come from UnixDomainServer or
+    // UnixDomainClientContext. Not available on Windows.
+    constexpr size_t maxPassedFds = 64;// per message
+
+    // Writes data, which must not be empty, with duplicates of fds attached. The caller keeps its own descriptors.
+    bool writeWithFds(SimpleConnection& conn, std::span<const uint8_t> data, std::span<const int> fds);
+
+    // Reads like SimpleConnection::read, appending any descriptors that came with the data to fds.
+    // They belong to the caller, which must close them. On a stream socket, the descriptors arrive with the
+    // first byte of the write they were attached to, so read exactly up to message boundaries to keep them aligned.
+    // Fails if a message carried more than maxPassedFds descriptors, none of them is returned then.
+    int readWithFds(SimpleConnection& conn, std::span<uint8_t> buffer, std::vector<int>& fds);
+
 }// namespace simple_socket
 
 #endif//SIMPLE_SOCKET_UNIXDOMAINSOCKET_HPP
@@ -2,24 +2,90 @@
 #ifndef SIMPLE_SOCKET_WEBSOCKET_HPP
 #define SIMPLE_SOCKET_WEBSOCKET_HPP
 
+#include "simple_socket/Metrics.hpp"
+#include "simple_socket/SendQueue.hpp"
+
+#include <chrono>
 #include <functional>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace simple_socket {
 
+    // RFC 7692 permessage-deflate, requires a build with SIMPLE_SOCKET_WITH_ZLIB
+    struct PerMessageDeflateOptions {
+        bool enabled = false;
+        // LZ77 window sizes (9-15), smaller windows use less memory per connection at the cost of compression ratio
+        int serverMaxWindowBits = 15;
+        int clientMaxWindowBits = 15;
+        // Compress every message independently, rather than referencing previous messages
+        bool serverNoContextTakeover = false;
+        bool clientNoContextTakeover = false;
+        int compressionLevel = 6;
+        // Smaller messages are sent uncompressed
+        size_t minCompressSize = 64;
+    };
+
+    // Pings peers that have gone quiet, to find connections that died without being closed, e.g. when the host
+    // of the peer lost power. Both ends answer pings either way.
+    struct HeartbeatOptions {
+        // How long a connection may be idle before its peer is pinged, 0 disables the heartbeat
+        std::chrono::milliseconds pingInterval{0};
+        // A pinged peer that sends nothing within this time, not even the pong, is disconnected
+        std::chrono::milliseconds pongTimeout{10000};
+    };
+
     class WebSocketConnection {
 
     public:
         WebSocketConnection();
 
+        // Tells the connections of a server apart, including ones that have closed, so it may be kept to address
+        // the connection through WebSocket::send after it is gone. 0 for the connection of a WebSocketClient.
+        [[nodiscard]] uint64_t id() const {
+            return id_;
+        }
+
+        // A random UUID, generated on first use
         const std::string& uuid();
 
+        // The subprotocol agreed on in the handshake of a server connection, empty if there is none
+        [[nodiscard]] const std::string& subprotocol() const {
+            return subprotocol_;
+        }
+
         virtual void send(const std::string& msg) = 0;
 
+        // Sends data as a binary (opcode 0x2) message
+        virtual void sendBinary(std::span<const uint8_t> data) = 0;
+
+        // As above. When the server's send queue uses OverflowPolicy::Conflate, the message replaces the one
+        // with the same key that is still waiting to be sent, e.g. an older value of the same quantity.
+        virtual void send(const std::string& msg, uint64_t /*key*/) {
+            send(msg);
+        }
+
+        virtual void sendBinary(std::span<const uint8_t> data, uint64_t /*key*/) {
+            sendBinary(data);
+        }
+
+        // The transport's stats with the messages received and sent, and what waits in the send queue
+        [[nodiscard]] virtual ConnectionStats stats() const {
+            return {};
+        }
+
         virtual ~WebSocketConnection() = default;
 
+    protected:
+        uint64_t id_ = 0;
+        std::string subprotocol_;
+
     private:
+        std::once_flag uuidOnce_;
         std::string uuid_;
     };
 
@@ -29,11 +95,64 @@ namespace simple_socket {
         std::function<void(WebSocketConnection*)> onOpen;
         std::function<void(WebSocketConnection*)> onClose;
         std::function<void(WebSocketConnection*, const std::string&)> onMessage;
+        // The view points into the connection's receive buffer and is only valid during the call
+        std::function<void(WebSocketConnection*, std::span<const uint8_t>)> onBinaryMessage;
+        // A connection whose queue went above sendQueue.highWatermark is down to its lowWatermark again
+        std::function<void(WebSocketConnection*)> onDrain;
+
+        // Offered to clients during the handshake, set before start()
+        PerMessageDeflateOptions perMessageDeflate;
+
+        // Sec-WebSocket-Protocol values the server speaks, in order of preference, set before start().
+        // The first of them a client asks for is agreed on, clients asking for none of them get none.
+        std::vector<std::string> subprotocols;
+
+        // Connections that have not completed their upgrade request by then are closed
+        std::chrono::milliseconds handshakeTimeout{10000};
+
+        // For all connections of the server, timed together by the loop threads, set before start()
+        HeartbeatOptions heartbeat;
 
-        explicit WebSocket(uint16_t port, const std::string& cert_file = "", const std::string& key_file = "");
+        // Messages to a connection are queued and written by the loop thread serving it, set before start().
+        // Its watermarks and overflow policy keep clients that fall behind from piling up memory.
+        SendQueueOptions sendQueue;
+
+        // Connections are served by an event loop running on numThreads threads.
+        explicit WebSocket(uint16_t port, const std::string& cert_file = "", const std::string& key_file = "", size_t numThreads = 1);
 
         void start();
 
+        // Sends a message to every open connection and returns the number of recipients.
+        // The frame is encoded once and shared by all connections, it is never compressed.
+        size_t broadcast(const std::string& message);
+
+        size_t broadcastBinary(std::span<const uint8_t> data);
+
+        // Adds conn to a topic, connections are removed from their topics when they close
+        void subscribe(WebSocketConnection* conn, const std::string& topic);
+
+        void unsubscribe(WebSocketConnection* conn, const std::string& topic);
+
+        // Like broadcast, limited to the connections subscribed to topic. With OverflowPolicy::Conflate only the
+        // latest message of a topic waits in the queue of a client that is behind.
+        size_t publish(const std::string& topic, const std::string& message);
+
+        size_t publishBinary(const std::string& topic, std::span<const uint8_t> data);
+
+        // Sends a message to the open connection with the given id(), false if there is none
+        bool send(uint64_t id, const std::string& message);
+
+        bool sendBinary(uint64_t id, std::span<const uint8_t> data);
+
+        // Shuts the connection down, its onClose follows on its loop thread. False if no open connection has the id.
+        bool disconnect(uint64_t id);
+
+        // Connections accepted and not yet closed, including ones still in their handshake
+        [[nodiscard]] size_t connectionCount() const;
+
+        // Counted in builds with SIMPLE_SOCKET_WITH_METRICS, but for the open connections and their queued bytes
+        [[nodiscard]] WebSocketServerStats stats() const;
+
         void stop();
 
         ~WebSocket();
@@ -49,6 +168,14 @@ namespace simple_socket {
         std::function<void(WebSocketConnection*)> onOpen;
         std::function<void(WebSocketConnection*)> onClose;
         std::function<void(WebSocketConnection*, const std::string&)> onMessage;
+        // The view points into the connection's receive buffer and is only valid during the call
+        std::function<void(WebSocketConnection*, std::span<const uint8_t>)> onBinaryMessage;
+
+        // Requested from the server during the handshake, set before connect()
+        PerMessageDeflateOptions perMessageDeflate;
+
+        // Set before connect(). The heartbeats of all clients are timed together, on a thread they share.
+        HeartbeatOptions heartbeat;
 
         WebSocketClient();
 
@@ -56,6 +183,8 @@ namespace simple_socket {
 
         void send(const std::string& msg);
 
+        void sendBinary(std::span<const uint8_t> data);
+
         void close();
 
         ~WebSocketClient();
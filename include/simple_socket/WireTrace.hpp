@@ -0,0 +1,59 @@
+
+#ifndef SIMPLE_SOCKET_WIRETRACE_HPP
+#define SIMPLE_SOCKET_WIRETRACE_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace simple_socket {
+
+    struct WireTraceOptions {
+        // Bytes kept of every read and write, the length of the rest is still recorded
+        size_t snapLength = 2048;
+        // Of the ring each thread doing I/O records into. What finds its ring full is dropped rather than waited for.
+        size_t ringSize = size_t{1} << 20;
+        // How often the rings are drained into the file
+        std::chrono::milliseconds flushInterval{100};
+    };
+
+    struct WireTraceStats {
+        uint64_t frames = 0; // written to the file
+        uint64_t dropped = 0;// found a full ring
+    };
+
+    // Captures what TCP, Unix domain and TLS connections read and write, as the application sees it (TLS in
+    // plaintext), into a pcapng file for Wireshark. Every read and write becomes a TCP segment between the
+    // endpoints of its connection with made up IP and TCP headers, whose sequence numbers count the bytes of each
+    // direction, so Wireshark reassembles streams and dissects Modbus TCP, HTTP and WebSocket as usual. Unix domain
+    // connections are given loopback addresses. What sendFile had the kernel send is read back from the file, and a
+    // connection being destroyed ends its stream with a FIN.
+    //
+    // Connections stamp their frames and copy them into a lock-free ring of their thread, a thread of the trace
+    // drains the rings and does the file I/O. One trace runs at a time in a process, and while none does a read
+    // or write costs a single relaxed load.
+    class WireTrace {
+    public:
+        // Starts tracing into a new file at path. Throws if it can not be created, or another trace is running.
+        explicit WireTrace(const std::string& path, const WireTraceOptions& options = {});
+
+        WireTrace(const WireTrace&) = delete;
+        WireTrace& operator=(const WireTrace&) = delete;
+
+        [[nodiscard]] WireTraceStats stats() const;
+
+        // Stops tracing and writes out what the rings still hold. Frames recorded while stopping may be missed.
+        void stop();
+
+        ~WireTrace();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_WIRETRACE_HPP
@@ -0,0 +1,43 @@
+#ifndef SIMPLE_SOCKET_COILREGISTER_HPP
+#define SIMPLE_SOCKET_COILREGISTER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+
+namespace simple_socket {
+
+    // Single-bit points: coils, or discrete inputs when clients may only read them. Stored bit-packed and,
+    // like HoldingRegister, read without locking, so a range read always sees the bits as one write left them.
+    class CoilRegister {
+    public:
+        explicit CoilRegister(size_t numCoils);
+
+        size_t size() const;
+
+        void set(size_t index, bool value);
+
+        bool get(size_t index) const;
+
+        // Copies count bits starting at index into packed, 8 per byte with the first in the least significant bit,
+        // the way Modbus sends them. packed must hold at least (count + 7) / 8 bytes.
+        void readRange(size_t index, size_t count, std::span<uint8_t> packed) const;
+
+        // Writes count bits from packed (same layout as above) starting at index, readers see none or all of them
+        void writeRange(size_t index, size_t count, std::span<const uint8_t> packed);
+
+    private:
+        size_t size_;
+        std::unique_ptr<std::atomic<uint8_t>[]> bits_;
+
+        std::mutex writeMutex_;
+        alignas(64) std::atomic<uint64_t> sequence_{0};
+
+        void checkBounds(size_t index, size_t count) const;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_COILREGISTER_HPP
@@ -2,19 +2,66 @@
 #ifndef SIMPLE_SOCKET_HOLDINGREGISTER_HPP
 #define SIMPLE_SOCKET_HOLDINGREGISTER_HPP
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <vector>
 
 namespace simple_socket {
 
+    // Registers shared between the application and ModbusServer. Reads never block: they are retried if a write
+    // overlapped them (a seqlock), so any read, single value or range, sees the registers as one write left them.
+    // Writes are serialized with each other.
     class HoldingRegister {
     public:
+        // Changes are tracked per block of this many registers
+        static constexpr size_t blockSize = 16;
+
+        struct Range {
+            size_t index;
+            size_t count;
+        };
+
+        // Collects the blocks whose values writes changed, until they are taken. Each subscription sees
+        // every change, so a consumer can push deltas instead of diffing the whole bank.
+        class Subscription {
+        public:
+            // Returns what changed since the last call, waiting up to timeout for something to change.
+            // Adjacent blocks are merged into one range, which is empty if nothing changed in time.
+            std::vector<Range> wait(std::chrono::milliseconds timeout);
+
+            // As above, without waiting
+            std::vector<Range> poll();
+
+            // Stops tracking, the register may be destroyed before or after its subscriptions
+            ~Subscription();
+
+        private:
+            friend class HoldingRegister;
+            struct State;
+
+            explicit Subscription(std::shared_ptr<State> state);
+
+            std::shared_ptr<State> state_;
+        };
+
         // Constructor to initialize with a specific number of registers
         explicit HoldingRegister(size_t numRegisters);
 
         size_t size() const;
 
+        // Copies out.size() registers starting at index, as one consistent snapshot
+        void readRange(size_t index, std::span<uint16_t> out) const;
+
+        // Writes values to the registers starting at index; readers see either none or all of them
+        void writeRange(size_t index, std::span<const uint16_t> values);
+
+        // Starts tracking changes, for as long as the subscription lives
+        std::unique_ptr<Subscription> subscribe();
+
         // Method to set a uint16_t value at a specific register index
         void setUint16(size_t index, uint16_t value);
 
@@ -46,8 +93,14 @@ namespace simple_socket {
         double getDouble(size_t index) const;
 
     private:
-        mutable std::mutex m_;
-        std::vector<uint16_t> registers_;
+        size_t size_;
+        std::unique_ptr<std::atomic<uint16_t>[]> registers_;
+
+        std::mutex writeMutex_;
+        // odd while a write is in progress, on its own cache line as every reader polls it
+        alignas(64) std::atomic<uint64_t> sequence_{0};
+
+        std::vector<std::shared_ptr<Subscription::State>> subscriptions_;// guarded by writeMutex_
 
         // Check if the register access is within bounds
         void checkBounds(size_t index, size_t count) const;
@@ -2,17 +2,28 @@
 #ifndef SIMPLE_SOCKET_MODBUSCLIENT_HPP
 #define SIMPLE_SOCKET_MODBUSCLIENT_HPP
 
+#include "simple_socket/Metrics.hpp"
+
+#include <future>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
 namespace simple_socket {
 
+    class ConnectionPool;
+
     class ModbusClient {
 
     public:
+        // Connects right away, throws if the server can not be reached
         ModbusClient(const std::string& host, uint16_t port);
 
+        // Draws a connection from pool for every request, so clients of the same server can share connections.
+        // pool must outlive the client.
+        ModbusClient(ConnectionPool& pool, const std::string& host, uint16_t port);
+
         ModbusClient(const ModbusClient&) = delete;
         ModbusClient& operator=(const ModbusClient&) = delete;
         ModbusClient(ModbusClient&&) = delete;
@@ -20,6 +31,9 @@ namespace simple_socket {
 
         std::vector<uint16_t> read_holding_registers(uint16_t address, uint16_t count, uint8_t unit_id = 1);
 
+        // Reads out.size() registers, at most 125, into out without allocating
+        void read_holding_registers(uint16_t address, std::span<uint16_t> out, uint8_t unit_id = 1);
+
         uint16_t read_uint16(uint16_t address, uint8_t unit_id = 1);
         uint32_t read_uint32(uint16_t address, uint8_t unit_id = 1);
         uint64_t read_uint64(uint16_t address, uint8_t unit_id = 1);
@@ -37,6 +51,29 @@ namespace simple_socket {
             return write_multiple_registers(address, values.data(), values.size(), unitID);
         }
 
+        std::vector<bool> read_coils(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+        std::vector<bool> read_discrete_inputs(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+        std::vector<uint16_t> read_input_registers(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+
+        bool write_single_coil(uint16_t address, bool value, uint8_t unit_id = 1);
+        bool write_multiple_coils(uint16_t address, const std::vector<bool>& values, uint8_t unitID = 1);
+
+        // Writes size registers at writeAddress, then reads readCount registers at readAddress, in one round trip
+        std::vector<uint16_t> read_write_multiple_registers(uint16_t readAddress, uint16_t readCount,
+                                                            uint16_t writeAddress, const uint16_t* values, size_t size, uint8_t unitID = 1);
+
+        // Pipelined requests: each goes out without waiting for the responses to earlier ones, so polling many blocks
+        // takes about one round trip. Responses are matched to requests by transaction ID. The first of these calls
+        // opens a connection the client keeps for pipelining, plain TCP only, which synchronous requests then share.
+        // I/O errors are reported through the future, and are not retried.
+        std::future<std::vector<uint16_t>> read_holding_registers_async(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+        std::future<bool> write_single_register_async(uint16_t address, uint16_t value, uint8_t unit_id = 1);
+        // values are copied before this returns
+        std::future<bool> write_multiple_registers_async(uint16_t address, const uint16_t* values, size_t size, uint8_t unitID = 1);
+
+        // Counted in builds with SIMPLE_SOCKET_WITH_METRICS
+        [[nodiscard]] ModbusClientStats stats() const;
+
         ~ModbusClient();
 
     private:
@@ -0,0 +1,72 @@
+
+#ifndef SIMPLE_SOCKET_MODBUS_READ_PLAN_HPP
+#define SIMPLE_SOCKET_MODBUS_READ_PLAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+namespace simple_socket {
+
+    class ModbusClient;
+
+    enum class ModbusType {
+        Uint16,
+        Uint32,
+        Uint64,
+        Float,
+        Double
+    };
+
+    // A value to read: holding registers starting at address, decoded as type (big-endian word order)
+    struct ModbusTag {
+        uint16_t address;
+        ModbusType type;
+        uint8_t unitId = 1;
+    };
+
+    using ModbusValue = std::variant<uint16_t, uint32_t, uint64_t, float, double>;
+
+    // Reads a list of tags with as few Read Holding Registers (0x03) requests as possible. Tags close to each
+    // other are merged into one request as long as it stays within the 125 registers the protocol allows.
+    // Built once, executed as often as needed.
+    class ModbusReadPlan {
+    public:
+        static constexpr uint16_t maxRegistersPerRequest = 125;
+
+        struct Request {
+            uint8_t unitId;
+            uint16_t address;
+            uint16_t count;
+        };
+
+        // gapTolerance is the number of unused registers a request may read to cover two tags at once,
+        // trading a few bytes on the wire for a round trip
+        explicit ModbusReadPlan(std::vector<ModbusTag> tags, uint16_t gapTolerance = 8);
+
+        [[nodiscard]] const std::vector<ModbusTag>& tags() const;
+
+        [[nodiscard]] const std::vector<Request>& requests() const;
+
+        // Sends every request pipelined and decodes the values, in the order of tags.
+        // Throws if any of the requests fails.
+        [[nodiscard]] std::vector<ModbusValue> execute(ModbusClient& client) const;
+
+    private:
+        struct Location {
+            size_t request;
+            uint16_t offset;
+        };
+
+        std::vector<ModbusTag> tags_;
+        std::vector<Request> requests_;
+        std::vector<Location> locations_;// where each tag is found, by tag index
+    };
+
+    // Number of registers a value of type occupies
+    uint16_t registerCount(ModbusType type);
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_MODBUS_READ_PLAN_HPP
@@ -0,0 +1,52 @@
+#ifndef SIMPLE_SOCKET_MODBUSRTUCLIENT_HPP
+#define SIMPLE_SOCKET_MODBUSRTUCLIENT_HPP
+
+#include "simple_socket/SimpleConnection.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace simple_socket {
+
+    // Modbus RTU master: frames of unit id, PDU and CRC-16 over any connection, a serial port wrapped in a
+    // SimpleConnection or a TCP connection to an RTU-over-TCP gateway. A bus serves one request at a time,
+    // so concurrent calls are serialized. A missing reply blocks for as long as a read on conn does.
+    class ModbusRtuClient {
+
+    public:
+        // Largest PDU (function code and data) Modbus allows
+        static constexpr size_t maxPduSize = 253;
+
+        explicit ModbusRtuClient(std::unique_ptr<SimpleConnection> conn);
+
+        ModbusRtuClient(const ModbusRtuClient&) = delete;
+        ModbusRtuClient& operator=(const ModbusRtuClient&) = delete;
+        ModbusRtuClient(ModbusRtuClient&&) = delete;
+        ModbusRtuClient& operator=(ModbusRtuClient&&) = delete;
+
+        std::vector<uint16_t> read_holding_registers(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+        std::vector<uint16_t> read_input_registers(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+        std::vector<bool> read_coils(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+        std::vector<bool> read_discrete_inputs(uint16_t address, uint16_t count, uint8_t unit_id = 1);
+
+        bool write_single_register(uint16_t address, uint16_t value, uint8_t unit_id = 1);
+        bool write_multiple_registers(uint16_t address, const uint16_t* values, size_t size, uint8_t unitID = 1);
+        bool write_single_coil(uint16_t address, bool value, uint8_t unit_id = 1);
+
+        // Sends request, a PDU, to unitId as it is and copies the PDU of the reply into response (at least maxPduSize bytes).
+        // Returns its size, 0 for broadcasts (unit 0) which are not answered. Lets a gateway forward the PDUs of
+        // Modbus TCP requests without decoding them. Throws std::runtime_error if the exchange fails.
+        size_t transact(uint8_t unitId, std::span<const uint8_t> request, std::span<uint8_t> response);
+
+        ~ModbusRtuClient();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_MODBUSRTUCLIENT_HPP
@@ -2,17 +2,48 @@
 #ifndef SIMPLE_SOCKET_MODBUSSERVER_HPP
 #define SIMPLE_SOCKET_MODBUSSERVER_HPP
 
+#include "CoilRegister.hpp"
 #include "HoldingRegister.hpp"
 
-
+#include <chrono>
 #include <memory>
 
 namespace simple_socket {
 
+    // The tables a server exposes. Any may be left out, requests for it are answered with Illegal Function.
+    struct ModbusDataModel {
+        HoldingRegister* holdingRegisters = nullptr;
+        HoldingRegister* inputRegisters = nullptr;// read-only to clients
+        CoilRegister* coils = nullptr;
+        CoilRegister* discreteInputs = nullptr;// read-only to clients
+    };
+
+    enum class ModbusFraming {
+        Tcp,       // MBAP header, the standard Modbus TCP
+        RtuOverTcp // unit id and CRC-16, as RTU devices behind transparent serial-to-Ethernet converters expect
+    };
+
+    struct ModbusServerOptions {
+        // Clients are served by an event loop running on numThreads threads.
+        size_t numThreads = 1;
+        // Connections beyond this many are closed right after being accepted
+        size_t maxClients = 64;
+        // Clients that send nothing for this long are disconnected, zero to keep them forever
+        std::chrono::milliseconds idleTimeout = std::chrono::seconds(60);
+        ModbusFraming framing = ModbusFraming::Tcp;
+    };
+
     class ModbusServer {
 
     public:
-        explicit ModbusServer(HoldingRegister& reg, uint16_t port);
+        // Clients are served by an event loop running on numThreads threads.
+        // Neither their number nor their idle time is limited, use ModbusServerOptions for that.
+        explicit ModbusServer(HoldingRegister& reg, uint16_t port, size_t numThreads = 1);
+
+        ModbusServer(HoldingRegister& reg, uint16_t port, const ModbusServerOptions& options);
+
+        // Tables in model must outlive the server
+        ModbusServer(const ModbusDataModel& model, uint16_t port, const ModbusServerOptions& options = {});
 
         ModbusServer(const ModbusServer&) = delete;
         ModbusServer& operator=(const ModbusServer&) = delete;
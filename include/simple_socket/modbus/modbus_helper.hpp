@@ -3,12 +3,130 @@
 #define SIMPLE_SOCKET_MODBUS_HELPER_HPP
 
 #include <array>
+#include <bit>
+#include <cstdint>
 #include <cstring>
+#include <span>
 #include <sstream>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace simple_socket {
 
+    // The order of the registers of a value that spans several. Modbus puts the most significant first,
+    // many devices store 32 and 64-bit values with the least significant first ("word swapped").
+    enum class WordOrder {
+        HighFirst,
+        LowFirst
+    };
+
+    namespace detail {
+
+        template<typename T>
+        using register_bits_t = std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+
+        // Swaps the bytes of count 16-bit words from in to out, 8 words at a time where there are vector instructions
+        inline void swap_register_bytes(const uint8_t* in, uint8_t* out, size_t count) {
+            size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+            for (; i + 8 <= count; i += 8) {
+                const auto words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8)));
+            }
+#elif defined(__ARM_NEON)
+            for (; i + 8 <= count; i += 8) {
+                vst1q_u8(out + i * 2, vrev16q_u8(vld1q_u8(in + i * 2)));
+            }
+#endif
+            for (; i < count; ++i) {
+                out[i * 2] = in[i * 2 + 1];
+                out[i * 2 + 1] = in[i * 2];
+            }
+        }
+
+        inline void copy_registers(const uint8_t* in, uint8_t* out, size_t count) {
+            if constexpr (std::endian::native == std::endian::big) {
+                std::memcpy(out, in, count * 2);
+            } else {
+                swap_register_bytes(in, out, count);
+            }
+        }
+
+    }// namespace detail
+
+    // Decodes the big endian registers of a PDU, 2 bytes each, into out in one pass
+    inline void decode_registers(std::span<const uint8_t> bytes, std::span<uint16_t> out) {
+        if (bytes.size() != out.size() * 2) {
+            throw std::out_of_range("Register data does not match the number of registers.");
+        }
+        detail::copy_registers(bytes.data(), reinterpret_cast<uint8_t*>(out.data()), out.size());
+    }
+
+    // Encodes registers into out, big endian as in a PDU
+    inline void encode_registers(std::span<const uint16_t> registers, std::span<uint8_t> out) {
+        if (out.size() != registers.size() * 2) {
+            throw std::out_of_range("Register data does not match the number of registers.");
+        }
+        detail::copy_registers(reinterpret_cast<const uint8_t*>(registers.data()), out.data(), registers.size());
+    }
+
+    // Decodes a 16, 32 or 64-bit integer, float or double from the registers starting at offset
+    template<typename T, WordOrder order = WordOrder::HighFirst>
+    constexpr T decode_value(std::span<const uint16_t> registers, size_t offset = 0) {
+        static_assert(std::is_trivially_copyable_v<T> && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+                      "Values span 1, 2 or 4 registers");
+        constexpr size_t words = sizeof(T) / 2;
+        uint64_t raw = 0;
+        for (size_t i = 0; i < words; ++i) {
+            raw = (raw << 16) | registers[offset + (order == WordOrder::HighFirst ? i : words - 1 - i)];
+        }
+        return std::bit_cast<T>(static_cast<detail::register_bits_t<T>>(raw));
+    }
+
+    // Encodes value into the registers starting at offset
+    template<typename T, WordOrder order = WordOrder::HighFirst>
+    constexpr void encode_value(T value, std::span<uint16_t> registers, size_t offset = 0) {
+        static_assert(std::is_trivially_copyable_v<T> && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+                      "Values span 1, 2 or 4 registers");
+        constexpr size_t words = sizeof(T) / 2;
+        uint64_t raw = std::bit_cast<detail::register_bits_t<T>>(value);
+        for (size_t i = 0; i < words; ++i) {
+            registers[offset + (order == WordOrder::HighFirst ? words - 1 - i : i)] = static_cast<uint16_t>(raw);
+            raw >>= 16;
+        }
+    }
+
+    // Decodes out.size() consecutive values from registers
+    template<typename T, WordOrder order = WordOrder::HighFirst>
+    void decode_values(std::span<const uint16_t> registers, std::span<T> out) {
+        constexpr size_t words = sizeof(T) / 2;
+        if (registers.size() < out.size() * words) {
+            throw std::out_of_range("Not enough registers to decode the values.");
+        }
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = decode_value<T, order>(registers, i * words);
+        }
+    }
+
+    // Encodes values into consecutive registers
+    template<typename T, WordOrder order = WordOrder::HighFirst>
+    void encode_values(std::span<const T> values, std::span<uint16_t> registers) {
+        constexpr size_t words = sizeof(T) / 2;
+        if (registers.size() < values.size() * words) {
+            throw std::out_of_range("Not enough registers to encode the values.");
+        }
+        for (size_t i = 0; i < values.size(); ++i) {
+            encode_value<T, order>(values[i], registers, i * words);
+        }
+    }
+
     // Decode 32-bit unsigned integer (4 bytes)
     inline uint32_t decode_uint32(const std::vector<uint16_t>& data, size_t offset = 0) {
         return (static_cast<uint32_t>(data[offset + 0]) << 16) |
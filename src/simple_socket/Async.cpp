@@ -0,0 +1,45 @@
+
+#include "simple_socket/Async.hpp"
+
+using namespace simple_socket;
+
+// The operations try the non-blocking call first and only suspend when it would block, so a connection with data
+// waiting costs no more than the plain call.
+
+Task<int> simple_socket::asyncRead(EventLoop& loop, SimpleConnection& conn, std::span<uint8_t> buffer) {
+    if (buffer.empty()) co_return 0;
+
+    for (;;) {
+        const auto n = conn.tryRead(buffer.data(), buffer.size());
+        if (n != 0) co_return n;
+        co_await ReadyAwaiter(loop, conn, false);
+    }
+}
+
+Task<bool> simple_socket::asyncReadExact(EventLoop& loop, SimpleConnection& conn, std::span<uint8_t> buffer) {
+    size_t total = 0;
+    while (total < buffer.size()) {
+        const auto n = co_await asyncRead(loop, conn, buffer.subspan(total));
+        if (n <= 0) co_return false;
+        total += static_cast<size_t>(n);
+    }
+    co_return true;
+}
+
+Task<bool> simple_socket::asyncWrite(EventLoop& loop, SimpleConnection& conn, std::span<const uint8_t> data) {
+    size_t total = 0;
+    while (total < data.size()) {
+        const auto n = conn.tryWrite(data.data() + total, data.size() - total);
+        if (n < 0) co_return false;
+        if (n == 0) {
+            co_await ReadyAwaiter(loop, conn, true);
+            continue;
+        }
+        total += static_cast<size_t>(n);
+    }
+    co_return true;
+}
+
+Task<bool> simple_socket::asyncWrite(EventLoop& loop, SimpleConnection& conn, std::string_view data) {
+    return asyncWrite(loop, conn, std::span(reinterpret_cast<const uint8_t*>(data.data()), data.size()));
+}
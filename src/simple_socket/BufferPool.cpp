@@ -0,0 +1,197 @@
+
+#include "simple_socket/BufferPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace simple_socket;
+
+namespace {
+
+    constexpr size_t minClassSize = 64;
+
+    constexpr size_t classSize(size_t size) {
+        return std::bit_ceil(std::max(size, minClassSize));
+    }
+
+    constexpr size_t classIndex(size_t capacity) {
+        return static_cast<size_t>(std::countr_zero(capacity) - std::countr_zero(minClassSize));
+    }
+
+    // Free buffers kept by each thread. Buffers of a class are interchangeable, so the cache serves every pool.
+    constexpr size_t threadCacheMaxSize = 64 * 1024;
+    constexpr size_t threadCachePerClass = 16;
+
+    struct ThreadCache {
+
+        uint8_t* take(size_t capacity);
+
+        bool give(uint8_t* data, size_t capacity, detail::BufferPoolState& owner);
+
+        ~ThreadCache();
+
+        bool alive = true;
+        // the pool of the first buffer cached, which gets them all back when the thread ends
+        std::shared_ptr<detail::BufferPoolState> home;
+        std::array<std::vector<uint8_t*>, classIndex(threadCacheMaxSize) + 1> lists;
+    };
+
+    thread_local ThreadCache threadCache;
+
+}// namespace
+
+struct detail::BufferPoolState: std::enable_shared_from_this<BufferPoolState> {
+
+    BufferPoolState(size_t maxCachedPerClass, size_t maxPooledSize)
+        : maxCachedPerClass(maxCachedPerClass), maxPooledSize(classSize(maxPooledSize)),
+          freeLists(classIndex(this->maxPooledSize) + 1) {}
+
+    uint8_t* take(size_t capacity) {
+        acquired.fetch_add(1, std::memory_order_relaxed);
+        if (const auto data = threadCache.take(capacity)) return data;
+        {
+            std::lock_guard lck(m);
+            auto& list = freeLists[classIndex(capacity)];
+            if (!list.empty()) {
+                const auto data = list.back();
+                list.pop_back();
+                return data;
+            }
+        }
+        allocated.fetch_add(1, std::memory_order_relaxed);
+        return new uint8_t[capacity];
+    }
+
+    void give(uint8_t* data, size_t capacity) {
+        if (threadCache.give(data, capacity, *this)) return;
+        share(data, capacity);
+    }
+
+    // Into the lists shared between threads
+    void share(uint8_t* data, size_t capacity) {
+        if (capacity <= maxPooledSize) {
+            std::lock_guard lck(m);
+            auto& list = freeLists[classIndex(capacity)];
+            if (list.size() < maxCachedPerClass) {
+                list.push_back(data);
+                return;
+            }
+        }
+        delete[] data;
+    }
+
+    ~BufferPoolState() {
+        for (auto& list : freeLists) {
+            for (const auto data : list) delete[] data;
+        }
+    }
+
+    const size_t maxCachedPerClass;
+    const size_t maxPooledSize;
+
+    std::atomic<uint64_t> acquired{0};
+    std::atomic<uint64_t> allocated{0};
+
+    std::mutex m;
+    std::vector<std::vector<uint8_t*>> freeLists;// by size class
+};
+
+uint8_t* ThreadCache::take(size_t capacity) {
+    if (!alive || capacity > threadCacheMaxSize) return nullptr;
+
+    auto& list = lists[classIndex(capacity)];
+    if (list.empty()) return nullptr;
+    const auto data = list.back();
+    list.pop_back();
+    return data;
+}
+
+bool ThreadCache::give(uint8_t* data, size_t capacity, detail::BufferPoolState& owner) {
+    if (!alive || capacity > threadCacheMaxSize) return false;
+
+    auto& list = lists[classIndex(capacity)];
+    if (list.size() >= threadCachePerClass) return false;
+    if (list.capacity() == 0) list.reserve(threadCachePerClass);
+    if (!home) home = owner.shared_from_this();
+    list.push_back(data);
+    return true;
+}
+
+ThreadCache::~ThreadCache() {
+    // buffers released later on this thread (by static destructors) go to their pools directly
+    alive = false;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        for (const auto data : lists[i]) home->share(data, minClassSize << i);
+    }
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      capacity_(std::exchange(other.capacity_, 0)),
+      pool_(std::move(other.pool_)) {}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        capacity_ = std::exchange(other.capacity_, 0);
+        pool_ = std::move(other.pool_);
+    }
+    return *this;
+}
+
+void PooledBuffer::resize(size_t size) {
+    if (size > capacity_) {
+        throw std::length_error("PooledBuffer can not grow beyond its capacity");
+    }
+    size_ = size;
+}
+
+void PooledBuffer::release() {
+    if (!data_) return;
+
+    if (pool_) {
+        pool_->give(data_, capacity_);
+    } else {
+        delete[] data_;
+    }
+    data_ = nullptr;
+    size_ = capacity_ = 0;
+    pool_.reset();
+}
+
+PooledBuffer::~PooledBuffer() {
+    release();
+}
+
+BufferPool::BufferPool(size_t maxCachedPerClass, size_t maxPooledSize)
+    : state_(std::make_shared<detail::BufferPoolState>(maxCachedPerClass, maxPooledSize)) {}
+
+PooledBuffer BufferPool::acquire(size_t size) {
+    if (size == 0) return {};
+
+    if (size > state_->maxPooledSize) {
+        state_->acquired.fetch_add(1, std::memory_order_relaxed);
+        state_->allocated.fetch_add(1, std::memory_order_relaxed);
+        return {new uint8_t[size], size, size, nullptr};
+    }
+    const auto capacity = classSize(size);
+    return {state_->take(capacity), size, capacity, state_};
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    return {state_->acquired.load(std::memory_order_relaxed), state_->allocated.load(std::memory_order_relaxed)};
+}
+
+BufferPool& BufferPool::global() {
+    static BufferPool pool;
+    return pool;
+}
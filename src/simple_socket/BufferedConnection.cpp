@@ -0,0 +1,188 @@
+
+#include "simple_socket/BufferedConnection.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+using namespace simple_socket;
+
+struct BufferedConnection::Impl {
+
+    Impl(std::unique_ptr<SimpleConnection> conn, size_t bufferSize)
+        : conn(std::move(conn)), buffer(bufferSize) {
+
+        if (!this->conn) {
+            throw std::invalid_argument("BufferedConnection requires a connection");
+        }
+        if (bufferSize == 0) {
+            throw std::invalid_argument("BufferedConnection requires a non-empty buffer");
+        }
+    }
+
+    [[nodiscard]] size_t available() const {
+        return end - begin;
+    }
+
+    int fill() {
+        if (end == buffer.size()) {
+            compact();
+            if (end == buffer.size()) return 0;
+        }
+
+        const auto bytesRead = conn->read(buffer.data() + end, buffer.size() - end);
+        if (bytesRead <= 0) return -1;
+
+        end += bytesRead;
+        return bytesRead;
+    }
+
+    int read(uint8_t* data, size_t size) {
+        if (available() == 0) {
+            // large reads bypass the buffer rather than being copied through it
+            if (size >= buffer.size()) {
+                return conn->read(data, size);
+            }
+            if (fill() <= 0) return -1;
+        }
+
+        const auto n = std::min(size, available());
+        std::memcpy(data, buffer.data() + begin, n);
+        consume(n);
+        return static_cast<int>(n);
+    }
+
+    int tryRead(uint8_t* data, size_t size) {
+        if (available() == 0) {
+            return conn->tryRead(data, size);
+        }
+
+        const auto n = std::min(size, available());
+        std::memcpy(data, buffer.data() + begin, n);
+        consume(n);
+        return static_cast<int>(n);
+    }
+
+    std::span<const uint8_t> peek(size_t size) {
+        size = std::min(size, buffer.size());
+        while (available() < size) {
+            if (begin + size > buffer.size()) compact();
+            if (fill() <= 0) break;
+        }
+        return {buffer.data() + begin, std::min(size, available())};
+    }
+
+    std::span<const uint8_t> readUntil(std::string_view delimiter) {
+        if (delimiter.empty()) return {};
+
+        size_t searched = 0;// bytes from begin already known not to start the delimiter
+        for (;;) {
+            const auto first = buffer.begin() + static_cast<std::ptrdiff_t>(begin);
+            const auto it = std::search(first + static_cast<std::ptrdiff_t>(searched), buffer.begin() + static_cast<std::ptrdiff_t>(end),
+                                        delimiter.begin(), delimiter.end(),
+                                        [](uint8_t a, char b) { return a == static_cast<uint8_t>(b); });
+            if (it != buffer.begin() + static_cast<std::ptrdiff_t>(end)) {
+                const auto size = static_cast<size_t>(it - first) + delimiter.size();
+                const std::span<const uint8_t> result(buffer.data() + begin, size);
+                consume(size);
+                return result;
+            }
+
+            if (available() >= delimiter.size()) {
+                searched = available() - delimiter.size() + 1;
+            }
+            if (available() == buffer.size()) return {};// delimiter does not fit
+
+            if (begin > 0 && end == buffer.size()) {
+                compact();
+            }
+            if (fill() <= 0) return {};
+        }
+    }
+
+    void consume(size_t size) {
+        begin += std::min(size, available());
+        if (begin == end) {
+            begin = end = 0;
+        }
+    }
+
+    // Moves the buffered bytes to the front, making room at the back
+    void compact() {
+        if (begin == 0) return;
+        std::memmove(buffer.data(), buffer.data() + begin, available());
+        end -= begin;
+        begin = 0;
+    }
+
+    std::unique_ptr<SimpleConnection> conn;
+    std::vector<uint8_t> buffer;
+    size_t begin{0};
+    size_t end{0};
+};
+
+BufferedConnection::BufferedConnection(std::unique_ptr<SimpleConnection> conn, size_t bufferSize)
+    : pimpl_(std::make_unique<Impl>(std::move(conn), bufferSize)) {}
+
+int BufferedConnection::read(uint8_t* buffer, size_t size) {
+    return pimpl_->read(buffer, size);
+}
+
+int BufferedConnection::tryRead(uint8_t* buffer, size_t size) {
+    return pimpl_->tryRead(buffer, size);
+}
+
+bool BufferedConnection::write(const uint8_t* data, size_t size) {
+    return pimpl_->conn->write(data, size);
+}
+
+int BufferedConnection::tryWrite(const uint8_t* data, size_t size) {
+    return pimpl_->conn->tryWrite(data, size);
+}
+
+bool BufferedConnection::writev(std::span<const std::span<const uint8_t>> buffers) {
+    return pimpl_->conn->writev(buffers);
+}
+
+bool BufferedConnection::sendFile(int fd, uint64_t offset, uint64_t length) {
+    return pimpl_->conn->sendFile(fd, offset, length);
+}
+
+std::span<const uint8_t> BufferedConnection::peek(size_t size) {
+    return pimpl_->peek(size);
+}
+
+std::span<const uint8_t> BufferedConnection::readUntil(std::string_view delimiter) {
+    return pimpl_->readUntil(delimiter);
+}
+
+void BufferedConnection::consume(size_t size) {
+    pimpl_->consume(size);
+}
+
+size_t BufferedConnection::available() const {
+    return pimpl_->available();
+}
+
+int BufferedConnection::fill() {
+    return pimpl_->fill();
+}
+
+size_t BufferedConnection::capacity() const {
+    return pimpl_->buffer.size();
+}
+
+SimpleConnection& BufferedConnection::next() const {
+    return *pimpl_->conn;
+}
+
+ConnectionStats BufferedConnection::stats() const {
+    return pimpl_->conn->stats();
+}
+
+void BufferedConnection::close() {
+    pimpl_->conn->close();
+}
+
+BufferedConnection::~BufferedConnection() = default;
@@ -0,0 +1,198 @@
+
+#include "simple_socket/ConnectionPool.hpp"
+
+#include "simple_socket/Socket.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+using namespace simple_socket;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    bool isHealthy(SimpleConnection& conn) {
+        const auto native = dynamic_cast<NativeConnection*>(&conn);
+        return native && native->healthy();
+    }
+
+}// namespace
+
+struct ConnectionPool::Impl {
+
+    struct Idle {
+        std::unique_ptr<SimpleConnection> conn;
+        Clock::time_point since;
+    };
+
+    struct Host {
+        std::deque<Idle> idle;// most recently returned at the back
+        size_t total = 0;     // idle, leased and being connected
+    };
+
+    explicit Impl(const ConnectionPoolOptions& options)
+        : options(options) {}
+
+    // Takes connections out of the pool that should be closed, they are closed by the caller outside the lock
+    void takeExpired(std::vector<std::unique_ptr<SimpleConnection>>& expired, Clock::time_point now) {
+        for (auto& [key, host] : hosts) {
+            while (!host.idle.empty() && now - host.idle.front().since > options.maxIdle) {
+                expired.push_back(std::move(host.idle.front().conn));
+                host.idle.pop_front();
+                --host.total;
+            }
+        }
+        if (!expired.empty()) available.notify_all();
+    }
+
+    Lease acquire(const std::shared_ptr<Impl>& self, const std::string& host, uint16_t port) {
+        const auto key = host + ":" + std::to_string(port);
+        const auto deadline = Clock::now() + options.acquireTimeout;
+
+        {
+            std::vector<std::unique_ptr<SimpleConnection>> expired;
+            std::lock_guard lock(mutex);
+            takeExpired(expired, Clock::now());
+        }
+
+        std::unique_lock lock(mutex);
+        for (;;) {
+            auto& entry = hosts[key];
+
+            if (!entry.idle.empty()) {
+                // LIFO, the most recently used connection is the least likely to have been dropped by the peer
+                auto conn = std::move(entry.idle.back().conn);
+                entry.idle.pop_back();
+
+                lock.unlock();
+                if (isHealthy(*conn)) {
+                    return {self, key, std::move(conn)};
+                }
+                conn.reset();
+                lock.lock();
+                --entry.total;
+                available.notify_one();
+                continue;
+            }
+
+            if (entry.total < options.maxPerHost) {
+                ++entry.total;// holds the slot while connecting
+                lock.unlock();
+
+                auto connectOptions = options.connect;
+                connectOptions.timeout = std::min(connectOptions.timeout, std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()));
+                auto conn = ctx.connect(host, port, connectOptions);
+                if (conn) {
+                    return {self, key, std::move(conn)};
+                }
+
+                lock.lock();
+                --entry.total;
+                available.notify_one();
+                return {};
+            }
+
+            if (available.wait_until(lock, deadline) == std::cv_status::timeout) {
+                return {};
+            }
+        }
+    }
+
+    void release(const std::string& key, std::unique_ptr<SimpleConnection> conn) {
+        std::lock_guard lock(mutex);
+        auto& entry = hosts[key];
+        if (conn) {
+            entry.idle.push_back({std::move(conn), Clock::now()});
+        } else {
+            --entry.total;
+        }
+        available.notify_one();
+    }
+
+    ConnectionPoolOptions options;
+    TCPClientContext ctx;
+
+    mutable std::mutex mutex;
+    std::condition_variable available;
+    std::unordered_map<std::string, Host> hosts;
+};
+
+ConnectionPool::Lease::Lease(std::weak_ptr<Impl> pool, std::string key, std::unique_ptr<SimpleConnection> conn)
+    : pool_(std::move(pool)), key_(std::move(key)), conn_(std::move(conn)) {}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(std::move(other.pool_)), key_(std::move(other.key_)), conn_(std::move(other.conn_)) {}
+
+ConnectionPool::Lease& ConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        reset();
+        pool_ = std::move(other.pool_);
+        key_ = std::move(other.key_);
+        conn_ = std::move(other.conn_);
+    }
+    return *this;
+}
+
+void ConnectionPool::Lease::invalidate() {
+    if (conn_) {
+        conn_->close();
+        conn_.reset();
+    }
+}
+
+void ConnectionPool::Lease::reset() {
+    // an invalidated lease still gives its slot back
+    if (const auto pool = pool_.lock()) {
+        pool->release(key_, std::move(conn_));
+    }
+    conn_.reset();
+    pool_.reset();
+}
+
+ConnectionPool::Lease::~Lease() {
+    reset();
+}
+
+ConnectionPool::ConnectionPool(const ConnectionPoolOptions& options)
+    : pimpl_(std::make_shared<Impl>(options)) {}
+
+ConnectionPool::Lease ConnectionPool::acquire(const std::string& host, uint16_t port) {
+    return pimpl_->acquire(pimpl_, host, port);
+}
+
+void ConnectionPool::evictIdle() {
+    std::vector<std::unique_ptr<SimpleConnection>> expired;
+    std::lock_guard lock(pimpl_->mutex);
+    pimpl_->takeExpired(expired, Clock::now());
+}
+
+void ConnectionPool::clear() {
+    std::vector<std::unique_ptr<SimpleConnection>> idle;
+    std::lock_guard lock(pimpl_->mutex);
+    for (auto& [key, host] : pimpl_->hosts) {
+        for (auto& entry : host.idle) {
+            idle.push_back(std::move(entry.conn));
+        }
+        host.total -= host.idle.size();
+        host.idle.clear();
+    }
+    pimpl_->available.notify_all();
+}
+
+size_t ConnectionPool::idleCount() const {
+    std::lock_guard lock(pimpl_->mutex);
+    size_t count = 0;
+    for (const auto& [key, host] : pimpl_->hosts) {
+        count += host.idle.size();
+    }
+    return count;
+}
+
+TCPClientContext& ConnectionPool::context() {
+    return pimpl_->ctx;
+}
+
+ConnectionPool::~ConnectionPool() = default;
@@ -0,0 +1,132 @@
+
+#ifndef SIMPLE_SOCKET_COUNTERS_HPP
+#define SIMPLE_SOCKET_COUNTERS_HPP
+
+#include "simple_socket/Metrics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_socket {
+
+    // Counters are relaxed atomics, a snapshot reads each of them on its own rather than all at one instant.
+    // Without SIMPLE_SOCKET_WITH_METRICS they keep their place in the objects that own them, so the layout of
+    // those does not depend on the build, but are never touched.
+    inline void count(std::atomic_uint64_t& counter, uint64_t n = 1) {
+#ifdef SIMPLE_SOCKET_WITH_METRICS
+        counter.fetch_add(n, std::memory_order_relaxed);
+#else
+        (void) counter;
+        (void) n;
+#endif
+    }
+
+    inline uint64_t load(const std::atomic_uint64_t& counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+    // The transport counters of a connection, on a cache line of their own so the connections served by different
+    // threads never write to a shared one
+    struct alignas(64) ConnectionCounters {
+        std::atomic_uint64_t bytesRead{0};
+        std::atomic_uint64_t bytesWritten{0};
+        std::atomic_uint64_t readCalls{0};
+        std::atomic_uint64_t writeCalls{0};
+
+        // A call that returned n, the number of bytes transferred or an error
+        void onRead(long long n) {
+            count(readCalls);
+            if (n > 0) count(bytesRead, static_cast<uint64_t>(n));
+        }
+
+        void onWrite(long long n) {
+            count(writeCalls);
+            if (n > 0) count(bytesWritten, static_cast<uint64_t>(n));
+        }
+
+        [[nodiscard]] ConnectionStats snapshot() const {
+            ConnectionStats stats;
+            stats.bytesRead = load(bytesRead);
+            stats.bytesWritten = load(bytesWritten);
+            stats.readCalls = load(readCalls);
+            stats.writeCalls = load(writeCalls);
+            return stats;
+        }
+    };
+
+    // The time since it was made. Without SIMPLE_SOCKET_WITH_METRICS the clock is never read and it is always 0.
+    class Stopwatch {
+    public:
+        [[nodiscard]] std::chrono::nanoseconds elapsed() const {
+#ifdef SIMPLE_SOCKET_WITH_METRICS
+            return std::chrono::steady_clock::now() - start_;
+#else
+            return std::chrono::nanoseconds(0);
+#endif
+        }
+
+    private:
+#ifdef SIMPLE_SOCKET_WITH_METRICS
+        std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+#endif
+    };
+
+    // Records durations into the buckets of a LatencySnapshot
+    class Histogram {
+    public:
+        void record(std::chrono::nanoseconds duration) {
+#ifdef SIMPLE_SOCKET_WITH_METRICS
+            const auto ns = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+            const auto bucket = std::min<size_t>(std::bit_width(ns), LatencySnapshot::buckets - 1);
+            counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(ns, std::memory_order_relaxed);
+#else
+            (void) duration;
+#endif
+        }
+
+        void record(const Stopwatch& stopwatch) {
+            record(stopwatch.elapsed());
+        }
+
+        [[nodiscard]] LatencySnapshot snapshot() const {
+            LatencySnapshot snapshot;
+            for (size_t i = 0; i < LatencySnapshot::buckets; ++i) {
+                snapshot.counts[i] = load(counts_[i]);
+                snapshot.count += snapshot.counts[i];
+            }
+            snapshot.sum = std::chrono::nanoseconds(load(sum_));
+            return snapshot;
+        }
+
+    private:
+        std::array<std::atomic_uint64_t, LatencySnapshot::buckets> counts_{};
+        std::atomic_uint64_t sum_{0};
+    };
+
+    // Records the time from its construction to its destruction
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram)
+            : histogram_(histogram) {}
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+        ~ScopedTimer() {
+            histogram_.record(stopwatch_);
+        }
+
+    private:
+        Histogram& histogram_;
+        Stopwatch stopwatch_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_COUNTERS_HPP
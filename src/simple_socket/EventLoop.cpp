@@ -0,0 +1,353 @@
+
+#include "simple_socket/EventLoop.hpp"
+
+#include "simple_socket/Reactor.hpp"
+#include "simple_socket/Socket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+using namespace simple_socket;
+
+namespace {
+
+    NativeConnection& native(SimpleConnection& conn) {
+        const auto native = dynamic_cast<NativeConnection*>(&conn);
+        if (!native) {
+            throw std::invalid_argument("EventLoop can only watch socket based connections");
+        }
+        return *native;
+    }
+
+    void pinCurrentThread(size_t index) {
+        const auto cpus = std::max(1u, std::thread::hardware_concurrency());
+        const auto cpu = index % cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (cpu % (sizeof(DWORD_PTR) * 8)));
+#else
+        (void) cpu;// macOS only supports affinity hints between threads, not binding to a CPU
+#endif
+    }
+
+}// namespace
+
+struct EventLoop::Impl {
+
+    Impl(size_t numThreads, bool pinThreads) {
+        if (numThreads == 0) {
+            throw std::invalid_argument("EventLoop requires at least one thread");
+        }
+        for (size_t i = 0; i < numThreads; ++i) {
+            reactors_.emplace_back(std::make_unique<Reactor>());
+        }
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads_.emplace_back([r = reactors_[i].get(), i, pinThreads] {
+                if (pinThreads) pinCurrentThread(i);
+                r->run();
+            });
+        }
+    }
+
+    [[nodiscard]] size_t size() const {
+        return reactors_.size();
+    }
+
+    void post(std::function<void()> task, std::optional<size_t> thread) {
+        checkThread(thread);
+        reactors_[thread ? *thread : next_++ % reactors_.size()]->post(std::move(task));
+    }
+
+    [[nodiscard]] std::optional<size_t> currentThread() const {
+        for (size_t i = 0; i < reactors_.size(); ++i) {
+            if (reactors_[i]->inLoopThread()) return i;
+        }
+        return std::nullopt;
+    }
+
+    void schedule(std::chrono::milliseconds delay, std::function<void()> task, std::optional<size_t> thread) {
+        checkThread(thread);
+        reactors_[thread ? *thread : next_++ % reactors_.size()]->schedule(delay, std::move(task));
+    }
+
+    void watch(SimpleConnection& conn, std::function<void()> onReadable, std::optional<size_t> thread) {
+        checkThread(thread);
+        auto& socket = native(conn);
+        const auto fd = socket.nativeHandle();
+        set_nonblocking(fd);
+
+        Reactor* reactor;
+        const auto watched = std::make_shared<std::atomic_bool>(true);
+        {
+            std::lock_guard lck(m_);
+            reactor = reactors_[thread ? *thread : next_++ % reactors_.size()].get();
+            assigned_[fd] = {reactor, watched, {}};
+        }
+        reactor->add(fd, Reactor::Readable, [this, fd, onReadable = std::move(onReadable), &socket, watched](unsigned ready) {
+            if (ready & Reactor::Writable) {
+                writable(fd);
+                if (!*watched) return;
+            }
+            if (!(ready & Reactor::Readable)) return;
+            // data a TLS connection has already decrypted does not make the socket readable again,
+            // so the callback is repeated until it is consumed (unless the callback unwatched the connection)
+            do {
+                onReadable();
+            } while (*watched && socket.hasPendingData());
+        });
+    }
+
+    void accept(SimpleConnection& listener, std::function<void(std::unique_ptr<SimpleConnection>)> onAccepted, std::optional<size_t> thread) {
+        checkThread(thread);
+        const auto fd = native(listener).nativeHandle();
+        set_nonblocking(fd);
+
+        Reactor* reactor;
+        {
+            std::lock_guard lck(m_);
+            reactor = reactors_[thread ? *thread : next_++ % reactors_.size()].get();
+            assigned_[fd] = {reactor, std::make_shared<std::atomic_bool>(true), {}};
+        }
+        reactor->addListener(fd, [onAccepted = std::move(onAccepted)](SOCKET sock) {
+            onAccepted(sock == INVALID_SOCKET ? nullptr : std::make_unique<Socket>(sock));
+        });
+    }
+
+    bool whenWritable(SimpleConnection& conn, std::function<void()> onWritable) {
+        const auto fd = native(conn).nativeHandle();
+
+        std::lock_guard lck(m_);
+        const auto it = assigned_.find(fd);
+        if (it == assigned_.end()) return false;
+
+        auto& watch = it->second;
+        if (watch.onWritable) {
+            throw std::logic_error("A write notification is already pending on this connection");
+        }
+        watch.onWritable = std::move(onWritable);
+        watch.reactor->modify(fd, Reactor::Readable | Reactor::Writable);
+        return true;
+    }
+
+    void unwatch(SimpleConnection& conn) {
+        const auto fd = native(conn).nativeHandle();
+
+        Reactor* reactor = nullptr;
+        {
+            std::lock_guard lck(m_);
+            // pending notifications are dropped, a coroutine waiting on conn is never resumed
+            if (const auto waiting = waiting_.find(fd); waiting != waiting_.end()) {
+                waiting->second.reactor->remove(fd);
+                waiting_.erase(waiting);
+            }
+            const auto it = assigned_.find(fd);
+            if (it == assigned_.end()) return;
+            reactor = it->second.reactor;
+            *it->second.watched = false;
+            assigned_.erase(it);
+        }
+        reactor->remove(fd);
+    }
+
+    void whenReady(SimpleConnection& conn, bool writable, std::function<void()> onReady) {
+        const auto fd = native(conn).nativeHandle();
+
+        std::lock_guard lck(m_);
+        const auto [it, added] = waiting_.try_emplace(fd);
+        auto& waiters = it->second;
+        auto& slot = writable ? waiters.onWritable : waiters.onReadable;
+        if (slot) {
+            throw std::logic_error(writable ? "A write is already pending on this connection" : "A read is already pending on this connection");
+        }
+        slot = std::move(onReady);
+
+        if (added) {
+            // stay on the calling loop thread, a coroutine resumed elsewhere would lose its cache
+            const auto current = currentThread();
+            waiters.reactor = reactors_[current ? *current : next_++ % reactors_.size()].get();
+            try {
+                waiters.reactor->add(fd, waiters.events(), [this, fd](unsigned ready) { notify(fd, ready); });
+            } catch (...) {
+                waiting_.erase(it);
+                throw;
+            }
+        } else {
+            waiters.reactor->modify(fd, waiters.events());
+        }
+    }
+
+    void stop() {
+        if (stopped_.exchange(true)) return;
+
+        for (auto& reactor : reactors_) {
+            reactor->stop();
+        }
+        joinOthers();
+    }
+
+    ~Impl() {
+        stop();
+        // a stop() from within a callback left that thread running, it is done with the reactors once joined.
+        // Only a loop destroyed from its own callback leaves that thread to finish.
+        joinOthers();
+        for (auto& thread : threads_) {
+            if (thread.joinable()) thread.detach();
+        }
+    }
+
+private:
+    // allows stop() from within a callback, the calling thread can not join itself
+    void joinOthers() {
+        for (auto& thread : threads_) {
+            if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+                thread.join();
+            }
+        }
+    }
+
+    struct Watch {
+        Reactor* reactor;
+        std::shared_ptr<std::atomic_bool> watched;
+        std::function<void()> onWritable;// registered by whenWritable
+    };
+
+    // one-shot notifications of a connection, registered with its reactor while any is pending
+    struct Waiters {
+        Reactor* reactor = nullptr;
+        std::function<void()> onReadable;
+        std::function<void()> onWritable;
+
+        [[nodiscard]] unsigned events() const {
+            return (onReadable ? Reactor::Readable : 0u) | (onWritable ? Reactor::Writable : 0u);
+        }
+    };
+
+    std::mutex m_;
+    std::atomic_bool stopped_{false};
+    std::atomic_size_t next_{0};
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::vector<std::thread> threads_;
+    std::unordered_map<SOCKET, Watch> assigned_;
+    std::unordered_map<SOCKET, Waiters> waiting_;
+
+    void notify(SOCKET fd, unsigned ready) {
+        std::function<void()> onReadable;
+        std::function<void()> onWritable;
+        {
+            std::lock_guard lck(m_);
+            const auto it = waiting_.find(fd);
+            if (it == waiting_.end()) return;
+            auto& waiters = it->second;
+            if (ready & Reactor::Readable) std::swap(onReadable, waiters.onReadable);
+            if (ready & Reactor::Writable) std::swap(onWritable, waiters.onWritable);
+
+            // level-triggered, so nothing may stay registered without someone waiting for it
+            if (const auto events = waiters.events()) {
+                waiters.reactor->modify(fd, events);
+            } else {
+                waiters.reactor->remove(fd);
+                waiting_.erase(it);
+            }
+        }
+        // these typically resume a coroutine, which may wait on the connection again right away
+        if (onReadable) onReadable();
+        if (onWritable) onWritable();
+    }
+
+    // A watched connection became writable
+    void writable(SOCKET fd) {
+        std::function<void()> onWritable;
+        {
+            std::lock_guard lck(m_);
+            const auto it = assigned_.find(fd);
+            if (it == assigned_.end() || !it->second.onWritable) return;
+            std::swap(onWritable, it->second.onWritable);
+            it->second.reactor->modify(fd, Reactor::Readable);
+        }
+        onWritable();
+    }
+
+    void checkThread(std::optional<size_t> thread) const {
+        if (thread && *thread >= reactors_.size()) {
+            throw std::out_of_range("EventLoop thread index out of range");
+        }
+    }
+};
+
+EventLoop::EventLoop(size_t numThreads, bool pinThreads)
+    : pimpl_(std::make_unique<Impl>(numThreads, pinThreads)) {}
+
+size_t EventLoop::size() const {
+    return pimpl_->size();
+}
+
+void EventLoop::post(std::function<void()> task) {
+    pimpl_->post(std::move(task), std::nullopt);
+}
+
+void EventLoop::post(std::function<void()> task, size_t thread) {
+    pimpl_->post(std::move(task), thread);
+}
+
+std::optional<size_t> EventLoop::currentThread() const {
+    return pimpl_->currentThread();
+}
+
+void EventLoop::schedule(std::chrono::milliseconds delay, std::function<void()> task) {
+    pimpl_->schedule(delay, std::move(task), std::nullopt);
+}
+
+void EventLoop::schedule(std::chrono::milliseconds delay, std::function<void()> task, size_t thread) {
+    pimpl_->schedule(delay, std::move(task), thread);
+}
+
+void EventLoop::watch(SimpleConnection& conn, std::function<void()> onReadable) {
+    pimpl_->watch(conn, std::move(onReadable), std::nullopt);
+}
+
+void EventLoop::watch(SimpleConnection& conn, std::function<void()> onReadable, size_t thread) {
+    pimpl_->watch(conn, std::move(onReadable), thread);
+}
+
+void EventLoop::accept(SimpleConnection& listener, std::function<void(std::unique_ptr<SimpleConnection>)> onAccepted) {
+    pimpl_->accept(listener, std::move(onAccepted), std::nullopt);
+}
+
+void EventLoop::accept(SimpleConnection& listener, std::function<void(std::unique_ptr<SimpleConnection>)> onAccepted, size_t thread) {
+    pimpl_->accept(listener, std::move(onAccepted), thread);
+}
+
+bool EventLoop::whenWritable(SimpleConnection& conn, std::function<void()> onWritable) {
+    return pimpl_->whenWritable(conn, std::move(onWritable));
+}
+
+void EventLoop::unwatch(SimpleConnection& conn) {
+    pimpl_->unwatch(conn);
+}
+
+void EventLoop::whenReady(SimpleConnection& conn, bool writable, std::function<void()> onReady) {
+    pimpl_->whenReady(conn, writable, std::move(onReady));
+}
+
+void EventLoop::stop() {
+    pimpl_->stop();
+}
+
+EventLoop::~EventLoop() = default;
@@ -0,0 +1,124 @@
+
+#include "simple_socket/IoUring.hpp"
+
+#include "simple_socket/socket_common.hpp"
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace simple_socket;
+
+namespace {
+
+    template<class T>
+    T* at(void* base, unsigned offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(base) + offset);
+    }
+
+    // the kernel updates the heads and tails concurrently, so they are read and written like atomics
+    unsigned loadAcquire(const unsigned* p) {
+        return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+    }
+
+    void storeRelease(unsigned* p, unsigned value) {
+        __atomic_store_n(p, value, __ATOMIC_RELEASE);
+    }
+
+}// namespace
+
+IoUring::IoUring(unsigned entries) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CLAMP;
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) {
+        throwSocketError("Failed to create io_uring instance");
+    }
+
+    constexpr unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & required) != required) {
+        ::close(fd_);
+        throw std::runtime_error("io_uring lacks required features");
+    }
+
+    // one mapping holds both rings
+    ringsSize_ = std::max<size_t>(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                  params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    rings_ = ::mmap(nullptr, ringsSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (rings_ == MAP_FAILED || sqes == MAP_FAILED) {
+        const int error = errno;
+        if (rings_ != MAP_FAILED) ::munmap(rings_, ringsSize_);
+        if (sqes != MAP_FAILED) ::munmap(sqes, sqesSize_);
+        ::close(fd_);
+        errno = error;
+        throwSocketError("Failed to map io_uring rings");
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    sqHead_ = at<unsigned>(rings_, params.sq_off.head);
+    sqTail_ = at<unsigned>(rings_, params.sq_off.tail);
+    sqMask_ = *at<unsigned>(rings_, params.sq_off.ring_mask);
+    sqEntries_ = *at<unsigned>(rings_, params.sq_off.ring_entries);
+    sqArray_ = at<unsigned>(rings_, params.sq_off.array);
+
+    cqHead_ = at<unsigned>(rings_, params.cq_off.head);
+    cqTail_ = at<unsigned>(rings_, params.cq_off.tail);
+    cqMask_ = *at<unsigned>(rings_, params.cq_off.ring_mask);
+    cqes_ = at<io_uring_cqe>(rings_, params.cq_off.cqes);
+}
+
+void IoUring::push(const io_uring_sqe& sqe) {
+    // only the submitting side moves the tail, the kernel moves the head as it consumes entries
+    const unsigned tail = *sqTail_;
+    if (tail - loadAcquire(sqHead_) == sqEntries_) {
+        enter(sqEntries_, 0, 0, nullptr, 0);
+        if (tail - loadAcquire(sqHead_) == sqEntries_) {
+            throw std::runtime_error("io_uring submission queue is full");
+        }
+    }
+
+    const unsigned index = tail & sqMask_;
+    sqes_[index] = sqe;
+    sqArray_[index] = index;
+    storeRelease(sqTail_, tail + 1);
+}
+
+void IoUring::wait(int timeoutMs) {
+    __kernel_timespec ts{timeoutMs / 1000, (timeoutMs % 1000) * 1000000LL};
+    io_uring_getevents_arg arg{};
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = timeoutMs < 0 ? 0 : reinterpret_cast<uint64_t>(&ts);
+
+    // the kernel submits no more than is queued
+    enter(sqEntries_, timeoutMs == 0 ? 0 : 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+size_t IoUring::reap(io_uring_cqe* out, size_t max) {
+    unsigned head = *cqHead_;
+    const unsigned tail = loadAcquire(cqTail_);
+    size_t n = 0;
+    while (head != tail && n < max) {
+        out[n++] = cqes_[head & cqMask_];
+        ++head;
+    }
+    storeRelease(cqHead_, head);
+    return n;
+}
+
+int IoUring::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize) const {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd_, toSubmit, minComplete, flags, arg, argSize));
+}
+
+IoUring::~IoUring() {
+    ::munmap(sqes_, sqesSize_);
+    ::munmap(rings_, ringsSize_);
+    ::close(fd_);
+}
@@ -0,0 +1,56 @@
+
+#ifndef SIMPLE_SOCKET_IO_URING_HPP
+#define SIMPLE_SOCKET_IO_URING_HPP
+
+#include <linux/io_uring.h>
+
+#include <cstddef>
+
+namespace simple_socket {
+
+    // Minimal io_uring submission/completion ring on the raw system calls (no liburing dependency).
+    // push() may be called from any thread as long as calls are serialized, reap() only from the thread calling wait().
+    class IoUring {
+    public:
+        // Throws if the kernel lacks io_uring, or the features the reactor relies on (single mmap, EXT_ARG timeouts, no dropped completions).
+        explicit IoUring(unsigned entries);
+
+        IoUring(const IoUring&) = delete;
+        IoUring& operator=(const IoUring&) = delete;
+
+        // Queues a request, to be submitted with the next wait(). Submits the queued ones first if the ring is full.
+        void push(const io_uring_sqe& sqe);
+
+        // Submits everything queued and, in the same system call, waits up to timeoutMs (-1 forever) for a completion
+        void wait(int timeoutMs);
+
+        // Copies up to max completions to out, returning how many
+        size_t reap(io_uring_cqe* out, size_t max);
+
+        ~IoUring();
+
+    private:
+        int fd_ = -1;
+
+        void* rings_ = nullptr;
+        size_t ringsSize_ = 0;
+        io_uring_sqe* sqes_ = nullptr;
+        size_t sqesSize_ = 0;
+
+        unsigned* sqHead_;
+        unsigned* sqTail_;
+        unsigned sqMask_;
+        unsigned sqEntries_;
+        unsigned* sqArray_;
+
+        unsigned* cqHead_;
+        unsigned* cqTail_;
+        unsigned cqMask_;
+        io_uring_cqe* cqes_;
+
+        int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize) const;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_IO_URING_HPP
@@ -0,0 +1,138 @@
+
+#include "simple_socket/MessageConnection.hpp"
+
+#include "simple_socket/BufferedConnection.hpp"
+#include "simple_socket/util/byte_conversion.hpp"
+
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+using namespace simple_socket;
+
+namespace {
+
+    constexpr size_t prefixSize = 4;
+
+}// namespace
+
+struct MessageConnection::Impl {
+
+    Impl(std::unique_ptr<SimpleConnection> conn, const MessageConnectionOptions& options)
+        : conn(std::move(conn), options.readBufferSize), options(options),
+          pool(options.pool ? *options.pool : BufferPool::global()) {
+
+        if (options.maxMessageSize > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("maxMessageSize does not fit the 4 byte length prefix");
+        }
+        batch.reserve(options.batchSize);
+    }
+
+    std::optional<PooledBuffer> read() {
+        uint8_t prefix[prefixSize];
+        if (!conn.readExact(prefix, prefixSize)) return std::nullopt;
+
+        const size_t size = decode_uint32(prefix, options.byteOrder);
+        if (size > options.maxMessageSize) {
+            conn.close();
+            return std::nullopt;
+        }
+
+        auto message = pool.acquire(size);
+        if (size > 0 && !conn.readExact(message.data(), size)) return std::nullopt;
+        return message;
+    }
+
+    bool write(std::span<const std::span<const uint8_t>> messages) {
+        for (const auto& message : messages) {
+            if (message.size() > options.maxMessageSize) return false;
+        }
+
+        // kept between calls, so steady traffic does not allocate them
+        prefixes.resize(messages.size());
+        buffers.clear();
+        // what was queued before goes first, in the same call
+        if (!batch.empty()) buffers.emplace_back(batch);
+        for (size_t i = 0; i < messages.size(); ++i) {
+            prefixes[i] = encode_uint32(static_cast<uint32_t>(messages[i].size()), options.byteOrder);
+            buffers.emplace_back(prefixes[i]);
+            if (!messages[i].empty()) buffers.emplace_back(messages[i]);
+        }
+        const bool written = buffers.empty() || conn.writev(buffers);
+        batch.clear();
+        return written;
+    }
+
+    bool queue(std::span<const uint8_t> message) {
+        if (message.size() > options.maxMessageSize) return false;
+
+        if (batch.size() + prefixSize + message.size() > options.batchSize) {
+            if (!flush()) return false;
+            // too large to be worth copying
+            if (prefixSize + message.size() > options.batchSize) {
+                const std::span<const uint8_t> single[] = {message};
+                return write(single);
+            }
+        }
+
+        const auto prefix = encode_uint32(static_cast<uint32_t>(message.size()), options.byteOrder);
+        batch.insert(batch.end(), prefix.begin(), prefix.end());
+        batch.insert(batch.end(), message.begin(), message.end());
+        return batch.size() < options.batchSize || flush();
+    }
+
+    bool flush() {
+        if (batch.empty()) return true;
+
+        const bool written = conn.write(batch.data(), batch.size());
+        batch.clear();
+        return written;
+    }
+
+    BufferedConnection conn;
+    MessageConnectionOptions options;
+    BufferPool& pool;
+
+    std::vector<std::array<uint8_t, prefixSize>> prefixes;
+    std::vector<std::span<const uint8_t>> buffers;
+    std::vector<uint8_t> batch;
+};
+
+MessageConnection::MessageConnection(std::unique_ptr<SimpleConnection> conn, const MessageConnectionOptions& options)
+    : pimpl_(std::make_unique<Impl>(std::move(conn), options)) {}
+
+std::optional<PooledBuffer> MessageConnection::read() {
+    return pimpl_->read();
+}
+
+bool MessageConnection::write(std::span<const uint8_t> message) {
+    const std::span<const uint8_t> single[] = {message};
+    return pimpl_->write(single);
+}
+
+bool MessageConnection::write(std::span<const std::span<const uint8_t>> messages) {
+    return pimpl_->write(messages);
+}
+
+bool MessageConnection::queue(std::span<const uint8_t> message) {
+    return pimpl_->queue(message);
+}
+
+bool MessageConnection::flush() {
+    return pimpl_->flush();
+}
+
+size_t MessageConnection::queued() const {
+    return pimpl_->batch.size();
+}
+
+SimpleConnection& MessageConnection::next() const {
+    return pimpl_->conn.next();
+}
+
+void MessageConnection::close() {
+    pimpl_->conn.close();
+}
+
+MessageConnection::~MessageConnection() = default;
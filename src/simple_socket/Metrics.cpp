@@ -0,0 +1,133 @@
+
+#include "simple_socket/Metrics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace simple_socket;
+
+namespace {
+
+    // Prometheus exposes durations in seconds
+    std::string seconds(std::chrono::nanoseconds duration) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.9g", std::chrono::duration<double>(duration).count());
+        return buffer;
+    }
+
+    // {labels} or {labels,extra}, nothing at all if both are empty
+    std::string labelSet(std::string_view labels, std::string_view extra = {}) {
+        if (labels.empty() && extra.empty()) return {};
+
+        std::string set = "{";
+        set += labels;
+        if (!labels.empty() && !extra.empty()) set += ',';
+        set += extra;
+        set += '}';
+        return set;
+    }
+
+}// namespace
+
+bool simple_socket::metricsEnabled() {
+#ifdef SIMPLE_SOCKET_WITH_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::chrono::nanoseconds LatencySnapshot::quantile(double q) const {
+    if (count == 0) return std::chrono::nanoseconds(0);
+
+    const auto rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(count)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets; ++i) {
+        seen += counts[i];
+        if (seen >= std::max<uint64_t>(rank, 1)) return upperBound(i);
+    }
+    return upperBound(buckets - 1);
+}
+
+std::chrono::nanoseconds LatencySnapshot::mean() const {
+    return count == 0 ? std::chrono::nanoseconds(0) : sum / static_cast<int64_t>(count);
+}
+
+std::chrono::nanoseconds LatencySnapshot::upperBound(size_t bucket) {
+    return std::chrono::nanoseconds(int64_t{1} << std::min(bucket, buckets - 1));
+}
+
+void PrometheusWriter::write(const ConnectionStats& stats, std::string_view labels) {
+    counter("simple_socket_connection_read_bytes_total", "Bytes read from connections", labels, stats.bytesRead);
+    counter("simple_socket_connection_written_bytes_total", "Bytes written to connections", labels, stats.bytesWritten);
+    counter("simple_socket_connection_read_calls_total", "Read calls on connections, including ones that found nothing", labels, stats.readCalls);
+    counter("simple_socket_connection_write_calls_total", "Write calls on connections", labels, stats.writeCalls);
+    counter("simple_socket_connection_received_messages_total", "Messages received on message based connections", labels, stats.messagesReceived);
+    counter("simple_socket_connection_sent_messages_total", "Messages sent on message based connections", labels, stats.messagesSent);
+    gauge("simple_socket_connection_queued_bytes", "Bytes waiting in send queues", labels, stats.queuedBytes);
+}
+
+void PrometheusWriter::write(const TCPServerStats& stats, std::string_view labels) {
+    counter("simple_socket_tcp_accepted_total", "Connections accepted", labels, stats.accepted);
+    counter("simple_socket_tcp_accept_failures_total", "Accepts that failed", labels, stats.acceptFailures);
+    histogram("simple_socket_tcp_accept_seconds", "Time taken by accepting a connection", labels, stats.acceptLatency);
+}
+
+void PrometheusWriter::write(const WebSocketServerStats& stats, std::string_view labels) {
+    counter("simple_socket_ws_accepted_total", "WebSocket connections accepted", labels, stats.accepted);
+    counter("simple_socket_ws_handshake_failures_total", "WebSocket upgrade requests refused or abandoned", labels, stats.handshakesFailed);
+    gauge("simple_socket_ws_open_connections", "WebSocket connections accepted and not yet closed", labels, stats.open);
+    write(stats.traffic, labels);
+    histogram("simple_socket_ws_message_handling_seconds", "Time spent handling a received WebSocket message", labels, stats.messageHandling);
+}
+
+void PrometheusWriter::write(const ModbusClientStats& stats, std::string_view labels) {
+    counter("simple_socket_modbus_transactions_total", "Modbus requests made", labels, stats.transactions);
+    counter("simple_socket_modbus_failures_total", "Modbus requests without a valid response", labels, stats.failures);
+    counter("simple_socket_modbus_reconnects_total", "Modbus requests sent again on a new connection", labels, stats.reconnects);
+    histogram("simple_socket_modbus_transaction_seconds", "Time from sending a Modbus request to having its response", labels, stats.transactionLatency);
+}
+
+std::string PrometheusWriter::str() const {
+    std::string out;
+    for (const auto& [name, family] : families_) {
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + family.type + "\n";
+        out += family.samples;
+    }
+    return out;
+}
+
+void PrometheusWriter::counter(std::string_view name, std::string_view help, std::string_view labels, uint64_t value) {
+    auto& samples = family(name, help, "counter").samples;
+    samples.append(name).append(labelSet(labels)).append(" ").append(std::to_string(value)).append("\n");
+}
+
+void PrometheusWriter::gauge(std::string_view name, std::string_view help, std::string_view labels, uint64_t value) {
+    auto& samples = family(name, help, "gauge").samples;
+    samples.append(name).append(labelSet(labels)).append(" ").append(std::to_string(value)).append("\n");
+}
+
+void PrometheusWriter::histogram(std::string_view name, std::string_view help, std::string_view labels, const LatencySnapshot& snapshot) {
+    auto& samples = family(name, help, "histogram").samples;
+
+    // buckets are cumulative, the last one of the snapshot is open ended and goes into +Inf
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i + 1 < LatencySnapshot::buckets; ++i) {
+        cumulative += snapshot.counts[i];
+        const auto le = "le=\"" + seconds(LatencySnapshot::upperBound(i)) + "\"";
+        samples.append(name).append("_bucket").append(labelSet(labels, le)).append(" ").append(std::to_string(cumulative)).append("\n");
+    }
+    samples.append(name).append("_bucket").append(labelSet(labels, "le=\"+Inf\"")).append(" ").append(std::to_string(snapshot.count)).append("\n");
+    samples.append(name).append("_sum").append(labelSet(labels)).append(" ").append(seconds(snapshot.sum)).append("\n");
+    samples.append(name).append("_count").append(labelSet(labels)).append(" ").append(std::to_string(snapshot.count)).append("\n");
+}
+
+PrometheusWriter::Family& PrometheusWriter::family(std::string_view name, std::string_view help, std::string_view type) {
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        it = families_.emplace(std::string(name), Family{std::string(help), std::string(type), {}}).first;
+    }
+    return it->second;
+}
@@ -0,0 +1,698 @@
+
+#include "simple_socket/Reactor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#define SIMPLE_SOCKET_REACTOR_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#ifdef SIMPLE_SOCKET_WITH_IO_URING
+#include "simple_socket/IoUring.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#endif
+#elif defined(__APPLE__) || defined(__FreeBSD__)
+#define SIMPLE_SOCKET_REACTOR_KQUEUE
+#include <sys/event.h>
+#else
+#define SIMPLE_SOCKET_REACTOR_POLL
+#endif
+
+using namespace simple_socket;
+
+namespace {
+
+    constexpr int maxEvents = 64;
+
+#ifdef SIMPLE_SOCKET_WITH_IO_URING
+    constexpr unsigned ringEntries = 1024;
+
+    // user_data of the requests removing a poll or cancelling an accept, whose completions are ignored
+    constexpr uint64_t cancelTag = ~uint64_t{0};
+
+    // set in the tags of accept requests, generations stay below it
+    constexpr uint64_t acceptFlag = uint64_t{1} << 63;
+    constexpr uint32_t maxGeneration = 0x7fffffff;
+
+    // requests are tagged with the fd and a generation, the wake-up channel's generation is 0
+    uint64_t pollTag(uint32_t generation, SOCKET fd) {
+        return (uint64_t{generation} << 32) | static_cast<uint32_t>(fd);
+    }
+
+    unsigned pollMask(unsigned events) {
+        unsigned mask = 0;
+        if (events & Reactor::Readable) mask |= POLLIN | POLLRDHUP;
+        if (events & Reactor::Writable) mask |= POLLOUT;
+        return mask;
+    }
+#endif
+
+    using Clock = std::chrono::steady_clock;
+
+}// namespace
+
+struct Reactor::Impl {
+
+    struct Entry {
+        unsigned events;
+        std::shared_ptr<Handler> handler;
+        std::shared_ptr<AcceptHandler> onAccept{};// instead of handler, for a listener accepting through io_uring
+    };
+
+    Impl() {
+#if defined(SIMPLE_SOCKET_REACTOR_EPOLL)
+#ifdef SIMPLE_SOCKET_WITH_IO_URING
+        try {
+            ring_ = std::make_unique<IoUring>(ringEntries);
+        } catch (const std::exception&) {
+            // kernels without io_uring (or with it disabled) get epoll
+        }
+        if (ring_) {
+            wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wakefd_ < 0) {
+                throwSocketError("Failed to create reactor wake-up eventfd");
+            }
+            arm(wakefd_, pollTag(0, wakefd_), POLLIN);
+            return;
+        }
+#endif
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epfd_ < 0 || wakefd_ < 0) {
+            throwSocketError("Failed to create epoll instance");
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wakefd_;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &ev);
+#elif defined(SIMPLE_SOCKET_REACTOR_KQUEUE)
+        kq_ = kqueue();
+        if (kq_ < 0) {
+            throwSocketError("Failed to create kqueue");
+        }
+        struct kevent kev{};
+        EV_SET(&kev, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        kevent(kq_, &kev, 1, nullptr, 0, nullptr);
+#else
+        createWakeChannel();
+#endif
+    }
+
+    void add(SOCKET fd, unsigned events, Handler handler) {
+        std::lock_guard lck(m_);
+        entries_[fd] = Entry{events, std::make_shared<Handler>(std::move(handler))};
+        control(fd, 0, events);
+    }
+
+    void addListener(SOCKET listener, AcceptHandler handler) {
+#ifdef SIMPLE_SOCKET_WITH_IO_URING
+        if (ring_) {
+            std::lock_guard lck(m_);
+            entries_[listener] = Entry{Readable, nullptr, std::make_shared<AcceptHandler>(std::move(handler))};
+            control(listener, 0, Readable);
+            return;
+        }
+#endif
+        add(listener, Readable, [listener, handler = std::move(handler)](unsigned) {
+            // drain the backlog, the listener is level-triggered
+            for (;;) {
+                const SOCKET sock = ::accept(listener, nullptr, nullptr);
+                if (sock == INVALID_SOCKET) {
+                    if (!wouldBlock()) handler(INVALID_SOCKET);// tried again on the next readiness event
+                    return;
+                }
+                handler(sock);
+            }
+        });
+    }
+
+    void modify(SOCKET fd, unsigned events) {
+        std::lock_guard lck(m_);
+        const auto it = entries_.find(fd);
+        if (it == entries_.end()) return;
+        control(fd, it->second.events, events);
+        it->second.events = events;
+    }
+
+    void remove(SOCKET fd) {
+        std::lock_guard lck(m_);
+        const auto it = entries_.find(fd);
+        if (it == entries_.end()) return;
+        control(fd, it->second.events, 0);
+        entries_.erase(it);
+    }
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard lck(m_);
+            tasks_.emplace_back(std::move(task));
+        }
+        wake();
+    }
+
+    void schedule(std::chrono::milliseconds delay, std::function<void()> task) {
+        {
+            std::lock_guard lck(m_);
+            timers_.push_back(Timer{Clock::now() + delay, nextTimer_++, std::move(task)});
+            std::push_heap(timers_.begin(), timers_.end(), later);
+        }
+        wake();// the loop may be sleeping past the new deadline
+    }
+
+    [[nodiscard]] bool inLoopThread() const {
+        return loopThread_.load() == std::this_thread::get_id();
+    }
+
+    void run() {
+        loopThread_ = std::this_thread::get_id();
+        while (!stop_) {
+            poll(timeout());
+            runTasks();
+            runTimers();
+        }
+        loopThread_ = std::thread::id();
+    }
+
+    void stop() {
+        stop_ = true;
+        wake();
+    }
+
+    ~Impl() {
+#if defined(SIMPLE_SOCKET_REACTOR_EPOLL)
+        if (epfd_ >= 0) ::close(epfd_);
+        ::close(wakefd_);
+#elif defined(SIMPLE_SOCKET_REACTOR_KQUEUE)
+        ::close(kq_);
+#else
+        closeWakeChannel();
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    WSASession session_;
+#endif
+
+    struct Timer {
+        Clock::time_point deadline;
+        uint64_t sequence;// timers with the same deadline fire in the order they were scheduled
+        std::function<void()> task;
+    };
+
+    std::mutex m_;
+    std::unordered_map<SOCKET, Entry> entries_;
+    std::vector<std::function<void()>> tasks_;
+    std::vector<Timer> timers_;// min-heap on deadline
+    uint64_t nextTimer_ = 0;
+    std::atomic_bool stop_{false};
+    std::atomic<std::thread::id> loopThread_;
+
+    void dispatch(SOCKET fd, unsigned ready, bool error) {
+        std::shared_ptr<Handler> handler;
+        unsigned events;
+        {
+            std::lock_guard lck(m_);
+            const auto it = entries_.find(fd);
+            if (it == entries_.end()) return;
+            handler = it->second.handler;
+            events = it->second.events;
+        }
+        if (!handler) return;// a listener accepting through io_uring is not notified of readiness
+        // errors and hang-ups are delivered through whatever the handler is waiting for
+        ready = error ? events : ready & events;
+        if (ready == 0) return;
+
+        try {
+            (*handler)(ready);
+        } catch (const std::exception&) {}
+    }
+
+    void runTasks() {
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard lck(m_);
+            tasks.swap(tasks_);
+        }
+        for (auto& task : tasks) {
+            try {
+                task();
+            } catch (const std::exception&) {}
+        }
+    }
+
+    static bool later(const Timer& a, const Timer& b) {
+        return std::tie(a.deadline, a.sequence) > std::tie(b.deadline, b.sequence);
+    }
+
+    // Milliseconds until the next timer is due, or -1 to wait for events only
+    int timeout() {
+        std::lock_guard lck(m_);
+        if (timers_.empty()) return -1;
+
+        const auto remaining = timers_.front().deadline - Clock::now();
+        if (remaining <= Clock::duration::zero()) return 0;
+        // rounded up, waking up early would just go back to sleep for less than a millisecond
+        const auto ms = std::chrono::ceil<std::chrono::milliseconds>(remaining).count();
+        return static_cast<int>(std::min<decltype(ms)>(ms, std::numeric_limits<int>::max()));
+    }
+
+    void runTimers() {
+        std::vector<std::function<void()>> due;
+        {
+            std::lock_guard lck(m_);
+            const auto now = Clock::now();
+            while (!timers_.empty() && timers_.front().deadline <= now) {
+                std::pop_heap(timers_.begin(), timers_.end(), later);
+                due.emplace_back(std::move(timers_.back().task));
+                timers_.pop_back();
+            }
+        }
+        for (auto& task : due) {
+            try {
+                task();
+            } catch (const std::exception&) {}
+        }
+    }
+
+#if defined(SIMPLE_SOCKET_REACTOR_EPOLL)
+    int epfd_ = -1;
+    int wakefd_ = -1;
+
+    void control(SOCKET fd, unsigned oldEvents, unsigned newEvents) {
+#ifdef SIMPLE_SOCKET_WITH_IO_URING
+        if (ring_) {
+            ringControl(fd, oldEvents, newEvents);
+            return;
+        }
+#endif
+        epoll_event ev{};
+        ev.events = EPOLLRDHUP;
+        if (newEvents & Readable) ev.events |= EPOLLIN;
+        if (newEvents & Writable) ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+
+        if (newEvents == 0) {
+            epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, &ev);
+        } else if (oldEvents == 0) {
+            if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                entries_.erase(fd);
+                throwSocketError("Failed to register socket with epoll");
+            }
+        } else {
+            epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev);
+        }
+    }
+
+    void wake() const {
+        const uint64_t one = 1;
+        [[maybe_unused]] const auto n = ::write(wakefd_, &one, sizeof(one));
+    }
+
+    void poll(int timeoutMs) {
+#ifdef SIMPLE_SOCKET_WITH_IO_URING
+        if (ring_) {
+            ringPoll(timeoutMs);
+            return;
+        }
+#endif
+        epoll_event events[maxEvents];
+        const int n = epoll_wait(epfd_, events, maxEvents, timeoutMs);
+        for (int i = 0; i < n; ++i) {
+            const auto fd = events[i].data.fd;
+            const auto flags = events[i].events;
+            if (fd == wakefd_) {
+                uint64_t count;
+                [[maybe_unused]] const auto r = ::read(wakefd_, &count, sizeof(count));
+                continue;
+            }
+            unsigned ready = 0;
+            if (flags & (EPOLLIN | EPOLLRDHUP)) ready |= Readable;
+            if (flags & EPOLLOUT) ready |= Writable;
+            dispatch(fd, ready, flags & (EPOLLERR | EPOLLHUP));
+        }
+    }
+
+#ifdef SIMPLE_SOCKET_WITH_IO_URING
+    // Readiness through one-shot IORING_OP_POLL_ADD requests, re-armed after each dispatch (which keeps handlers
+    // level-triggered, a poll completes right away if the socket is still ready). Registrations and re-arms are only
+    // queued, the loop submits them all with the same io_uring_enter that waits for the next completions,
+    // so a busy loop makes one system call per iteration instead of one epoll_ctl per change plus epoll_wait.
+    // Listeners get one IORING_OP_ACCEPT at a time instead, completed with the accepted socket.
+    std::unique_ptr<IoUring> ring_;
+    std::unordered_map<SOCKET, uint64_t> armed_;// fd -> tag of its pending request
+    uint32_t generation_ = 0;
+
+    // called with m_ held, like everything touching the submission queue
+    void arm(SOCKET fd, uint64_t tag, unsigned mask) {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_POLL_ADD;
+        sqe.fd = fd;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        mask = mask << 16 | mask >> 16;// the kernel reads the mask as two little-endian halves
+#endif
+        sqe.poll32_events = mask;
+        sqe.user_data = tag;
+        ring_->push(sqe);
+    }
+
+    uint64_t nextTag(SOCKET fd) {
+        if (++generation_ > maxGeneration) generation_ = 1;
+        return pollTag(generation_, fd);
+    }
+
+    void arm(SOCKET fd, unsigned events) {
+        const auto entry = entries_.find(fd);
+        if (entry != entries_.end() && entry->second.onAccept) {
+            armAccept(fd);
+            return;
+        }
+        armPoll(fd, pollMask(events));
+    }
+
+    void armPoll(SOCKET fd, unsigned mask) {
+        const auto tag = nextTag(fd);
+        armed_[fd] = tag;
+        arm(fd, tag, mask);
+    }
+
+    void armAccept(SOCKET listener) {
+        io_uring_sqe sqe{};
+        sqe.opcode = IORING_OP_ACCEPT;
+        sqe.fd = listener;// the peer address is not asked for, addr and addr2 stay null
+        sqe.user_data = nextTag(listener) | acceptFlag;
+        armed_[listener] = sqe.user_data;
+        ring_->push(sqe);
+    }
+
+    void disarm(std::unordered_map<SOCKET, uint64_t>::iterator it) {
+        io_uring_sqe sqe{};
+        sqe.opcode = it->second & acceptFlag ? IORING_OP_ASYNC_CANCEL : IORING_OP_POLL_REMOVE;
+        sqe.fd = -1;
+        sqe.addr = it->second;
+        sqe.user_data = cancelTag;
+        ring_->push(sqe);
+        armed_.erase(it);
+    }
+
+    void ringControl(SOCKET fd, unsigned oldEvents, unsigned newEvents) {
+        const auto it = armed_.find(fd);
+        if (newEvents == 0) {
+            if (it == armed_.end()) return;
+            disarm(it);
+            // the request holds on to the descriptor (a listener keeps its port) until the removal is submitted
+            if (!inLoopThread()) wake();
+            return;
+        }
+        if (oldEvents == 0 && fcntl(fd, F_GETFD) < 0) {
+            // the poll request would only fail once submitted, so check the descriptor here
+            entries_.erase(fd);
+            throwSocketError("Failed to register socket with io_uring");
+        }
+        if (it != armed_.end()) {
+            if (oldEvents == newEvents) return;
+            disarm(it);
+        }
+        arm(fd, newEvents);
+        // the loop may be waiting, and only submits when it wakes up
+        if (!inLoopThread()) wake();
+    }
+
+    void ringPoll(int timeoutMs) {
+        ring_->wait(timeoutMs);
+
+        io_uring_cqe cqes[maxEvents];
+        const auto n = ring_->reap(cqes, maxEvents);
+        for (size_t i = 0; i < n; ++i) {
+            const auto tag = cqes[i].user_data;
+            if (tag == cancelTag) continue;
+
+            const auto fd = static_cast<SOCKET>(static_cast<uint32_t>(tag));
+            const auto res = cqes[i].res;
+            if (tag == pollTag(0, wakefd_)) {
+                uint64_t count;
+                [[maybe_unused]] const auto r = ::read(wakefd_, &count, sizeof(count));
+                std::lock_guard lck(m_);
+                arm(wakefd_, tag, POLLIN);
+                continue;
+            }
+
+            {
+                std::lock_guard lck(m_);
+                const auto it = armed_.find(fd);
+                // completions of removed or replaced requests
+                if (it == armed_.end() || it->second != tag) {
+                    if (tag & acceptFlag && res >= 0) ::close(res);// accepted for a listener that is gone
+                    continue;
+                }
+                armed_.erase(it);
+            }
+
+            if (tag & acceptFlag) {
+                accepted(fd, res);
+                continue;
+            }
+            if (res < 0) {
+                // e.g. the descriptor was closed without being removed first, it is not polled again
+                dispatch(fd, 0, true);
+                continue;
+            }
+            unsigned ready = 0;
+            if (res & (POLLIN | POLLRDHUP)) ready |= Readable;
+            if (res & POLLOUT) ready |= Writable;
+            dispatch(fd, ready, res & (POLLERR | POLLHUP));
+
+            std::lock_guard lck(m_);
+            const auto entry = entries_.find(fd);
+            // unless the handler removed the socket, or re-armed it by changing its events
+            if (entry != entries_.end() && !armed_.count(fd)) {
+                arm(fd, entry->second.events);
+            }
+        }
+    }
+
+    // The completion of listener's accept, the next one is queued before the connection is handed over
+    void accepted(SOCKET listener, int res) {
+        std::shared_ptr<AcceptHandler> handler;
+        {
+            std::lock_guard lck(m_);
+            const auto entry = entries_.find(listener);
+            if (entry == entries_.end()) {
+                if (res >= 0) ::close(res);
+                return;
+            }
+            // not a listener (any more), it is not accepted on again
+            if (res == -EBADF || res == -ENOTSOCK || res == -EINVAL) return;
+            if (res == -EAGAIN) {
+                // kernels that honour O_NONBLOCK here, the listener is polled and accepted on once readable
+                armPoll(listener, POLLIN);
+                return;
+            }
+            handler = entry->second.onAccept;
+            armAccept(listener);
+        }
+        try {
+            (*handler)(res >= 0 ? res : INVALID_SOCKET);
+        } catch (const std::exception&) {}
+    }
+#endif
+
+#elif defined(SIMPLE_SOCKET_REACTOR_KQUEUE)
+    int kq_ = -1;
+
+    void control(SOCKET fd, unsigned oldEvents, unsigned newEvents) {
+        struct kevent changes[2];
+        int n = 0;
+        if ((newEvents & Readable) != (oldEvents & Readable)) {
+            EV_SET(&changes[n++], fd, EVFILT_READ, (newEvents & Readable) ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+        }
+        if ((newEvents & Writable) != (oldEvents & Writable)) {
+            EV_SET(&changes[n++], fd, EVFILT_WRITE, (newEvents & Writable) ? EV_ADD : EV_DELETE, 0, 0, nullptr);
+        }
+        if (n > 0 && kevent(kq_, changes, n, nullptr, 0, nullptr) < 0 && newEvents != 0) {
+            if (oldEvents == 0) entries_.erase(fd);
+            throwSocketError("Failed to register socket with kqueue");
+        }
+    }
+
+    void wake() const {
+        struct kevent kev{};
+        EV_SET(&kev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+        kevent(kq_, &kev, 1, nullptr, 0, nullptr);
+    }
+
+    void poll(int timeoutMs) {
+        struct kevent events[maxEvents];
+        const timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+        const int n = kevent(kq_, nullptr, 0, events, maxEvents, timeoutMs < 0 ? nullptr : &timeout);
+        for (int i = 0; i < n; ++i) {
+            if (events[i].filter == EVFILT_USER) continue;
+            const auto fd = static_cast<SOCKET>(events[i].ident);
+            const unsigned ready = events[i].filter == EVFILT_READ ? Readable : Writable;
+            dispatch(fd, ready, events[i].flags & (EV_EOF | EV_ERROR));
+        }
+    }
+
+#else
+    // poll/WSAPoll have no kernel-side interest set, so the pollfd array is rebuilt whenever it changes
+    std::vector<pollfd> pollfds_;
+    bool dirty_ = true;
+#ifdef _WIN32
+    SOCKET wakeRecv_ = INVALID_SOCKET;
+    SOCKET wakeSend_ = INVALID_SOCKET;
+
+    void createWakeChannel() {
+        // WSAPoll only accepts sockets, so use a UDP socket connected to itself
+        wakeRecv_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (wakeRecv_ == INVALID_SOCKET ||
+            ::bind(wakeRecv_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR ||
+            getsockname(wakeRecv_, reinterpret_cast<sockaddr*>(&addr), &len) == SOCKET_ERROR ||
+            ::connect(wakeRecv_, reinterpret_cast<sockaddr*>(&addr), len) == SOCKET_ERROR) {
+            throwSocketError("Failed to create reactor wake-up socket");
+        }
+        set_nonblocking(wakeRecv_);
+        wakeSend_ = wakeRecv_;
+    }
+
+    void closeWakeChannel() {
+        closesocket(wakeRecv_);
+    }
+
+    void wake() const {
+        const char byte = 0;
+        send(wakeSend_, &byte, 1, 0);
+    }
+
+    void drainWakeChannel() const {
+        char buf[64];
+        while (recv(wakeRecv_, buf, sizeof(buf), 0) > 0) {}
+    }
+
+    static int pollSockets(pollfd* fds, size_t count, int timeoutMs) {
+        return WSAPoll(fds, static_cast<ULONG>(count), timeoutMs);
+    }
+#else
+    int wakeRecv_ = -1;
+    int wakeSend_ = -1;
+
+    void createWakeChannel() {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            throwSocketError("Failed to create reactor wake-up pipe");
+        }
+        wakeRecv_ = fds[0];
+        wakeSend_ = fds[1];
+        set_nonblocking(wakeRecv_);
+        set_nonblocking(wakeSend_);
+    }
+
+    void closeWakeChannel() {
+        ::close(wakeRecv_);
+        ::close(wakeSend_);
+    }
+
+    void wake() const {
+        const char byte = 0;
+        [[maybe_unused]] const auto n = ::write(wakeSend_, &byte, 1);
+    }
+
+    void drainWakeChannel() const {
+        char buf[64];
+        while (::read(wakeRecv_, buf, sizeof(buf)) > 0) {}
+    }
+
+    static int pollSockets(pollfd* fds, size_t count, int timeoutMs) {
+        return ::poll(fds, static_cast<nfds_t>(count), timeoutMs);
+    }
+#endif
+
+    void control(SOCKET, unsigned, unsigned) {
+        dirty_ = true;
+        wake();
+    }
+
+    void poll(int timeoutMs) {
+        {
+            std::lock_guard lck(m_);
+            if (dirty_) {
+                pollfds_.clear();
+                pollfds_.push_back(pollfd{wakeRecv_, POLLIN, 0});
+                for (const auto& [fd, entry] : entries_) {
+                    short events = 0;
+                    if (entry.events & Readable) events |= POLLIN;
+                    if (entry.events & Writable) events |= POLLOUT;
+                    pollfds_.push_back(pollfd{fd, events, 0});
+                }
+                dirty_ = false;
+            }
+        }
+
+        if (pollSockets(pollfds_.data(), pollfds_.size(), timeoutMs) <= 0) return;
+
+        if (pollfds_[0].revents) drainWakeChannel();
+        for (size_t i = 1; i < pollfds_.size(); ++i) {
+            const auto revents = pollfds_[i].revents;
+            if (revents == 0) continue;
+            unsigned ready = 0;
+            if (revents & POLLIN) ready |= Readable;
+            if (revents & POLLOUT) ready |= Writable;
+            dispatch(pollfds_[i].fd, ready, revents & (POLLERR | POLLHUP | POLLNVAL));
+        }
+    }
+#endif
+};
+
+Reactor::Reactor()
+    : pimpl_(std::make_unique<Impl>()) {}
+
+void Reactor::add(SOCKET fd, unsigned events, Handler handler) {
+    pimpl_->add(fd, events, std::move(handler));
+}
+
+void Reactor::addListener(SOCKET listener, AcceptHandler handler) {
+    pimpl_->addListener(listener, std::move(handler));
+}
+
+void Reactor::modify(SOCKET fd, unsigned events) {
+    pimpl_->modify(fd, events);
+}
+
+void Reactor::remove(SOCKET fd) {
+    pimpl_->remove(fd);
+}
+
+void Reactor::post(std::function<void()> task) {
+    pimpl_->post(std::move(task));
+}
+
+void Reactor::schedule(std::chrono::milliseconds delay, std::function<void()> task) {
+    pimpl_->schedule(delay, std::move(task));
+}
+
+bool Reactor::inLoopThread() const {
+    return pimpl_->inLoopThread();
+}
+
+void Reactor::run() {
+    pimpl_->run();
+}
+
+void Reactor::stop() {
+    pimpl_->stop();
+}
+
+Reactor::~Reactor() = default;
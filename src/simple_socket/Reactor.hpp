@@ -0,0 +1,69 @@
+
+#ifndef SIMPLE_SOCKET_REACTOR_HPP
+#define SIMPLE_SOCKET_REACTOR_HPP
+
+#include "simple_socket/socket_common.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace simple_socket {
+
+    // Single-threaded readiness notifier (epoll on Linux, or io_uring with SIMPLE_SOCKET_WITH_IO_URING,
+    // kqueue on BSD/macOS, WSAPoll/poll elsewhere).
+    // Handlers are level-triggered and always invoked on the thread calling run().
+    class Reactor {
+    public:
+        enum Events : unsigned {
+            Readable = 1,
+            Writable = 2
+        };
+
+        using Handler = std::function<void(unsigned events)>;
+
+        // Called with each socket accepted on a listener, or INVALID_SOCKET for an accept that failed
+        // (e.g. an aborted connection, or no descriptors left)
+        using AcceptHandler = std::function<void(SOCKET)>;
+
+        Reactor();
+
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        // add/modify/remove may be called from any thread.
+        void add(SOCKET fd, unsigned events, Handler handler);
+
+        // Accepts connections on the non-blocking listener as they arrive, until remove(listener). With io_uring the
+        // kernel completes IORING_OP_ACCEPT requests, sparing the readiness notification before each accept,
+        // elsewhere accept(2) is called whenever listener turns readable.
+        void addListener(SOCKET listener, AcceptHandler handler);
+
+        void modify(SOCKET fd, unsigned events);
+
+        // No new callbacks for fd are started once this returns.
+        void remove(SOCKET fd);
+
+        // Runs task on the loop thread.
+        void post(std::function<void()> task);
+
+        // Runs task on the loop thread once delay has passed. Timers pending when the reactor stops never fire.
+        void schedule(std::chrono::milliseconds delay, std::function<void()> task);
+
+        [[nodiscard]] bool inLoopThread() const;
+
+        // Dispatches events until stop() is called.
+        void run();
+
+        void stop();
+
+        ~Reactor();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_REACTOR_HPP
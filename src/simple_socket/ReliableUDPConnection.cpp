@@ -0,0 +1,456 @@
+
+#include "simple_socket/ReliableUDPConnection.hpp"
+
+#include "simple_socket/util/byte_conversion.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace simple_socket;
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Datagram layout, integers big endian:
+    //   Data:  kind, delivery, sequence (4), payload
+    //   Ack:   kind, delivery, next expected sequence (4), range count, ranges of [first, end) sequences received past it (4 + 4 each)
+    //   Close: kind
+    enum Kind : uint8_t {
+        Data = 0,
+        Ack = 1,
+        Close = 2
+    };
+
+    constexpr size_t dataHeaderSize = 6;
+    constexpr size_t ackHeaderSize = 7;
+    constexpr size_t maxAckRanges = 16;
+
+    // A message is retransmitted right away once this many acknowledgements have covered messages sent after it
+    constexpr size_t fastRetransmitThreshold = 3;
+
+    void put32(uint8_t* p, uint64_t value) {
+        const auto bytes = encode_uint32(static_cast<uint32_t>(value), std::endian::big);
+        std::copy(bytes.begin(), bytes.end(), p);
+    }
+
+    uint32_t get32(const uint8_t* p) {
+        return decode_uint32(p, std::endian::big);
+    }
+
+    // Sequence numbers are 64 bit locally and 32 bit on the wire: the one nearest to reference with these low bits
+    uint64_t unwrap(uint32_t wire, uint64_t reference) {
+        constexpr uint64_t span = uint64_t{1} << 32;
+        const auto candidate = (reference & ~(span - 1)) | wire;
+        if (candidate + span / 2 < reference) return candidate + span;
+        if (candidate > reference + span / 2 && candidate >= span) return candidate - span;
+        return candidate;
+    }
+
+}// namespace
+
+struct ReliableUDPConnection::Impl {
+
+    Impl(int localPort, const UDPEndpoint& peer, const ReliableUDPOptions& options)
+        : options_(options), socket_(localPort, peer.isV6()), rto_(options.initialRto), random_(std::random_device{}()) {
+
+        if (options_.maxPayload == 0 || options_.maxPayload + dataHeaderSize > MAX_UDP_PACKET_SIZE) {
+            throw std::invalid_argument("ReliableUDPConnection: maxPayload out of range");
+        }
+        if (options_.window == 0) {
+            throw std::invalid_argument("ReliableUDPConnection: window must be at least 1");
+        }
+
+        link_ = socket_.makeConnection(peer);
+        receiver_ = std::thread([this] { receiveLoop(); });
+        timer_ = std::thread([this] { timerLoop(); });
+    }
+
+    int read(uint8_t* buffer, size_t size, bool block) {
+        std::unique_lock lck(m_);
+        if (block) {
+            readable_.wait(lck, [&] { return !received_.empty() || closed_; });
+        }
+        if (received_.empty()) {
+            return closed_ ? -1 : 0;
+        }
+
+        size_t read = 0;
+        while (read < size && !received_.empty()) {
+            const auto& front = received_.front();
+            const auto count = std::min(size - read, front.size() - readOffset_);
+            std::copy_n(front.begin() + static_cast<std::ptrdiff_t>(readOffset_), count, buffer + read);
+            read += count;
+            readOffset_ += count;
+            if (readOffset_ == front.size()) {
+                received_.pop_front();
+                readOffset_ = 0;
+            }
+        }
+        return static_cast<int>(read);
+    }
+
+    bool write(const uint8_t* data, size_t size) {
+        for (size_t offset = 0; offset < size; offset += options_.maxPayload) {
+            if (!send({data + offset, std::min(options_.maxPayload, size - offset)}, UDPDelivery::ReliableOrdered)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool send(std::span<const uint8_t> message, UDPDelivery delivery) {
+        if (message.empty() || message.size() > options_.maxPayload) {
+            return false;
+        }
+
+        std::vector<uint8_t> packet(dataHeaderSize + message.size());
+        packet[0] = Data;
+        packet[1] = static_cast<uint8_t>(delivery);
+        std::copy(message.begin(), message.end(), packet.begin() + dataHeaderSize);
+
+        std::unique_lock lck(m_);
+        if (delivery == UDPDelivery::Unreliable) {
+            return !closed_ && transmit(packet);
+        }
+
+        auto& channel = channels_[static_cast<size_t>(delivery)];
+        writable_.wait(lck, [&] { return closed_ || channel.unacked.size() < options_.window; });
+        if (closed_) {
+            return false;
+        }
+
+        const auto sequence = channel.nextSequence++;
+        put32(packet.data() + 2, sequence);
+        transmit(packet);
+
+        const auto now = Clock::now();
+        channel.unacked.emplace(sequence, Outgoing{std::move(packet), now, now + rto_});
+        timerWake_.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard lck(m_);
+            if (closing_) return;
+            closing_ = true;
+            closed_ = true;
+        }
+        const uint8_t notice = Close;
+        link_->write(&notice, 1);
+
+        readable_.notify_all();
+        writable_.notify_all();
+        timerWake_.notify_all();
+        socket_.close();// wakes the receive thread
+
+        // allow close() from within onMessage; that thread is then joined by the destructor
+        for (auto* thread : {&receiver_, &timer_}) {
+            if (thread->joinable() && thread->get_id() != std::this_thread::get_id()) {
+                thread->join();
+            }
+        }
+    }
+
+    ~Impl() {
+        close();
+        // a close() from within onMessage left the receive thread running, it is done with this once joined.
+        // Only a connection destroyed from onMessage itself leaves its own thread to finish.
+        for (auto* thread : {&receiver_, &timer_}) {
+            if (!thread->joinable()) continue;
+            if (thread->get_id() == std::this_thread::get_id()) {
+                thread->detach();
+            } else {
+                thread->join();
+            }
+        }
+    }
+
+private:
+    struct Outgoing {
+        std::vector<uint8_t> packet;
+        Clock::time_point sentAt;
+        Clock::time_point deadline;
+        size_t retransmits = 0;
+        size_t skipped = 0;// acknowledgements of later messages since it was last sent
+    };
+
+    // One of the reliable channels, both directions
+    struct Channel {
+        uint64_t nextSequence = 0;
+        std::map<uint64_t, Outgoing> unacked;
+
+        uint64_t expected = 0;                         // everything before has been received
+        std::map<uint64_t, std::vector<uint8_t>> early;// received past a gap (payloads only kept when ordered)
+    };
+
+    ReliableUDPOptions options_;
+    UDPSocket socket_;
+    std::unique_ptr<SimpleConnection> link_;
+
+    std::mutex m_;
+    std::condition_variable readable_;
+    std::condition_variable writable_;
+    std::condition_variable timerWake_;
+    bool closed_ = false;
+    std::atomic_bool closing_{false};
+
+    Channel channels_[2];// indexed by UDPDelivery::ReliableOrdered and ReliableUnordered
+    std::deque<std::vector<uint8_t>> received_;
+    size_t readOffset_ = 0;
+
+    // RFC 6298 round trip estimation
+    bool measured_ = false;
+    Clock::duration srtt_{};
+    Clock::duration rttvar_{};
+    Clock::duration rto_;
+
+    std::mt19937 random_;
+    std::uniform_real_distribution<double> loss_{0, 1};
+
+    std::thread receiver_;
+    std::thread timer_;
+
+    // m_ must be held
+    bool transmit(std::span<const uint8_t> packet) {
+        if (options_.simulatedLoss > 0 && loss_(random_) < options_.simulatedLoss) {
+            return true;
+        }
+        return link_->write(packet.data(), packet.size());
+    }
+
+    void receiveLoop() {
+        std::vector<uint8_t> buffer(MAX_UDP_PACKET_SIZE);
+        while (!closing_) {
+            const auto n = link_->read(buffer);
+            if (closing_) break;
+            if (n <= 0) continue;// e.g. the peer's port was not open yet (ICMP port unreachable)
+
+            handle(std::span(buffer.data(), n));
+        }
+    }
+
+    void handle(std::span<const uint8_t> packet) {
+        switch (packet[0]) {
+            case Data: {
+                if (packet.size() <= dataHeaderSize || packet[1] > static_cast<uint8_t>(UDPDelivery::Unreliable)) return;
+                const auto delivery = static_cast<UDPDelivery>(packet[1]);
+                const auto payload = packet.subspan(dataHeaderSize);
+
+                if (delivery == UDPDelivery::Unreliable) {
+                    deliver(delivery, payload);
+                } else if (receiveReliable(delivery, get32(packet.data() + 2), payload)) {
+                    deliver(delivery, payload);
+                }
+                break;
+            }
+            case Ack: {
+                if (packet.size() < ackHeaderSize || packet[1] > static_cast<uint8_t>(UDPDelivery::ReliableUnordered)) return;
+                const auto ranges = std::min<size_t>(packet[6], (packet.size() - ackHeaderSize) / 8);
+
+                std::lock_guard lck(m_);
+                acknowledge(channels_[packet[1]], packet.subspan(2, 5 + ranges * 8), ranges);
+                break;
+            }
+            case Close: {
+                std::lock_guard lck(m_);
+                closed_ = true;
+                readable_.notify_all();
+                writable_.notify_all();
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void deliver(UDPDelivery delivery, std::span<const uint8_t> message) const {
+        if (options_.onMessage && !closing_) {
+            options_.onMessage(delivery, message);
+        }
+    }
+
+    // Returns true if an unordered message is new and should be delivered, ordered ones are queued for read()
+    bool receiveReliable(UDPDelivery delivery, uint32_t wireSequence, std::span<const uint8_t> payload) {
+        const bool ordered = delivery == UDPDelivery::ReliableOrdered;
+
+        std::lock_guard lck(m_);
+        auto& channel = channels_[static_cast<size_t>(delivery)];
+        const auto sequence = unwrap(wireSequence, channel.expected);
+
+        // both ends use the same window, so nothing legitimate arrives this far ahead
+        const bool fresh = sequence >= channel.expected && sequence < channel.expected + options_.window && !channel.early.contains(sequence);
+        if (fresh) {
+            if (sequence == channel.expected) {
+                if (ordered) received_.emplace_back(payload.begin(), payload.end());
+                ++channel.expected;
+                for (auto it = channel.early.begin(); it != channel.early.end() && it->first == channel.expected; it = channel.early.erase(it)) {
+                    if (ordered) received_.emplace_back(std::move(it->second));
+                    ++channel.expected;
+                }
+                if (ordered) readable_.notify_all();
+            } else {
+                channel.early.emplace(sequence, ordered ? std::vector<uint8_t>(payload.begin(), payload.end()) : std::vector<uint8_t>());
+            }
+        }
+
+        // duplicates are acknowledged too, the acknowledgement of the original may have been lost
+        sendAck(channel, delivery);
+        return fresh && !ordered;
+    }
+
+    // m_ must be held
+    void sendAck(const Channel& channel, UDPDelivery delivery) {
+        uint8_t packet[ackHeaderSize + maxAckRanges * 8];
+        packet[0] = Ack;
+        packet[1] = static_cast<uint8_t>(delivery);
+        put32(packet + 2, channel.expected);
+
+        size_t ranges = 0;
+        for (auto it = channel.early.begin(); it != channel.early.end() && ranges < maxAckRanges; ++ranges) {
+            const auto first = it->first;
+            auto end = first + 1;
+            for (++it; it != channel.early.end() && it->first == end; ++it) ++end;
+            put32(packet + ackHeaderSize + ranges * 8, first);
+            put32(packet + ackHeaderSize + ranges * 8 + 4, end);
+        }
+        packet[6] = static_cast<uint8_t>(ranges);
+
+        transmit(std::span(packet, ackHeaderSize + ranges * 8));
+    }
+
+    // m_ must be held. ack holds the next expected sequence followed by the range count and the ranges.
+    void acknowledge(Channel& channel, std::span<const uint8_t> ack, size_t ranges) {
+        const auto now = Clock::now();
+        const auto before = channel.unacked.size();
+
+        const auto erase = [&](std::map<uint64_t, Outgoing>::iterator it) {
+            if (it->second.retransmits == 0) sampleRtt(now - it->second.sentAt);// Karn's algorithm
+            return channel.unacked.erase(it);
+        };
+
+        const auto next = unwrap(get32(ack.data()), channel.nextSequence);
+        for (auto it = channel.unacked.begin(); it != channel.unacked.end() && it->first < next;) {
+            it = erase(it);
+        }
+
+        uint64_t highest = next;
+        for (size_t i = 0; i < ranges; ++i) {
+            const auto first = unwrap(get32(ack.data() + 5 + i * 8), channel.nextSequence);
+            const auto end = unwrap(get32(ack.data() + 5 + i * 8 + 4), channel.nextSequence);
+            for (auto it = channel.unacked.lower_bound(first); it != channel.unacked.end() && it->first < end;) {
+                it = erase(it);
+            }
+            highest = std::max(highest, end);
+        }
+
+        // what is still missing below the highest acknowledged message is likely lost, not just late
+        for (auto it = channel.unacked.begin(); it != channel.unacked.end() && it->first < highest; ++it) {
+            if (++it->second.skipped == fastRetransmitThreshold) {
+                retransmit(it->second, now);
+            }
+        }
+
+        if (channel.unacked.size() != before) {
+            writable_.notify_all();
+        }
+    }
+
+    // m_ must be held
+    void sampleRtt(Clock::duration rtt) {
+        if (!measured_) {
+            srtt_ = rtt;
+            rttvar_ = rtt / 2;
+            measured_ = true;
+        } else {
+            const auto deviation = srtt_ > rtt ? srtt_ - rtt : rtt - srtt_;
+            rttvar_ = (3 * rttvar_ + deviation) / 4;
+            srtt_ = (7 * srtt_ + rtt) / 8;
+        }
+        rto_ = std::clamp<Clock::duration>(srtt_ + 4 * rttvar_, options_.minRto, options_.maxRto);
+    }
+
+    // m_ must be held
+    void retransmit(Outgoing& outgoing, Clock::time_point now) {
+        transmit(outgoing.packet);
+        ++outgoing.retransmits;
+        outgoing.skipped = 0;
+
+        // exponential backoff
+        auto timeout = rto_;
+        for (size_t i = 0; i < outgoing.retransmits && timeout < options_.maxRto; ++i) timeout *= 2;
+        outgoing.deadline = now + std::min<Clock::duration>(timeout, options_.maxRto);
+    }
+
+    void timerLoop() {
+        std::unique_lock lck(m_);
+        while (!closing_) {
+            auto next = Clock::time_point::max();
+            for (const auto& channel : channels_) {
+                for (const auto& [sequence, outgoing] : channel.unacked) {
+                    next = std::min(next, outgoing.deadline);
+                }
+            }
+            if (next == Clock::time_point::max()) {
+                timerWake_.wait(lck);
+            } else {
+                timerWake_.wait_until(lck, next);
+            }
+            if (closing_) break;
+
+            const auto now = Clock::now();
+            for (auto& channel : channels_) {
+                for (auto& [sequence, outgoing] : channel.unacked) {
+                    if (outgoing.deadline > now) continue;
+                    if (outgoing.retransmits >= options_.maxRetransmits) {
+                        fail();
+                        return;
+                    }
+                    retransmit(outgoing, now);
+                }
+            }
+        }
+    }
+
+    // m_ must be held. The peer stopped acknowledging.
+    void fail() {
+        closed_ = true;
+        for (auto& channel : channels_) channel.unacked.clear();
+        readable_.notify_all();
+        writable_.notify_all();
+    }
+};
+
+ReliableUDPConnection::ReliableUDPConnection(int localPort, const UDPEndpoint& peer, const ReliableUDPOptions& options)
+    : pimpl_(std::make_unique<Impl>(localPort, peer, options)) {}
+
+int ReliableUDPConnection::read(uint8_t* buffer, size_t size) {
+    return pimpl_->read(buffer, size, true);
+}
+
+int ReliableUDPConnection::tryRead(uint8_t* buffer, size_t size) {
+    return pimpl_->read(buffer, size, false);
+}
+
+bool ReliableUDPConnection::write(const uint8_t* data, size_t size) {
+    return pimpl_->write(data, size);
+}
+
+bool ReliableUDPConnection::send(std::span<const uint8_t> message, UDPDelivery delivery) {
+    return pimpl_->send(message, delivery);
+}
+
+void ReliableUDPConnection::close() {
+    pimpl_->close();
+}
+
+ReliableUDPConnection::~ReliableUDPConnection() = default;
@@ -0,0 +1,277 @@
+
+#include "simple_socket/SendQueue.hpp"
+
+#include "simple_socket/Socket.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace simple_socket;
+
+struct SendQueue::Impl: std::enable_shared_from_this<Impl> {
+
+    struct Message {
+        PooledBuffer owned;
+        std::shared_ptr<const PooledBuffer> shared;
+        std::optional<uint64_t> key;
+
+        [[nodiscard]] std::span<const uint8_t> bytes() const {
+            return shared ? shared->span() : owned.span();
+        }
+    };
+
+    enum class State {
+        Idle,
+        Delayed,// a timer will arm the queue
+        Armed   // the loop writes once the socket is writable
+    };
+
+    Impl(EventLoop& loop, SimpleConnection& conn, const SendQueueOptions& options)
+        : loop(loop), conn(conn), options(options) {
+        batch.reserve(options.batchSize);
+    }
+
+    bool push(Message message) {
+        const auto size = message.bytes().size();
+        if (size == 0) return true;
+
+        std::lock_guard lck(queueMutex);
+        if (closed || failed) return false;
+
+        if (options.overflow == OverflowPolicy::Conflate && message.key) {
+            if (const auto it = byKey.find(*message.key); it != byKey.end()) {
+                queuedBytes -= it->second->bytes().size();
+                queuedBytes += size;
+                *it->second = std::move(message);
+                return true;
+            }
+        }
+
+        if (queuedBytes + size > options.highWatermark) {
+            overflowed = true;
+            switch (options.overflow) {
+                case OverflowPolicy::DropOldest:
+                    while (!messages.empty() && queuedBytes + size > options.highWatermark) {
+                        queuedBytes -= popFront().bytes().size();
+                    }
+                    break;
+                case OverflowPolicy::Disconnect:
+                    // the watcher of the connection sees it closed and cleans up as usual
+                    if (const auto native = dynamic_cast<NativeConnection*>(&conn)) {
+                        shutdownSocket(native->nativeHandle());
+                    }
+                    failed = true;
+                    clear();
+                    return false;
+                default:
+                    return false;
+            }
+        }
+
+        messages.push_back(std::move(message));
+        queuedBytes += size;
+        if (options.overflow == OverflowPolicy::Conflate && messages.back().key) {
+            byKey[*messages.back().key] = &messages.back();
+        }
+
+        if (state == State::Armed) return true;
+        if (options.flushDelay.count() == 0 || queuedBytes >= options.flushThreshold) {
+            arm();
+        } else if (state == State::Idle) {
+            state = State::Delayed;
+            loop.schedule(options.flushDelay, [self = shared_from_this()] {
+                std::lock_guard lck(self->queueMutex);
+                if (self->state == State::Delayed && !self->closed) self->arm();
+            });
+        }
+        return true;
+    }
+
+    // Runs on the loop thread of the connection
+    void flush() {
+        {
+            std::lock_guard lck(writeMutex);
+            if (closed) return;
+
+            switch (write()) {
+                case Progress::Done:
+                    break;
+                case Progress::Blocked: {
+                    std::lock_guard queueLck(queueMutex);
+                    arm();
+                    break;
+                }
+                case Progress::Failed:
+                    fail();
+                    return;
+            }
+        }
+
+        // outside the locks, as it typically sends more
+        bool drained = false;
+        {
+            std::lock_guard lck(queueMutex);
+            if (overflowed && queuedBytes <= options.lowWatermark) {
+                overflowed = false;
+                drained = !closed && !failed;
+            }
+        }
+        if (drained && options.onDrain) options.onDrain();
+    }
+
+    void close() {
+        std::lock_guard lck(writeMutex);
+        bool writable;
+        {
+            std::lock_guard queueLck(queueMutex);
+            if (closed) return;
+            closed = true;
+            writable = !failed;
+        }
+        // best effort, e.g. for a close frame queued last
+        if (writable) write();
+
+        std::lock_guard queueLck(queueMutex);
+        clear();
+        current = {};
+        writing = {};
+    }
+
+    EventLoop& loop;
+    SimpleConnection& conn;
+    const SendQueueOptions options;
+
+    std::atomic_size_t queuedBytes{0};
+
+    // guards the queue and the flags
+    std::mutex queueMutex;
+    std::deque<Message> messages;
+    std::unordered_map<uint64_t, Message*> byKey;// queued messages with a key, for Conflate
+    State state = State::Idle;
+    bool closed = false;
+    bool failed = false;
+    bool overflowed = false;// since the queue was last below lowWatermark
+
+    // guards what is being written
+    std::mutex writeMutex;
+    std::vector<uint8_t> batch;      // small messages, copied together
+    Message current;                 // or a large one
+    std::span<const uint8_t> writing;// what is left of either
+
+private:
+    enum class Progress {
+        Done,
+        Blocked,
+        Failed
+    };
+
+    // Requires queueMutex
+    void arm() {
+        state = State::Armed;
+        if (!loop.whenWritable(conn, [self = shared_from_this()] { self->flush(); })) {
+            failed = true;// not watched, or no longer
+            clear();
+        }
+    }
+
+    void fail() {
+        std::lock_guard lck(queueMutex);
+        failed = true;
+        clear();
+    }
+
+    // Requires queueMutex
+    void clear() {
+        messages.clear();
+        byKey.clear();
+        queuedBytes = 0;
+        state = State::Idle;
+    }
+
+    // Requires queueMutex
+    Message popFront() {
+        auto& front = messages.front();
+        if (front.key) {
+            const auto it = byKey.find(*front.key);
+            if (it != byKey.end() && it->second == &front) byKey.erase(it);
+        }
+        auto message = std::move(front);
+        messages.pop_front();
+        return message;
+    }
+
+    // Requires writeMutex. Writes until everything is written or the socket is full.
+    Progress write() {
+        while (true) {
+            if (writing.empty() && !next()) return Progress::Done;
+
+            // a connection that returned 0 gets the same data again, as TLS requires
+            const auto n = conn.tryWrite(writing.data(), writing.size());
+            if (n < 0) return Progress::Failed;
+            if (n == 0) return Progress::Blocked;
+
+            writing = writing.subspan(static_cast<size_t>(n));
+            queuedBytes -= static_cast<size_t>(n);
+        }
+    }
+
+    // Requires writeMutex. Takes the next messages off the queue, false if there are none.
+    bool next() {
+        current = {};
+        batch.clear();
+
+        std::lock_guard lck(queueMutex);
+        if (messages.empty()) {
+            state = State::Idle;
+            return false;
+        }
+
+        if (messages.front().bytes().size() >= options.batchSize) {
+            current = popFront();
+            writing = current.bytes();
+            return true;
+        }
+
+        while (!messages.empty() && batch.size() + messages.front().bytes().size() <= options.batchSize) {
+            const auto message = popFront();
+            const auto bytes = message.bytes();
+            batch.insert(batch.end(), bytes.begin(), bytes.end());
+        }
+        writing = batch;
+        return true;
+    }
+};
+
+SendQueue::SendQueue(EventLoop& loop, SimpleConnection& conn, const SendQueueOptions& options)
+    : pimpl_(std::make_shared<Impl>(loop, conn, options)) {}
+
+bool SendQueue::push(std::span<const uint8_t> data, std::optional<uint64_t> key) {
+    auto copy = BufferPool::global().acquire(data.size());
+    std::copy(data.begin(), data.end(), copy.data());
+    return push(std::move(copy), key);
+}
+
+bool SendQueue::push(PooledBuffer data, std::optional<uint64_t> key) {
+    return pimpl_->push({std::move(data), nullptr, key});
+}
+
+bool SendQueue::push(std::shared_ptr<const PooledBuffer> data, std::optional<uint64_t> key) {
+    if (!data) return true;
+    return pimpl_->push({{}, std::move(data), key});
+}
+
+size_t SendQueue::queued() const {
+    return pimpl_->queuedBytes;
+}
+
+void SendQueue::close() {
+    pimpl_->close();
+}
+
+SendQueue::~SendQueue() {
+    close();
+}
@@ -1,181 +1,273 @@
 #include "simple_socket/SharedMemoryConnection.hpp"
 
-#include <cstring>
-#include <thread>
+#include "simple_socket/shm/NamedSemaphore.hpp"
+#include "simple_socket/shm/SharedSegment.hpp"
+#include "simple_socket/shm/SpinWait.hpp"
+#include "simple_socket/shm/SpscRing.hpp"
 
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <fcntl.h>
-#include <semaphore.h>
-#include <sys/mman.h>
-#include <unistd.h>
-#endif
+#include <cstring>
+#include <new>
+#include <optional>
+#include <stdexcept>
 
 using namespace simple_socket;
+using namespace simple_socket::shm;
 
-struct BufferControl {
-    size_t size;
-    uint8_t data[1];// Flexible array member
-};
+namespace {
+
+    constexpr uint64_t segmentMagic = 0x53534D52494E4731;// "SSMRING1"
+
+    // Written once by the server, the client takes the layout from here
+    struct alignas(cacheLineSize) SegmentHeader {
+        std::atomic<uint64_t> magic;// set last, once the rest of the segment is initialised
+        uint64_t maxMessageSize;
+        uint64_t capacity;
+    };
+
+    // Shared memory layout: [SegmentHeader][RingControl A][data A][RingControl B][data B]
+    // Ring A carries server to client messages, ring B client to server.
+    struct Layout {
+        size_t maxMessageSize;
+        uint64_t capacity;
+
+        [[nodiscard]] size_t ringSize() const {
+            return sizeof(RingControl) + SpscRing::dataSize(capacity, maxMessageSize);
+        }
+
+        [[nodiscard]] size_t ringOffset(bool ringB) const {
+            return sizeof(SegmentHeader) + (ringB ? ringSize() : 0);
+        }
+
+        [[nodiscard]] size_t totalSize() const {
+            return sizeof(SegmentHeader) + 2 * ringSize();
+        }
+    };
+
+}// namespace
 
 struct SharedMemoryConnection::Impl {
     std::string name_;
-    size_t bufferSize_;
     bool isServer_;
+    WaitPolicy waitPolicy_;
+    size_t spinCount_;
+    std::optional<SharedSegment> segment_;
     uint8_t* shm_ = nullptr;
 
-    BufferControl* myBuffer_ = nullptr;
-    BufferControl* peerBuffer_ = nullptr;
-
-#ifdef _WIN32
-    HANDLE hMapFile_ = nullptr;
-    HANDLE myWriteSem_ = nullptr;
-    HANDLE myReadSem_ = nullptr;
-    HANDLE peerWriteSem_ = nullptr;
-    HANDLE peerReadSem_ = nullptr;
-#else
-    int fd_ = -1;
-    sem_t* myWriteSem_ = nullptr;
-    sem_t* myReadSem_ = nullptr;
-    sem_t* peerWriteSem_ = nullptr;
-    sem_t* peerReadSem_ = nullptr;
-#endif
-
-    Impl(const std::string& name, size_t size, bool isServer)
-        : name_(name), bufferSize_(size), isServer_(isServer) {
-
-        // Shared memory layout: [BufferA][BufferB]
-        size_t totalSize = 2 * (sizeof(BufferControl) - 1 + size);
-
-#ifdef _WIN32
+    std::optional<SpscRing> tx_;
+    std::optional<SpscRing> rx_;
+
+    // outstanding loans, 0 when there is none
+    size_t writeLoan_ = 0;
+    size_t readLoan_ = 0;
+
+    // per ring: "r" is posted when a message arrives, "w" when room frees up
+    std::optional<NamedSemaphore> myWriteSem_;
+    std::optional<NamedSemaphore> myReadSem_;
+    std::optional<NamedSemaphore> peerWriteSem_;
+    std::optional<NamedSemaphore> peerReadSem_;
+
+    Impl(const std::string& name, size_t size, bool isServer, const SharedMemoryOptions& options)
+        : name_(name), isServer_(isServer), waitPolicy_(options.waitPolicy), spinCount_(options.spinCount) {
+
         if (isServer) {
-            hMapFile_ = CreateFileMapping(
-                    INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
-                    static_cast<DWORD>(totalSize), name.c_str());
+            if (size == 0 || options.slots == 0) {
+                throw std::invalid_argument("SharedMemoryConnection requires a non-zero size and slot count");
+            }
+            const Layout layout{size, SpscRing::capacityFor(size, options.slots)};
+            segment_.emplace(name, layout.totalSize(), options);
+            shm_ = segment_->data();
+            initialise(layout);
         } else {
-            hMapFile_ = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+            segment_.emplace(name, options);
+            shm_ = segment_->data();
         }
-        if (hMapFile_) {
-            shm_ = static_cast<uint8_t*>(MapViewOfFile(
-                    hMapFile_, FILE_MAP_ALL_ACCESS, 0, 0, totalSize));
-        }
-#else
-        if (isServer) {
-            fd_ = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
-            ftruncate(fd_, totalSize);
-        } else {
-            fd_ = shm_open(name.c_str(), O_RDWR, 0666);
+
+        const auto header = reinterpret_cast<SegmentHeader*>(shm_);
+        if (header->magic.load(std::memory_order_acquire) != segmentMagic) {
+            close();
+            throw std::runtime_error("Shared memory segment '" + name + "' is not initialised");
         }
-        if (fd_ != -1) {
-            shm_ = static_cast<uint8_t*>(mmap(
-                    nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+        const Layout layout{static_cast<size_t>(header->maxMessageSize), header->capacity};
+        if (layout.totalSize() > segment_->size()) {
+            close();
+            throw std::runtime_error("Shared memory segment '" + name + "' is truncated");
         }
-#endif
-        // Buffer assignment
-        myBuffer_ = reinterpret_cast<BufferControl*>(shm_ + (isServer ? 0 : (sizeof(BufferControl) - 1 + size)));
-        peerBuffer_ = reinterpret_cast<BufferControl*>(shm_ + (isServer ? (sizeof(BufferControl) - 1 + size) : 0));
+
+        const auto ring = [&](bool ringB) {
+            const auto base = shm_ + layout.ringOffset(ringB);
+            return SpscRing(reinterpret_cast<RingControl*>(base), base + sizeof(RingControl), layout.capacity, layout.maxMessageSize);
+        };
+        tx_.emplace(ring(!isServer));
+        rx_.emplace(ring(isServer));
 
         // Semaphore names
         std::string semBase = (isServer ? "A" : "B");
         std::string peerSemBase = (isServer ? "B" : "A");
 
-#ifdef _WIN32
-        myWriteSem_ = CreateSemaphore(nullptr, 1, 1, (name + "_w" + semBase).c_str());
-        myReadSem_ = CreateSemaphore(nullptr, 0, 1, (name + "_r" + semBase).c_str());
-        peerWriteSem_ = CreateSemaphore(nullptr, 1, 1, (name + "_w" + peerSemBase).c_str());
-        peerReadSem_ = CreateSemaphore(nullptr, 0, 1, (name + "_r" + peerSemBase).c_str());
-#else
-        myWriteSem_ = sem_open(("/" + name + "_w" + semBase).c_str(), O_CREAT, 0666, 1);
-        myReadSem_ = sem_open(("/" + name + "_r" + semBase).c_str(), O_CREAT, 0666, 0);
-        peerWriteSem_ = sem_open(("/" + name + "_w" + peerSemBase).c_str(), O_CREAT, 0666, 1);
-        peerReadSem_ = sem_open(("/" + name + "_r" + peerSemBase).c_str(), O_CREAT, 0666, 0);
-#endif
+        try {
+            myWriteSem_.emplace(name + "_w" + semBase);
+            myReadSem_.emplace(name + "_r" + semBase);
+            peerWriteSem_.emplace(name + "_w" + peerSemBase);
+            peerReadSem_.emplace(name + "_r" + peerSemBase);
+        } catch (const std::exception&) {
+            close();
+            throw;
+        }
+    }
+
+    void initialise(const Layout& layout) {
+        const auto header = new (shm_) SegmentHeader{};
+        header->maxMessageSize = layout.maxMessageSize;
+        header->capacity = layout.capacity;
+        for (const bool ringB : {false, true}) {
+            new (shm_ + layout.ringOffset(ringB)) RingControl{};
+        }
+        header->magic.store(segmentMagic, std::memory_order_release);
     }
 
     ~Impl() { close(); }
 
+    // The reader announces it is about to sleep, then looks once more. The writer publishes, then checks for
+    // a sleeping reader. With a full fence on both sides at least one of them sees the other, so a message
+    // can not slip in unnoticed between the consumer's last look and its wait.
+    std::span<const uint8_t> waitReadable() {
+        std::span<const uint8_t> view;
+        const auto ready = [&] {
+            view = rx_->tryPeek();
+            return view.data() != nullptr;
+        };
+        if (spinWait(waitPolicy_, spinCount_, ready)) return view;
+
+        auto& control = rx_->control();
+        for (;;) {
+            if (ready()) return view;
+
+            control.readerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!rx_->empty()) {
+                control.readerWaiting.store(0, std::memory_order_relaxed);
+                continue;
+            }
+            peerReadSem_->wait();
+        }
+    }
+
+    uint8_t* waitWritable(size_t size) {
+        uint8_t* buffer = nullptr;
+        const auto ready = [&] {
+            buffer = tx_->tryAcquire(size);
+            return buffer != nullptr;
+        };
+        if (spinWait(waitPolicy_, spinCount_, ready)) return buffer;
+
+        auto& control = tx_->control();
+        for (;;) {
+            if (ready()) return buffer;
+
+            control.writerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!tx_->full(size)) {
+                control.writerWaiting.store(0, std::memory_order_relaxed);
+                continue;
+            }
+            myWriteSem_->wait();
+        }
+    }
+
+    void commit(size_t size) {
+        tx_->commit(size);
+        wake(tx_->control().readerWaiting, *myReadSem_);
+    }
+
+    void release(size_t size) {
+        rx_->release(size);
+        wake(rx_->control().writerWaiting, *peerWriteSem_);
+    }
+
+    static void wake(std::atomic<uint32_t>& waiting, NamedSemaphore& sem) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed) && waiting.exchange(0, std::memory_order_relaxed)) {
+            sem.post();
+        }
+    }
+
     void close() {
-#ifdef _WIN32
-        if (shm_) UnmapViewOfFile(shm_);
-        if (hMapFile_) CloseHandle(hMapFile_);
-        if (myWriteSem_) CloseHandle(myWriteSem_);
-        if (myReadSem_) CloseHandle(myReadSem_);
-        if (peerWriteSem_) CloseHandle(peerWriteSem_);
-        if (peerReadSem_) CloseHandle(peerReadSem_);
-#else
-        if (shm_) munmap(shm_, 2 * (sizeof(BufferControl) - 1 + bufferSize_));
-        if (fd_ != -1) ::close(fd_);
-        if (myWriteSem_) sem_close(myWriteSem_);
-        if (myReadSem_) sem_close(myReadSem_);
-        if (peerWriteSem_) sem_close(peerWriteSem_);
-        if (peerReadSem_) sem_close(peerReadSem_);
-        if (isServer_) {
-            shm_unlink(name_.c_str());
-            sem_unlink(("/" + name_ + "_wA").c_str());
-            sem_unlink(("/" + name_ + "_rA").c_str());
-            sem_unlink(("/" + name_ + "_wB").c_str());
-            sem_unlink(("/" + name_ + "_rB").c_str());
+        tx_.reset();
+        rx_.reset();
+        const bool removeSemaphores = isServer_ && segment_;
+        segment_.reset();
+        myWriteSem_.reset();
+        myReadSem_.reset();
+        peerWriteSem_.reset();
+        peerReadSem_.reset();
+        if (removeSemaphores) {
+            for (const auto suffix : {"_wA", "_rA", "_wB", "_rB"}) {
+                NamedSemaphore::remove(name_ + suffix);
+            }
         }
-#endif
         shm_ = nullptr;
-        myWriteSem_ = myReadSem_ = peerWriteSem_ = peerReadSem_ = nullptr;
     }
 };
 
-SharedMemoryConnection::SharedMemoryConnection(const std::string& name, size_t size, bool isServer)
-    : pimpl_(std::make_unique<Impl>(name, size, isServer)) {}
+SharedMemoryConnection::SharedMemoryConnection(const std::string& name, size_t size, bool isServer, const SharedMemoryOptions& options)
+    : pimpl_(std::make_unique<Impl>(name, size, isServer, options)) {}
 
 int SharedMemoryConnection::read(uint8_t* buffer, size_t size) {
-    if (!buffer || size == 0) return -1;
-#ifdef _WIN32
-    WaitForSingleObject(pimpl_->peerReadSem_, INFINITE);
-#else
-    sem_wait(pimpl_->peerReadSem_);
-#endif
-    std::atomic_thread_fence(std::memory_order_acquire);
-
-    size_t dataSize = pimpl_->peerBuffer_->size;
+    if (!buffer || size == 0 || !pimpl_->rx_ || pimpl_->readLoan_) return -1;
+
+    const auto message = pimpl_->waitReadable();
+    const auto dataSize = message.size();
     if (dataSize > size) {
-#ifdef _WIN32
-        ReleaseSemaphore(pimpl_->peerWriteSem_, 1, nullptr);
-#else
-        sem_post(pimpl_->peerWriteSem_);
-#endif
+        pimpl_->release(dataSize);
         return -1;
     }
-    std::memcpy(buffer, pimpl_->peerBuffer_->data, dataSize);
-    pimpl_->peerBuffer_->size = 0;
-    std::atomic_thread_fence(std::memory_order_release);
-
-#ifdef _WIN32
-    ReleaseSemaphore(pimpl_->peerWriteSem_, 1, nullptr);
-#else
-    sem_post(pimpl_->peerWriteSem_);
-#endif
+    std::memcpy(buffer, message.data(), dataSize);
+    pimpl_->release(dataSize);
+
     return static_cast<int>(dataSize);
 }
 
 bool SharedMemoryConnection::write(const uint8_t* data, size_t size) {
-    if (!data || size == 0 || size > pimpl_->bufferSize_) return false;
-#ifdef _WIN32
-    WaitForSingleObject(pimpl_->myWriteSem_, INFINITE);
-#else
-    sem_wait(pimpl_->myWriteSem_);
-#endif
-    std::atomic_thread_fence(std::memory_order_release);
-    pimpl_->myBuffer_->size = size;
-    std::memcpy(pimpl_->myBuffer_->data, data, size);
-    std::atomic_thread_fence(std::memory_order_release);
-
-#ifdef _WIN32
-    ReleaseSemaphore(pimpl_->myReadSem_, 1, nullptr);
-#else
-    sem_post(pimpl_->myReadSem_);
-#endif
+    if (!data || size == 0 || !pimpl_->tx_ || pimpl_->writeLoan_ || size > pimpl_->tx_->maxMessageSize()) return false;
+
+    const auto buffer = pimpl_->waitWritable(size);
+    std::memcpy(buffer, data, size);
+    pimpl_->commit(size);
+
     return true;
 }
 
+std::span<uint8_t> SharedMemoryConnection::acquireWriteBuffer(size_t size) {
+    if (size == 0 || !pimpl_->tx_ || pimpl_->writeLoan_ || size > pimpl_->tx_->maxMessageSize()) return {};
+
+    const auto buffer = pimpl_->waitWritable(size);
+    pimpl_->writeLoan_ = size;
+    return {buffer, size};
+}
+
+bool SharedMemoryConnection::commit(size_t size) {
+    if (!pimpl_->tx_ || size > pimpl_->writeLoan_) return false;
+
+    pimpl_->writeLoan_ = 0;
+    if (size > 0) pimpl_->commit(size);
+    return true;
+}
+
+std::span<const uint8_t> SharedMemoryConnection::acquireReadView() {
+    if (!pimpl_->rx_) return {};
+
+    const auto message = pimpl_->waitReadable();
+    pimpl_->readLoan_ = message.size();
+    return message;
+}
+
+void SharedMemoryConnection::release() {
+    if (!pimpl_->rx_ || !pimpl_->readLoan_) return;
+
+    pimpl_->release(pimpl_->readLoan_);
+    pimpl_->readLoan_ = 0;
+}
+
 void SharedMemoryConnection::close() {
     if (pimpl_) pimpl_->close();
 }
@@ -0,0 +1,485 @@
+#include "simple_socket/SharedMemoryPubSub.hpp"
+
+#include "simple_socket/shm/NamedSemaphore.hpp"
+#include "simple_socket/shm/SharedSegment.hpp"
+#include "simple_socket/shm/SpinWait.hpp"
+#include "simple_socket/shm/SpscRing.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <unistd.h>
+#endif
+
+using namespace simple_socket;
+using namespace simple_socket::shm;
+
+namespace {
+
+    constexpr uint64_t segmentMagic = 0x53534D5055425331;// "SSMPUBS1"
+
+    // how often a blocked publisher looks for subscribers that died without detaching
+    constexpr std::chrono::milliseconds reapInterval{100};
+
+    struct alignas(cacheLineSize) SegmentHeader {
+        std::atomic<uint64_t> magic;// set last, once the rest of the segment is initialised
+        uint64_t maxMessageSize;
+        uint64_t capacity;
+        uint64_t maxSubscribers;
+    };
+
+    struct PublisherControl {
+        alignas(cacheLineSize) std::atomic<uint64_t> head;         // next write position
+        alignas(cacheLineSize) std::atomic<uint32_t> writerWaiting;// set by a publisher about to block on a full ring
+        std::atomic<uint32_t> closed;
+    };
+
+    enum SlotState : uint32_t {
+        Free,
+        Joining,
+        Active
+    };
+
+    struct SubscriberSlot {
+        alignas(cacheLineSize) std::atomic<uint64_t> cursor;// next read position, written by the subscriber only
+        alignas(cacheLineSize) std::atomic<uint32_t> state;
+        std::atomic<uint32_t> readerWaiting;// set by a subscriber about to block on an empty ring
+        std::atomic<int64_t> pid;
+    };
+
+    // Shared memory layout: [SegmentHeader][PublisherControl][SubscriberSlot x maxSubscribers][data]
+    // The data area holds records as laid out by SpscRing.
+    struct Layout {
+        size_t maxMessageSize;
+        uint64_t capacity;
+        size_t maxSubscribers;
+
+        [[nodiscard]] size_t slotsOffset() const {
+            return sizeof(SegmentHeader) + sizeof(PublisherControl);
+        }
+
+        [[nodiscard]] size_t dataOffset() const {
+            return slotsOffset() + maxSubscribers * sizeof(SubscriberSlot);
+        }
+
+        [[nodiscard]] size_t totalSize() const {
+            return dataOffset() + SpscRing::dataSize(capacity, maxMessageSize);
+        }
+    };
+
+    std::string subscriberSemaphore(const std::string& name, size_t slot) {
+        return name + "_s" + std::to_string(slot);
+    }
+
+    std::string publisherSemaphore(const std::string& name) {
+        return name + "_p";
+    }
+
+    int64_t currentProcess() {
+#ifdef _WIN32
+        return static_cast<int64_t>(GetCurrentProcessId());
+#else
+        return static_cast<int64_t>(getpid());
+#endif
+    }
+
+    bool processAlive(int64_t pid) {
+#ifdef _WIN32
+        const auto process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(pid));
+        if (!process) return GetLastError() == ERROR_ACCESS_DENIED;
+        const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+        CloseHandle(process);
+        return alive;
+#else
+        return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+    }
+
+    void wake(std::atomic<uint32_t>& waiting, NamedSemaphore& sem) {
+        if (waiting.load(std::memory_order_relaxed) && waiting.exchange(0, std::memory_order_relaxed)) {
+            sem.post();
+        }
+    }
+
+    // Maps and validates a segment created by a publisher
+    struct Mapping {
+        SharedSegment segment;
+        Layout layout;
+        PublisherControl* control;
+        SubscriberSlot* slots;
+        uint8_t* data;
+
+        Mapping(const std::string& name, const SharedMemoryOptions& options, const std::optional<Layout>& create)
+            : segment(create ? SharedSegment(name, create->totalSize(), options) : SharedSegment(name, options)),
+              layout(create.value_or(Layout{})) {
+
+            const auto base = segment.data();
+            const auto header = reinterpret_cast<SegmentHeader*>(base);
+            if (create) {
+                new (header) SegmentHeader{};
+                header->maxMessageSize = layout.maxMessageSize;
+                header->capacity = layout.capacity;
+                header->maxSubscribers = layout.maxSubscribers;
+                new (base + sizeof(SegmentHeader)) PublisherControl{};
+                for (size_t i = 0; i < layout.maxSubscribers; ++i) {
+                    new (base + layout.slotsOffset() + i * sizeof(SubscriberSlot)) SubscriberSlot{};
+                }
+                header->magic.store(segmentMagic, std::memory_order_release);
+            } else {
+                if (segment.size() < sizeof(SegmentHeader) || header->magic.load(std::memory_order_acquire) != segmentMagic) {
+                    throw std::runtime_error("Shared memory segment '" + name + "' is not a publisher");
+                }
+                layout = {static_cast<size_t>(header->maxMessageSize), header->capacity, static_cast<size_t>(header->maxSubscribers)};
+                if (layout.totalSize() > segment.size()) {
+                    throw std::runtime_error("Shared memory segment '" + name + "' is truncated");
+                }
+            }
+
+            control = reinterpret_cast<PublisherControl*>(base + sizeof(SegmentHeader));
+            slots = reinterpret_cast<SubscriberSlot*>(base + layout.slotsOffset());
+            data = base + layout.dataOffset();
+        }
+
+        [[nodiscard]] uint8_t* record(uint64_t position) const {
+            return data + position % layout.capacity;
+        }
+    };
+
+}// namespace
+
+struct SharedMemoryPublisher::Impl {
+    std::string name_;
+    size_t maxSubscribers_;
+    WaitPolicy waitPolicy_;
+    size_t spinCount_;
+    std::optional<Mapping> mapping_;
+    std::optional<NamedSemaphore> spaceSem_;
+    std::vector<std::unique_ptr<NamedSemaphore>> subscriberSems_;
+
+    uint64_t head_{0};
+    uint64_t minCursor_{0};// last seen cursor of the slowest subscriber, or head_ if there were none
+    size_t writeLoan_{0};
+
+    Impl(const std::string& name, size_t maxMessageSize, const SharedMemoryOptions& options)
+        : name_(name), maxSubscribers_(options.maxSubscribers), waitPolicy_(options.waitPolicy), spinCount_(options.spinCount) {
+
+        if (maxMessageSize == 0 || options.slots == 0 || options.maxSubscribers == 0) {
+            throw std::invalid_argument("SharedMemoryPublisher requires a non-zero size, slot count and subscriber count");
+        }
+        mapping_.emplace(name, options, Layout{maxMessageSize, SpscRing::capacityFor(maxMessageSize, options.slots), options.maxSubscribers});
+
+        try {
+            spaceSem_.emplace(publisherSemaphore(name));
+            for (size_t i = 0; i < options.maxSubscribers; ++i) {
+                subscriberSems_.push_back(std::make_unique<NamedSemaphore>(subscriberSemaphore(name, i)));
+            }
+        } catch (const std::exception&) {
+            close();
+            throw;
+        }
+    }
+
+    ~Impl() { close(); }
+
+    [[nodiscard]] size_t maxMessageSize() const {
+        return mapping_->layout.maxMessageSize;
+    }
+
+    // Cursors of attached subscribers only ever increase, so the cached minimum stays a safe lower bound
+    // until it is recomputed here. A subscriber attaching concurrently starts at a head value this scan can
+    // not be ahead of, see SharedMemorySubscriber::Impl::attach.
+    void scanSubscribers() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        minCursor_ = head_;
+        for (size_t i = 0; i < mapping_->layout.maxSubscribers; ++i) {
+            const auto& slot = mapping_->slots[i];
+            if (slot.state.load(std::memory_order_relaxed) == Active) {
+                minCursor_ = std::min(minCursor_, slot.cursor.load(std::memory_order_acquire));
+            }
+        }
+    }
+
+    [[nodiscard]] bool full(size_t size) const {
+        return head_ - minCursor_ + SpscRing::recordSize(size) > mapping_->layout.capacity;
+    }
+
+    uint8_t* tryAcquire(size_t size) {
+        if (full(size)) {
+            scanSubscribers();
+            if (full(size)) return nullptr;
+        }
+        return mapping_->record(head_) + SpscRing::recordHeaderSize;
+    }
+
+    uint8_t* waitWritable(size_t size) {
+        uint8_t* buffer = nullptr;
+        const auto ready = [&] {
+            buffer = tryAcquire(size);
+            return buffer != nullptr;
+        };
+        if (spinWait(waitPolicy_, spinCount_, ready)) return buffer;
+
+        auto& control = *mapping_->control;
+        for (;;) {
+            if (ready()) return buffer;
+
+            control.writerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            scanSubscribers();
+            if (!full(size)) {
+                control.writerWaiting.store(0, std::memory_order_relaxed);
+                continue;
+            }
+            if (!spaceSem_->waitFor(reapInterval)) {
+                reapSubscribers();
+            }
+        }
+    }
+
+    // Detaches subscribers whose process is gone, they would hold the ring back forever
+    void reapSubscribers() {
+        for (size_t i = 0; i < mapping_->layout.maxSubscribers; ++i) {
+            auto& slot = mapping_->slots[i];
+            uint32_t active = Active;
+            if (slot.state.load(std::memory_order_relaxed) == Active && !processAlive(slot.pid.load(std::memory_order_relaxed))) {
+                slot.state.compare_exchange_strong(active, Free);
+            }
+        }
+    }
+
+    void commit(size_t size) {
+        const uint64_t recordHeader = size;
+        std::memcpy(mapping_->record(head_), &recordHeader, SpscRing::recordHeaderSize);
+        head_ += SpscRing::recordSize(size);
+        mapping_->control->head.store(head_, std::memory_order_release);
+        wakeSubscribers();
+    }
+
+    void wakeSubscribers() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (size_t i = 0; i < mapping_->layout.maxSubscribers; ++i) {
+            auto& slot = mapping_->slots[i];
+            if (slot.state.load(std::memory_order_relaxed) == Active) {
+                wake(slot.readerWaiting, *subscriberSems_[i]);
+            }
+        }
+    }
+
+    [[nodiscard]] size_t subscriberCount() const {
+        if (!mapping_) return 0;
+
+        size_t count = 0;
+        for (size_t i = 0; i < mapping_->layout.maxSubscribers; ++i) {
+            if (mapping_->slots[i].state.load(std::memory_order_relaxed) == Active) ++count;
+        }
+        return count;
+    }
+
+    void close() {
+        if (mapping_ && spaceSem_) {
+            mapping_->control->closed.store(1, std::memory_order_relaxed);
+            wakeSubscribers();
+        }
+        mapping_.reset();
+        spaceSem_.reset();
+        subscriberSems_.clear();
+
+        NamedSemaphore::remove(publisherSemaphore(name_));
+        for (size_t i = 0; i < maxSubscribers_; ++i) {
+            NamedSemaphore::remove(subscriberSemaphore(name_, i));
+        }
+    }
+};
+
+struct SharedMemorySubscriber::Impl {
+    WaitPolicy waitPolicy_;
+    size_t spinCount_;
+    std::optional<Mapping> mapping_;
+    SubscriberSlot* slot_ = nullptr;
+    std::optional<NamedSemaphore> dataSem_;
+    std::optional<NamedSemaphore> spaceSem_;
+
+    uint64_t cursor_{0};
+    uint64_t head_{0};// last seen publisher head
+    size_t readLoan_{0};
+
+    Impl(const std::string& name, const SharedMemoryOptions& options)
+        : waitPolicy_(options.waitPolicy), spinCount_(options.spinCount) {
+
+        mapping_.emplace(name, options, std::nullopt);
+
+        size_t index = 0;
+        for (; index < mapping_->layout.maxSubscribers; ++index) {
+            uint32_t free = Free;
+            if (mapping_->slots[index].state.compare_exchange_strong(free, Joining)) break;
+        }
+        if (index == mapping_->layout.maxSubscribers) {
+            throw std::runtime_error("Shared memory segment '" + name + "' has no free subscriber slots");
+        }
+        slot_ = &mapping_->slots[index];
+
+        try {
+            dataSem_.emplace(subscriberSemaphore(name, index));
+            spaceSem_.emplace(publisherSemaphore(name));
+        } catch (const std::exception&) {
+            slot_->state.store(Free, std::memory_order_release);
+            throw;
+        }
+        attach();
+    }
+
+    ~Impl() { close(); }
+
+    // Until it sees the slot as Active the publisher may overwrite anything, so the subscriber may only start at
+    // a head read after the slot became visible. The first cursor, published before that, is merely a lower bound
+    // for a publisher that happens to scan in between.
+    void attach() {
+        auto& head = mapping_->control->head;
+        slot_->pid.store(currentProcess(), std::memory_order_relaxed);
+        slot_->readerWaiting.store(0, std::memory_order_relaxed);
+        slot_->cursor.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        slot_->state.store(Active, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cursor_ = head_ = head.load(std::memory_order_acquire);
+        slot_->cursor.store(cursor_, std::memory_order_release);
+    }
+
+    std::span<const uint8_t> tryPeek() {
+        if (cursor_ == head_) {
+            head_ = mapping_->control->head.load(std::memory_order_acquire);
+            if (cursor_ == head_) return {};
+        }
+        const auto record = mapping_->record(cursor_);
+        uint64_t size;
+        std::memcpy(&size, record, SpscRing::recordHeaderSize);
+        return {record + SpscRing::recordHeaderSize, static_cast<size_t>(size)};
+    }
+
+    // Empty once the publisher has closed and the ring is drained
+    std::span<const uint8_t> waitReadable() {
+        std::span<const uint8_t> view;
+        const auto ready = [&] {
+            view = tryPeek();
+            return view.data() != nullptr || mapping_->control->closed.load(std::memory_order_relaxed);
+        };
+        if (spinWait(waitPolicy_, spinCount_, ready)) return view;
+
+        for (;;) {
+            if (ready()) return view;
+
+            slot_->readerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready()) {
+                slot_->readerWaiting.store(0, std::memory_order_relaxed);
+                return view;
+            }
+            dataSem_->wait();
+        }
+    }
+
+    void release(size_t size) {
+        cursor_ += SpscRing::recordSize(size);
+        slot_->cursor.store(cursor_, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake(mapping_->control->writerWaiting, *spaceSem_);
+    }
+
+    void close() {
+        if (slot_) {
+            slot_->state.store(Free, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wake(mapping_->control->writerWaiting, *spaceSem_);
+            slot_ = nullptr;
+        }
+        dataSem_.reset();
+        spaceSem_.reset();
+        mapping_.reset();
+    }
+};
+
+SharedMemoryPublisher::SharedMemoryPublisher(const std::string& name, size_t maxMessageSize, const SharedMemoryOptions& options)
+    : pimpl_(std::make_unique<Impl>(name, maxMessageSize, options)) {}
+
+bool SharedMemoryPublisher::publish(const uint8_t* data, size_t size) {
+    if (!data || size == 0 || !pimpl_->mapping_ || pimpl_->writeLoan_ || size > pimpl_->maxMessageSize()) return false;
+
+    const auto buffer = pimpl_->waitWritable(size);
+    std::memcpy(buffer, data, size);
+    pimpl_->commit(size);
+
+    return true;
+}
+
+std::span<uint8_t> SharedMemoryPublisher::acquireWriteBuffer(size_t size) {
+    if (size == 0 || !pimpl_->mapping_ || pimpl_->writeLoan_ || size > pimpl_->maxMessageSize()) return {};
+
+    const auto buffer = pimpl_->waitWritable(size);
+    pimpl_->writeLoan_ = size;
+    return {buffer, size};
+}
+
+bool SharedMemoryPublisher::commit(size_t size) {
+    if (!pimpl_->mapping_ || size > pimpl_->writeLoan_) return false;
+
+    pimpl_->writeLoan_ = 0;
+    if (size > 0) pimpl_->commit(size);
+    return true;
+}
+
+size_t SharedMemoryPublisher::subscriberCount() const {
+    return pimpl_->subscriberCount();
+}
+
+void SharedMemoryPublisher::close() {
+    pimpl_->close();
+}
+
+SharedMemoryPublisher::~SharedMemoryPublisher() = default;
+
+SharedMemorySubscriber::SharedMemorySubscriber(const std::string& name, const SharedMemoryOptions& options)
+    : pimpl_(std::make_unique<Impl>(name, options)) {}
+
+int SharedMemorySubscriber::read(uint8_t* buffer, size_t size) {
+    if (!buffer || size == 0 || !pimpl_->slot_ || pimpl_->readLoan_) return -1;
+
+    const auto message = pimpl_->waitReadable();
+    if (!message.data()) return -1;
+
+    const auto dataSize = message.size();
+    if (dataSize <= size) {
+        std::memcpy(buffer, message.data(), dataSize);
+    }
+    pimpl_->release(dataSize);
+
+    return dataSize <= size ? static_cast<int>(dataSize) : -1;
+}
+
+std::span<const uint8_t> SharedMemorySubscriber::acquireReadView() {
+    if (!pimpl_->slot_) return {};
+
+    const auto message = pimpl_->waitReadable();
+    pimpl_->readLoan_ = message.size();
+    return message;
+}
+
+void SharedMemorySubscriber::release() {
+    if (!pimpl_->slot_ || !pimpl_->readLoan_) return;
+
+    pimpl_->release(pimpl_->readLoan_);
+    pimpl_->readLoan_ = 0;
+}
+
+void SharedMemorySubscriber::close() {
+    pimpl_->close();
+}
+
+SharedMemorySubscriber::~SharedMemorySubscriber() = default;
@@ -0,0 +1,201 @@
+
+#include "simple_socket/SimpleConnection.hpp"
+
+#include "simple_socket/Socket.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <mswsock.h>
+#include <sys/stat.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+#endif
+
+using namespace simple_socket;
+
+namespace {
+
+    // Chunk size when the file has to be copied through user space
+    constexpr uint64_t copyChunk = 64 * 1024;
+
+    // Bytes per sendfile/TransmitFile call, both take at most a signed 32 bit count
+    constexpr uint64_t kernelChunk = 1u << 30;
+
+#ifndef _WIN32
+    // sendfile has no MSG_NOSIGNAL, so SIGPIPE is blocked for the calling thread while it runs.
+    // One raised meanwhile is consumed, unless one was already pending before.
+    class SigPipeBlock {
+    public:
+        SigPipeBlock() {
+            sigemptyset(&pipe_);
+            sigaddset(&pipe_, SIGPIPE);
+            pendingBefore_ = pending();
+            pthread_sigmask(SIG_BLOCK, &pipe_, &previous_);
+        }
+
+        SigPipeBlock(const SigPipeBlock&) = delete;
+        SigPipeBlock& operator=(const SigPipeBlock&) = delete;
+
+        ~SigPipeBlock() {
+            if (!pendingBefore_ && pending()) {
+                int signal;
+                sigwait(&pipe_, &signal);// returns right away, the signal is pending
+            }
+            pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+        }
+
+    private:
+        sigset_t pipe_{};
+        sigset_t previous_{};
+        bool pendingBefore_;
+
+        static bool pending() {
+            sigset_t set;
+            sigpending(&set);
+            return sigismember(&set, SIGPIPE) == 1;
+        }
+    };
+#endif
+
+}// namespace
+
+bool simple_socket::kernelSendFile(SOCKET sock, int fd, uint64_t& offset, uint64_t& length) {
+#if defined(__linux__)
+    const SigPipeBlock block;
+    bool sentAny = false;
+    while (length > 0) {
+        auto position = static_cast<off_t>(offset);
+        const auto n = ::sendfile(sock, fd, &position, std::min(length, kernelChunk));
+        if (n > 0) {
+            offset += n;
+            length -= n;
+            sentAny = true;
+            continue;
+        }
+        if (n == 0) break;// end of file
+        if (errno == EINTR) continue;
+        // the socket may have been put in non-blocking mode by an EventLoop
+        if (wouldBlock() && waitFor(sock, true)) continue;
+        if (!sentAny && (errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) return false;
+        break;
+    }
+    return true;
+#elif defined(__APPLE__)
+    const SigPipeBlock block;
+    bool sentAny = false;
+    while (length > 0) {
+        auto sent = static_cast<off_t>(std::min(length, kernelChunk));
+        const auto rc = ::sendfile(fd, sock, static_cast<off_t>(offset), &sent, nullptr, 0);
+        // sent is updated even when the call fails part way
+        offset += sent;
+        length -= sent;
+        sentAny |= sent > 0;
+        if (rc == 0) {
+            if (sent == 0) break;// end of file
+            continue;
+        }
+        if (errno == EINTR) continue;
+        if (wouldBlock() && waitFor(sock, true)) continue;
+        // only stream sockets of the internet domains are supported
+        if (!sentAny && (errno == ENOTSOCK || errno == EOPNOTSUPP || errno == ENOTSUP || errno == EINVAL)) return false;
+        break;
+    }
+    return true;
+#elif defined(_WIN32)
+    const auto file = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    const auto event = WSACreateEvent();
+    if (event == WSA_INVALID_EVENT) return false;
+
+    bool sentAny = false;
+    while (length > 0) {
+        const auto chunk = static_cast<DWORD>(std::min(length, kernelChunk));
+        OVERLAPPED overlapped{};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        overlapped.hEvent = event;
+
+        DWORD sent = 0;
+        DWORD flags = 0;
+        if (!TransmitFile(sock, file, chunk, 0, &overlapped, nullptr, 0)) {
+            const auto error = WSAGetLastError();
+            if (error != ERROR_IO_PENDING && error != WSA_IO_PENDING) {
+                WSACloseEvent(event);
+                return sentAny || error != WSAENOTSOCK;
+            }
+        }
+        if (!WSAGetOverlappedResult(sock, &overlapped, &sent, TRUE, &flags) || sent == 0) break;
+
+        offset += sent;
+        length -= sent;
+        sentAny = true;
+    }
+    WSACloseEvent(event);
+    return true;
+#else
+    (void) sock;
+    (void) fd;
+    (void) offset;
+    (void) length;
+    return false;
+#endif
+}
+
+bool SimpleConnection::sendFile(int fd, uint64_t offset, uint64_t length) {
+    std::vector<uint8_t> buffer(std::min(length, copyChunk));
+    while (length > 0) {
+        const auto chunk = static_cast<size_t>(std::min<uint64_t>(length, buffer.size()));
+#ifdef _WIN32
+        if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+        const auto n = _read(fd, buffer.data(), static_cast<unsigned>(chunk));
+#else
+        ssize_t n;
+        do {
+            n = ::pread(fd, buffer.data(), chunk, static_cast<off_t>(offset));
+        } while (n < 0 && errno == EINTR);
+#endif
+        if (n <= 0 || !write(buffer.data(), static_cast<size_t>(n))) {
+            return false;
+        }
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool SimpleConnection::sendFile(const std::string& path, uint64_t offset, std::optional<uint64_t> length) {
+#ifdef _WIN32
+    const int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+    struct _stat64 status{};
+    const bool opened = fd >= 0 && _fstat64(fd, &status) == 0;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status{};
+    const bool opened = fd >= 0 && ::fstat(fd, &status) == 0;
+#endif
+
+    bool result = false;
+    const auto size = static_cast<uint64_t>(status.st_size);
+    if (opened && offset <= size) {
+        result = sendFile(fd, offset, length.value_or(size - offset));
+    }
+
+    if (fd >= 0) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        ::close(fd);
+#endif
+    }
+    return result;
+}
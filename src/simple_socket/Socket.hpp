@@ -2,49 +2,252 @@
 #ifndef SIMPLE_SOCKET_SOCKET_HPP
 #define SIMPLE_SOCKET_SOCKET_HPP
 
+#include "simple_socket/Counters.hpp"
 #include "simple_socket/SimpleConnection.hpp"
+#include "simple_socket/Tracing.hpp"
 #include "simple_socket/socket_common.hpp"
 
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
 #ifdef SIMPLE_SOCKET_WITH_TLS
 #include <openssl/err.h>
 #include <openssl/ssl.h>
 #endif
 
-#ifndef _WIN32
-#include <fcntl.h>
-#endif
-
 
 namespace simple_socket {
 
-    struct Socket: SimpleConnection {
+    // Sends length bytes of fd from offset with the kernel copying them straight from the page cache
+    // (sendfile, TransmitFile), advancing offset and reducing length by what was sent.
+    // Returns false, having sent nothing, if the kernel can not send this file on sock, so the caller can fall back
+    // to copying. Returns true otherwise, length is then left non-zero if sending failed or the file ended early.
+    // A peer that went away makes it fail rather than raise SIGPIPE.
+    bool kernelSendFile(SOCKET sock, int fd, uint64_t& offset, uint64_t& length);
+
+    // A connection backed by an OS socket, which allows it to be driven by an EventLoop.
+    struct NativeConnection: SimpleConnection {
+
+        [[nodiscard]] virtual SOCKET nativeHandle() const = 0;
+
+        // An idle connection is healthy if it is still open and nothing arrived while it sat unused.
+        // Unread bytes mean it is out of step with its peer, e.g. a late reply to an abandoned request.
+        [[nodiscard]] virtual bool healthy() {
+            return nativeHandle() != INVALID_SOCKET && !waitFor(nativeHandle(), false, 0);
+        }
+
+        // True if data has already been taken off the socket and is waiting to be read, which readiness
+        // notification on the socket does not announce
+        [[nodiscard]] virtual bool hasPendingData() const {
+            return false;
+        }
+
+        [[nodiscard]] ConnectionStats stats() const override {
+            return counters_.snapshot();
+        }
+
+        // Hands what a read or write that returned n transferred to a running WireTrace. Public for I/O made
+        // on nativeHandle() from outside, e.g. sendmsg with descriptors attached.
+        void trace(tracing::Direction direction, const uint8_t* data, long long n) {
+            if (n > 0 && tracing::active.load(std::memory_order_relaxed)) {
+                const std::span<const uint8_t> buffer(data, static_cast<size_t>(n));
+                traceSlow(direction, std::span(&buffer, 1), 0, buffer.size());
+            }
+        }
+
+        // As above for a vectored write, of n bytes from offset into buffers
+        void trace(tracing::Direction direction, std::span<const std::span<const uint8_t>> buffers, size_t offset, long long n) {
+            if (n > 0 && tracing::active.load(std::memory_order_relaxed)) {
+                traceSlow(direction, buffers, offset, static_cast<size_t>(n));
+            }
+        }
+
+        ~NativeConnection() override {
+            if (traceId_ != 0 && tracing::active.load(std::memory_order_relaxed)) {
+                tracing::recordClose(traceId_, traceEndpoints_);
+            }
+        }
+
+    protected:
+        ConnectionCounters counters_;
+
+        // As trace for the size bytes of fd from offset that kernelSendFile sent
+        void traceFile(int fd, uint64_t offset, uint64_t size) {
+            if (size > 0 && tracing::active.load(std::memory_order_relaxed)) {
+                tracing::recordFile(traceId(), traceEndpoints_, fd, offset, size);
+            }
+        }
+
+    private:
+        // The endpoints are looked up when the connection is first traced
+        std::once_flag traceOnce_;
+        uint64_t traceId_ = 0;
+        tracing::Endpoints traceEndpoints_;
+
+        uint64_t traceId();
+
+        void traceSlow(tracing::Direction direction, std::span<const std::span<const uint8_t>> buffers, size_t offset, size_t size);
+    };
+
+    struct Socket: NativeConnection {
 
         explicit Socket(SOCKET socket)
             : sockfd_(socket) {}
 
+        using NativeConnection::sendFile;
+
         int read(unsigned char* buffer, size_t size) override {
 
+            for (;;) {
 #ifdef _WIN32
+                const auto read = recv(sockfd_, reinterpret_cast<char*>(buffer), static_cast<int>(size), 0);
+#else
+                const auto read = ::read(sockfd_, buffer, size);
+#endif
+                counters_.onRead(read);
+                trace(tracing::Direction::In, buffer, read);
+                // the socket may have been put in non-blocking mode by an EventLoop
+                if (read == SOCKET_ERROR && wouldBlock() && waitFor(sockfd_, false)) {
+                    continue;
+                }
+
+                return (read != SOCKET_ERROR) && (read != 0) ? static_cast<int>(read) : -1;
+            }
+        }
+
+        int tryRead(unsigned char* buffer, size_t size) override {
+#ifdef _WIN32
+            if (!waitFor(sockfd_, false, 0)) return 0;
             const auto read = recv(sockfd_, reinterpret_cast<char*>(buffer), static_cast<int>(size), 0);
 #else
-            const auto read = ::read(sockfd_, buffer, size);
+            ssize_t read;
+            do {
+                read = ::recv(sockfd_, buffer, size, MSG_DONTWAIT);
+            } while (read == SOCKET_ERROR && errno == EINTR);
 #endif
+            counters_.onRead(read);
+            trace(tracing::Direction::In, buffer, read);
+            if (read == SOCKET_ERROR && wouldBlock()) return 0;
+            return (read != SOCKET_ERROR) && (read != 0) ? static_cast<int>(read) : -1;
+        }
 
-            return (read != SOCKET_ERROR) && (read != 0) ? read : -1;
+        int tryWrite(const unsigned char* data, size_t size) override {
+            size = std::min<size_t>(size, std::numeric_limits<int>::max());
+#ifdef _WIN32
+            if (!waitFor(sockfd_, true, 0)) return 0;
+            const auto n = send(sockfd_, reinterpret_cast<const char*>(data), static_cast<int>(size), 0);
+#else
+            ssize_t n;
+            do {
+                n = ::send(sockfd_, data, size, MSG_DONTWAIT | sendFlags);
+            } while (n == SOCKET_ERROR && errno == EINTR);
+#endif
+            counters_.onWrite(n);
+            trace(tracing::Direction::Out, data, n);
+            if (n == SOCKET_ERROR) return wouldBlock() ? 0 : -1;
+            return static_cast<int>(n);
         }
 
         bool write(const unsigned char* data, size_t size) override {
 
+            size_t total = 0;
+            while (total < size) {
 #ifdef _WIN32
-            return send(sockfd_, reinterpret_cast<const char*>(data), static_cast<int>(size), 0) != SOCKET_ERROR;
+                const auto n = send(sockfd_, reinterpret_cast<const char*>(data + total), static_cast<int>(size - total), 0);
 #else
-            return ::write(sockfd_, data, size) != SOCKET_ERROR;
+                const auto n = ::send(sockfd_, data + total, size - total, sendFlags);
 #endif
+                counters_.onWrite(n);
+                trace(tracing::Direction::Out, data + total, n);
+                if (n == SOCKET_ERROR) {
+                    if (wouldBlock() && waitFor(sockfd_, true)) continue;
+                    return false;
+                }
+                total += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        bool writev(std::span<const std::span<const uint8_t>> buffers) override {
+
+            // buffers are submitted in batches, IOV_MAX is at least 16 on POSIX systems
+            constexpr size_t maxBatch = 16;
+
+            size_t index = 0; // first buffer not yet fully written
+            size_t offset = 0;// bytes of buffers[index] already written
+            while (index < buffers.size()) {
+#ifdef _WIN32
+                WSABUF batch[maxBatch];
+#else
+                iovec batch[maxBatch];
+#endif
+                size_t count = 0;
+                for (size_t i = index; i < buffers.size() && count < maxBatch; ++i) {
+                    const auto skip = (i == index) ? offset : 0;
+                    if (buffers[i].size() == skip) continue;
+#ifdef _WIN32
+                    batch[count].buf = reinterpret_cast<CHAR*>(const_cast<uint8_t*>(buffers[i].data() + skip));
+                    batch[count].len = static_cast<ULONG>(buffers[i].size() - skip);
+#else
+                    batch[count].iov_base = const_cast<uint8_t*>(buffers[i].data() + skip);
+                    batch[count].iov_len = buffers[i].size() - skip;
+#endif
+                    ++count;
+                }
+                if (count == 0) break;
+
+#ifdef _WIN32
+                DWORD sent = 0;
+                const auto n = WSASend(sockfd_, batch, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) == 0 ? static_cast<long long>(sent) : SOCKET_ERROR;
+#else
+                msghdr msg{};
+                msg.msg_iov = batch;
+                msg.msg_iovlen = count;
+                const auto n = ::sendmsg(sockfd_, &msg, sendFlags);
+#endif
+                counters_.onWrite(n);
+                trace(tracing::Direction::Out, buffers.subspan(index), offset, n);
+                if (n == SOCKET_ERROR) {
+                    if (wouldBlock() && waitFor(sockfd_, true)) continue;
+                    return false;
+                }
+
+                // advance past what was written, which may end in the middle of a buffer
+                auto written = static_cast<size_t>(n);
+                while (index < buffers.size()) {
+                    const auto remaining = buffers[index].size() - offset;
+                    if (written < remaining) {
+                        offset += written;
+                        break;
+                    }
+                    written -= remaining;
+                    ++index;
+                    offset = 0;
+                }
+            }
+            return true;
+        }
+
+        bool sendFile(int fd, uint64_t offset, uint64_t length) override {
+
+            const auto start = offset;
+            if (kernelSendFile(sockfd_, fd, offset, length)) {
+                traceFile(fd, start, offset - start);
+                return length == 0;
+            }
+            return NativeConnection::sendFile(fd, offset, length);
+        }
+
+        [[nodiscard]] SOCKET nativeHandle() const override {
+
+            return sockfd_;
         }
 
         void close() override {
 
             closeSocket(sockfd_);
+            sockfd_ = INVALID_SOCKET;
         }
 
         ~Socket() override {
@@ -57,20 +260,17 @@ namespace simple_socket {
 
 #ifdef SIMPLE_SOCKET_WITH_TLS
 
-
-    // Helper: put socket into non-blocking mode
-    inline void set_nonblocking(SOCKET s) {
-#ifdef _WIN32
-        u_long mode = 1;
-        ioctlsocket(s, FIONBIO, &mode);
+    // Asks OpenSSL to hand record encryption over to the kernel once the handshake is done (Linux kTLS).
+    // Stays in user space if OpenSSL, the kernel (the tls module) or the negotiated cipher does not support it.
+    inline void requestKernelTLS(SSL* ssl) {
+#ifdef SSL_OP_ENABLE_KTLS
+        SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
 #else
-        int flags = fcntl(s, F_GETFL, 0);
-        if (flags >= 0) fcntl(s, F_SETFL, flags | O_NONBLOCK);
+        (void) ssl;
 #endif
     }
 
-
-    class TLSConnection: public SimpleConnection {
+    class TLSConnection: public NativeConnection {
     public:
         TLSConnection(SOCKET sock, SSL* ssl, SSL_CTX* ctx = nullptr)
             : sockfd_(sock), ssl_(ssl), ctx_(ctx) {
@@ -87,15 +287,13 @@ namespace simple_socket {
             size_t total = 0;
             while (total < len) {
                 const int n = SSL_write(ssl_, buf + total, static_cast<int>(len - total));
+                counters_.onWrite(n);
+                trace(tracing::Direction::Out, buf + total, n);
                 if (n > 0) {
                     total += static_cast<size_t>(n);
                     continue;
                 }
-                const int err = SSL_get_error(ssl_, n);
-                if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
-                    continue; // retry
-                }
-                return false; // fatal
+                if (!waitForIo(n)) return false;
             }
             return true;
         }
@@ -105,21 +303,125 @@ namespace simple_socket {
 
             for (;;) {
                 const int n = SSL_read(ssl_, buf, static_cast<int>(len));
+                counters_.onRead(n);
+                trace(tracing::Direction::In, buf, n);
                 if (n > 0) return n;
 
-                const int err = SSL_get_error(ssl_, n);
-                if (err == SSL_ERROR_ZERO_RETURN) return 0; // clean TLS shutdown
-                if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
-                    // retry until caller cancels via close()
-                    continue;
-                }
-                return -1; // fatal
+                if (SSL_get_error(ssl_, n) == SSL_ERROR_ZERO_RETURN) return 0; // clean TLS shutdown
+                if (!waitForIo(n)) return -1;
+            }
+        }
+
+        int tryRead(uint8_t* buf, size_t len) override {
+            if (!ssl_) return -1;
+
+            const int n = SSL_read(ssl_, buf, static_cast<int>(len));
+            counters_.onRead(n);
+            trace(tracing::Direction::In, buf, n);
+            if (n > 0) return n;
+
+            // a write may be needed to make progress, e.g. for a key update, the socket will then be readable again
+            const int err = SSL_get_error(ssl_, n);
+            return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? 0 : -1;
+        }
+
+        // A write that returned 0 must be retried with the same data, OpenSSL may already hold part of the record
+        int tryWrite(const uint8_t* buf, size_t len) override {
+            if (!ssl_) return -1;
+
+            const int n = SSL_write(ssl_, buf, static_cast<int>(std::min<size_t>(len, std::numeric_limits<int>::max())));
+            counters_.onWrite(n);
+            trace(tracing::Direction::Out, buf, n);
+            if (n > 0) return n;
+
+            const int err = SSL_get_error(ssl_, n);
+            return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? 0 : -1;
+        }
+
+        [[nodiscard]] bool hasPendingData() const override {
+            return ssl_ && SSL_has_pending(ssl_);
+        }
+
+        using NativeConnection::sendFile;
+
+        // With kernel offload, the kernel encrypts what sendfile puts on the socket. Otherwise every byte has to
+        // pass through SSL_write.
+        bool sendFile(int fd, uint64_t offset, uint64_t length) override {
+            const auto start = offset;
+            if (kernelSend() && kernelSendFile(sockfd_, fd, offset, length)) {
+                traceFile(fd, start, offset - start);
+                return length == 0;
+            }
+            return NativeConnection::sendFile(fd, offset, length);
+        }
+
+        [[nodiscard]] SOCKET nativeHandle() const override {
+
+            return sockfd_;
+        }
+
+        // The socket may well be readable: TLS 1.3 servers send session tickets after the handshake.
+        // SSL_peek processes those and only reports application data.
+        [[nodiscard]] bool healthy() override {
+            if (!ssl_) return false;
+
+            uint8_t byte;
+            const int n = SSL_peek(ssl_, &byte, 1);
+            return n <= 0 && SSL_get_error(ssl_, n) == SSL_ERROR_WANT_READ;
+        }
+
+        // Whether records are encrypted by the kernel, which lets plain sendfile/splice on the socket carry TLS
+        [[nodiscard]] bool kernelSend() const {
+#ifdef BIO_get_ktls_send
+            return ssl_ && BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+            return false;
+#endif
+        }
+
+        // Whether records are decrypted by the kernel
+        [[nodiscard]] bool kernelReceive() const {
+#ifdef BIO_get_ktls_recv
+            return ssl_ && BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+            return false;
+#endif
+        }
+
+        enum class Handshake {
+            Done,
+            WantRead,
+            WantWrite,
+            Failed
+        };
+
+        // Takes the handshake as far as the non-blocking socket allows, on the side SSL_set_accept_state or
+        // SSL_set_connect_state chose. Repeated when the socket is ready as the result asks.
+        Handshake continueHandshake() {
+            if (!ssl_) return Handshake::Failed;
+
+            const int n = SSL_do_handshake(ssl_);
+            if (n == 1) return Handshake::Done;
+            switch (SSL_get_error(ssl_, n)) {
+                case SSL_ERROR_WANT_READ:
+                    return Handshake::WantRead;
+                case SSL_ERROR_WANT_WRITE:
+                    return Handshake::WantWrite;
+                default:
+                    ERR_print_errors_fp(stderr);
+                    return Handshake::Failed;
             }
         }
 
+        // Whether the handshake resumed an earlier session rather than doing a full one
+        [[nodiscard]] bool sessionReused() const {
+            return ssl_ && SSL_session_reused(ssl_);
+        }
+
         void close() override {
 
             closeSocket(sockfd_);
+            sockfd_ = INVALID_SOCKET;
 
             if (ssl_) {
                 SSL_shutdown(ssl_);
@@ -141,6 +443,19 @@ namespace simple_socket {
         SSL* ssl_;
         SSL_CTX* ctx_;
 
+        // The socket is non-blocking, so OpenSSL reports when it needs the socket to become readable or writable,
+        // which either of read() and write() may need. Returns false on anything else.
+        bool waitForIo(int result) {
+            switch (SSL_get_error(ssl_, result)) {
+                case SSL_ERROR_WANT_READ:
+                    return waitFor(sockfd_, false);
+                case SSL_ERROR_WANT_WRITE:
+                    return waitFor(sockfd_, true);
+                default:
+                    return false;
+            }
+        }
+
     };
 #endif
 
@@ -0,0 +1,82 @@
+
+#include "simple_socket/SocketTuning.hpp"
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+using namespace simple_socket;
+
+namespace {
+
+    // queue of pending Fast Open connections a listener accepts before falling back to the regular handshake
+    constexpr int fastOpenQueue = 128;
+
+    void setInt(SOCKET sock, int level, int option, int value) {
+        setsockopt(sock, level, option, reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void applyTcpOptions(SOCKET sock, const SocketOptions& options, SocketKind kind) {
+        if (options.noDelay) {
+            setInt(sock, IPPROTO_TCP, TCP_NODELAY, 1);
+        }
+#ifdef TCP_QUICKACK
+        if (options.quickAck && kind != SocketKind::TcpListener) {
+            setInt(sock, IPPROTO_TCP, TCP_QUICKACK, 1);
+        }
+#endif
+
+        if (options.keepAlive) {
+            setInt(sock, SOL_SOCKET, SO_KEEPALIVE, 1);
+#if defined(TCP_KEEPIDLE)
+            if (options.keepAliveIdle.count() > 0) setInt(sock, IPPROTO_TCP, TCP_KEEPIDLE, static_cast<int>(options.keepAliveIdle.count()));
+#elif defined(TCP_KEEPALIVE)
+            // macOS
+            if (options.keepAliveIdle.count() > 0) setInt(sock, IPPROTO_TCP, TCP_KEEPALIVE, static_cast<int>(options.keepAliveIdle.count()));
+#endif
+#ifdef TCP_KEEPINTVL
+            if (options.keepAliveInterval.count() > 0) setInt(sock, IPPROTO_TCP, TCP_KEEPINTVL, static_cast<int>(options.keepAliveInterval.count()));
+#endif
+#ifdef TCP_KEEPCNT
+            if (options.keepAliveProbes > 0) setInt(sock, IPPROTO_TCP, TCP_KEEPCNT, options.keepAliveProbes);
+#endif
+        }
+
+        if (options.fastOpen) {
+#if defined(__APPLE__) && defined(TCP_FASTOPEN)
+            if (kind == SocketKind::TcpListener) setInt(sock, IPPROTO_TCP, TCP_FASTOPEN, 1);
+#elif defined(TCP_FASTOPEN)
+            if (kind == SocketKind::TcpListener) setInt(sock, IPPROTO_TCP, TCP_FASTOPEN, fastOpenQueue);
+#endif
+            // Clients do not ask for it with TCP_FASTOPEN_CONNECT: connect() would then return before any SYN is
+            // sent, and connectAny could no longer tell a reachable address from one to fall back from
+        }
+    }
+
+}// namespace
+
+void simple_socket::applySocketOptions(SOCKET sock, const SocketOptions& options, SocketKind kind) {
+    const bool tcp = kind == SocketKind::TcpListener || kind == SocketKind::TcpClient || kind == SocketKind::TcpAccepted;
+    if (tcp) {
+        applyTcpOptions(sock, options, kind);
+    }
+
+    if (options.sendBufferSize) {
+        setInt(sock, SOL_SOCKET, SO_SNDBUF, *options.sendBufferSize);
+    }
+    if (options.receiveBufferSize) {
+        setInt(sock, SOL_SOCKET, SO_RCVBUF, *options.receiveBufferSize);
+    }
+
+#ifdef SO_BUSY_POLL
+    if (options.busyPollMicros && kind != SocketKind::Unix) {
+        setInt(sock, SOL_SOCKET, SO_BUSY_POLL, *options.busyPollMicros);
+    }
+#endif
+#ifdef SO_INCOMING_CPU
+    if (options.incomingCpu && kind != SocketKind::Unix) {
+        setInt(sock, SOL_SOCKET, SO_INCOMING_CPU, *options.incomingCpu);
+    }
+#endif
+}
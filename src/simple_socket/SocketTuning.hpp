@@ -0,0 +1,24 @@
+
+#ifndef SIMPLE_SOCKET_SOCKETTUNING_HPP
+#define SIMPLE_SOCKET_SOCKETTUNING_HPP
+
+#include "simple_socket/SocketOptions.hpp"
+#include "simple_socket/socket_common.hpp"
+
+namespace simple_socket {
+
+    enum class SocketKind {
+        TcpListener,// before bind/listen
+        TcpClient,  // before connect
+        TcpAccepted,
+        Unix,
+        Udp
+    };
+
+    // Applies the options that make sense for kind. Best effort: options the platform (or the caller's privileges)
+    // do not allow are skipped.
+    void applySocketOptions(SOCKET sock, const SocketOptions& options, SocketKind kind);
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_SOCKETTUNING_HPP
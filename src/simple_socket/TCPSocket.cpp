@@ -1,8 +1,20 @@
 
 #include "simple_socket/TCPSocket.hpp"
 
+#include "simple_socket/Async.hpp"
+#include "simple_socket/Counters.hpp"
 #include "simple_socket/SimpleConnection.hpp"
 #include "simple_socket/Socket.hpp"
+#include "simple_socket/SocketTuning.hpp"
+#include "simple_socket/tcp/Connect.hpp"
+#include "simple_socket/tcp/TlsClient.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <future>
+#include <mutex>
+#include <thread>
 
 #ifdef SIMPLE_SOCKET_WITH_TLS
 #include <openssl/err.h>
@@ -33,7 +45,7 @@ namespace {
     }
 
     std::pair<std::string, uint16_t> parseHostPort(const std::string& input) {
-        const size_t colonPos = input.find(':');
+        const size_t colonPos = input.rfind(':');// the last one, IPv6 addresses are written as [::1]:port
         if (colonPos == std::string::npos) {
             throw std::invalid_argument("Invalid input format. Expected 'host:port'.");
         }
@@ -52,54 +64,384 @@ namespace {
         return std::make_pair(host, port);
     }
 
+    // What a TCPServer counts, shared with the TLS handshakes it leaves in progress on an EventLoop
+    struct AcceptState {
+        std::atomic_bool open{true};// handshakes completing after the server closed drop their connection
+        std::atomic_uint64_t accepted{0};
+        std::atomic_uint64_t acceptFailures{0};
+        Histogram acceptLatency;
+    };
+
+    // The happy eyeballs of tcp::connectAny on one EventLoop thread: an attempt that is under way completes through
+    // a readiness notification rather than a blocking poll. done gets the first socket that connected, nullptr if
+    // every endpoint failed or deadline passed first.
+    class PendingConnect: public std::enable_shared_from_this<PendingConnect> {
+    public:
+        using Done = std::function<void(std::unique_ptr<Socket>)>;
+
+        static void start(EventLoop& loop, std::vector<tcp::Endpoint> endpoints, std::chrono::milliseconds attemptDelay,
+                          tcp::Clock::time_point deadline, const SocketOptions& options, Done done) {
+            const auto thread = loop.currentThread();
+            if (!thread) {
+                // the timers have to fire on the thread the attempts complete on
+                loop.post([&loop, endpoints = std::move(endpoints), attemptDelay, deadline, options, done = std::move(done)]() mutable {
+                    start(loop, std::move(endpoints), attemptDelay, deadline, options, std::move(done));
+                });
+                return;
+            }
+
+            const std::shared_ptr<PendingConnect> connect(new PendingConnect(loop, *thread, std::move(endpoints), attemptDelay, options, std::move(done)));
+            const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(deadline - tcp::Clock::now());
+            loop.schedule(std::max(timeout, std::chrono::milliseconds::zero()), [weak = std::weak_ptr(connect)] {
+                if (const auto c = weak.lock()) c->finish(nullptr);
+            }, *thread);
+            connect->startNext();
+        }
+
+    private:
+        EventLoop& loop_;
+        size_t thread_;
+        std::vector<tcp::Endpoint> endpoints_;
+        size_t next_{0};// the endpoint to try next
+        std::chrono::milliseconds attemptDelay_;
+        SocketOptions options_;
+        std::vector<std::unique_ptr<Socket>> pending_;// attempts under way, each keeps this alive through its notification
+        Done done_;
+
+        PendingConnect(EventLoop& loop, size_t thread, std::vector<tcp::Endpoint> endpoints, std::chrono::milliseconds attemptDelay,
+                       const SocketOptions& options, Done done)
+            : loop_(loop), thread_(thread), endpoints_(std::move(endpoints)), attemptDelay_(attemptDelay),
+              options_(options), done_(std::move(done)) {}
+
+        // Starts the next attempt that does not fail right away. A failed attempt hands over without waiting
+        // for the head start to run out.
+        void startNext() {
+            while (next_ < endpoints_.size()) {
+                const auto attempt = tcp::startConnect(endpoints_[next_++], options_);
+                if (attempt.sock == INVALID_SOCKET) continue;
+
+                auto socket = std::make_unique<Socket>(attempt.sock);
+                if (attempt.connected) {
+                    finish(std::move(socket));
+                    return;
+                }
+
+                loop_.whenReady(*socket, true, [self = shared_from_this(), s = socket.get()] {
+                    self->ready(s);
+                });
+                pending_.push_back(std::move(socket));
+                if (next_ < endpoints_.size()) {
+                    loop_.schedule(attemptDelay_, [weak = weak_from_this(), started = next_] {
+                        const auto c = weak.lock();
+                        if (c && c->done_ && c->next_ == started) c->startNext();
+                    }, thread_);
+                }
+                return;
+            }
+            if (pending_.empty()) finish(nullptr);
+        }
+
+        // the connect of s is over, one way or the other
+        void ready(Socket* s) {
+            const auto it = std::find_if(pending_.begin(), pending_.end(), [s](const auto& p) { return p.get() == s; });
+            auto socket = std::move(*it);
+            pending_.erase(it);
+
+            if (tcp::connectSucceeded(socket->sockfd_)) {
+                finish(std::move(socket));
+            } else {
+                startNext();
+            }
+        }
+
+        void finish(std::unique_ptr<Socket> socket) {
+            const auto done = std::exchange(done_, nullptr);
+            if (!done) return;
+
+            for (const auto& other : pending_) {
+                loop_.unwatch(*other);// drops the pending notification
+            }
+            pending_.clear();
+            done(std::move(socket));
+        }
+    };
+
+    // Suspends a coroutine until start hands the result to the callback it is given,
+    // the coroutine resumes on the thread that does
+    template<class T>
+    struct CallbackAwaiter {
+        std::function<void(std::function<void(T)>)> start;
+        T result{};
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            // the callback may run before start returns, and resuming may destroy this
+            const auto starting = std::move(start);
+            starting([this, handle](T value) {
+                result = std::move(value);
+                handle.resume();
+            });
+        }
+
+        T await_resume() {
+            return std::move(result);
+        }
+    };
+
+#ifdef SIMPLE_SOCKET_WITH_TLS
+    // The handshake of a connection on an EventLoop, stepped by readiness notifications on one
+    // loop thread rather than blocking it. done gets the connection once the handshake completed, nullptr if it
+    // failed or was still incomplete after timeout.
+    class PendingHandshake: public std::enable_shared_from_this<PendingHandshake> {
+    public:
+        using Done = std::function<void(std::unique_ptr<SimpleConnection>)>;
+
+        static void start(EventLoop& loop, std::unique_ptr<TLSConnection> conn, std::chrono::milliseconds timeout, Done done) {
+            const auto thread = loop.currentThread();
+            if (!thread) {
+                // the timeout has to fire on the thread the steps run on
+                auto pending = std::make_shared<std::unique_ptr<TLSConnection>>(std::move(conn));
+                loop.post([&loop, pending, timeout, done = std::move(done)]() mutable {
+                    start(loop, std::move(*pending), timeout, std::move(done));
+                });
+                return;
+            }
+
+            const std::shared_ptr<PendingHandshake> handshake(new PendingHandshake(loop, std::move(conn), std::move(done)));
+            loop.schedule(timeout, [weak = std::weak_ptr(handshake)] {
+                if (const auto h = weak.lock()) h->expire();
+            }, *thread);
+            handshake->step();
+        }
+
+    private:
+        EventLoop& loop_;
+        std::unique_ptr<TLSConnection> conn_;// until the handshake is over
+        Done done_;
+
+        PendingHandshake(EventLoop& loop, std::unique_ptr<TLSConnection> conn, Done done)
+            : loop_(loop), conn_(std::move(conn)), done_(std::move(done)) {}
+
+        // Kept alive by the pending notification in between
+        void step() {
+            const auto state = conn_->continueHandshake();
+            if (state == TLSConnection::Handshake::WantRead || state == TLSConnection::Handshake::WantWrite) {
+                loop_.whenReady(*conn_, state == TLSConnection::Handshake::WantWrite, [self = shared_from_this()] {
+                    self->step();
+                });
+                return;
+            }
+            if (state == TLSConnection::Handshake::Done) {
+                finish(std::move(conn_));
+            } else {
+                conn_.reset();
+                finish(nullptr);
+            }
+        }
+
+        void expire() {
+            if (!conn_) return;
+            loop_.unwatch(*conn_);// drops the pending notification
+            conn_.reset();
+            finish(nullptr);
+        }
+
+        void finish(std::unique_ptr<SimpleConnection> conn) {
+            const auto done = std::move(done_);
+            done(std::move(conn));
+        }
+    };
+#endif
+
+    // the options of the positional constructor, everything it does not name keeps its default
+    TCPServerOptions serverOptions(int backlog, bool useTLS, const std::string& certFile, const std::string& keyFile) {
+        TCPServerOptions options;
+        options.backlog = backlog;
+        options.useTLS = useTLS;
+        options.certFile = certFile;
+        options.keyFile = keyFile;
+        return options;
+    }
+
 }// namespace
 
 
 struct TCPServer::Impl {
 
-    Impl(int port, int backlog, bool useTLS = false, const std::string& cert_file = "", const std::string& key_file = "")
-        : socket(createSocket()), useTLS(useTLS) {
+    Impl(int port, const TCPServerOptions& options)
+        : socket(createSocket()), port(port), options(options) {
 
-        if (useTLS) {
+        if (options.useTLS) {
 #ifdef SIMPLE_SOCKET_WITH_TLS
-            initTLS(cert_file, key_file);
+            initTLS(options.certFile, options.keyFile);
 #else
             throw std::runtime_error("TLS support is not enabled in this build.");
 #endif
         }
 
+        bindAndListen(socket.sockfd_);
+    }
 
-        sockaddr_in serv_addr{};
-        serv_addr.sin_family = AF_INET;
-        serv_addr.sin_addr.s_addr = INADDR_ANY;
-        serv_addr.sin_port = htons(port);
+    std::unique_ptr<SimpleConnection> accept() {
 
-        if (::bind(socket.sockfd_, reinterpret_cast<sockaddr*>(&serv_addr), sizeof(serv_addr)) < 0) {
+        return accept(socket);
+    }
 
-            throwSocketError("Bind failed");
+    std::unique_ptr<SimpleConnection> accept(const Socket& listener) {
+        const Stopwatch stopwatch;
+        try {
+            auto conn = acceptOne(listener);
+            if (conn) {
+                count(state->accepted);
+                state->acceptLatency.record(stopwatch);
+            }
+            return conn;
+        } catch (const std::exception&) {
+            count(state->acceptFailures);
+            state->acceptLatency.record(stopwatch);
+            throw;
         }
+    }
+
+    TCPServerStats stats() const {
+        TCPServerStats stats;
+        stats.accepted = load(state->accepted);
+        stats.acceptFailures = load(state->acceptFailures);
+        stats.acceptLatency = state->acceptLatency.snapshot();
+        return stats;
+    }
 
-        if (::listen(socket.sockfd_, backlog) < 0) {
+    void acceptAsync(EventLoop& eventLoop, std::function<void(std::unique_ptr<SimpleConnection>)> onConnection) {
 
-            throwSocketError("Listen failed");
+        loop = &eventLoop;
+
+        // a shard is an extra listener bound to the same port, the kernel balances incoming connections between them
+        if (options.reusePort && reusePortSupported) {
+            for (size_t i = 1; i < loop->size(); ++i) {
+                auto& shard = shards.emplace_back(std::make_unique<Socket>(createSocket()));
+                bindAndListen(shard->sockfd_);
+            }
+        }
+
+        auto handler = std::make_shared<std::function<void(std::unique_ptr<SimpleConnection>)>>(std::move(onConnection));
+        watchListener(socket, 0, handler);
+        for (size_t i = 0; i < shards.size(); ++i) {
+            watchListener(*shards[i], i + 1, handler);
         }
     }
 
-    std::unique_ptr<SimpleConnection> accept() {
+    Task<std::unique_ptr<SimpleConnection>> asyncAccept(EventLoop& eventLoop) {
+
+        if (!loop) {
+            loop = &eventLoop;
+            set_nonblocking(socket.sockfd_);
+        }
+        for (;;) {
+#ifdef SIMPLE_SOCKET_WITH_TLS
+            if (options.useTLS) {
+                const Stopwatch stopwatch;
+                if (const auto sock = acceptCounted(socket, stopwatch); sock != INVALID_SOCKET) {
+                    auto conn = co_await HandshakeAwaiter{*this, sock, stopwatch};
+                    if (!conn) {
+                        throw std::runtime_error("TLS handshake failed");
+                    }
+                    co_return conn;
+                }
+                co_await ReadyAwaiter(eventLoop, socket, false);
+                continue;
+            }
+#endif
+            if (auto conn = accept(socket)) co_return conn;
+            co_await ReadyAwaiter(eventLoop, socket, false);
+        }
+    }
+
+    void close() {
+
+        state->open = false;
+        if (loop) {
+            loop->unwatch(socket);
+            for (auto& shard : shards) {
+                loop->unwatch(*shard);
+            }
+            loop = nullptr;
+        }
+        socket.close();
+        shards.clear();
+#ifdef SIMPLE_SOCKET_WITH_TLS
+        if (ctx) {
+            SSL_CTX_free(ctx);
+            ctx = nullptr;
+        }
+#endif
+    }
+
+    ~Impl() {
+
+        state->open = false;
+        if (loop) {
+            loop->unwatch(socket);
+            for (auto& shard : shards) {
+                loop->unwatch(*shard);
+            }
+        }
+#ifdef SIMPLE_SOCKET_WITH_TLS
+        // connections still hold a reference of their own
+        if (ctx) SSL_CTX_free(ctx);
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    WSASession session;
+#endif
+
+#if defined(__linux__) && defined(SO_REUSEPORT)
+    // Only Linux load balances between SO_REUSEPORT listeners, elsewhere the last bound socket takes every connection
+    static constexpr bool reusePortSupported = true;
+#else
+    static constexpr bool reusePortSupported = false;
+#endif
+
+    Socket socket;
+    int port;
+    TCPServerOptions options;
+    EventLoop* loop{nullptr};
+    std::vector<std::unique_ptr<Socket>> shards;
+
+    std::shared_ptr<AcceptState> state = std::make_shared<AcceptState>();
+
+    // INVALID_SOCKET if the listener is non-blocking and no connection is pending
+    SOCKET acceptSocket(const Socket& listener) {
         sockaddr_in client_addr{};
         socklen_t addrlen = sizeof(client_addr);
-        SOCKET new_sock = ::accept(socket.sockfd_, reinterpret_cast<sockaddr*>(&client_addr), &addrlen);
+        SOCKET new_sock = ::accept(listener.sockfd_, reinterpret_cast<sockaddr*>(&client_addr), &addrlen);
 
         if (new_sock == INVALID_SOCKET) {
 
+            if (loop && wouldBlock()) {
+                return INVALID_SOCKET;// listener is non-blocking when driven by an EventLoop
+            }
             throwSocketError("Accept failed");
         }
 
+        applySocketOptions(new_sock, options.socketOptions, SocketKind::TcpAccepted);
+        return new_sock;
+    }
+
+    // nullptr if the listener is non-blocking and no connection is pending
+    std::unique_ptr<SimpleConnection> acceptOne(const Socket& listener) {
+        const auto new_sock = acceptSocket(listener);
+        if (new_sock == INVALID_SOCKET) return nullptr;
+
 #ifdef SIMPLE_SOCKET_WITH_TLS
-        if (useTLS) {
-            SSL* ssl = SSL_new(ctx);
-            SSL_set_fd(ssl, static_cast<int>(new_sock));
+        if (options.useTLS) {
+            set_nonblocking(new_sock, false);// BSD derived systems inherit O_NONBLOCK from the listener
 
+            SSL* ssl = newSsl(new_sock);
             if (SSL_accept(ssl) <= 0) {
                 ERR_print_errors_fp(stderr);
                 SSL_free(ssl);
@@ -114,27 +456,126 @@ struct TCPServer::Impl {
         return std::make_unique<Socket>(new_sock);
     }
 
-    void close() {
+    void bindAndListen(SOCKET sockfd) const {
 
-        socket.close();
-#ifdef SIMPLE_SOCKET_WITH_TLS
-        if (ctx) {
-            SSL_CTX_free(ctx);
-            ctx = nullptr;
+        applySocketOptions(sockfd, options.socketOptions, SocketKind::TcpListener);
+
+#ifndef _WIN32
+        // Windows SO_REUSEADDR allows stealing a port in use, rather than just rebinding one in TIME_WAIT
+        if (options.reuseAddress) {
+            const int optval = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&optval), sizeof(optval));
         }
 #endif
+#ifdef SO_REUSEPORT
+        if (options.reusePort && reusePortSupported) {
+            const int optval = 1;
+            setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&optval), sizeof(optval));
+        }
+#endif
+
+        sockaddr_in serv_addr{};
+        serv_addr.sin_family = AF_INET;
+        serv_addr.sin_addr.s_addr = INADDR_ANY;
+        serv_addr.sin_port = htons(port);
+
+        if (::bind(sockfd, reinterpret_cast<sockaddr*>(&serv_addr), sizeof(serv_addr)) < 0) {
+
+            throwSocketError("Bind failed");
+        }
+
+        if (::listen(sockfd, options.backlog) < 0) {
+
+            throwSocketError("Listen failed");
+        }
     }
 
-private:
-#ifdef _WIN32
-    WSASession session;
-#endif
+    void watchListener(Socket& listener, size_t thread, const std::shared_ptr<std::function<void(std::unique_ptr<SimpleConnection>)>>& onConnection) {
 
-    Socket socket;
-    bool useTLS{false};
+        loop->accept(listener, [this, onConnection](std::unique_ptr<SimpleConnection> conn) {
+            const Stopwatch stopwatch;
+            if (!conn) {
+                // e.g. aborted connection or fd exhaustion, accepting carries on
+                count(state->acceptFailures);
+                state->acceptLatency.record(stopwatch);
+                return;
+            }
+
+            // EventLoop::accept hands over plain sockets
+            auto& socket = static_cast<Socket&>(*conn);
+            applySocketOptions(socket.sockfd_, options.socketOptions, SocketKind::TcpAccepted);
+#ifdef SIMPLE_SOCKET_WITH_TLS
+            if (options.useTLS) {
+                handshake(std::exchange(socket.sockfd_, INVALID_SOCKET), stopwatch, [onConnection](std::unique_ptr<SimpleConnection> conn) {
+                    if (conn) (*onConnection)(std::move(conn));
+                });
+                return;
+            }
+#endif
+            count(state->accepted);
+            state->acceptLatency.record(stopwatch);
+            (*onConnection)(std::move(conn));
+        }, thread);
+    }
 #ifdef SIMPLE_SOCKET_WITH_TLS
     SSL_CTX* ctx = nullptr;
 
+    SSL* newSsl(SOCKET sock) const {
+        SSL* ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, static_cast<int>(sock));
+        SSL_set_accept_state(ssl);
+        if (options.kernelTLS) {
+            requestKernelTLS(ssl);
+        }
+        return ssl;
+    }
+
+    // accept() of a socket to be handed to handshake(), counting failures as accept() does
+    SOCKET acceptCounted(const Socket& listener, const Stopwatch& stopwatch) {
+        try {
+            return acceptSocket(listener);
+        } catch (const std::exception&) {
+            count(state->acceptFailures);
+            state->acceptLatency.record(stopwatch);
+            throw;
+        }
+    }
+
+    // Runs the handshake of an accepted socket on the loop without blocking it, bounded by tlsHandshakeTimeout.
+    // done gets the connection, or nullptr if the handshake failed, unless the server closed in the meantime.
+    void handshake(SOCKET sock, const Stopwatch& stopwatch, std::function<void(std::unique_ptr<SimpleConnection>)> done) {
+        auto conn = std::make_unique<TLSConnection>(sock, newSsl(sock));// non-blocking
+        PendingHandshake::start(*loop, std::move(conn), options.tlsHandshakeTimeout,
+                                [state = state, stopwatch, done = std::move(done)](std::unique_ptr<SimpleConnection> conn) {
+                                    count(conn ? state->accepted : state->acceptFailures);
+                                    state->acceptLatency.record(stopwatch);
+                                    if (state->open) done(std::move(conn));
+                                });
+    }
+
+    // Suspends asyncAccept for the handshake, which resumes it on the loop thread
+    struct HandshakeAwaiter {
+        Impl& server;
+        SOCKET sock;
+        Stopwatch stopwatch;
+        std::unique_ptr<SimpleConnection> conn{};// filled in by the handshake
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            server.handshake(sock, stopwatch, [this, handle](std::unique_ptr<SimpleConnection> result) {
+                conn = std::move(result);
+                handle.resume();
+            });
+        }
+
+        std::unique_ptr<SimpleConnection> await_resume() {
+            return std::move(conn);
+        }
+    };
+
     void initTLS(const std::string& cert_file, const std::string& key_file) {
         SSL_load_error_strings();
         OpenSSL_add_ssl_algorithms();
@@ -157,13 +598,31 @@ private:
 };
 
 TCPServer::TCPServer(uint16_t port, int backlog, bool useTLS, const std::string& cert_file, const std::string& key_file)
-    : pimpl_(std::make_unique<Impl>(port, backlog, useTLS, cert_file, key_file)) {}
+    : TCPServer(port, serverOptions(backlog, useTLS, cert_file, key_file)) {}
+
+TCPServer::TCPServer(uint16_t port, const TCPServerOptions& options)
+    : pimpl_(std::make_unique<Impl>(port, options)) {}
 
 [[nodiscard]] std::unique_ptr<SimpleConnection> TCPServer::accept() {
 
     return pimpl_->accept();
 }
 
+void TCPServer::acceptAsync(EventLoop& loop, std::function<void(std::unique_ptr<SimpleConnection>)> onConnection) {
+
+    pimpl_->acceptAsync(loop, std::move(onConnection));
+}
+
+Task<std::unique_ptr<SimpleConnection>> TCPServer::asyncAccept(EventLoop& loop) {
+
+    return pimpl_->asyncAccept(loop);
+}
+
+TCPServerStats TCPServer::stats() const {
+
+    return pimpl_->stats();
+}
+
 void TCPServer::close() {
 
     pimpl_->close();
@@ -172,60 +631,154 @@ void TCPServer::close() {
 TCPServer::~TCPServer() = default;
 
 
-[[nodiscard]] std::unique_ptr<SimpleConnection> TCPClientContext::connect(const std::string& ip, uint16_t port, bool useTLS) {
+struct TCPClientContext::Impl {
 
-    SOCKET sock = createSocket();
+    explicit Impl(std::chrono::seconds dnsCacheTtl)
+        : dnsCache(dnsCacheTtl) {}
 
-    sockaddr_in serv_addr{};
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(port);
+    std::unique_ptr<SimpleConnection> connect(const std::string& host, uint16_t port, const TCPConnectOptions& options) {
+        const auto deadline = tcp::Clock::now() + options.timeout;
 
-    if (inet_pton(AF_INET, ip.c_str(), &serv_addr.sin_addr) <= 0) {
+        const auto endpoints = dnsCache.lookup(host, port, deadline);
+        if (endpoints.empty()) return nullptr;
 
-        // Fallback: resolve hostname
-        addrinfo hints{}, *res = nullptr;
-        hints.ai_family = AF_INET;
-        hints.ai_socktype = SOCK_STREAM;
-        if (getaddrinfo(ip.c_str(), nullptr, &hints, &res) != 0 || !res) {
-            closeSocket(sock);
+        const SOCKET sock = tcp::connectAny(endpoints, options.attemptDelay, deadline, options.socketOptions);
+        if (sock == INVALID_SOCKET) {
+            dnsCache.invalidate(host);// the host may have moved
             return nullptr;
         }
-        serv_addr.sin_addr = reinterpret_cast<sockaddr_in*>(res->ai_addr)->sin_addr;
-        freeaddrinfo(res);
+
+        if (options.useTLS) {
+            return connectTLS(sock, host, port, options.kernelTLS);
+        }
+        return std::make_unique<Socket>(sock);
     }
 
-    if (::connect(sock, reinterpret_cast<sockaddr*>(&serv_addr), sizeof(serv_addr)) < 0) {
+    // As connect, the coroutine shares ownership of impl so the context may go away meanwhile
+    static Task<std::unique_ptr<SimpleConnection>> asyncConnect(std::shared_ptr<Impl> impl, EventLoop& loop, std::string host, uint16_t port, TCPConnectOptions options) {
+        const auto deadline = tcp::Clock::now() + options.timeout;
+
+        auto endpoints = impl->dnsCache.find(host, port);
+        if (!endpoints) {
+            // polled, the resolver thread may outlive loop and so can not post to it
+            auto resolving = tcp::resolveAsync(host, port);
+            auto delay = std::chrono::milliseconds(1);
+            while (resolving.wait_for(std::chrono::seconds::zero()) != std::future_status::ready) {
+                const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - tcp::Clock::now());
+                if (left <= std::chrono::milliseconds::zero()) co_return nullptr;
+
+                co_await asyncSleep(loop, std::min(delay, left));
+                delay = std::min(delay * 2, std::chrono::milliseconds(50));
+            }
+            endpoints = resolving.get();
+            impl->dnsCache.insert(host, *endpoints);
+        }
+        if (endpoints->empty()) co_return nullptr;
+
+        // named, GCC destroys a temporary awaiter twice
+        CallbackAwaiter<std::unique_ptr<Socket>> connecting{[&](auto done) {
+            PendingConnect::start(loop, std::move(*endpoints), options.attemptDelay, deadline, options.socketOptions, std::move(done));
+        }};
+        auto socket = co_await connecting;
+        if (!socket) {
+            impl->dnsCache.invalidate(host);// the host may have moved
+            co_return nullptr;
+        }
+        if (!options.useTLS) co_return std::move(socket);
 
-        return nullptr;
-    }
-    if (useTLS) {
+        const SOCKET sock = std::exchange(socket->sockfd_, INVALID_SOCKET);// owned by the TLS connection from here
 #ifdef SIMPLE_SOCKET_WITH_TLS
+        impl->initTLS(sock);
+        auto conn = impl->tls->prepare(sock, host, port, options.kernelTLS);
+        if (!conn) co_return nullptr;
+
+        CallbackAwaiter<std::unique_ptr<SimpleConnection>> handshaking{[&](auto done) {
+            PendingHandshake::start(loop, std::move(conn), options.timeout, std::move(done));
+        }};
+        auto result = co_await handshaking;
+        if (!result) impl->tls->failed(host, port);
+        co_return result;
+#else
+        closeSocket(sock);
+        throw std::runtime_error("TLS support is not enabled in this build.");
+#endif
+    }
 
-        SSL_library_init();
-        SSL_load_error_strings();
-        const SSL_METHOD* method = TLS_client_method();
-        SSL_CTX* ctx = SSL_CTX_new(method);
-        if (!ctx) return nullptr;
-
-        SSL* ssl = SSL_new(ctx);
-        SSL_set_fd(ssl, static_cast<int>(sock));
-        SSL_set_tlsext_host_name(ssl, ip.c_str());
-        if (SSL_connect(ssl) <= 0) {
-            ERR_print_errors_fp(stderr);
-            SSL_free(ssl);
-            SSL_CTX_free(ctx);
-            closeSocket(sock);
-            return nullptr;
-        }
-        return std::make_unique<TLSConnection>(sock, ssl, ctx);
+    std::unique_ptr<SimpleConnection> connectTLS(SOCKET sock, const std::string& host, uint16_t port, bool kernelTLS) {
+#ifdef SIMPLE_SOCKET_WITH_TLS
+        initTLS(sock);
+        return tls->handshake(sock, host, port, kernelTLS);
 #else
+        (void) host;
+        (void) port;
+        (void) kernelTLS;
+        closeSocket(sock);
         throw std::runtime_error("TLS support is not enabled in this build.");
 #endif
     }
-    return std::make_unique<Socket>(sock);
+
+#ifdef SIMPLE_SOCKET_WITH_TLS
+    // Creates tls on first use, closing sock if that fails
+    void initTLS(SOCKET sock) {
+        try {
+            std::call_once(tlsInit, [this] { tls = std::make_unique<tcp::TlsClient>(); });
+        } catch (const std::exception&) {
+            closeSocket(sock);
+            throw;
+        }
+    }
+
+    // created on first use, shared by every TLS connection of the context
+    std::once_flag tlsInit;
+    std::unique_ptr<tcp::TlsClient> tls;
+#endif
+    tcp::DnsCache dnsCache;
+};
+
+TCPClientContext::TCPClientContext(std::chrono::seconds dnsCacheTtl)
+    : pimpl_(std::make_shared<Impl>(dnsCacheTtl)) {}
+
+std::unique_ptr<SimpleConnection> TCPClientContext::connect(const std::string& host, uint16_t port, const TCPConnectOptions& options) {
+
+    return pimpl_->connect(host, port, options);
+}
+
+[[nodiscard]] std::unique_ptr<SimpleConnection> TCPClientContext::connect(const std::string& ip, uint16_t port, bool useTLS) {
+
+    TCPConnectOptions options;
+    options.useTLS = useTLS;
+    return pimpl_->connect(ip, port, options);
 }
 
 std::unique_ptr<SimpleConnection> TCPClientContext::connect(const std::string& host) {
     const auto [ip, port] = parseHostPort(host);
     return connect(ip, port);
 }
+
+std::future<std::unique_ptr<SimpleConnection>> TCPClientContext::connectAsync(const std::string& host, uint16_t port, const TCPConnectOptions& options) {
+
+    // the task shares ownership of the Impl, so the context may go away before the future is consumed
+    return std::async(std::launch::async, [impl = pimpl_, host, port, options] {
+        return impl->connect(host, port, options);
+    });
+}
+
+Task<std::unique_ptr<SimpleConnection>> TCPClientContext::asyncConnect(EventLoop& loop, std::string host, uint16_t port, TCPConnectOptions options) {
+
+    return Impl::asyncConnect(pimpl_, loop, std::move(host), port, std::move(options));
+}
+
+void TCPClientContext::clearDnsCache() {
+
+    pimpl_->dnsCache.clear();
+}
+
+void TCPClientContext::clearTlsSessions() {
+#ifdef SIMPLE_SOCKET_WITH_TLS
+    if (pimpl_->tls) {
+        pimpl_->tls->clearSessions();
+    }
+#endif
+}
+
+TCPClientContext::~TCPClientContext() = default;
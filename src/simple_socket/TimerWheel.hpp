@@ -0,0 +1,95 @@
+
+#ifndef SIMPLE_SOCKET_TIMERWHEEL_HPP
+#define SIMPLE_SOCKET_TIMERWHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace simple_socket {
+
+    // Hierarchical timing wheel: timers are bucketed by the tick they are due in, in levels of 64 slots that each
+    // cover 64 times the span of the level below. Adding a timer and advancing by a tick take O(1) regardless of
+    // how many are pending, timers move down a level at most every 64 ticks. Timers count whole ticks and cannot
+    // be cancelled, the caller checks whether the value it gets back is still of interest. Not thread safe.
+    template<typename T>
+    class TimerWheel {
+    public:
+        static constexpr size_t slotBits = 6;
+        static constexpr size_t slots = size_t{1} << slotBits;
+        static constexpr size_t levels = 4;// up to 64^4 ticks, later timers wait in the last level
+
+        [[nodiscard]] uint64_t now() const {
+            return now_;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return size_;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return size_ == 0;
+        }
+
+        // value is handed back ticks from now, at least on the next tick
+        void add(uint64_t ticks, T value) {
+            place({now_ + std::max<uint64_t>(ticks, 1), std::move(value)});
+            ++size_;
+        }
+
+        // Advances by one tick and calls fn with the value of every timer due
+        template<typename Fn>
+        void tick(Fn&& fn) {
+            ++now_;
+
+            // bring down the timers of the higher levels whose slot has come up, topmost first
+            size_t top = 0;
+            while (top + 1 < levels && (now_ & ((uint64_t{1} << (slotBits * (top + 1))) - 1)) == 0) ++top;
+            for (size_t level = top; level > 0; --level) {
+                auto& slot = wheel_[level][index(now_, level)];
+                due_.swap(slot);
+                for (auto& timer : due_) place(std::move(timer));
+                due_.clear();
+            }
+
+            due_.swap(wheel_[0][index(now_, 0)]);
+            size_ -= due_.size();
+            for (auto& timer : due_) fn(std::move(timer.value));
+            due_.clear();
+        }
+
+    private:
+        struct Timer {
+            uint64_t deadline;
+            T value;
+        };
+
+        uint64_t now_ = 0;
+        size_t size_ = 0;
+        std::array<std::array<std::vector<Timer>, slots>, levels> wheel_;
+        std::vector<Timer> due_;// kept, so ticks do not allocate
+
+        static size_t index(uint64_t tick, size_t level) {
+            return static_cast<size_t>(tick >> (slotBits * level)) & (slots - 1);
+        }
+
+        void place(Timer timer) {
+            // a timer cascading down may be due right away, the slot of now is fired next
+            const auto delta = timer.deadline > now_ ? timer.deadline - now_ : 0;
+
+            size_t level = 0;
+            while (level + 1 < levels && delta >= (uint64_t{1} << (slotBits * (level + 1)))) ++level;
+
+            // beyond the last level, wait in its farthest slot and move on from there
+            const auto span = uint64_t{1} << (slotBits * levels);
+            const auto at = delta < span ? timer.deadline : now_ + span - 1;
+            wheel_[level][index(at, level)].push_back(std::move(timer));
+        }
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_TIMERWHEEL_HPP
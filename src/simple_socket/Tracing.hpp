@@ -0,0 +1,52 @@
+
+#ifndef SIMPLE_SOCKET_TRACING_HPP
+#define SIMPLE_SOCKET_TRACING_HPP
+
+#include "simple_socket/socket_common.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// The recording side of WireTrace, called by connections from any thread
+namespace simple_socket::tracing {
+
+    enum class Direction: uint8_t {
+        In,
+        Out
+    };
+
+    // The addresses of a connection, which the capture puts in the IP and TCP headers it makes up
+    struct Endpoints {
+        uint8_t version = 4;// IP version, connections other than TCP ones are given loopback addresses
+        std::array<uint8_t, 16> local{};
+        std::array<uint8_t, 16> peer{};
+        uint16_t localPort = 0;
+        uint16_t peerPort = 0;
+    };
+
+    // Set while a WireTrace runs, the one check made on every read and write otherwise
+    extern std::atomic_bool active;
+
+    // Identifies a connection in the capture, ids are never reused
+    uint64_t nextConnectionId();
+
+    Endpoints endpointsOf(SOCKET socket, uint64_t connection);
+
+    // Copies size bytes from offset into buffers, as far as the snap length allows, into the ring of the calling
+    // thread. Dropped, never waited for, if the ring is full.
+    void record(uint64_t connection, Direction direction, const Endpoints& endpoints,
+                std::span<const std::span<const uint8_t>> buffers, size_t offset, size_t size);
+
+    // As record for size bytes of the file fd from offset, which the kernel sent without them passing through
+    // user space. The captured ones are read from the file again.
+    void recordFile(uint64_t connection, const Endpoints& endpoints, int fd, uint64_t offset, uint64_t size);
+
+    // The connection is gone, which ends its stream in the capture
+    void recordClose(uint64_t connection, const Endpoints& endpoints);
+
+}// namespace simple_socket::tracing
+
+#endif//SIMPLE_SOCKET_TRACING_HPP
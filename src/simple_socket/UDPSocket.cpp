@@ -1,46 +1,148 @@
 
 #include "simple_socket/UDPSocket.hpp"
 
+#include "simple_socket/SocketTuning.hpp"
 #include "simple_socket/socket_common.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <netinet/udp.h>
+#endif
+
 using namespace simple_socket;
 
+namespace {
+
+    // Datagrams per sendmmsg/recvmmsg call, bounds what goes on the stack
+    constexpr size_t batchSize = 64;
+
+    // What the kernel accepts in one UDP_SEGMENT send (UDP_MAX_SEGMENTS)
+    constexpr size_t maxSegments = 64;
+
+    bool segmented(const UDPMessage& message) {
+        return message.segmentSize > 0 && message.segmentSize < message.buffer.size();
+    }
+
+    bool validSegments(const UDPMessage& message) {
+        return !segmented(message) ||
+               (message.buffer.size() <= MAX_UDP_PACKET_SIZE && (message.buffer.size() + message.segmentSize - 1) / message.segmentSize <= maxSegments);
+    }
+
+}// namespace
+
+std::optional<UDPEndpoint> UDPEndpoint::parse(const std::string& address, uint16_t port) {
+    sockaddr_in v4{};
+    if (inet_pton(AF_INET, address.c_str(), &v4.sin_addr) == 1) {
+        v4.sin_family = AF_INET;
+        v4.sin_port = htons(port);
+        return fromNative(&v4, sizeof(v4));
+    }
+    sockaddr_in6 v6{};
+    if (inet_pton(AF_INET6, address.c_str(), &v6.sin6_addr) == 1) {
+        v6.sin6_family = AF_INET6;
+        v6.sin6_port = htons(port);
+        return fromNative(&v6, sizeof(v6));
+    }
+    return std::nullopt;
+}
+
+UDPEndpoint UDPEndpoint::fromNative(const void* addr, size_t size) {
+    static_assert(sizeof(storage_) >= sizeof(sockaddr_storage));
+
+    const auto v6 = static_cast<const sockaddr_in6*>(addr);
+    if (size >= sizeof(sockaddr_in6) && v6->sin6_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&v6->sin6_addr)) {
+        // an IPv4 peer of a dual-stack socket
+        sockaddr_in v4{};
+        v4.sin_family = AF_INET;
+        v4.sin_port = v6->sin6_port;
+        std::memcpy(&v4.sin_addr, reinterpret_cast<const uint8_t*>(&v6->sin6_addr) + 12, 4);
+        return fromNative(&v4, sizeof(v4));
+    }
+
+    UDPEndpoint endpoint;
+    endpoint.size_ = std::min(size, sizeof(sockaddr_storage));
+    std::memcpy(endpoint.storage_.data(), addr, endpoint.size_);
+    return endpoint;
+}
+
+std::string UDPEndpoint::address() const {
+    char text[INET6_ADDRSTRLEN]{};
+    if (isV6()) {
+        inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(storage_.data())->sin6_addr, text, sizeof(text));
+    } else if (size_ > 0) {
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(storage_.data())->sin_addr, text, sizeof(text));
+    }
+    return text;
+}
+
+uint16_t UDPEndpoint::port() const {
+    if (size_ == 0) return 0;
+    return ntohs(isV6() ? reinterpret_cast<const sockaddr_in6*>(storage_.data())->sin6_port
+                        : reinterpret_cast<const sockaddr_in*>(storage_.data())->sin_port);
+}
+
+bool UDPEndpoint::isV6() const {
+    return size_ > 0 && reinterpret_cast<const sockaddr*>(storage_.data())->sa_family == AF_INET6;
+}
+
+bool UDPEndpoint::operator==(const UDPEndpoint& other) const {
+    // compares what identifies the endpoint, padding and IPv6 flow info differ between otherwise equal addresses
+    return size_ == other.size_ && isV6() == other.isV6() && port() == other.port() && address() == other.address();
+}
+
 struct UDPSocket::Impl {
 
-    explicit Impl(int localPort)
-        : sockfd_(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) {
+    Impl(int localPort, bool ipv6, bool reuseAddress, const SocketOptions& options)
+        : v6_(ipv6), sockfd_(socket(ipv6 ? AF_INET6 : AF_INET, SOCK_DGRAM, IPPROTO_UDP)) {
 
         if (sockfd_ == INVALID_SOCKET) {
 
             throwSocketError("Failed to create socket");
         }
 
-        sockaddr_in addr{};
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = INADDR_ANY;
-        addr.sin_port = htons(localPort);
-
-        if (::bind(sockfd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        applySocketOptions(sockfd_, options, SocketKind::Udp);
 
-            throwSocketError("Bind failed");
+        if (reuseAddress) {
+            const int reuse = 1;
+            setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+#ifdef SO_REUSEPORT
+            // what BSD and macOS require for several sockets to share a multicast port
+            setsockopt(sockfd_, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+#endif
         }
-    }
 
-    bool sendTo(const std::string& address, uint16_t port, const std::string& data) const {
-
-        if (data.empty() || data.size() > MAX_UDP_PACKET_SIZE) {
-            return false;
+        int result;
+        if (ipv6) {
+            // dual-stack, IPv4 peers show up as mapped addresses, which UDPEndpoint turns back into IPv4 ones
+            const int v6only = 0;
+            setsockopt(sockfd_, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast<const char*>(&v6only), sizeof(v6only));
+
+            sockaddr_in6 addr{};
+            addr.sin6_family = AF_INET6;
+            addr.sin6_addr = in6addr_any;
+            addr.sin6_port = htons(localPort);
+            result = ::bind(sockfd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        } else {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = INADDR_ANY;
+            addr.sin_port = htons(localPort);
+            result = ::bind(sockfd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
         }
 
-        sockaddr_in to{};
-        to.sin_family = AF_INET;
-        to.sin_port = htons(port);
-        if (!inet_pton(AF_INET, address.c_str(), &to.sin_addr)) {
+        if (result == SOCKET_ERROR) {
 
-            return false;
+            throwSocketError("Bind failed");
         }
+    }
+
+    bool sendTo(const std::string& address, uint16_t port, const std::string& data) const {
 
-        return sendto(sockfd_, data.c_str(), data.size(), 0, reinterpret_cast<sockaddr*>(&to), sizeof(to)) != SOCKET_ERROR;
+        return sendTo(address, port, reinterpret_cast<const unsigned char*>(data.data()), data.size());
     }
 
     bool sendTo(const std::string& address, uint16_t port, const std::vector<unsigned char>& data) const {
@@ -50,70 +152,284 @@ struct UDPSocket::Impl {
 
     bool sendTo(const std::string& address, uint16_t port, const unsigned char* data, size_t size) const {
 
-        if (size == 0 || size > MAX_UDP_PACKET_SIZE) {
+        const auto to = UDPEndpoint::parse(address, port);
+        return to && sendTo(*to, std::span(data, size));
+    }
+
+    bool sendTo(const UDPEndpoint& to, std::span<const uint8_t> data) const {
+
+        if (data.empty() || data.size() > MAX_UDP_PACKET_SIZE) {
             return false;
         }
 
-        sockaddr_in to{};
-        to.sin_family = AF_INET;
-        to.sin_port = htons(port);
-        if (!inet_pton(AF_INET, address.c_str(), &to.sin_addr)) {
-
+        sockaddr_in6 mapped;
+        socklen_t length;
+        const auto destination = nativeAddress(to, mapped, length);
+        if (!destination) {
             return false;
         }
 
-        return sendto(sockfd_, reinterpret_cast<const char*>(data), size, 0, reinterpret_cast<sockaddr*>(&to), sizeof(to)) != SOCKET_ERROR;
+        return sendto(sockfd_, reinterpret_cast<const char*>(data.data()), static_cast<int>(data.size()), 0, destination, length) != SOCKET_ERROR;
     }
 
-    int recvFrom(const std::string& address, uint16_t port, std::vector<unsigned char>& buffer) const {
+    // The address and port arguments are not used, datagrams from any sender are received
+    int recvFrom(const std::string&, uint16_t, unsigned char* buffer, size_t size) const {
 
-        return recvFrom(address, port, buffer.data(), buffer.size());
+        return recvFrom(std::span(buffer, size)).first;
     }
 
-    int recvFrom(const std::string& address, uint16_t port, unsigned char* buffer, size_t size) const {
-
-        sockaddr_in from{};
-        from.sin_family = AF_INET;
-        from.sin_port = htons(port);
-        if (!inet_pton(AF_INET, address.c_str(), &from.sin_addr)) {
+    std::pair<int, UDPEndpoint> recvFrom(std::span<uint8_t> buffer) const {
 
-            return -1;
-        }
+        sockaddr_storage from{};
         socklen_t fromLength = sizeof(from);
 
-        const auto receive = recvfrom(sockfd_, reinterpret_cast<char*>(buffer), size, 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
+        const auto receive = recvfrom(sockfd_, reinterpret_cast<char*>(buffer.data()), static_cast<int>(buffer.size()), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
         if (receive == SOCKET_ERROR) {
-            return -1;
+            return {-1, UDPEndpoint()};
         }
 
-        return receive;
+        return {static_cast<int>(receive), UDPEndpoint::fromNative(&from, fromLength)};
     }
 
-    [[nodiscard]] std::string recvFrom(const std::string& address, uint16_t port) const {
+    [[nodiscard]] std::string recvFrom() const {
 
-        sockaddr_in from{};
-        from.sin_family = AF_INET;
-        from.sin_port = htons(port);
-        if (!inet_pton(AF_INET, address.c_str(), &from.sin_addr)) {
+        thread_local std::vector<unsigned char> buffer(MAX_UDP_PACKET_SIZE);
+
+        const auto receive = recvFrom(buffer).first;
+        if (receive < 0) {
 
             return "";
         }
-        socklen_t fromLength = sizeof(from);
 
-        thread_local std::vector<unsigned char> buffer(MAX_UDP_PACKET_SIZE);
+        return {buffer.begin(), buffer.begin() + receive};
+    }
 
-        const auto receive = recvfrom(sockfd_, reinterpret_cast<char*>(buffer.data()), buffer.size(), 0, reinterpret_cast<sockaddr*>(&from), &fromLength);
-        if (receive == SOCKET_ERROR) {
+    // Makes the socket exchange datagrams with peer only, which then need no address
+    bool connect(const UDPEndpoint& peer) const {
 
-            return "";
+        sockaddr_in6 mapped;
+        socklen_t length;
+        const auto destination = nativeAddress(peer, mapped, length);
+        return destination && ::connect(sockfd_, destination, length) != SOCKET_ERROR;
+    }
+
+    bool send(const unsigned char* data, size_t size) const {
+
+        if (size == 0 || size > MAX_UDP_PACKET_SIZE) {
+            return false;
         }
+        return ::send(sockfd_, reinterpret_cast<const char*>(data), static_cast<int>(size), 0) != SOCKET_ERROR;
+    }
 
-        return {buffer.begin(), buffer.begin() + receive};
+    int recv(unsigned char* buffer, size_t size) const {
+
+        const auto receive = ::recv(sockfd_, reinterpret_cast<char*>(buffer), static_cast<int>(size), 0);
+        return receive == SOCKET_ERROR ? -1 : static_cast<int>(receive);
+    }
+
+    int sendBatch(std::span<const UDPMessage> messages) const {
+        size_t sent = 0;
+#if defined(__linux__)
+        mmsghdr headers[batchSize];
+        iovec iov[batchSize];
+        sockaddr_in6 mapped[batchSize];
+        alignas(cmsghdr) char control[batchSize][CMSG_SPACE(sizeof(uint16_t))];
+        while (gso_ && sent < messages.size()) {
+            const auto count = std::min(batchSize, messages.size() - sent);
+            size_t prepared = 0;
+            for (; prepared < count; ++prepared) {
+                const auto& message = messages[sent + prepared];
+                if (!validSegments(message)) break;
+
+                iov[prepared] = {message.buffer.data(), message.buffer.size()};
+                auto& header = headers[prepared].msg_hdr;
+                headers[prepared] = {};
+                socklen_t length = 0;
+                header.msg_name = const_cast<sockaddr*>(nativeAddress(message.peer, mapped[prepared], length));
+                header.msg_namelen = length;
+                header.msg_iov = &iov[prepared];
+                header.msg_iovlen = 1;
+                if (segmented(message)) {
+                    header.msg_control = control[prepared];
+                    header.msg_controllen = sizeof(control[prepared]);
+                    const auto cmsg = CMSG_FIRSTHDR(&header);
+                    cmsg->cmsg_level = SOL_UDP;
+                    cmsg->cmsg_type = UDP_SEGMENT;
+                    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                    const auto segmentSize = static_cast<uint16_t>(message.segmentSize);
+                    std::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+                }
+            }
+            if (prepared == 0) break;
+
+            int n;
+            do {
+                n = sendmmsg(sockfd_, headers, static_cast<unsigned>(prepared), 0);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0 && segmented(messages[sent]) && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)) {
+                // no GSO from this kernel or device, segmented from here on
+                gso_ = false;
+                break;
+            }
+            if (n <= 0) break;
+            sent += n;
+            if (static_cast<size_t>(n) < prepared) break;// the first one not sent failed
+        }
+        if (gso_) {
+            return sent == 0 && !messages.empty() ? -1 : static_cast<int>(sent);
+        }
+#endif
+        for (const auto& message : messages.subspan(sent)) {
+            if (!validSegments(message) || !sendSegments(message)) break;
+            ++sent;
+        }
+        return sent == 0 && !messages.empty() ? -1 : static_cast<int>(sent);
+    }
+
+    int recvBatch(std::span<UDPMessage> messages) const {
+        size_t received = 0;
+#if defined(__linux__)
+        mmsghdr headers[batchSize];
+        iovec iov[batchSize];
+        sockaddr_storage from[batchSize];
+        alignas(cmsghdr) char control[batchSize][CMSG_SPACE(sizeof(int))];
+        while (received < messages.size()) {
+            const auto count = std::min(batchSize, messages.size() - received);
+            for (size_t i = 0; i < count; ++i) {
+                const auto& message = messages[received + i];
+                iov[i] = {message.buffer.data(), message.buffer.size()};
+                headers[i] = {};
+                headers[i].msg_hdr.msg_name = &from[i];
+                headers[i].msg_hdr.msg_namelen = sizeof(from[i]);
+                headers[i].msg_hdr.msg_iov = &iov[i];
+                headers[i].msg_hdr.msg_iovlen = 1;
+                if (gro_) {
+                    headers[i].msg_hdr.msg_control = control[i];
+                    headers[i].msg_hdr.msg_controllen = sizeof(control[i]);
+                }
+            }
+            // blocks for the first datagram only, then takes what is queued
+            int n;
+            do {
+                n = recvmmsg(sockfd_, headers, static_cast<unsigned>(count), received == 0 ? MSG_WAITFORONE : MSG_DONTWAIT, nullptr);
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) break;
+
+            for (int i = 0; i < n; ++i) {
+                auto& message = messages[received + i];
+                message.size = headers[i].msg_len;
+                message.truncated = headers[i].msg_hdr.msg_flags & MSG_TRUNC;
+                message.peer = UDPEndpoint::fromNative(&from[i], headers[i].msg_hdr.msg_namelen);
+                message.segmentSize = message.size;
+                if (gro_) {
+                    for (auto cmsg = CMSG_FIRSTHDR(&headers[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&headers[i].msg_hdr, cmsg)) {
+                        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                            int segmentSize;
+                            std::memcpy(&segmentSize, CMSG_DATA(cmsg), sizeof(segmentSize));
+                            message.segmentSize = segmentSize;
+                        }
+                    }
+                }
+            }
+            received += n;
+            if (static_cast<size_t>(n) < count) break;// nothing more queued
+        }
+#else
+        for (auto& message : messages) {
+            // blocks for the first datagram only
+            if (received > 0 && !waitFor(sockfd_, false, 0)) break;
+
+            sockaddr_storage from{};
+            socklen_t fromLength = sizeof(from);
+            const auto n = recvfrom(sockfd_, reinterpret_cast<char*>(message.buffer.data()), static_cast<int>(message.buffer.size()), 0,
+                                    reinterpret_cast<sockaddr*>(&from), &fromLength);
+#ifdef _WIN32
+            message.truncated = n == SOCKET_ERROR && WSAGetLastError() == WSAEMSGSIZE;
+            if (n == SOCKET_ERROR && !message.truncated) break;
+            message.size = message.truncated ? message.buffer.size() : n;
+#else
+            if (n == SOCKET_ERROR) break;
+            message.size = n;
+            message.truncated = false;// not reported by recvfrom
+#endif
+            message.peer = UDPEndpoint::fromNative(&from, fromLength);
+            message.segmentSize = message.size;
+            ++received;
+        }
+#endif
+        return received == 0 && !messages.empty() ? -1 : static_cast<int>(received);
+    }
+
+    bool setGro(bool enable) {
+#if defined(__linux__)
+        const int value = enable;
+        if (setsockopt(sockfd_, SOL_UDP, UDP_GRO, &value, sizeof(value)) == SOCKET_ERROR) {
+            return false;
+        }
+        gro_ = enable;
+        return true;
+#else
+        return !enable;
+#endif
+    }
+
+    bool joinGroup(const std::string& group, unsigned interfaceIndex, bool join) const {
+        const auto address = UDPEndpoint::parse(group, 0);
+        if (!address || (address->isV6() && !v6_)) {
+            return false;
+        }
+
+        // RFC 3678 protocol independent API, the same for IPv4 and IPv6 groups
+        group_req request{};
+        request.gr_interface = interfaceIndex;
+        std::memcpy(&request.gr_group, address->native(), address->nativeSize());
+
+        const int level = address->isV6() ? IPPROTO_IPV6 : IPPROTO_IP;
+        return setsockopt(sockfd_, level, join ? MCAST_JOIN_GROUP : MCAST_LEAVE_GROUP, reinterpret_cast<const char*>(&request), sizeof(request)) != SOCKET_ERROR;
+    }
+
+    bool setMulticastTtl(int ttl) const {
+        if (ttl < 0 || ttl > 255) return false;
+
+        // dual-stack sockets need both, for their IPv4 and IPv6 groups
+        const bool v4 = setMulticastOption(IP_MULTICAST_TTL, ttl);
+        if (!v6_) return v4;
+        return setsockopt(sockfd_, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, reinterpret_cast<const char*>(&ttl), sizeof(ttl)) != SOCKET_ERROR;
+    }
+
+    bool setMulticastLoopback(bool enable) const {
+        const bool v4 = setMulticastOption(IP_MULTICAST_LOOP, enable);
+        if (!v6_) return v4;
+#ifdef _WIN32
+        const DWORD value = enable;
+#else
+        const unsigned value = enable;
+#endif
+        return setsockopt(sockfd_, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, reinterpret_cast<const char*>(&value), sizeof(value)) != SOCKET_ERROR;
+    }
+
+    bool setMulticastInterface(unsigned interfaceIndex) const {
+#if defined(_WIN32)
+        // an index in network byte order, in place of an interface address
+        const DWORD v4Interface = htonl(interfaceIndex);
+        const bool v4 = setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_IF, reinterpret_cast<const char*>(&v4Interface), sizeof(v4Interface)) != SOCKET_ERROR;
+#elif defined(__linux__)
+        ip_mreqn v4Interface{};
+        v4Interface.imr_ifindex = static_cast<int>(interfaceIndex);
+        const bool v4 = setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_IF, &v4Interface, sizeof(v4Interface)) != SOCKET_ERROR;
+#elif defined(IP_MULTICAST_IFINDEX)
+        const bool v4 = setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_IFINDEX, &interfaceIndex, sizeof(interfaceIndex)) != SOCKET_ERROR;
+#else
+        const bool v4 = false;
+#endif
+        if (!v6_) return v4;
+        return setsockopt(sockfd_, IPPROTO_IPV6, IPV6_MULTICAST_IF, reinterpret_cast<const char*>(&interfaceIndex), sizeof(interfaceIndex)) != SOCKET_ERROR;
     }
 
-    void close() const {
+    // Closes once, the destructor closing again could hit a descriptor that was reused meanwhile
+    void close() {
 
-        closeSocket(sockfd_);
+        closeSocket(sockfd_.exchange(INVALID_SOCKET));
     }
 
     ~Impl() {
@@ -125,12 +441,58 @@ private:
 #ifdef _WIN32
     WSASession session_;
 #endif
-    SOCKET sockfd_;
+    bool v6_;
+    std::atomic<SOCKET> sockfd_;// atomic, close() may be called while another thread receives
+    bool gro_ = false;
+    mutable std::atomic_bool gso_{true};
+
+    // IPv4 multicast options take a DWORD on Windows and a byte elsewhere
+    bool setMulticastOption(int option, int value) const {
+#ifdef _WIN32
+        const DWORD v = value;
+#else
+        const unsigned char v = static_cast<unsigned char>(value);
+#endif
+        return setsockopt(sockfd_, IPPROTO_IP, option, reinterpret_cast<const char*>(&v), sizeof(v)) != SOCKET_ERROR;
+    }
+
+    // Segments message in user space, for when the kernel can not
+    bool sendSegments(const UDPMessage& message) const {
+        if (!segmented(message)) {
+            return sendTo(message.peer, message.buffer);
+        }
+        for (size_t offset = 0; offset < message.buffer.size(); offset += message.segmentSize) {
+            if (!sendTo(message.peer, message.buffer.subspan(offset, std::min(message.segmentSize, message.buffer.size() - offset)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // to as the socket takes it: IPv4 destinations of a dual-stack socket are written to mapped as IPv4-mapped
+    // IPv6 addresses. Returns nullptr if the socket can not reach to.
+    const sockaddr* nativeAddress(const UDPEndpoint& to, sockaddr_in6& mapped, socklen_t& length) const {
+        const auto addr = static_cast<const sockaddr*>(to.native());
+        length = static_cast<socklen_t>(to.nativeSize());
+        if (length == 0) return nullptr;
+        if (to.isV6()) return v6_ ? addr : nullptr;
+        if (!v6_) return addr;
+
+        const auto v4 = reinterpret_cast<const sockaddr_in*>(addr);
+        mapped = {};
+        mapped.sin6_family = AF_INET6;
+        mapped.sin6_port = v4->sin_port;
+        auto* bytes = reinterpret_cast<uint8_t*>(&mapped.sin6_addr);
+        bytes[10] = bytes[11] = 0xFF;
+        std::memcpy(bytes + 12, &v4->sin_addr, 4);
+        length = sizeof(mapped);
+        return reinterpret_cast<const sockaddr*>(&mapped);
+    }
 };
 
 
-UDPSocket::UDPSocket(int localPort)
-    : pimpl_(std::make_unique<Impl>(localPort)) {}
+UDPSocket::UDPSocket(int localPort, bool ipv6, bool reuseAddress, const SocketOptions& options)
+    : pimpl_(std::make_unique<Impl>(localPort, ipv6, reuseAddress, options)) {}
 
 bool UDPSocket::sendTo(const std::string& address, uint16_t remotePort, const std::string& data) {
 
@@ -147,9 +509,14 @@ bool UDPSocket::sendTo(const std::string& address, uint16_t remotePort, const un
     return pimpl_->sendTo(address, remotePort, data, size);
 }
 
+bool UDPSocket::sendTo(const UDPEndpoint& to, std::span<const uint8_t> data) {
+
+    return pimpl_->sendTo(to, data);
+}
+
 int UDPSocket::recvFrom(const std::string& address, uint16_t remotePort, std::vector<unsigned char>& buffer) {
 
-    return pimpl_->recvFrom(address, remotePort, buffer);
+    return pimpl_->recvFrom(address, remotePort, buffer.data(), buffer.size());
 }
 
 int UDPSocket::recvFrom(const std::string& address, uint16_t remotePort, unsigned char* buffer, size_t size) {
@@ -157,9 +524,24 @@ int UDPSocket::recvFrom(const std::string& address, uint16_t remotePort, unsigne
     return pimpl_->recvFrom(address, remotePort, buffer, size);
 }
 
-std::string UDPSocket::recvFrom(const std::string& address, uint16_t remotePort) {
+std::string UDPSocket::recvFrom(const std::string&, uint16_t) {
+
+    return pimpl_->recvFrom();
+}
+
+std::pair<int, UDPEndpoint> UDPSocket::recvFrom(std::span<uint8_t> buffer) {
+
+    return pimpl_->recvFrom(buffer);
+}
+
+int UDPSocket::sendBatch(std::span<const UDPMessage> messages) {
 
-    return pimpl_->recvFrom(address, remotePort);
+    return pimpl_->sendBatch(messages);
+}
+
+int UDPSocket::recvBatch(std::span<UDPMessage> messages) {
+
+    return pimpl_->recvBatch(messages);
 }
 
 void UDPSocket::close() {
@@ -167,23 +549,60 @@ void UDPSocket::close() {
     pimpl_->close();
 }
 
+bool UDPSocket::setGro(bool enable) {
+
+    return pimpl_->setGro(enable);
+}
+
+bool UDPSocket::joinGroup(const std::string& group, unsigned interfaceIndex) {
+
+    return pimpl_->joinGroup(group, interfaceIndex, true);
+}
+
+bool UDPSocket::leaveGroup(const std::string& group, unsigned interfaceIndex) {
+
+    return pimpl_->joinGroup(group, interfaceIndex, false);
+}
+
+bool UDPSocket::setMulticastTtl(int ttl) {
+
+    return pimpl_->setMulticastTtl(ttl);
+}
+
+bool UDPSocket::setMulticastLoopback(bool enable) {
+
+    return pimpl_->setMulticastLoopback(enable);
+}
+
+bool UDPSocket::setMulticastInterface(unsigned interfaceIndex) {
+
+    return pimpl_->setMulticastInterface(interfaceIndex);
+}
+
 std::unique_ptr<SimpleConnection> UDPSocket::makeConnection(const std::string& address, uint16_t remotePort) {
 
+    const auto peer = UDPEndpoint::parse(address, remotePort);
+    if (!peer) {
+        throw std::invalid_argument("Invalid UDP address: " + address);
+    }
+    return makeConnection(*peer);
+}
+
+std::unique_ptr<SimpleConnection> UDPSocket::makeConnection(const UDPEndpoint& peer) {
+
     struct UDPConnection: SimpleConnection {
 
-        UDPSocket* socket;
-        std::string address;
-        uint16_t port;
+        Impl* socket;
 
-        explicit UDPConnection(UDPSocket* sock, std::string address, uint16_t port)
-            : socket(sock), address(std::move(address)), port(port) {}
+        explicit UDPConnection(Impl* socket)
+            : socket(socket) {}
 
         int read(unsigned char* buffer, size_t size) override {
-            return socket->recvFrom(address, port, buffer, size);
+            return socket->recv(buffer, size);
         }
 
         bool write(const unsigned char* data, size_t size) override {
-            return socket->sendTo(address, port, data, size);
+            return socket->send(data, size);
         }
 
         void close() override {
@@ -191,7 +610,10 @@ std::unique_ptr<SimpleConnection> UDPSocket::makeConnection(const std::string& a
         }
     };
 
-    return std::make_unique<UDPConnection>(this, address, remotePort);
+    if (!pimpl_->connect(peer)) {
+        throwSocketError("Failed to connect UDP socket to " + peer.address());
+    }
+    return std::make_unique<UDPConnection>(pimpl_.get());
 }
 
 UDPSocket::~UDPSocket() = default;
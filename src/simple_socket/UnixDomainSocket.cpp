@@ -2,6 +2,10 @@
 #include "simple_socket/UnixDomainSocket.hpp"
 
 #include "simple_socket/Socket.hpp"
+#include "simple_socket/SocketTuning.hpp"
+
+#include <cstring>
+#include <stdexcept>
 
 #ifdef _WIN32
 #include <afunix.h>
@@ -12,8 +16,16 @@ using namespace simple_socket;
 
 namespace {
 
-    SOCKET createSocket() {
-        SOCKET sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    SOCKET createSocket(UnixSocketType type) {
+#ifdef SOCK_SEQPACKET
+        const int socketType = type == UnixSocketType::SeqPacket ? SOCK_SEQPACKET : SOCK_STREAM;
+#else
+        if (type == UnixSocketType::SeqPacket) {
+            throw std::runtime_error("SOCK_SEQPACKET is not supported on this platform");
+        }
+        const int socketType = SOCK_STREAM;
+#endif
+        SOCKET sockfd = socket(AF_UNIX, socketType, 0);
         if (sockfd == INVALID_SOCKET) {
             throwSocketError("Failed to create socket");
         }
@@ -34,9 +46,10 @@ namespace {
 
 struct UnixDomainServer::Impl {
 
-    explicit Impl(const std::string& domain, int backlog)
-        : socket(createSocket()), domain(domain) {
+    Impl(const std::string& domain, UnixSocketType type, int backlog, const SocketOptions& options)
+        : socket(createSocket(type)), domain(domain), options(options) {
 
+        applySocketOptions(socket.sockfd_, options, SocketKind::Unix);
         unlinkPath(domain);
 
         sockaddr_un addr{};
@@ -63,6 +76,7 @@ struct UnixDomainServer::Impl {
             throwSocketError("Accept failed");
         }
 
+        applySocketOptions(new_sock, options, SocketKind::Unix);
         return std::make_unique<Socket>(new_sock);
     }
 
@@ -82,11 +96,15 @@ private:
 
     Socket socket;
     std::string domain;
+    SocketOptions options;
 };
 
 
-UnixDomainServer::UnixDomainServer(const std::string& domain, int backlog)
-       : pimpl_(std::make_unique<Impl>(domain, backlog)) {}
+UnixDomainServer::UnixDomainServer(const std::string& domain, int backlog, const SocketOptions& options)
+       : UnixDomainServer(domain, UnixSocketType::Stream, backlog, options) {}
+
+UnixDomainServer::UnixDomainServer(const std::string& domain, UnixSocketType type, int backlog, const SocketOptions& options)
+       : pimpl_(std::make_unique<Impl>(domain, type, backlog, options)) {}
 
 void UnixDomainServer::close() {
 
@@ -101,9 +119,12 @@ std::unique_ptr<SimpleConnection> UnixDomainServer::accept() {
 UnixDomainServer::~UnixDomainServer() = default;
 
 
+UnixDomainClientContext::UnixDomainClientContext(UnixSocketType type)
+    : type_(type) {}
+
 std::unique_ptr<SimpleConnection> UnixDomainClientContext::connect(const std::string& domain) {
 
-    SOCKET sockfd = createSocket();
+    SOCKET sockfd = createSocket(type_);
 
     sockaddr_un addr{};
     addr.sun_family = AF_UNIX;
@@ -114,5 +135,118 @@ std::unique_ptr<SimpleConnection> UnixDomainClientContext::connect(const std::st
         return std::make_unique<Socket>(sockfd);
     }
 
+    closeSocket(sockfd);
     return nullptr;
 }
+
+namespace {
+
+    NativeConnection& native(SimpleConnection& conn) {
+        const auto native = dynamic_cast<NativeConnection*>(&conn);
+        if (!native) {
+            throw std::invalid_argument("File descriptors can only be passed over Unix domain socket connections");
+        }
+        return *native;
+    }
+
+}// namespace
+
+bool simple_socket::writeWithFds(SimpleConnection& conn, std::span<const uint8_t> data, std::span<const int> fds) {
+#ifdef _WIN32
+    (void) conn;
+    (void) data;
+    (void) fds;
+    return false;
+#else
+    auto& connection = native(conn);
+    const auto sock = connection.nativeHandle();
+    if (data.empty() || fds.size() > maxPassedFds) {
+        return false;
+    }
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxPassedFds)]{};
+    size_t sent = 0;
+    while (sent < data.size()) {
+        iovec iov{const_cast<uint8_t*>(data.data() + sent), data.size() - sent};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        // the descriptors go with the first chunk only
+        if (sent == 0 && !fds.empty()) {
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+            const auto cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+            std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+        }
+
+        const auto n = ::sendmsg(sock, &msg, sendFlags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // the socket may have been put in non-blocking mode by an EventLoop
+            if (wouldBlock() && waitFor(sock, true)) continue;
+            return false;
+        }
+        connection.trace(tracing::Direction::Out, data.data() + sent, n);
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+#endif
+}
+
+int simple_socket::readWithFds(SimpleConnection& conn, std::span<uint8_t> buffer, std::vector<int>& fds) {
+#ifdef _WIN32
+    (void) conn;
+    (void) buffer;
+    (void) fds;
+    return -1;
+#else
+    auto& connection = native(conn);
+    const auto sock = connection.nativeHandle();
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * maxPassedFds)];
+    for (;;) {
+        iovec iov{buffer.data(), buffer.size()};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+#ifdef MSG_CMSG_CLOEXEC
+        const auto n = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+#else
+        const auto n = ::recvmsg(sock, &msg, 0);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (wouldBlock() && waitFor(sock, false)) continue;
+            return -1;
+        }
+
+        connection.trace(tracing::Direction::In, buffer.data(), n);
+
+        const auto received = fds.size();
+        for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+
+            const auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; ++i) {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(fd));
+                fds.push_back(fd);
+            }
+        }
+        if (msg.msg_flags & MSG_CTRUNC) {
+            // more descriptors were sent than fit, the kernel closed the rest and the message is no use without them
+            for (auto fd = fds.begin() + static_cast<std::ptrdiff_t>(received); fd != fds.end(); ++fd) ::close(*fd);
+            fds.resize(received);
+            errno = EMSGSIZE;
+            return -1;
+        }
+        return n > 0 ? static_cast<int>(n) : -1;
+    }
+#endif
+}
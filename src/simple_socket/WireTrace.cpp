@@ -0,0 +1,525 @@
+
+#include "simple_socket/WireTrace.hpp"
+
+#include "simple_socket/Socket.hpp"
+#include "simple_socket/Tracing.hpp"
+#include "simple_socket/shm/SpscRing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace simple_socket;
+
+std::atomic_bool tracing::active{false};
+
+namespace {
+
+    // A frame as it sits in a ring, followed by the bytes captured of it
+    struct FrameHeader {
+        uint64_t timestamp; // ns since the epoch
+        uint64_t connection;
+        uint64_t length;// of the read or write, of which up to snapLength bytes follow
+        tracing::Direction direction;
+        bool closed;// the connection is gone, there is no data
+        tracing::Endpoints endpoints;
+    };
+
+    // The frames recorded by one thread, drained by the thread of the trace
+    struct ThreadRing {
+        ThreadRing(size_t ringSize, size_t snapLength)
+            : snapLength(snapLength),
+              capacity(std::max(shm::alignToCacheLine(ringSize), shm::SpscRing::recordSize(sizeof(FrameHeader) + snapLength))),
+              data(shm::SpscRing::dataSize(capacity, sizeof(FrameHeader) + snapLength)),
+              producer(&control, data.data(), capacity, sizeof(FrameHeader) + snapLength),
+              consumer(&control, data.data(), capacity, sizeof(FrameHeader) + snapLength) {}
+
+        const size_t snapLength;
+        shm::RingControl control{};
+        const uint64_t capacity;
+        std::vector<uint8_t> data;
+        shm::SpscRing producer;
+        shm::SpscRing consumer;
+        std::atomic_uint64_t dropped{0};
+    };
+
+    // What a running trace shares with the threads recording into it
+    struct Session {
+        WireTraceOptions options;
+        std::mutex m;
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+    };
+
+    std::mutex sessionMutex;
+    std::shared_ptr<Session> current;// guarded by sessionMutex
+    std::atomic_uint64_t generation{0};// counted up whenever current changes
+
+    std::atomic_uint64_t connectionIds{0};
+
+    // The ring of the calling thread in the running trace, registered with it on first use
+    ThreadRing* threadRing() {
+        thread_local std::shared_ptr<ThreadRing> ring;
+        thread_local uint64_t ringGeneration = 0;
+        if (ringGeneration == generation.load(std::memory_order_acquire)) return ring.get();
+
+        std::shared_ptr<Session> session;
+        {
+            std::lock_guard lck(sessionMutex);
+            session = current;
+            ringGeneration = generation.load(std::memory_order_relaxed);
+        }
+        ring.reset();
+        if (!session) return nullptr;
+
+        ring = std::make_shared<ThreadRing>(session->options.ringSize, session->options.snapLength);
+        std::lock_guard lck(session->m);
+        session->rings.push_back(ring);
+        return ring.get();
+    }
+
+    uint64_t now() {
+        const auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count());
+    }
+
+    // Reserves a frame in the ring with room for up to captured bytes after its header, which it is given.
+    // Returns where they go, nullptr if the ring is full.
+    uint8_t* acquireFrame(ThreadRing& ring, const FrameHeader& header, size_t captured) {
+        const auto frame = ring.producer.tryAcquire(sizeof(FrameHeader) + captured);
+        if (!frame) {
+            ring.dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        std::memcpy(frame, &header, sizeof(header));
+        return frame + sizeof(header);
+    }
+
+    FrameHeader frameHeader(uint64_t connection, tracing::Direction direction, const tracing::Endpoints& endpoints, uint64_t length) {
+        FrameHeader header;
+        header.timestamp = now();
+        header.connection = connection;
+        header.length = length;
+        header.direction = direction;
+        header.closed = false;
+        header.endpoints = endpoints;
+        return header;
+    }
+
+    void put16(uint8_t* p, uint16_t v) {
+        p[0] = static_cast<uint8_t>(v >> 8);
+        p[1] = static_cast<uint8_t>(v);
+    }
+
+    void put32(uint8_t* p, uint32_t v) {
+        put16(p, static_cast<uint16_t>(v >> 16));
+        put16(p + 2, static_cast<uint16_t>(v));
+    }
+
+    uint16_t ipv4Checksum(const uint8_t* header) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < 20; i += 2) sum += (header[i] << 8) | header[i + 1];
+        while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+        return static_cast<uint16_t>(~sum);
+    }
+
+    // pcapng blocks in the byte order of the host, which the section header announces
+    class PcapngWriter {
+    public:
+        explicit PcapngWriter(std::FILE* file)
+            : file_(file) {}
+
+        void sectionHeader() {
+            begin(0x0A0D0D0A);
+            append<uint32_t>(0x1A2B3C4D);// byte order magic
+            append<uint16_t>(1);         // version 1.0
+            append<uint16_t>(0);
+            append<int64_t>(-1);// section length unknown
+            end();
+        }
+
+        // The made up packets start at their IP header
+        void interfaceDescription() {
+            constexpr uint16_t linkTypeRaw = 101;
+            begin(1);
+            append<uint16_t>(linkTypeRaw);
+            append<uint16_t>(0);
+            append<uint32_t>(0);// no snap length
+            append<uint16_t>(9);// if_tsresol: timestamps in ns
+            append<uint16_t>(1);
+            append<uint8_t>(9);
+            pad();
+            append<uint32_t>(0);// opt_endofopt
+            end();
+        }
+
+        void enhancedPacket(uint64_t timestamp, std::span<const uint8_t> headers, std::span<const uint8_t> payload, uint64_t originalLength) {
+            begin(6);
+            append<uint32_t>(0);// interface
+            append<uint32_t>(static_cast<uint32_t>(timestamp >> 32));
+            append<uint32_t>(static_cast<uint32_t>(timestamp));
+            append<uint32_t>(static_cast<uint32_t>(headers.size() + payload.size()));
+            append<uint32_t>(static_cast<uint32_t>(std::min<uint64_t>(headers.size() + originalLength, UINT32_MAX)));
+            block_.insert(block_.end(), headers.begin(), headers.end());
+            block_.insert(block_.end(), payload.begin(), payload.end());
+            pad();
+            end();
+        }
+
+    private:
+        std::FILE* file_;
+        std::vector<uint8_t> block_;
+
+        void begin(uint32_t type) {
+            block_.clear();
+            append(type);
+            append<uint32_t>(0);// total length, filled in by end()
+        }
+
+        void end() {
+            const auto length = static_cast<uint32_t>(block_.size() + 4);
+            std::memcpy(block_.data() + 4, &length, 4);
+            append(length);
+            std::fwrite(block_.data(), 1, block_.size(), file_);
+        }
+
+        template<typename T>
+        void append(T value) {
+            const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+            for (size_t i = 0; i < sizeof(T); ++i) block_.push_back(bytes[i]);
+        }
+
+        void pad() {
+            while (block_.size() % 4 != 0) block_.push_back(0);
+        }
+    };
+
+}// namespace
+
+uint64_t tracing::nextConnectionId() {
+    return ++connectionIds;
+}
+
+tracing::Endpoints tracing::endpointsOf(SOCKET socket, uint64_t connection) {
+    Endpoints endpoints;
+
+    sockaddr_storage local{};
+    sockaddr_storage peer{};
+    socklen_t localLength = sizeof(local);
+    socklen_t peerLength = sizeof(peer);
+    if (::getsockname(socket, reinterpret_cast<sockaddr*>(&local), &localLength) == 0 &&
+        ::getpeername(socket, reinterpret_cast<sockaddr*>(&peer), &peerLength) == 0 &&
+        local.ss_family == peer.ss_family) {
+
+        if (local.ss_family == AF_INET) {
+            const auto& l = reinterpret_cast<const sockaddr_in&>(local);
+            const auto& p = reinterpret_cast<const sockaddr_in&>(peer);
+            std::memcpy(endpoints.local.data(), &l.sin_addr, 4);
+            std::memcpy(endpoints.peer.data(), &p.sin_addr, 4);
+            endpoints.localPort = ntohs(l.sin_port);
+            endpoints.peerPort = ntohs(p.sin_port);
+            return endpoints;
+        }
+        if (local.ss_family == AF_INET6) {
+            const auto& l = reinterpret_cast<const sockaddr_in6&>(local);
+            const auto& p = reinterpret_cast<const sockaddr_in6&>(peer);
+            endpoints.localPort = ntohs(l.sin6_port);
+            endpoints.peerPort = ntohs(p.sin6_port);
+            // as the IPv4 client at the other end sees it, on dual stack servers
+            if (IN6_IS_ADDR_V4MAPPED(&l.sin6_addr) && IN6_IS_ADDR_V4MAPPED(&p.sin6_addr)) {
+                std::memcpy(endpoints.local.data(), reinterpret_cast<const uint8_t*>(&l.sin6_addr) + 12, 4);
+                std::memcpy(endpoints.peer.data(), reinterpret_cast<const uint8_t*>(&p.sin6_addr) + 12, 4);
+                return endpoints;
+            }
+            endpoints.version = 6;
+            std::memcpy(endpoints.local.data(), &l.sin6_addr, 16);
+            std::memcpy(endpoints.peer.data(), &p.sin6_addr, 16);
+            return endpoints;
+        }
+    }
+
+    // 127.0.0.1 talking to 127.0.0.2, on a port of the connection's own
+    endpoints.local = {127, 0, 0, 1};
+    endpoints.peer = {127, 0, 0, 2};
+    endpoints.localPort = static_cast<uint16_t>(1024 + connection % 64000);
+    endpoints.peerPort = endpoints.localPort;
+    return endpoints;
+}
+
+void tracing::record(uint64_t connection, Direction direction, const Endpoints& endpoints,
+                     std::span<const std::span<const uint8_t>> buffers, size_t offset, size_t size) {
+    const auto ring = threadRing();
+    if (!ring) return;
+
+    const auto captured = std::min(size, ring->snapLength);
+    auto out = acquireFrame(*ring, frameHeader(connection, direction, endpoints, size), captured);
+    if (!out) return;
+
+    auto left = captured;
+    for (const auto& buffer : buffers) {
+        if (left == 0) break;
+        if (offset >= buffer.size()) {
+            offset -= buffer.size();
+            continue;
+        }
+        const auto n = std::min(buffer.size() - offset, left);
+        std::memcpy(out, buffer.data() + offset, n);
+        out += n;
+        left -= n;
+        offset = 0;
+    }
+    ring->producer.commit(sizeof(FrameHeader) + captured - left);
+}
+
+void tracing::recordFile(uint64_t connection, const Endpoints& endpoints, int fd, uint64_t offset, uint64_t size) {
+    const auto ring = threadRing();
+    if (!ring) return;
+
+    const auto captured = static_cast<size_t>(std::min<uint64_t>(size, ring->snapLength));
+    const auto out = acquireFrame(*ring, frameHeader(connection, Direction::Out, endpoints, size), captured);
+    if (!out) return;
+
+#ifdef _WIN32
+    // without pread the file position would have to move, only the length is recorded
+    (void) fd;
+    (void) offset;
+    const size_t read = 0;
+#else
+    const auto n = ::pread(fd, out, captured, static_cast<off_t>(offset));
+    const size_t read = n > 0 ? static_cast<size_t>(n) : 0;
+#endif
+    ring->producer.commit(sizeof(FrameHeader) + read);
+}
+
+void tracing::recordClose(uint64_t connection, const Endpoints& endpoints) {
+    const auto ring = threadRing();
+    if (!ring) return;
+
+    auto header = frameHeader(connection, Direction::Out, endpoints, 0);
+    header.closed = true;
+    if (acquireFrame(*ring, header, 0)) ring->producer.commit(sizeof(FrameHeader));
+}
+
+uint64_t NativeConnection::traceId() {
+    std::call_once(traceOnce_, [this] {
+        traceId_ = tracing::nextConnectionId();
+        traceEndpoints_ = tracing::endpointsOf(nativeHandle(), traceId_);
+    });
+    return traceId_;
+}
+
+void NativeConnection::traceSlow(tracing::Direction direction, std::span<const std::span<const uint8_t>> buffers, size_t offset, size_t size) {
+    tracing::record(traceId(), direction, traceEndpoints_, buffers, offset, size);
+}
+
+
+struct WireTrace::Impl {
+
+    Impl(const std::string& path, const WireTraceOptions& options)
+        : session(std::make_shared<Session>()) {
+        session->options = options;
+        session->options.snapLength = std::min<size_t>(options.snapLength, 65535 - 60);// fits the largest IP headers
+        {
+            std::lock_guard lck(sessionMutex);
+            if (current) {
+                throw std::runtime_error("A WireTrace is already running");
+            }
+            file = std::fopen(path.c_str(), "wb");
+            if (!file) {
+                throw std::runtime_error("Failed to create " + path);
+            }
+            current = session;
+            generation.fetch_add(1, std::memory_order_release);
+        }
+
+        PcapngWriter writer(file);
+        writer.sectionHeader();
+        writer.interfaceDescription();
+
+        tracing::active = true;
+        thread = std::thread([this] {
+            run();
+        });
+    }
+
+    WireTraceStats stats() {
+        WireTraceStats stats;
+        stats.frames = frames.load(std::memory_order_relaxed);
+        std::lock_guard lck(session->m);
+        for (const auto& ring : session->rings) {
+            stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    void stop() {
+        if (stopped.exchange(true)) return;
+
+        tracing::active = false;
+        {
+            std::lock_guard lck(sessionMutex);
+            current.reset();
+            generation.fetch_add(1, std::memory_order_release);
+        }
+        {
+            std::lock_guard lck(m);
+            stopping = true;
+        }
+        cv.notify_one();
+        thread.join();
+        std::fclose(file);
+    }
+
+    ~Impl() {
+        stop();
+    }
+
+private:
+    struct Stream {
+        std::array<uint32_t, 2> next{1, 1};// sequence numbers, by Direction
+        uint64_t lastFrame = 0;            // timestamp
+    };
+
+    // Streams end with their connection, but a close frame finding its ring full is lost. Past this many,
+    // the half written to least recently is forgotten.
+    static constexpr size_t maxStreams = size_t{1} << 16;
+
+    std::shared_ptr<Session> session;
+    std::FILE* file = nullptr;
+    std::thread thread;
+    std::atomic_bool stopped{false};
+    std::atomic_uint64_t frames{0};
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping = false;
+
+    // only touched by the thread of the trace
+    std::unordered_map<uint64_t, Stream> streams;
+    std::array<uint8_t, 60> packet{};// IP and TCP header
+
+    void run() {
+        std::unique_lock lck(m);
+        // drains once more after being stopped, however early that was
+        for (bool last = false; !last;) {
+            last = cv.wait_for(lck, session->options.flushInterval, [this] { return stopping; });
+            lck.unlock();
+            drain();
+            lck.lock();
+        }
+    }
+
+    void drain() {
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+        {
+            std::lock_guard lck(session->m);
+            rings = session->rings;
+        }
+
+        PcapngWriter writer(file);
+        for (const auto& ring : rings) {
+            for (auto frame = ring->consumer.tryPeek(); !frame.empty(); frame = ring->consumer.tryPeek()) {
+                write(writer, frame);
+                ring->consumer.release(frame.size());
+            }
+        }
+        std::fflush(file);
+    }
+
+    void write(PcapngWriter& writer, std::span<const uint8_t> frame) {
+        FrameHeader header;
+        std::memcpy(&header, frame.data(), sizeof(header));
+        const auto payload = frame.subspan(sizeof(header));
+        constexpr uint8_t pshAck = 0x18;
+        constexpr uint8_t finAck = 0x11;
+        constexpr auto out = static_cast<size_t>(tracing::Direction::Out);
+
+        if (header.closed) {
+            const auto stream = streams.find(header.connection);
+            if (stream == streams.end()) return;// none of its data made it into this capture
+            const auto next = stream->second.next;
+            streams.erase(stream);
+            segment(writer, header, payload, next[out], next[1 - out], finAck);
+            return;
+        }
+
+        if (streams.size() >= maxStreams && !streams.contains(header.connection)) prune();
+        auto& stream = streams[header.connection];
+        stream.lastFrame = header.timestamp;
+        const auto direction = static_cast<size_t>(header.direction);
+        const auto seq = stream.next[direction];
+        const auto ack = stream.next[1 - direction];
+        stream.next[direction] += static_cast<uint32_t>(header.length);
+        segment(writer, header, payload, seq, ack, pshAck);
+    }
+
+    void prune() {
+        std::vector<uint64_t> seen;
+        seen.reserve(streams.size());
+        for (const auto& [connection, stream] : streams) seen.push_back(stream.lastFrame);
+        const auto median = seen.begin() + static_cast<std::ptrdiff_t>(seen.size() / 2);
+        std::nth_element(seen.begin(), median, seen.end());
+        std::erase_if(streams, [cut = *median](const auto& entry) { return entry.second.lastFrame < cut; });
+    }
+
+    void segment(PcapngWriter& writer, const FrameHeader& header, std::span<const uint8_t> payload, uint32_t seq, uint32_t ack, uint8_t flags) {
+        const auto& e = header.endpoints;
+
+        // what goes out travels from the local end to the peer
+        const bool out = header.direction == tracing::Direction::Out;
+        const auto& src = out ? e.local : e.peer;
+        const auto& dst = out ? e.peer : e.local;
+
+        const size_t ipSize = e.version == 6 ? 40 : 20;
+        const auto ipPayload = std::min<uint64_t>(20 + header.length, 65535);
+        packet.fill(0);
+        if (e.version == 6) {
+            packet[0] = 0x60;
+            put16(&packet[4], static_cast<uint16_t>(ipPayload));
+            packet[6] = 6;// TCP
+            packet[7] = 64;
+            std::copy_n(src.begin(), 16, &packet[8]);
+            std::copy_n(dst.begin(), 16, &packet[24]);
+        } else {
+            packet[0] = 0x45;
+            put16(&packet[2], static_cast<uint16_t>(std::min<uint64_t>(ipSize + ipPayload, 65535)));
+            packet[6] = 0x40;// don't fragment
+            packet[8] = 64;
+            packet[9] = 6;// TCP
+            std::copy_n(src.begin(), 4, &packet[12]);
+            std::copy_n(dst.begin(), 4, &packet[16]);
+            put16(&packet[10], ipv4Checksum(packet.data()));
+        }
+
+        auto tcp = &packet[ipSize];
+        put16(tcp, out ? e.localPort : e.peerPort);
+        put16(tcp + 2, out ? e.peerPort : e.localPort);
+        put32(tcp + 4, seq);
+        put32(tcp + 8, ack);
+        tcp[12] = 0x50;// 20 byte header
+        tcp[13] = flags;
+        put16(tcp + 14, 0xFFFF);
+
+        writer.enhancedPacket(header.timestamp, std::span(packet.data(), ipSize + 20), payload, header.length);
+        frames.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+WireTrace::WireTrace(const std::string& path, const WireTraceOptions& options)
+    : pimpl_(std::make_unique<Impl>(path, options)) {}
+
+WireTraceStats WireTrace::stats() const {
+    return pimpl_->stats();
+}
+
+void WireTrace::stop() {
+    pimpl_->stop();
+}
+
+WireTrace::~WireTrace() = default;
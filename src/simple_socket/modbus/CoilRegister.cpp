@@ -0,0 +1,68 @@
+
+#include "simple_socket/modbus/CoilRegister.hpp"
+
+#include "simple_socket/modbus/SeqLock.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace simple_socket;
+
+CoilRegister::CoilRegister(size_t numCoils)
+    : size_(numCoils), bits_(std::make_unique<std::atomic<uint8_t>[]>((numCoils + 7) / 8)) {}
+
+size_t CoilRegister::size() const {
+    return size_;
+}
+
+void CoilRegister::set(size_t index, bool value) {
+    const uint8_t packed = value;
+    writeRange(index, 1, std::span(&packed, 1));
+}
+
+bool CoilRegister::get(size_t index) const {
+    uint8_t packed;
+    readRange(index, 1, std::span(&packed, 1));
+    return packed & 1;
+}
+
+void CoilRegister::readRange(size_t index, size_t count, std::span<uint8_t> packed) const {
+    checkBounds(index, count);
+    if (packed.size() < (count + 7) / 8) {
+        throw std::invalid_argument("Buffer too small for the requested coils");
+    }
+
+    modbus::seqlockRead(sequence_, [&] {
+        std::fill_n(packed.begin(), (count + 7) / 8, 0);
+        for (size_t i = 0; i < count; ++i) {
+            const size_t bit = index + i;
+            if (bits_[bit / 8].load(std::memory_order_relaxed) & (1 << bit % 8)) {
+                packed[i / 8] |= 1 << i % 8;
+            }
+        }
+    });
+}
+
+void CoilRegister::writeRange(size_t index, size_t count, std::span<const uint8_t> packed) {
+    checkBounds(index, count);
+    if (packed.size() < (count + 7) / 8) {
+        throw std::invalid_argument("Buffer too small for the given coils");
+    }
+
+    std::lock_guard lck(writeMutex_);
+    modbus::seqlockWrite(sequence_, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            const size_t bit = index + i;
+            auto& byte = bits_[bit / 8];
+            const auto mask = static_cast<uint8_t>(1 << bit % 8);
+            const auto old = byte.load(std::memory_order_relaxed);
+            byte.store(packed[i / 8] & (1 << i % 8) ? old | mask : old & ~mask, std::memory_order_relaxed);
+        }
+    });
+}
+
+void CoilRegister::checkBounds(size_t index, size_t count) const {
+    if (index + count > size_) {
+        throw std::out_of_range("Coil index out of bounds");
+    }
+}
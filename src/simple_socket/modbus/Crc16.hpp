@@ -0,0 +1,39 @@
+
+#ifndef SIMPLE_SOCKET_MODBUS_CRC16_HPP
+#define SIMPLE_SOCKET_MODBUS_CRC16_HPP
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace simple_socket::modbus {
+
+    namespace detail {
+
+        // CRC-16/MODBUS: reflected polynomial 0xA001, one entry per byte value
+        constexpr std::array<uint16_t, 256> crcTable = [] {
+            std::array<uint16_t, 256> table{};
+            for (uint16_t byte = 0; byte < 256; ++byte) {
+                uint16_t crc = byte;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+                }
+                table[byte] = crc;
+            }
+            return table;
+        }();
+
+    }// namespace detail
+
+    // Continues crc over data, start with the default to compute it from scratch.
+    // Modbus RTU sends the result low byte first.
+    constexpr uint16_t crc16(std::span<const uint8_t> data, uint16_t crc = 0xFFFF) {
+        for (const auto byte : data) {
+            crc = (crc >> 8) ^ detail::crcTable[(crc ^ byte) & 0xFF];
+        }
+        return crc;
+    }
+
+}// namespace simple_socket::modbus
+
+#endif//SIMPLE_SOCKET_MODBUS_CRC16_HPP
@@ -1,82 +1,190 @@
 
 #include "simple_socket/modbus/HoldingRegister.hpp"
 
+#include "simple_socket/modbus/SeqLock.hpp"
 #include "simple_socket/modbus/modbus_helper.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <condition_variable>
+#include <cstring>
 #include <stdexcept>
 
 using namespace simple_socket;
 
+struct HoldingRegister::Subscription::State {
+    const size_t size;// of the register, in registers
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<uint64_t> dirty;// one bit per block
+    bool pending = false;
+    std::atomic_bool active{true};
+
+    explicit State(size_t size)
+        : size(size), dirty((size + blockSize * 64 - 1) / (blockSize * 64)) {}
+
+    void mark(size_t firstBlock, size_t lastBlock) {
+        bool notify;
+        {
+            std::lock_guard lck(m);
+            for (auto block = firstBlock; block <= lastBlock; ++block) {
+                dirty[block / 64] |= uint64_t(1) << block % 64;
+            }
+            notify = !pending;// waiters are only woken for the first change since they last looked
+            pending = true;
+        }
+        if (notify) cv.notify_all();
+    }
+
+    // Takes the dirty blocks as merged ranges, with m held
+    std::vector<Range> take() {
+        std::vector<Range> ranges;
+        if (!pending) return ranges;
+
+        for (size_t word = 0; word < dirty.size(); ++word) {
+            while (dirty[word]) {
+                const auto block = word * 64 + std::countr_zero(dirty[word]);
+                dirty[word] &= dirty[word] - 1;
+
+                const auto index = block * blockSize;
+                const auto count = std::min(blockSize, size - index);
+                if (!ranges.empty() && ranges.back().index + ranges.back().count == index) {
+                    ranges.back().count += count;
+                } else {
+                    ranges.push_back({index, count});
+                }
+            }
+        }
+        pending = false;
+        return ranges;
+    }
+};
+
+HoldingRegister::Subscription::Subscription(std::shared_ptr<State> state)
+    : state_(std::move(state)) {}
+
+std::vector<HoldingRegister::Range> HoldingRegister::Subscription::wait(std::chrono::milliseconds timeout) {
+    std::unique_lock lck(state_->m);
+    state_->cv.wait_for(lck, timeout, [this] { return state_->pending; });
+    return state_->take();
+}
+
+std::vector<HoldingRegister::Range> HoldingRegister::Subscription::poll() {
+    std::lock_guard lck(state_->m);
+    return state_->take();
+}
+
+HoldingRegister::Subscription::~Subscription() {
+    state_->active = false;// dropped by the register on its next write
+}
+
 HoldingRegister::HoldingRegister(size_t numRegisters)
-    : registers_(numRegisters, 0) {}
+    : size_(numRegisters), registers_(std::make_unique<std::atomic<uint16_t>[]>(numRegisters)) {}
 
 size_t HoldingRegister::size() const {
-    std::lock_guard lck(m_);
-    return registers_.size();
+    return size_;
+}
+
+void HoldingRegister::readRange(size_t index, std::span<uint16_t> out) const {
+    checkBounds(index, out.size());
+
+    modbus::seqlockRead(sequence_, [&] {
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = registers_[index + i].load(std::memory_order_relaxed);
+        }
+    });
+}
+
+void HoldingRegister::writeRange(size_t index, std::span<const uint16_t> values) {
+    checkBounds(index, values.size());
+
+    std::lock_guard lck(writeMutex_);
+    // only registers whose value changes count as changed
+    size_t first = values.size();
+    size_t last = 0;
+    modbus::seqlockWrite(sequence_, [&] {
+        for (size_t i = 0; i < values.size(); ++i) {
+            auto& reg = registers_[index + i];
+            if (!subscriptions_.empty() && reg.load(std::memory_order_relaxed) != values[i]) {
+                first = std::min(first, i);
+                last = i;
+            }
+            reg.store(values[i], std::memory_order_relaxed);
+        }
+    });
+
+    if (subscriptions_.empty()) return;
+    std::erase_if(subscriptions_, [](const auto& subscription) { return !subscription->active; });
+    if (first == values.size()) return;// nothing changed
+    for (const auto& subscription : subscriptions_) {
+        subscription->mark((index + first) / blockSize, (index + last) / blockSize);
+    }
+}
+
+std::unique_ptr<HoldingRegister::Subscription> HoldingRegister::subscribe() {
+    auto state = std::make_shared<Subscription::State>(size_);
+
+    std::lock_guard lck(writeMutex_);
+    subscriptions_.push_back(state);
+    return std::unique_ptr<Subscription>(new Subscription(std::move(state)));
 }
 
 void HoldingRegister::setUint16(size_t index, uint16_t value) {
-    std::lock_guard lck(m_);
-    checkBounds(index, 1);
-    registers_[index] = value;
+    writeRange(index, std::span(&value, 1));
 }
 
 uint16_t HoldingRegister::getUint16(size_t index) const {
-    std::lock_guard lck(m_);
-    checkBounds(index, 1);
-    return registers_[index];
+    uint16_t value;
+    readRange(index, std::span(&value, 1));
+    return value;
 }
 
 void HoldingRegister::setUint32(size_t index, uint32_t value) {
-    std::lock_guard lck(m_);
-    checkBounds(index, 2);
-    encode_uint32(value, registers_, index);
+    writeRange(index, encode_uint32(value));
 }
 
 uint32_t HoldingRegister::getUint32(size_t index) const {
-    std::lock_guard lck(m_);
-    checkBounds(index, 2);
-    return decode_uint32(registers_, index);
+    std::array<uint16_t, 2> words{};
+    readRange(index, words);
+    return decode_value<uint32_t>(words);
 }
 
 void HoldingRegister::setUint64(size_t index, uint64_t value) {
-    std::lock_guard lck(m_);
-    checkBounds(index, 4);
-    encode_uint64(value, registers_, index);
+    writeRange(index, encode_uint64(value));
 }
 
 uint64_t HoldingRegister::getUint64(size_t index) const {
-    std::lock_guard lck(m_);
-    checkBounds(index, 4);
-    return decode_uint64(registers_, index);
+    std::array<uint16_t, 4> words{};
+    readRange(index, words);
+    return decode_value<uint64_t>(words);
 }
 
 void HoldingRegister::setFloat(size_t index, float value) {
-    std::lock_guard lck(m_);
-    checkBounds(index, 2);
-    encode_float(value, registers_, index);
+    writeRange(index, encode_float(value));
 }
 
 float HoldingRegister::getFloat(size_t index) const {
-    std::lock_guard lck(m_);
-    checkBounds(index, 2);
-    return decode_float(registers_, index);
+    const uint32_t raw = getUint32(index);
+    float value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return value;
 }
 
 void HoldingRegister::setDouble(size_t index, double value) {
-    std::lock_guard lck(m_);
-    checkBounds(index, 4);
-    encode_double(value, registers_, index);
+    writeRange(index, encode_double(value));
 }
 
 double HoldingRegister::getDouble(size_t index) const {
-    std::lock_guard lck(m_);
-    checkBounds(index, 4);
-    return decode_double(registers_, index);
+    const uint64_t raw = getUint64(index);
+    double value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return value;
 }
 
 void HoldingRegister::checkBounds(size_t index, size_t count) const {
-    if (index + count > registers_.size()) {
+    if (index + count > size_) {
         throw std::out_of_range("Register index out of bounds");
     }
 }
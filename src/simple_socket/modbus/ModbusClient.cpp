@@ -1,195 +1,428 @@
 
 #include "simple_socket/modbus/ModbusClient.hpp"
 
-#include "simple_socket/TCPSocket.hpp"
+#include "simple_socket/BufferPool.hpp"
+#include "simple_socket/ConnectionPool.hpp"
+#include "simple_socket/Counters.hpp"
+#include "simple_socket/modbus/ModbusPdu.hpp"
+#include "simple_socket/modbus/ModbusPipeline.hpp"
 #include "simple_socket/modbus/modbus_helper.hpp"
 
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <stdexcept>
 
 using namespace simple_socket;
 
 namespace {
-    std::vector<uint8_t> makeRequest(uint16_t transactionID, uint8_t unitID, uint8_t functionCode, const std::vector<uint8_t>& data) {
-        std::vector<uint8_t> request_;
-        // MBAP Header
-        request_.resize(7 + 1 + data.size());     // 7 bytes MBAP + 1 byte function code + data size
+
+    // MBAP header + PDU, the PDU is encoded straight into place by encode
+    template<typename Encode>
+    PooledBuffer makeRequest(uint16_t transactionID, uint8_t unitID, Encode encode) {
+        auto request_ = BufferPool::global().acquire(7 + modbus::maxPduSize);
+        const size_t size = encode(modbus::PduBuffer(request_.data() + 7, modbus::maxPduSize));
+        request_.resize(7 + size);
+
         request_[0] = (transactionID >> 8) & 0xFF;// Transaction ID High byte
         request_[1] = transactionID & 0xFF;       // Transaction ID Low byte
         request_[2] = 0x00;                       // Protocol ID (always 0 for Modbus TCP)
         request_[3] = 0x00;
 
-        const auto length = data.size() + 2;
-        request_[4] = length >> 8;// Length field (2 bytes: unitID + functionCode + data)
+        const auto length = size + 1;
+        request_[4] = length >> 8;// Length field (unitID + PDU)
         request_[5] = length & 0xFF;
         request_[6] = unitID;// Unit ID
+        return request_;
+    }
 
-        // Modbus PDU (Protocol Data Unit)
-        request_[7] = functionCode;// Function code (e.g., 0x03 for Read Holding Registers)
+    // Read Holding Registers (0x03) request, or any other read taking an address and a count (0x01, 0x02, 0x04)
+    PooledBuffer readRegistersRequest(uint16_t transactionID, uint16_t address, uint16_t count, uint8_t unitID, uint8_t functionCode = 0x03) {
+        return makeRequest(transactionID, unitID, [&](modbus::PduBuffer pdu) {
+            return modbus::encodeRead(pdu, functionCode, address, count);
+        });
+    }
 
-        // Data part of the PDU
-        std::copy(data.begin(), data.end(), request_.begin() + 8);
+    // Write Single Register (0x06) request
+    PooledBuffer writeRegisterRequest(uint16_t transactionID, uint16_t address, uint16_t value, uint8_t unitID) {
+        return makeRequest(transactionID, unitID, [&](modbus::PduBuffer pdu) {
+            return modbus::encodeWriteSingle(pdu, 0x06, address, value);
+        });
+    }
 
-        return request_;
+    // Write Multiple Registers (0x10) request
+    PooledBuffer writeRegistersRequest(uint16_t transactionID, uint16_t address, const uint16_t* values, size_t size, uint8_t unitID) {
+        return makeRequest(transactionID, unitID, [&](modbus::PduBuffer pdu) {
+            return modbus::encodeWriteRegisters(pdu, address, std::span(values, size));
+        });
     }
 
-    // Parse the response for reading registers
-    std::vector<uint16_t> parse_registers_response(const std::vector<uint8_t>& response, uint16_t count) {
-        // Check if response has the minimum size: 9 bytes for the header + data bytes
-        if (response.size() < 9 + count * 2) { // TODO: verify
-            throw std::runtime_error("Invalid response size or insufficient data");
-        }
+    // Write Single Coil (0x05) request, ON is sent as 0xFF00 and OFF as 0x0000
+    PooledBuffer writeCoilRequest(uint16_t transactionID, uint16_t address, bool value, uint8_t unitID) {
+        return makeRequest(transactionID, unitID, [&](modbus::PduBuffer pdu) {
+            return modbus::encodeWriteSingle(pdu, 0x05, address, value ? 0xFF00 : 0x0000);
+        });
+    }
 
-        // The first 9 bytes are part of the MBAP header and function code
-        const uint8_t byte_count = response[8];// The number of data bytes
+    // Write Multiple Coils (0x0F) request
+    PooledBuffer writeCoilsRequest(uint16_t transactionID, uint16_t address, const std::vector<bool>& values, uint8_t unitID) {
+        return makeRequest(transactionID, unitID, [&](modbus::PduBuffer pdu) {
+            return modbus::encodeWriteCoils(pdu, address, values);
+        });
+    }
 
-        // Check if the byte count matches the expected number of bytes
-        if (byte_count != count * 2) {
-            throw std::runtime_error("Byte count mismatch in Modbus response");
-        }
+    // Read/Write Multiple registers (0x17) request
+    PooledBuffer readWriteRegistersRequest(uint16_t transactionID, uint16_t readAddress, uint16_t readCount,
+                                                   uint16_t writeAddress, const uint16_t* values, size_t size, uint8_t unitID) {
+        return makeRequest(transactionID, unitID, [&](modbus::PduBuffer pdu) {
+            return modbus::encodeReadWriteRegisters(pdu, readAddress, readCount, writeAddress, std::span(values, size));
+        });
+    }
 
-        // Extract the registers from the response
-        std::vector<uint16_t> registers;
-        for (size_t i = 0; i < count; ++i) {
-            const uint16_t reg_value = (response[9 + i * 2] << 8) | response[9 + i * 2 + 1];// Combine high and low bytes
-            registers.emplace_back(reg_value);
+    // The PDU of a response ADU, behind the 7 byte MBAP header
+    std::span<const uint8_t> pduOf(std::span<const uint8_t> response) {
+        if (response.size() < 8) {
+            throw std::runtime_error("Invalid response size or insufficient data");
         }
+        return response.subspan(7);
+    }
 
-        return registers;
+    // Parse the response for reading coils or discrete inputs
+    std::vector<bool> parse_bits_response(std::span<const uint8_t> response, uint16_t count) {
+        return modbus::decodeBits(pduOf(response), count);
+    }
+
+    // Parse the response for reading registers
+    std::vector<uint16_t> parse_registers_response(std::span<const uint8_t> response, uint16_t count) {
+        return modbus::decodeRegisters(pduOf(response), count);
+    }
+
+    void parse_registers_response(std::span<const uint8_t> response, std::span<uint16_t> out) {
+        modbus::decodeRegisters(pduOf(response), out);
     }
 
     // Validate the response of a write operation
-    bool validate_write_response(const std::vector<uint8_t>& response, uint16_t address, uint16_t value) {
-        if (response.size() < 12) {
-            return false;
-        }
-        const uint16_t resp_address = (response[8] << 8) | response[9];
-        const uint16_t resp_value = (response[10] << 8) | response[11];
-        return resp_address == address && resp_value == value;
+    bool validate_write_response(std::span<const uint8_t> response, uint16_t address, uint16_t value) {
+        return response.size() >= 8 && modbus::confirmsWrite(response.subspan(7), address, value);
     }
 
+    // Shared with the completion handlers of pipelined requests, which may outlive the client
+    struct Counters {
+        std::atomic_uint64_t transactions{0};
+        std::atomic_uint64_t failures{0};
+        std::atomic_uint64_t reconnects{0};
+        Histogram latency;
+
+        void completed(const Stopwatch& stopwatch, bool ok) {
+            if (!ok) count(failures);
+            latency.record(stopwatch);
+        }
+    };
 
 }// namespace
 
 struct ModbusClient::Impl {
 
-    Impl(const std::string& host, uint16_t port) {
-        conn = ctx.connect(host, port);
-        if (!conn) {
-            throw std::runtime_error("Error");
+    Impl(const std::string& host, uint16_t port)
+        : ownPool(std::make_unique<ConnectionPool>(singleConnection())), pool(*ownPool), host(host), port(port) {
+        // connect eagerly, the connection waits in the pool for the first request
+        if (!pool.acquire(host, port)) {
+            throw std::runtime_error("Failed to connect to Modbus server " + host + ":" + std::to_string(port));
         }
     }
 
+    Impl(ConnectionPool& pool, const std::string& host, uint16_t port)
+        : pool(pool), host(host), port(port) {}
+
     std::vector<uint16_t> read_holding_registers(uint16_t address, uint16_t count, uint8_t unit_id) {
-        std::vector request_data{
-                static_cast<uint8_t>((address >> 8) & 0xFF),// High byte of address
-                static_cast<uint8_t>(address & 0xFF),       // Low byte of address
-                static_cast<uint8_t>((count >> 8) & 0xFF),  // High byte of count
-                static_cast<uint8_t>(count & 0xFF)          // Low byte of count
-        };
-        const auto request = makeRequest(next_transaction_id_++, unit_id, 0x03, request_data);// 0x03 is function code for reading holding registers
-
-        if (!conn->write(request)) {
-            throw std::runtime_error("Failed to send Modbus request");
+        const auto response = transact(readRegistersRequest(next_transaction_id_++, address, count, unit_id));
+        if (!response) {
+            throw std::runtime_error("Failed to receive response");
         }
-
-        std::vector<uint8_t> response = receive_response(count);
         // Handle the response and extract register values
-        return parse_registers_response(response, count);
+        return parse_registers_response(response->span(), count);
     }
 
-    std::vector<uint8_t> receive_response(uint16_t count) {
-        std::vector<uint8_t> buffer(255);// Adjust buffer size based on expected response
-        const auto bytes_received = conn->read(buffer);
-        if (bytes_received < 0) {
+    void read_holding_registers(uint16_t address, std::span<uint16_t> out, uint8_t unit_id) {
+        if (out.size() > 125) {
+            throw std::invalid_argument("At most 125 registers can be read at once");
+        }
+        const auto response = transact(readRegistersRequest(next_transaction_id_++, address, static_cast<uint16_t>(out.size()), unit_id));
+        if (!response) {
             throw std::runtime_error("Failed to receive response");
         }
-        buffer.resize(bytes_received);
-        return buffer;
+        parse_registers_response(response->span(), out);
     }
 
-    bool write_single_register(uint16_t address, uint16_t value, uint8_t unitID) {
-        // Construct the data part (address + value) for the Modbus PDU
-        std::vector data{
-                static_cast<uint8_t>((address >> 8) & 0xFF),// High byte of the address
-                static_cast<uint8_t>(address & 0xFF),       // Low byte of the address
-                static_cast<uint8_t>((value >> 8) & 0xFF),  // High byte of the value
-                static_cast<uint8_t>(value & 0xFF)          // Low byte of the value
-        };
+    // A value of T spanning sizeof(T) / 2 registers
+    template<typename T>
+    T read_value(uint16_t address, uint8_t unit_id) {
+        std::array<uint16_t, sizeof(T) / 2> registers{};
+        read_holding_registers(address, registers, unit_id);
+        return decode_value<T>(registers);
+    }
 
-        // Create the Modbus request
-        const auto request = makeRequest(next_transaction_id_++, unitID, 0x06, data);// 0x06 for Write Single Register
+    std::vector<bool> read_bits(uint8_t functionCode, uint16_t address, uint16_t count, uint8_t unit_id) {
+        const auto response = transact(readRegistersRequest(next_transaction_id_++, address, count, unit_id, functionCode));
+        if (!response) {
+            throw std::runtime_error("Failed to receive response");
+        }
+        return parse_bits_response(response->span(), count);
+    }
 
-        // Send request and handle the response
-        if (!conn->write(request)) {
-            return false;
+    std::vector<uint16_t> read_input_registers(uint16_t address, uint16_t count, uint8_t unit_id) {
+        const auto response = transact(readRegistersRequest(next_transaction_id_++, address, count, unit_id, 0x04));
+        if (!response) {
+            throw std::runtime_error("Failed to receive response");
         }
+        return parse_registers_response(response->span(), count);
+    }
 
-        std::vector<uint8_t> response = receive_response(1);
-        // Validate the response (should echo the request)
-        return validate_write_response(response, address, value);
+    std::vector<uint16_t> read_write_multiple_registers(uint16_t readAddress, uint16_t readCount, uint16_t writeAddress, const uint16_t* values, size_t size, uint8_t unitID) {
+        const auto response = transact(readWriteRegistersRequest(next_transaction_id_++, readAddress, readCount, writeAddress, values, size, unitID));
+        if (!response) {
+            throw std::runtime_error("Failed to receive response");
+        }
+        return parse_registers_response(response->span(), readCount);
     }
 
-    bool write_multiple_registers(uint16_t address, const uint16_t* values, size_t size, uint8_t unitID) {
-        // Construct the data part for the Modbus PDU: address, number of registers, and values
-        std::vector data {
-                static_cast<uint8_t>((address >> 8) & 0xFF),      // High byte of the address
-                static_cast<uint8_t>(address & 0xFF),             // Low byte of the address
-                static_cast<uint8_t>((size >> 8) & 0xFF),// High byte of number of registers
-                static_cast<uint8_t>(size & 0xFF),       // Low byte of number of registers
-                static_cast<uint8_t>(size * 2)           // Byte count (2 bytes per register)
-        };
-
-        // Append register values (each register is 2 bytes)
-        for (unsigned i = 0; i < size; ++i) {
-            data.emplace_back(static_cast<uint8_t>((values[i] >> 8) & 0xFF));// High byte of value
-            data.emplace_back(static_cast<uint8_t>(values[i] & 0xFF));       // Low byte of value
+    std::future<std::vector<uint16_t>> read_holding_registers_async(uint16_t address, uint16_t count, uint8_t unit_id) {
+        return submit<std::vector<uint16_t>>(readRegistersRequest(0, address, count, unit_id), [count](std::span<const uint8_t> response) {
+            return parse_registers_response(response, count);
+        });
+    }
+
+    // Sends request and receives the matching response. A pooled connection may have been dropped by the server
+    // while it was idle, so a request that fails on one is sent once more on a new connection. That is safe as
+    // every request this client makes is idempotent. Returns nothing if the exchange failed twice.
+    std::optional<PooledBuffer> transact(PooledBuffer request) {
+        if (const auto pipeline = activePipeline()) {
+            // the pipeline may hold the only connection the pool allows
+            try {
+                return submit<PooledBuffer>(std::move(request), [](std::span<const uint8_t> response) {
+                           auto copy = BufferPool::global().acquire(response.size());
+                           std::copy(response.begin(), response.end(), copy.data());
+                           return copy;
+                       }).get();
+            } catch (const std::exception&) {
+                return std::nullopt;
+            }
         }
 
-        // Create the Modbus request
-        const auto request = makeRequest(next_transaction_id_++, unitID, 0x10, data);// 0x10 for Write Multiple Registers
+        count(counters->transactions);
+        const Stopwatch stopwatch;
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            auto lease = pool.acquire(host, port);
+            if (!lease) break;
+            if (attempt > 0) count(counters->reconnects);
+
+            PooledBuffer response;
+            try {
+                if (!lease->write(request.data(), request.size()) || !receive_response(*lease, response)) {
+                    lease.invalidate();
+                    continue;
+                }
+            } catch (const std::exception&) {
+                lease.invalidate();// what is left of the malformed response must not reach the next request
+                counters->completed(stopwatch, false);
+                throw;
+            }
+            if (response[0] != request[0] || response[1] != request[1]) {
+                lease.invalidate();
+                counters->completed(stopwatch, false);
+                throw std::runtime_error("Transaction ID mismatch in Modbus response");
+            }
+            counters->completed(stopwatch, true);
+            return response;
+        }
+        counters->completed(stopwatch, false);
+        return std::nullopt;
+    }
 
-        // Send request and handle the response
-        if (!conn->write(request)) {
-            return false;
+    ModbusClientStats stats() const {
+        ModbusClientStats stats;
+        stats.transactions = load(counters->transactions);
+        stats.failures = load(counters->failures);
+        stats.reconnects = load(counters->reconnects);
+        stats.transactionLatency = counters->latency.snapshot();
+        return stats;
+    }
+
+    // Sends request on the pipeline, the future holds what parse makes of the response
+    template<typename T, typename Parse>
+    std::future<T> submit(PooledBuffer request, Parse parse) {
+        auto promise = std::make_shared<std::promise<T>>();
+        auto future = promise->get_future();
+
+        count(counters->transactions);
+        const Stopwatch stopwatch;
+        std::shared_ptr<modbus::Pipeline> connection;
+        try {
+            connection = pipeline();
+        } catch (const std::exception&) {
+            counters->completed(stopwatch, false);
+            promise->set_exception(std::current_exception());
+            return future;
         }
 
-        const auto response = receive_response(size);
+        connection->send(request.span(), [promise, parse, counters = counters, stopwatch](std::span<const uint8_t> response, const std::exception_ptr& error) {
+            if (error) {
+                counters->completed(stopwatch, false);
+                promise->set_exception(error);
+                return;
+            }
+            try {
+                auto value = parse(response);
+                counters->completed(stopwatch, true);
+                promise->set_value(std::move(value));
+            } catch (...) {
+                counters->completed(stopwatch, false);
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+
+    // The pipeline, opened on first use and reopened after its connection failed
+    std::shared_ptr<modbus::Pipeline> pipeline() {
+        std::lock_guard lock(pipelineMutex);
+        if (!pipeline_ || pipeline_->broken()) {
+            pipeline_.reset();// gives the connection slot back first
+            auto lease = pool.acquire(host, port);
+            if (!lease) {
+                throw std::runtime_error("Failed to connect to Modbus server " + host + ":" + std::to_string(port));
+            }
+            pipeline_ = std::make_shared<modbus::Pipeline>(std::move(lease));
+        }
+        return pipeline_;
+    }
+
+    std::shared_ptr<modbus::Pipeline> activePipeline() {
+        std::lock_guard lock(pipelineMutex);
+        return pipeline_ && !pipeline_->broken() ? pipeline_ : nullptr;
+    }
+
+    // Receives one complete ADU, typically in a single read. Returns false on I/O errors,
+    // throws if the server sent something other than a single well-formed ADU.
+    static bool receive_response(SimpleConnection& conn, PooledBuffer& response) {
+        auto buffer = BufferPool::global().acquire(maxAduSize);
+        size_t received = 0;
+        size_t size = 7;// until the header is in
+        while (received < size) {
+            const auto n = conn.read(buffer.data() + received, buffer.size() - received);
+            if (n <= 0) return false;
+            received += n;
+
+            if (received >= 6) {
+                // The MBAP length field counts the bytes following it
+                size = 6 + ((buffer[4] << 8) | buffer[5]);
+                if (size < 8 || size > maxAduSize) {
+                    throw std::runtime_error("Invalid Modbus response length");
+                }
+            }
+        }
+        if (received > size) {
+            throw std::runtime_error("Unexpected data after Modbus response");
+        }
+        buffer.resize(size);
+        response = std::move(buffer);
+        return true;
+    }
+
+    bool write_single_register(uint16_t address, uint16_t value, uint8_t unitID) {
+        // Send request and handle the response
+        const auto response = transact(writeRegisterRequest(next_transaction_id_++, address, value, unitID));
+        // Validate the response (should echo the request)
+        return response && validate_write_response(response->span(), address, value);
+    }
+
+    std::future<bool> write_single_register_async(uint16_t address, uint16_t value, uint8_t unitID) {
+        return submit<bool>(writeRegisterRequest(0, address, value, unitID), [address, value](std::span<const uint8_t> response) {
+            return validate_write_response(response, address, value);
+        });
+    }
+
+    bool write_multiple_registers(uint16_t address, const uint16_t* values, size_t size, uint8_t unitID) {
+        // Send request and handle the response
+        const auto response = transact(writeRegistersRequest(next_transaction_id_++, address, values, size, unitID));
         // Validate the response (should echo the address and number of registers written)
-        return validate_write_response(response, address, size);
+        return response && validate_write_response(response->span(), address, size);
+    }
+
+    std::future<bool> write_multiple_registers_async(uint16_t address, const uint16_t* values, size_t size, uint8_t unitID) {
+        return submit<bool>(writeRegistersRequest(0, address, values, size, unitID), [address, size](std::span<const uint8_t> response) {
+            return validate_write_response(response, address, size);
+        });
+    }
+
+    bool write_single_coil(uint16_t address, bool value, uint8_t unitID) {
+        const auto response = transact(writeCoilRequest(next_transaction_id_++, address, value, unitID));
+        // Validate the response (should echo the request)
+        return response && validate_write_response(response->span(), address, value ? 0xFF00 : 0x0000);
+    }
+
+    bool write_multiple_coils(uint16_t address, const std::vector<bool>& values, uint8_t unitID) {
+        const auto response = transact(writeCoilsRequest(next_transaction_id_++, address, values, unitID));
+        // Validate the response (should echo the address and number of coils written)
+        return response && validate_write_response(response->span(), address, values.size());
+    }
+
+    static ConnectionPoolOptions singleConnection() {
+        ConnectionPoolOptions options;
+        options.maxPerHost = 1;
+        return options;
     }
 
-    TCPClientContext ctx;
-    std::unique_ptr<SimpleConnection> conn;
+    // MBAP header + PDU, the largest ADU Modbus TCP allows
+    static constexpr size_t maxAduSize = 260;
 
-    uint16_t next_transaction_id_ = 1;
+    std::unique_ptr<ConnectionPool> ownPool;
+    ConnectionPool& pool;
+    std::string host;
+    uint16_t port;
+
+    std::atomic<uint16_t> next_transaction_id_{1};
+    std::shared_ptr<Counters> counters = std::make_shared<Counters>();
+
+    std::mutex pipelineMutex;
+    std::shared_ptr<modbus::Pipeline> pipeline_;
 };
 
 
 ModbusClient::ModbusClient(const std::string& host, uint16_t port)
     : pimpl_(std::make_unique<Impl>(host, port)) {}
 
+ModbusClient::ModbusClient(ConnectionPool& pool, const std::string& host, uint16_t port)
+    : pimpl_(std::make_unique<Impl>(pool, host, port)) {}
+
 std::vector<uint16_t> ModbusClient::read_holding_registers(uint16_t address, uint16_t count, uint8_t unit_id) {
     return pimpl_->read_holding_registers(address, count, unit_id);
 }
 
+void ModbusClient::read_holding_registers(uint16_t address, std::span<uint16_t> out, uint8_t unit_id) {
+    pimpl_->read_holding_registers(address, out, unit_id);
+}
+
 uint16_t ModbusClient::read_uint16(uint16_t address, uint8_t unit_id) {
-    return pimpl_->read_holding_registers(address, 1, unit_id).front();
+    return pimpl_->read_value<uint16_t>(address, unit_id);
 }
 
 uint32_t ModbusClient::read_uint32(uint16_t address, uint8_t unit_id) {
-    return decode_uint32(pimpl_->read_holding_registers(address, 2, unit_id));
+    return pimpl_->read_value<uint32_t>(address, unit_id);
 }
 
 uint64_t ModbusClient::read_uint64(uint16_t address, uint8_t unit_id) {
-    return decode_uint64(pimpl_->read_holding_registers(address, 4, unit_id));
+    return pimpl_->read_value<uint64_t>(address, unit_id);
 }
 
 float ModbusClient::read_float(uint16_t address, uint8_t unit_id) {
-    return decode_float(pimpl_->read_holding_registers(address, 2, unit_id));
+    return pimpl_->read_value<float>(address, unit_id);
 }
 
 double ModbusClient::read_double(uint16_t address, uint8_t unit_id) {
-    return decode_double(pimpl_->read_holding_registers(address, 4, unit_id));
+    return pimpl_->read_value<double>(address, unit_id);
 }
 
 bool ModbusClient::write_single_register(uint16_t address, uint16_t value, uint8_t unit_id) {
@@ -200,4 +433,44 @@ bool ModbusClient::write_multiple_registers(uint16_t address, const uint16_t* va
     return pimpl_->write_multiple_registers(address, values, size, unitID);
 }
 
+std::vector<bool> ModbusClient::read_coils(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->read_bits(0x01, address, count, unit_id);
+}
+
+std::vector<bool> ModbusClient::read_discrete_inputs(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->read_bits(0x02, address, count, unit_id);
+}
+
+std::vector<uint16_t> ModbusClient::read_input_registers(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->read_input_registers(address, count, unit_id);
+}
+
+bool ModbusClient::write_single_coil(uint16_t address, bool value, uint8_t unit_id) {
+    return pimpl_->write_single_coil(address, value, unit_id);
+}
+
+bool ModbusClient::write_multiple_coils(uint16_t address, const std::vector<bool>& values, uint8_t unitID) {
+    return pimpl_->write_multiple_coils(address, values, unitID);
+}
+
+std::vector<uint16_t> ModbusClient::read_write_multiple_registers(uint16_t readAddress, uint16_t readCount, uint16_t writeAddress, const uint16_t* values, size_t size, uint8_t unitID) {
+    return pimpl_->read_write_multiple_registers(readAddress, readCount, writeAddress, values, size, unitID);
+}
+
+std::future<std::vector<uint16_t>> ModbusClient::read_holding_registers_async(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->read_holding_registers_async(address, count, unit_id);
+}
+
+std::future<bool> ModbusClient::write_single_register_async(uint16_t address, uint16_t value, uint8_t unit_id) {
+    return pimpl_->write_single_register_async(address, value, unit_id);
+}
+
+std::future<bool> ModbusClient::write_multiple_registers_async(uint16_t address, const uint16_t* values, size_t size, uint8_t unitID) {
+    return pimpl_->write_multiple_registers_async(address, values, size, unitID);
+}
+
+ModbusClientStats ModbusClient::stats() const {
+    return pimpl_->stats();
+}
+
 ModbusClient::~ModbusClient() = default;
@@ -0,0 +1,344 @@
+
+#include "simple_socket/modbus/ModbusPdu.hpp"
+
+#include "simple_socket/modbus/modbus_helper.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <string>
+
+using namespace simple_socket;
+using namespace simple_socket::modbus;
+
+namespace {
+
+    constexpr uint8_t illegalFunction = 0x01;
+    constexpr uint8_t illegalDataAddress = 0x02;
+    constexpr uint8_t illegalDataValue = 0x03;
+
+    uint16_t word(std::span<const uint8_t> pdu, size_t offset) {
+        return (pdu[offset] << 8) | pdu[offset + 1];
+    }
+
+    void putWord(PduBuffer out, size_t offset, uint16_t value) {
+        out[offset] = value >> 8;
+        out[offset + 1] = value & 0xFF;
+    }
+
+    size_t exception(PduBuffer response, uint8_t functionCode, uint8_t exceptionCode) {
+        response[0] = functionCode | 0x80;// Set error flag
+        response[1] = exceptionCode;
+        return 2;
+    }
+
+    // Echo back the first five bytes of the request (function code, address and value or quantity) as a confirmation
+    size_t echo(std::span<const uint8_t> request, PduBuffer response) {
+        std::copy_n(request.begin(), 5, response.begin());
+        return 5;
+    }
+
+    // Read Coils (0x01) and Read Discrete Inputs (0x02)
+    size_t readBits(std::span<const uint8_t> request, PduBuffer response, const CoilRegister& bits) {
+        const uint8_t functionCode = request[0];
+        const uint16_t startAddress = word(request, 1);
+        const uint16_t quantity = word(request, 3);
+
+        if (quantity == 0 || quantity > 2000) {
+            return exception(response, functionCode, illegalDataValue);
+        }
+        if (startAddress + quantity > bits.size()) {
+            return exception(response, functionCode, illegalDataAddress);
+        }
+
+        const auto byteCount = static_cast<uint8_t>((quantity + 7) / 8);
+        response[0] = functionCode;
+        response[1] = byteCount;
+        bits.readRange(startAddress, quantity, response.subspan(2, byteCount));
+        return 2 + byteCount;
+    }
+
+    // Register values, taken as one consistent snapshot, as the response to Read Holding/Input Registers (0x03/0x04)
+    // and Read/Write Multiple registers (0x17)
+    size_t sendRegisters(uint8_t functionCode, PduBuffer response, const HoldingRegister& reg, uint16_t startAddress, uint16_t quantity) {
+        std::array<uint16_t, 125> registers{};
+        reg.readRange(startAddress, std::span(registers.data(), quantity));
+
+        response[0] = functionCode;
+        response[1] = static_cast<uint8_t>(quantity * 2);// Byte Count
+        encode_registers(std::span(registers.data(), quantity), response.subspan(2, quantity * 2));
+        return 2 + quantity * 2;
+    }
+
+    // Read Holding Registers (0x03) and Read Input Registers (0x04)
+    size_t readRegisters(std::span<const uint8_t> request, PduBuffer response, const HoldingRegister& reg) {
+        const uint8_t functionCode = request[0];
+        const uint16_t startAddress = word(request, 1);
+        const uint16_t quantity = word(request, 3);
+
+        if (startAddress + quantity > reg.size()) {
+            return exception(response, functionCode, illegalDataAddress);
+        }
+        if (quantity == 0 || quantity > 125) {
+            return exception(response, functionCode, illegalDataValue);
+        }
+        return sendRegisters(functionCode, response, reg, startAddress, quantity);
+    }
+
+    // Decodes quantity register values at request[offset] and writes them, all at once.
+    // Returns the exception code if the request does not hold them.
+    uint8_t writeRegisters(std::span<const uint8_t> request, size_t offset, HoldingRegister& reg, uint16_t startAddress, uint16_t quantity, uint16_t maxQuantity) {
+        const uint8_t byteCount = request[offset - 1];// Number of data bytes
+
+        // Check if the request is valid: the quantity of registers should not exceed the register size.
+        if (startAddress + quantity > reg.size() || byteCount != quantity * 2) {
+            return illegalDataAddress;
+        }
+        if (quantity == 0 || quantity > maxQuantity || request.size() < offset + byteCount) {
+            return illegalDataValue;
+        }
+
+        std::array<uint16_t, 123> registers{};
+        decode_registers(request.subspan(offset, byteCount), std::span(registers.data(), quantity));
+        reg.writeRange(startAddress, std::span(registers.data(), quantity));
+        return 0;
+    }
+
+    void checkException(std::span<const uint8_t> response) {
+        if (response.empty()) {
+            throw std::runtime_error("Empty Modbus response");
+        }
+        // The server rejected the request, the exception code follows the function code
+        if (response[0] & 0x80) {
+            throw std::runtime_error("Modbus exception response, code " + std::to_string(response.size() > 1 ? response[1] : 0));
+        }
+    }
+
+}// namespace
+
+size_t modbus::processPdu(std::span<const uint8_t> request, PduBuffer response, const ModbusDataModel& model) {
+    const uint8_t functionCode = request[0];
+
+    // every supported request starts with a start address and a quantity or value
+    if (request.size() < 5) {
+        return exception(response, functionCode, illegalDataValue);
+    }
+    const uint16_t startAddress = word(request, 1);
+    const uint16_t quantity = word(request, 3);
+
+    switch (functionCode) {
+        case 0x01:// Read Coils
+            if (!model.coils) break;
+            return readBits(request, response, *model.coils);
+
+        case 0x02:// Read Discrete Inputs
+            if (!model.discreteInputs) break;
+            return readBits(request, response, *model.discreteInputs);
+
+        case 0x03:// Read Holding Registers
+            if (!model.holdingRegisters) break;
+            return readRegisters(request, response, *model.holdingRegisters);
+
+        case 0x04:// Read Input Registers
+            if (!model.inputRegisters) break;
+            return readRegisters(request, response, *model.inputRegisters);
+
+        case 0x05: {// Write Single Coil
+            if (!model.coils) break;
+            if (startAddress >= model.coils->size()) {
+                return exception(response, functionCode, illegalDataAddress);
+            }
+            // ON is 0xFF00, OFF is 0x0000, anything else is invalid
+            if (quantity != 0xFF00 && quantity != 0x0000) {
+                return exception(response, functionCode, illegalDataValue);
+            }
+            model.coils->set(startAddress, quantity == 0xFF00);
+            return echo(request, response);
+        }
+
+        case 0x06: {// Write Single Register
+            if (!model.holdingRegisters) break;
+            if (startAddress >= model.holdingRegisters->size()) {
+                return exception(response, functionCode, illegalDataAddress);
+            }
+            model.holdingRegisters->setUint16(startAddress, quantity);
+            return echo(request, response);
+        }
+
+        case 0x0F: {// Write Multiple Coils
+            if (!model.coils) break;
+            const uint8_t byteCount = request.size() > 5 ? request[5] : 0;// Number of data bytes
+            if (startAddress + quantity > model.coils->size()) {
+                return exception(response, functionCode, illegalDataAddress);
+            }
+            if (quantity == 0 || quantity > 1968 || byteCount != (quantity + 7) / 8 || request.size() < 6u + byteCount) {
+                return exception(response, functionCode, illegalDataValue);
+            }
+            model.coils->writeRange(startAddress, quantity, request.subspan(6, byteCount));
+            return echo(request, response);
+        }
+
+        case 0x10: {// Write Multiple Registers
+            if (!model.holdingRegisters) break;
+            if (request.size() < 6) {
+                return exception(response, functionCode, illegalDataValue);
+            }
+            if (const auto error = writeRegisters(request, 6, *model.holdingRegisters, startAddress, quantity, 123)) {
+                return exception(response, functionCode, error);
+            }
+            return echo(request, response);
+        }
+
+        case 0x17: {// Read/Write Multiple registers, the write is performed before the read
+            if (!model.holdingRegisters) break;
+            auto& reg = *model.holdingRegisters;
+            if (request.size() < 10) {
+                return exception(response, functionCode, illegalDataValue);
+            }
+            if (startAddress + quantity > reg.size()) {
+                return exception(response, functionCode, illegalDataAddress);
+            }
+            if (quantity == 0 || quantity > 125) {
+                return exception(response, functionCode, illegalDataValue);
+            }
+            if (const auto error = writeRegisters(request, 10, reg, word(request, 5), word(request, 7), 121)) {
+                return exception(response, functionCode, error);
+            }
+            return sendRegisters(functionCode, response, reg, startAddress, quantity);
+        }
+
+        default:
+            break;
+    }
+    return exception(response, functionCode, illegalFunction);
+}
+
+size_t modbus::encodeRead(PduBuffer out, uint8_t functionCode, uint16_t address, uint16_t count) {
+    out[0] = functionCode;
+    putWord(out, 1, address);
+    putWord(out, 3, count);
+    return 5;
+}
+
+size_t modbus::encodeWriteSingle(PduBuffer out, uint8_t functionCode, uint16_t address, uint16_t value) {
+    return encodeRead(out, functionCode, address, value);// same layout
+}
+
+size_t modbus::encodeWriteRegisters(PduBuffer out, uint16_t address, std::span<const uint16_t> values) {
+    if (values.size() > 123) {
+        throw std::invalid_argument("At most 123 registers can be written at once");
+    }
+    out[0] = 0x10;
+    putWord(out, 1, address);
+    putWord(out, 3, static_cast<uint16_t>(values.size()));
+    out[5] = static_cast<uint8_t>(values.size() * 2);// Byte count (2 bytes per register)
+    encode_registers(values, out.subspan(6, values.size() * 2));
+    return 6 + values.size() * 2;
+}
+
+size_t modbus::encodeWriteCoils(PduBuffer out, uint16_t address, const std::vector<bool>& values) {
+    if (values.size() > 1968) {
+        throw std::invalid_argument("At most 1968 coils can be written at once");
+    }
+    const auto byteCount = (values.size() + 7) / 8;
+    out[0] = 0x0F;
+    putWord(out, 1, address);
+    putWord(out, 3, static_cast<uint16_t>(values.size()));
+    out[5] = static_cast<uint8_t>(byteCount);
+    // packed 8 to a byte with the first in the least significant bit
+    std::fill_n(out.begin() + 6, byteCount, 0);
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i]) out[6 + i / 8] |= 1 << i % 8;
+    }
+    return 6 + byteCount;
+}
+
+size_t modbus::encodeReadWriteRegisters(PduBuffer out, uint16_t readAddress, uint16_t readCount, uint16_t writeAddress, std::span<const uint16_t> values) {
+    if (values.size() > 121) {
+        throw std::invalid_argument("At most 121 registers can be written at once");
+    }
+    out[0] = 0x17;
+    putWord(out, 1, readAddress);
+    putWord(out, 3, readCount);
+    putWord(out, 5, writeAddress);
+    putWord(out, 7, static_cast<uint16_t>(values.size()));
+    out[9] = static_cast<uint8_t>(values.size() * 2);
+    encode_registers(values, out.subspan(10, values.size() * 2));
+    return 10 + values.size() * 2;
+}
+
+void modbus::decodeRegisters(std::span<const uint8_t> response, std::span<uint16_t> out) {
+    checkException(response);
+    // function code and byte count, then the data
+    if (response.size() < 2 + out.size() * 2) {
+        throw std::runtime_error("Invalid response size or insufficient data");
+    }
+    if (response[1] != out.size() * 2) {
+        throw std::runtime_error("Byte count mismatch in Modbus response");
+    }
+    decode_registers(response.subspan(2, out.size() * 2), out);
+}
+
+std::vector<uint16_t> modbus::decodeRegisters(std::span<const uint8_t> response, uint16_t count) {
+    std::vector<uint16_t> registers(count);
+    decodeRegisters(response, registers);
+    return registers;
+}
+
+std::vector<bool> modbus::decodeBits(std::span<const uint8_t> response, uint16_t count) {
+    checkException(response);
+    const size_t byteCount = (count + 7) / 8;
+    if (response.size() < 2 + byteCount || response[1] != byteCount) {
+        throw std::runtime_error("Invalid response size or insufficient data");
+    }
+
+    std::vector<bool> bits(count);
+    for (size_t i = 0; i < count; ++i) {
+        bits[i] = response[2 + i / 8] & (1 << i % 8);
+    }
+    return bits;
+}
+
+bool modbus::confirmsWrite(std::span<const uint8_t> response, uint16_t address, uint16_t value) {
+    return response.size() >= 5 && !(response[0] & 0x80) && word(response, 1) == address && word(response, 3) == value;
+}
+
+size_t modbus::rtuRequestSize(std::span<const uint8_t> frame) {
+    if (frame.size() < 2) return 0;
+    switch (frame[1]) {
+        case 0x01:
+        case 0x02:
+        case 0x03:
+        case 0x04:
+        case 0x05:
+        case 0x06:
+            return 8;// unit, function code, address, quantity or value, CRC
+        case 0x0F:
+        case 0x10:
+            return frame.size() < 7 ? 0 : 9 + frame[6];// byte count follows address and quantity
+        case 0x17:
+            return frame.size() < 11 ? 0 : 13 + frame[10];
+        default:
+            throw std::runtime_error("Unsupported Modbus RTU function code " + std::to_string(frame[1]));
+    }
+}
+
+size_t modbus::rtuResponseSize(std::span<const uint8_t> frame) {
+    if (frame.size() < 3) return 0;
+    if (frame[1] & 0x80) return 5;// unit, function code, exception code, CRC
+    switch (frame[1]) {
+        case 0x01:
+        case 0x02:
+        case 0x03:
+        case 0x04:
+        case 0x17:
+            return 5 + frame[2];// byte count follows the function code
+        case 0x05:
+        case 0x06:
+        case 0x0F:
+        case 0x10:
+            return 8;
+        default:
+            throw std::runtime_error("Unsupported Modbus RTU function code " + std::to_string(frame[1]));
+    }
+}
@@ -0,0 +1,65 @@
+
+#ifndef SIMPLE_SOCKET_MODBUS_PDU_HPP
+#define SIMPLE_SOCKET_MODBUS_PDU_HPP
+
+#include "simple_socket/modbus/ModbusServer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// The PDU, a function code followed by its data, is the part of a Modbus message that does not depend on the
+// transport. Modbus TCP puts an MBAP header in front of it, RTU a unit id, with a CRC-16 behind it.
+// Everything here works on PDUs in caller provided buffers, which the transports then frame without copying.
+namespace simple_socket::modbus {
+
+    constexpr size_t maxPduSize = 253;
+
+    using PduBuffer = std::span<uint8_t, maxPduSize>;
+
+    // Server side: handles request, a complete PDU, against model and writes the response PDU to response,
+    // an exception response if the request can not be served. Returns the size of the response.
+    size_t processPdu(std::span<const uint8_t> request, PduBuffer response, const ModbusDataModel& model);
+
+    // Request encoders, each writes a PDU to out and returns its size
+
+    // Read Coils, Discrete Inputs, Holding or Input Registers (0x01 to 0x04)
+    size_t encodeRead(PduBuffer out, uint8_t functionCode, uint16_t address, uint16_t count);
+
+    // Write Single Coil or Register (0x05, 0x06)
+    size_t encodeWriteSingle(PduBuffer out, uint8_t functionCode, uint16_t address, uint16_t value);
+
+    // Write Multiple Registers (0x10)
+    size_t encodeWriteRegisters(PduBuffer out, uint16_t address, std::span<const uint16_t> values);
+
+    // Write Multiple Coils (0x0F)
+    size_t encodeWriteCoils(PduBuffer out, uint16_t address, const std::vector<bool>& values);
+
+    // Read/Write Multiple registers (0x17)
+    size_t encodeReadWriteRegisters(PduBuffer out, uint16_t readAddress, uint16_t readCount, uint16_t writeAddress, std::span<const uint16_t> values);
+
+    // Response decoders, they throw std::runtime_error for exception responses and malformed ones
+
+    std::vector<uint16_t> decodeRegisters(std::span<const uint8_t> response, uint16_t count);
+
+    // As above, decoding out.size() registers into out
+    void decodeRegisters(std::span<const uint8_t> response, std::span<uint16_t> out);
+
+    std::vector<bool> decodeBits(std::span<const uint8_t> response, uint16_t count);
+
+    // Whether response confirms a write, by echoing its address and value (or quantity)
+    bool confirmsWrite(std::span<const uint8_t> response, uint16_t address, uint16_t value);
+
+    // RTU framing: the size of the complete frame starting at frame (unit id first, CRC included),
+    // 0 if more bytes are needed to tell. Throws std::runtime_error for function codes it can not frame.
+    size_t rtuRequestSize(std::span<const uint8_t> frame);
+
+    size_t rtuResponseSize(std::span<const uint8_t> frame);
+
+    // Largest RTU frame: unit id, PDU and CRC
+    constexpr size_t maxRtuFrameSize = 1 + maxPduSize + 2;
+
+}// namespace simple_socket::modbus
+
+#endif//SIMPLE_SOCKET_MODBUS_PDU_HPP
@@ -0,0 +1,129 @@
+
+#include "simple_socket/modbus/ModbusPipeline.hpp"
+
+#include "simple_socket/Socket.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace simple_socket;
+using namespace simple_socket::modbus;
+
+namespace {
+
+    // MBAP header + PDU, the largest ADU Modbus TCP allows
+    constexpr size_t maxAduSize = 260;
+
+}// namespace
+
+Pipeline::Pipeline(ConnectionPool::Lease lease)
+    : lease_(std::move(lease)) {
+
+    reader_ = std::thread([this] { run(); });
+}
+
+void Pipeline::send(std::span<uint8_t> request, Handler handler) {
+    {
+        std::unique_lock lock(mutex_);
+        if (broken_ || pending_.size() >= 0xFFFF) {
+            lock.unlock();
+            handler({}, std::make_exception_ptr(std::runtime_error(broken_ ? "Modbus connection is closed" : "Too many outstanding Modbus requests")));
+            return;
+        }
+
+        while (pending_.count(nextId_)) ++nextId_;
+        const uint16_t transactionID = nextId_++;
+        request[0] = transactionID >> 8;
+        request[1] = transactionID & 0xFF;
+        pending_.emplace(transactionID, std::move(handler));
+    }
+
+    // written outside mutex_, so responses keep being dispatched while a write waits for the socket
+    std::lock_guard lock(writeMutex_);
+    if (!lease_->write(request.data(), request.size())) {
+        shutdown();// the reader then fails everything outstanding, this request included
+    }
+}
+
+bool Pipeline::broken() const {
+    return broken_;
+}
+
+void Pipeline::run() {
+    std::vector<uint8_t> buffer(16 * maxAduSize);
+    size_t begin = 0;
+    size_t end = 0;
+
+    for (;;) {
+        while (end - begin >= 6) {
+            // The MBAP length field counts the bytes following it
+            const size_t length = (buffer[begin + 4] << 8) | buffer[begin + 5];
+            if (length < 2 || 6 + length > maxAduSize) {
+                fail(std::make_exception_ptr(std::runtime_error("Invalid Modbus response length")));
+                return;
+            }
+            if (end - begin < 6 + length) break;
+
+            const std::span<const uint8_t> response(buffer.data() + begin, 6 + length);
+            const uint16_t transactionID = (response[0] << 8) | response[1];
+            begin += response.size();
+
+            Handler handler;
+            {
+                std::lock_guard lock(mutex_);
+                const auto it = pending_.find(transactionID);
+                if (it == pending_.end()) continue;// nobody is waiting for it any more
+                handler = std::move(it->second);
+                pending_.erase(it);
+            }
+            handler(response, nullptr);
+        }
+
+        // keep room for at least one complete ADU at the back
+        if (begin == end) {
+            begin = end = 0;
+        } else if (buffer.size() - end < maxAduSize) {
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+        }
+
+        const auto n = lease_->read(buffer.data() + end, buffer.size() - end);
+        if (n <= 0) {
+            fail(std::make_exception_ptr(std::runtime_error("Modbus connection closed")));
+            return;
+        }
+        end += n;
+    }
+}
+
+void Pipeline::fail(const std::exception_ptr& error) {
+    std::unordered_map<uint16_t, Handler> failed;
+    {
+        std::lock_guard lock(mutex_);
+        broken_ = true;
+        failed.swap(pending_);
+    }
+    for (auto& [transactionID, handler] : failed) {
+        handler({}, error);
+    }
+}
+
+void Pipeline::shutdown() {
+    // wakes up the reader, the connection itself is only closed once it has stopped using it
+    if (const auto native = dynamic_cast<NativeConnection*>(lease_.get())) {
+#ifdef _WIN32
+        ::shutdown(native->nativeHandle(), SD_BOTH);
+#else
+        ::shutdown(native->nativeHandle(), SHUT_RDWR);
+#endif
+    } else {
+        lease_->close();
+    }
+}
+
+Pipeline::~Pipeline() {
+    shutdown();
+    reader_.join();
+    lease_.invalidate();
+}
@@ -0,0 +1,62 @@
+
+#ifndef SIMPLE_SOCKET_MODBUS_PIPELINE_HPP
+#define SIMPLE_SOCKET_MODBUS_PIPELINE_HPP
+
+#include "simple_socket/ConnectionPool.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_socket::modbus {
+
+    // Many outstanding Modbus TCP transactions on one connection. Requests are written as they come,
+    // a reader thread hands each response to the handler of the request with the same transaction ID,
+    // in whatever order the server answers. Reads and writes run concurrently, which the TLS connections of
+    // this library do not support, so a pipeline takes a plain TCP connection.
+    class Pipeline {
+    public:
+        // Called on the reader thread with the complete ADU, or with the error that ended the connection
+        using Handler = std::function<void(std::span<const uint8_t> response, std::exception_ptr error)>;
+
+        explicit Pipeline(ConnectionPool::Lease lease);
+
+        Pipeline(const Pipeline&) = delete;
+        Pipeline& operator=(const Pipeline&) = delete;
+
+        // Sends a request ADU, its transaction ID is written into it here. handler is always called exactly once,
+        // right away if the connection is already broken.
+        void send(std::span<uint8_t> request, Handler handler);
+
+        // True once the connection failed, every request from then on fails
+        [[nodiscard]] bool broken() const;
+
+        // Fails what is still outstanding and closes the connection
+        ~Pipeline();
+
+    private:
+        ConnectionPool::Lease lease_;
+        std::atomic_bool broken_{false};
+
+        std::mutex mutex_;
+        std::unordered_map<uint16_t, Handler> pending_;
+        uint16_t nextId_{1};
+
+        std::mutex writeMutex_;
+
+        std::thread reader_;
+
+        void run();
+        void fail(const std::exception_ptr& error);
+        void shutdown();
+    };
+
+}// namespace simple_socket::modbus
+
+#endif//SIMPLE_SOCKET_MODBUS_PIPELINE_HPP
@@ -0,0 +1,121 @@
+#include "simple_socket/modbus/ModbusReadPlan.hpp"
+
+#include "simple_socket/modbus/ModbusClient.hpp"
+#include "simple_socket/modbus/modbus_helper.hpp"
+
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <stdexcept>
+
+using namespace simple_socket;
+
+namespace {
+
+    ModbusValue decode(ModbusType type, const std::vector<uint16_t>& data, size_t offset) {
+        switch (type) {
+            case ModbusType::Uint16:
+                return data[offset];
+            case ModbusType::Uint32:
+                return decode_uint32(data, offset);
+            case ModbusType::Uint64:
+                return decode_uint64(data, offset);
+            case ModbusType::Float:
+                return decode_float(data, offset);
+            case ModbusType::Double:
+                return decode_double(data, offset);
+        }
+        throw std::invalid_argument("Unknown Modbus type");
+    }
+
+}// namespace
+
+uint16_t simple_socket::registerCount(ModbusType type) {
+    switch (type) {
+        case ModbusType::Uint16:
+            return 1;
+        case ModbusType::Uint32:
+        case ModbusType::Float:
+            return 2;
+        case ModbusType::Uint64:
+        case ModbusType::Double:
+            return 4;
+    }
+    throw std::invalid_argument("Unknown Modbus type");
+}
+
+ModbusReadPlan::ModbusReadPlan(std::vector<ModbusTag> tags, uint16_t gapTolerance)
+    : tags_(std::move(tags)), locations_(tags_.size()) {
+
+    for (const auto& tag : tags_) {
+        if (tag.address + registerCount(tag.type) > 0x10000) {
+            throw std::out_of_range("Modbus tag at " + std::to_string(tag.address) + " extends past the last register");
+        }
+    }
+
+    // by unit, then address, so that neighbours end up next to each other
+    std::vector<size_t> order(tags_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return std::pair(tags_[a].unitId, tags_[a].address) < std::pair(tags_[b].unitId, tags_[b].address);
+    });
+
+    // greedy: a tag joins the current request if it is close enough and the request stays within the limit,
+    // which gives the fewest requests for tags sorted by address
+    size_t end = 0;// one past the last register of the current request
+    for (const auto index : order) {
+        const auto& tag = tags_[index];
+        const size_t tagEnd = tag.address + registerCount(tag.type);
+
+        if (!requests_.empty()) {
+            auto& request = requests_.back();
+            const auto newEnd = std::max(end, tagEnd);
+            if (request.unitId == tag.unitId && tag.address <= end + gapTolerance && newEnd - request.address <= maxRegistersPerRequest) {
+                end = newEnd;
+                request.count = static_cast<uint16_t>(end - request.address);
+                locations_[index] = {requests_.size() - 1, static_cast<uint16_t>(tag.address - request.address)};
+                continue;
+            }
+        }
+
+        requests_.push_back({tag.unitId, tag.address, registerCount(tag.type)});
+        end = tagEnd;
+        locations_[index] = {requests_.size() - 1, 0};
+    }
+}
+
+const std::vector<ModbusTag>& ModbusReadPlan::tags() const {
+    return tags_;
+}
+
+const std::vector<ModbusReadPlan::Request>& ModbusReadPlan::requests() const {
+    return requests_;
+}
+
+std::vector<ModbusValue> ModbusReadPlan::execute(ModbusClient& client) const {
+    std::vector<std::future<std::vector<uint16_t>>> pending;
+    pending.reserve(requests_.size());
+    for (const auto& request : requests_) {
+        pending.push_back(client.read_holding_registers_async(request.address, request.count, request.unitId));
+    }
+
+    // every future is waited for before anything is thrown, none outlives the call
+    std::vector<std::vector<uint16_t>> blocks(pending.size());
+    std::exception_ptr error;
+    for (size_t i = 0; i < pending.size(); ++i) {
+        try {
+            blocks[i] = pending[i].get();
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+
+    std::vector<ModbusValue> values;
+    values.reserve(tags_.size());
+    for (size_t i = 0; i < tags_.size(); ++i) {
+        const auto& location = locations_[i];
+        values.push_back(decode(tags_[i].type, blocks[location.request], location.offset));
+    }
+    return values;
+}
@@ -0,0 +1,147 @@
+
+#include "simple_socket/modbus/ModbusRtuClient.hpp"
+
+#include "simple_socket/modbus/Crc16.hpp"
+#include "simple_socket/modbus/ModbusPdu.hpp"
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <stdexcept>
+
+using namespace simple_socket;
+
+struct ModbusRtuClient::Impl {
+
+    explicit Impl(std::unique_ptr<SimpleConnection> conn)
+        : conn(std::move(conn)) {
+        if (!this->conn) {
+            throw std::invalid_argument("ModbusRtuClient requires a connection");
+        }
+    }
+
+    size_t transact(uint8_t unitId, std::span<const uint8_t> request, std::span<uint8_t> response) {
+        if (request.empty() || request.size() > maxPduSize) {
+            throw std::invalid_argument("Invalid Modbus PDU size");
+        }
+        if (response.size() < maxPduSize) {
+            throw std::invalid_argument("Response buffer must hold at least maxPduSize bytes");
+        }
+
+        std::lock_guard lock(mutex);
+
+        // unit id, PDU and CRC go out in one call, straight from where they are
+        const uint16_t crc = modbus::crc16(request, modbus::crc16(std::span(&unitId, 1)));
+        const std::array<uint8_t, 2> trailer{static_cast<uint8_t>(crc & 0xFF), static_cast<uint8_t>(crc >> 8)};
+        const std::array<std::span<const uint8_t>, 3> frame{std::span<const uint8_t>(&unitId, 1), request, std::span<const uint8_t>(trailer)};
+        if (!conn->writev(frame)) {
+            throw std::runtime_error("Failed to send Modbus RTU request");
+        }
+        if (unitId == 0) return 0;
+
+        const auto reply = receive();
+        if (reply[0] != unitId) {
+            throw std::runtime_error("Modbus RTU response from unexpected unit " + std::to_string(reply[0]));
+        }
+        const auto pdu = reply.subspan(1, reply.size() - 3);
+        std::copy(pdu.begin(), pdu.end(), response.begin());
+        return pdu.size();
+    }
+
+    // Sends request built by encode and hands the response PDU to decode
+    template<typename Encode, typename Decode>
+    auto request(uint8_t unitId, Encode encode, Decode decode) {
+        std::array<uint8_t, maxPduSize> request{};
+        const auto size = encode(modbus::PduBuffer(request));
+
+        std::array<uint8_t, maxPduSize> response{};
+        const auto length = transact(unitId, std::span(request.data(), size), response);
+        return decode(std::span<const uint8_t>(response.data(), length));
+    }
+
+    std::vector<uint16_t> readRegisters(uint8_t functionCode, uint16_t address, uint16_t count, uint8_t unitId) {
+        return request(unitId, [&](modbus::PduBuffer pdu) { return modbus::encodeRead(pdu, functionCode, address, count); },
+                       [&](std::span<const uint8_t> pdu) { return modbus::decodeRegisters(pdu, count); });
+    }
+
+    std::vector<bool> readBits(uint8_t functionCode, uint16_t address, uint16_t count, uint8_t unitId) {
+        return request(unitId, [&](modbus::PduBuffer pdu) { return modbus::encodeRead(pdu, functionCode, address, count); },
+                       [&](std::span<const uint8_t> pdu) { return modbus::decodeBits(pdu, count); });
+    }
+
+    bool writeSingle(uint8_t functionCode, uint16_t address, uint16_t value, uint8_t unitId) {
+        return request(unitId, [&](modbus::PduBuffer pdu) { return modbus::encodeWriteSingle(pdu, functionCode, address, value); },
+                       [&](std::span<const uint8_t> pdu) { return unitId == 0 || modbus::confirmsWrite(pdu, address, value); });
+    }
+
+    bool writeRegisters(uint16_t address, const uint16_t* values, size_t size, uint8_t unitId) {
+        return request(unitId, [&](modbus::PduBuffer pdu) { return modbus::encodeWriteRegisters(pdu, address, std::span(values, size)); },
+                       [&](std::span<const uint8_t> pdu) { return unitId == 0 || modbus::confirmsWrite(pdu, address, static_cast<uint16_t>(size)); });
+    }
+
+private:
+    std::unique_ptr<SimpleConnection> conn;
+    std::mutex mutex;
+    std::array<uint8_t, modbus::maxRtuFrameSize> buffer{};
+
+    // Reads one complete frame. RTU has no length field, it follows from the first bytes of the frame.
+    std::span<const uint8_t> receive() {
+        size_t received = 0;
+        size_t size = 0;
+        while (size == 0 || received < size) {
+            const auto n = conn->read(buffer.data() + received, (size ? size : buffer.size()) - received);
+            if (n <= 0) {
+                throw std::runtime_error("Failed to receive response");
+            }
+            received += n;
+            size = modbus::rtuResponseSize(std::span(buffer.data(), received));
+            if (size > buffer.size()) {
+                throw std::runtime_error("Invalid Modbus RTU response length");
+            }
+        }
+
+        const std::span<const uint8_t> frame(buffer.data(), size);
+        const uint16_t crc = frame[size - 2] | (frame[size - 1] << 8);
+        if (modbus::crc16(frame.first(size - 2)) != crc) {
+            throw std::runtime_error("CRC mismatch in Modbus RTU response");
+        }
+        return frame;
+    }
+};
+
+ModbusRtuClient::ModbusRtuClient(std::unique_ptr<SimpleConnection> conn)
+    : pimpl_(std::make_unique<Impl>(std::move(conn))) {}
+
+std::vector<uint16_t> ModbusRtuClient::read_holding_registers(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->readRegisters(0x03, address, count, unit_id);
+}
+
+std::vector<uint16_t> ModbusRtuClient::read_input_registers(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->readRegisters(0x04, address, count, unit_id);
+}
+
+std::vector<bool> ModbusRtuClient::read_coils(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->readBits(0x01, address, count, unit_id);
+}
+
+std::vector<bool> ModbusRtuClient::read_discrete_inputs(uint16_t address, uint16_t count, uint8_t unit_id) {
+    return pimpl_->readBits(0x02, address, count, unit_id);
+}
+
+bool ModbusRtuClient::write_single_register(uint16_t address, uint16_t value, uint8_t unit_id) {
+    return pimpl_->writeSingle(0x06, address, value, unit_id);
+}
+
+bool ModbusRtuClient::write_multiple_registers(uint16_t address, const uint16_t* values, size_t size, uint8_t unitID) {
+    return pimpl_->writeRegisters(address, values, size, unitID);
+}
+
+bool ModbusRtuClient::write_single_coil(uint16_t address, bool value, uint8_t unit_id) {
+    return pimpl_->writeSingle(0x05, address, value ? 0xFF00 : 0x0000, unit_id);
+}
+
+size_t ModbusRtuClient::transact(uint8_t unitId, std::span<const uint8_t> request, std::span<uint8_t> response) {
+    return pimpl_->transact(unitId, request, response);
+}
+
+ModbusRtuClient::~ModbusRtuClient() = default;
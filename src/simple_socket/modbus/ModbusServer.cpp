@@ -1,178 +1,229 @@
 
 #include "simple_socket/modbus/ModbusServer.hpp"
 
+#include "simple_socket/BufferedConnection.hpp"
+#include "simple_socket/EventLoop.hpp"
 #include "simple_socket/TCPSocket.hpp"
-#include "simple_socket/modbus/HoldingRegister.hpp"
+#include "simple_socket/modbus/Crc16.hpp"
+#include "simple_socket/modbus/ModbusPdu.hpp"
 
+#include <algorithm>
 #include <array>
-#include <iostream>
-#include <thread>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
 
 using namespace simple_socket;
 
 namespace {
 
-    // Send exception response
-    void sendException(SimpleConnection& connection, uint8_t deviceAddress, uint8_t functionCode, uint8_t exceptionCode) {
-        std::array<uint8_t, 3> response{};
-        response[0] = deviceAddress;
-        response[1] = functionCode | 0x80;// Set error flag
-        response[2] = exceptionCode;
+    // Sends a response PDU behind an MBAP header, the transaction and protocol identifiers are sent straight from the request
+    void sendTcpResponse(SimpleConnection& conn, std::span<const uint8_t> request, std::span<const uint8_t> pdu) {
+        const auto length = static_cast<uint16_t>(1 + pdu.size());// Unit Identifier + PDU
+        const std::array<uint8_t, 3> header{
+                static_cast<uint8_t>(length >> 8),  // Length (High)
+                static_cast<uint8_t>(length & 0xFF),// Length (Low)
+                request[6]};                        // Unit Identifier
 
-        connection.write(response);
+        const std::array<std::span<const uint8_t>, 3> response{request.first(4), std::span<const uint8_t>(header), pdu};
+        conn.writev(response);
     }
 
-    void processRequest(SimpleConnection& conn, const std::vector<uint8_t>& request, HoldingRegister& reg) {
-        const int8_t headerSize = 6;
-        const uint8_t functionCode = request[headerSize + 1];
-        const uint16_t startAddress = (request[headerSize + 2] << 8) | request[headerSize + 3];
-        const uint16_t quantity = (request[headerSize + 4] << 8) | request[headerSize + 5];
-
-        switch (functionCode) {
-            case 0x03: {// Read Holding Registers
-                if (startAddress + quantity > reg.size()) {
-                    sendException(conn, request[headerSize + 0], functionCode, 0x02);// Illegal Data Address
-                    return;
-                }
-
-                // Prepare response: MBAP header + PDU
-                std::vector response(request.begin(), request.begin() + 4);
-                const uint16_t length = 3 + (quantity * 2);// Length of PDU
-                response.push_back(length >> 8);           // Length (High)
-                response.push_back(length & 0xFF);         // Length (Low)
-                response.push_back(request[6]);            // Unit Identifier
-
-                // PDU
-                response.push_back(functionCode);// Function Code
-                response.push_back(quantity * 2);// Byte Count
-                // Append register values to the response
-                for (uint16_t i = 0; i < quantity; ++i) {
-                    const uint16_t regValue = reg.getUint16(startAddress + i);
-                    response.push_back(regValue >> 8);
-                    response.push_back(regValue & 0xFF);
-                }
-
-                conn.write(response);
-                break;
-            }
-
-            case 0x06: {// Write Single Register
-                if (startAddress >= reg.size()) {
-                    sendException(conn, request[headerSize + 0], functionCode, 0x02);// Illegal Data Address
-                    return;
-                }
+    // Sends a response PDU as an RTU frame: unit id, PDU, CRC (low byte first)
+    void sendRtuResponse(SimpleConnection& conn, uint8_t unitId, std::span<const uint8_t> pdu) {
+        const uint16_t crc = modbus::crc16(pdu, modbus::crc16(std::span(&unitId, 1)));
+        const std::array<uint8_t, 2> trailer{static_cast<uint8_t>(crc & 0xFF), static_cast<uint8_t>(crc >> 8)};
 
-                const uint16_t valueToWrite = (request[headerSize + 4] << 8) | request[headerSize + 5];
-                reg.setUint16(startAddress, valueToWrite);
-
-                // Echo back the same request as a confirmation
-                const std::vector response(request.begin(), request.end());
-                conn.write(response);
-                break;
-            }
-
-            case 0x10: {// Write Multiple Registers
-                // Extract start address and quantity of registers from the request
-                const uint16_t startAddress = (request[headerSize + 2] << 8) | request[headerSize + 3];
-                const uint16_t quantity = (request[headerSize + 4] << 8) | request[headerSize + 5];
-                const uint8_t byteCount = request[headerSize + 6];// Number of data bytes
-
-                // Check if the request is valid: the quantity of registers should not exceed the register size.
-                if (startAddress + quantity > reg.size() || byteCount != quantity * 2) {
-                    sendException(conn, request[headerSize + 0], functionCode, 0x02);// Illegal Data Address
-                    return;
-                }
-
-                // Write data to the registers
-                for (uint16_t i = 0; i < quantity; ++i) {
-                    uint16_t regValue = (request[headerSize + 7 + (i * 2)] << 8) | request[headerSize + 8 + (i * 2)];
-                    reg.setUint16(startAddress + i, regValue);// Write the value to the register
-                }
-
-                // Prepare response (Echo start address and quantity of registers written)
-                std::vector response(request.begin(), request.begin() + 6);// Copy MBAP header
-                response.push_back(request[headerSize + 1]);               // Unit Identifier
-                response.push_back(functionCode);                          // Function Code
-                response.push_back(startAddress >> 8);                     // Starting Address (High byte)
-                response.push_back(startAddress & 0xFF);                   // Starting Address (Low byte)
-                response.push_back(quantity >> 8);                         // Quantity of Registers (High byte)
-                response.push_back(quantity & 0xFF);                       // Quantity of Registers (Low byte)
-
-                conn.write(response);
-                break;
-            }
+        const std::array<std::span<const uint8_t>, 3> response{std::span<const uint8_t>(&unitId, 1), pdu, std::span<const uint8_t>(trailer)};
+        conn.writev(response);
+    }
 
-            default:
-                sendException(conn, request[0], functionCode, 0x01);// Illegal Function
-                break;
-        }
+    // one listener per loop thread when there are several, the kernel balances connections between them
+    TCPServerOptions serverOptions(size_t numThreads) {
+        TCPServerOptions options;
+        options.reusePort = numThreads > 1;
+        return options;
     }
 
 }// namespace
 
 struct ModbusServer::Impl {
 
-    Impl(uint16_t port, HoldingRegister& reg)
-        : server_(port), register_(&reg) {}
+    Impl(uint16_t port, const ModbusDataModel& model, const ModbusServerOptions& options)
+        : options_(options),
+          loop_(options.numThreads),
+          server_(port, serverOptions(options.numThreads)),
+          model_(model) {}
 
     void start() {
-        thread_ = std::thread([this] {
-            try {
-                while (!stop_) {
-                    auto conn = server_.accept();
-                    clients_.emplace_back(&Impl::clientThread, this, std::move(conn));
-                }
-            } catch (const std::exception&) {}
+        if (options_.idleTimeout > std::chrono::milliseconds::zero()) {
+            for (size_t thread = 0; thread < loop_.size(); ++thread) {
+                scheduleSweep(thread);
+            }
+        }
+        server_.acceptAsync(loop_, [this](std::unique_ptr<SimpleConnection> conn) {
+            onConnection(std::move(conn));
         });
     }
 
     void stop() {
-        stop_ = true;
+        if (stop_.exchange(true)) return;
+
         server_.close();
+        loop_.stop();
+
+        std::lock_guard lck(m_);
+        clients_.clear();
     }
 
-    void clientThread(std::unique_ptr<SimpleConnection> conn) {
+    ~Impl() {
+        stop();
+    }
 
-        std::array<uint8_t, 6> mbap{};
-        std::vector<uint8_t> request;
-        while (!stop_) {
+private:
+    using Clock = std::chrono::steady_clock;
 
-            if (!conn->readExact(mbap)) {
-                std::cerr << "Error reading request or connection closed\n";
-                break;// Exit the loop if there’s an error or the connection is closed
+    struct Client {
+        std::unique_ptr<BufferedConnection> conn;
+        size_t thread;               // loop thread serving the client, the only one touching it
+        Clock::time_point lastActive;
+    };
+
+    // Largest Modbus TCP ADU is 260 bytes, leave room for a few pipelined requests
+    static constexpr size_t bufferSize = 2048;
+
+    ModbusServerOptions options_;
+    EventLoop loop_;
+    TCPServer server_;
+    ModbusDataModel model_;
+
+    std::atomic_bool stop_{false};
+    std::mutex m_;
+    std::unordered_map<Client*, std::unique_ptr<Client>> clients_;
+    size_t nextThread_ = 0;
+
+    void onConnection(std::unique_ptr<SimpleConnection> conn) {
+        auto client = std::make_unique<Client>();
+        Client* c = client.get();
+        {
+            std::lock_guard lck(m_);
+            if (stop_ || clients_.size() >= options_.maxClients) {
+                return;// dropping conn closes it, a client reconnecting in a loop costs nothing but the accept
             }
+            client->conn = std::make_unique<BufferedConnection>(std::move(conn), bufferSize);
+            client->thread = nextThread_++ % loop_.size();
+            client->lastActive = Clock::now();
+            clients_.emplace(c, std::move(client));
+        }
+        loop_.watch(c->conn->next(), [this, c] {
+            c->lastActive = Clock::now();
+            if (!onReadable(*c)) {
+                removeClient(c);
+            }
+        }, c->thread);
+    }
 
-            // Extract the length from the MBAP header (bytes 4 and 5)
-            // Length field specifies the number of bytes following the Unit Identifier
-            const uint16_t length = (mbap[4] << 8) | mbap[5];
+    // Each loop thread checks its own clients, so a client is never removed while its callback runs
+    void scheduleSweep(size_t thread) {
+        const auto interval = std::max(options_.idleTimeout / 4, std::chrono::milliseconds(10));
+        loop_.schedule(interval, [this, thread] {
+            sweep(thread);
+            if (!stop_) scheduleSweep(thread);
+        }, thread);
+    }
 
-            // The total frame length is the 7 bytes MBAP header + the length in MBAP (following Unit Identifier)
-            request.resize(length);// Resize request to fit the full frame (MBAP + Modbus request)
-            conn->readExact(request);
+    void sweep(size_t thread) {
+        const auto deadline = Clock::now() - options_.idleTimeout;
+        std::vector<Client*> idle;
+        {
+            std::lock_guard lck(m_);
+            for (const auto& [c, client] : clients_) {
+                if (client->thread == thread && client->lastActive < deadline) {
+                    idle.push_back(c);
+                }
+            }
+        }
+        for (const auto c : idle) {
+            removeClient(c);
+        }
+    }
 
-            request.insert(request.begin(), mbap.begin(), mbap.end());
-            processRequest(*conn, request, *register_);
+    // Reads what is available with a single syscall and processes every complete frame in the buffer
+    bool onReadable(Client& client) {
+        auto& conn = *client.conn;
+        if (conn.fill() < 0) {
+            return false;// connection closed
         }
+        return options_.framing == ModbusFraming::Tcp ? processTcp(conn) : processRtu(conn);
     }
 
-    ~Impl() {
-        for (auto& client : clients_) {
-            if (client.joinable()) client.join();
+    bool processTcp(BufferedConnection& conn) {
+        std::array<uint8_t, modbus::maxPduSize> response{};
+        while (conn.available() >= 6) {
+            // Length field (MBAP bytes 4 and 5) specifies the number of bytes following it,
+            // so the total frame length is the 6 leading MBAP bytes + length.
+            const auto header = conn.peek(6);
+            const uint16_t length = (header[4] << 8) | header[5];
+            if (length < 2 || length > 254) return false;// malformed, must at least hold unit id and function code
+            if (conn.available() < 6u + length) break;
+
+            const auto request = conn.peek(6 + length);
+            const auto size = modbus::processPdu(request.subspan(7), response, model_);
+            sendTcpResponse(conn, request, std::span(response.data(), size));
+            conn.consume(6 + length);
         }
-        if (thread_.joinable()) thread_.join();
+        return true;
     }
 
-private:
-    TCPServer server_;
-    HoldingRegister* register_;
+    // RTU frames carry no length, it follows from the function code. On a stream a bad frame means
+    // the frames can no longer be told apart, so the connection is dropped.
+    bool processRtu(BufferedConnection& conn) {
+        std::array<uint8_t, modbus::maxPduSize> response{};
+        while (conn.available() >= 2) {
+            size_t size;
+            try {
+                size = modbus::rtuRequestSize(conn.peek(std::min<size_t>(conn.available(), 11)));
+            } catch (const std::exception&) {
+                return false;
+            }
+            if (size == 0 || conn.available() < size) break;
+            if (size > modbus::maxRtuFrameSize) return false;
 
-    std::atomic_bool stop_;
-    std::thread thread_;
-    std::vector<std::thread> clients_;
+            const auto frame = conn.peek(size);
+            const uint16_t crc = frame[size - 2] | (frame[size - 1] << 8);
+            if (modbus::crc16(frame.first(size - 2)) != crc) return false;
+
+            const auto length = modbus::processPdu(frame.subspan(1, size - 3), response, model_);
+            if (frame[0] != 0) {// unit 0 is a broadcast, which is never answered
+                sendRtuResponse(conn, frame[0], std::span(response.data(), length));
+            }
+            conn.consume(size);
+        }
+        return true;
+    }
+
+    void removeClient(Client* client) {
+        loop_.unwatch(client->conn->next());
+
+        std::lock_guard lck(m_);
+        clients_.erase(client);
+    }
 };
 
-ModbusServer::ModbusServer(HoldingRegister& reg, uint16_t port)
-    : pimpl_(std::make_unique<Impl>(port, reg)) {}
+ModbusServer::ModbusServer(HoldingRegister& reg, uint16_t port, size_t numThreads)
+    : ModbusServer(reg, port, ModbusServerOptions{.numThreads = numThreads,
+                                                   .maxClients = std::numeric_limits<size_t>::max(),
+                                                   .idleTimeout = std::chrono::milliseconds::zero()}) {}
+
+ModbusServer::ModbusServer(HoldingRegister& reg, uint16_t port, const ModbusServerOptions& options)
+    : ModbusServer(ModbusDataModel{.holdingRegisters = &reg}, port, options) {}
+
+ModbusServer::ModbusServer(const ModbusDataModel& model, uint16_t port, const ModbusServerOptions& options)
+    : pimpl_(std::make_unique<Impl>(port, model, options)) {}
 
 void ModbusServer::start() {
     pimpl_->start();
@@ -0,0 +1,41 @@
+
+#ifndef SIMPLE_SOCKET_MODBUS_SEQLOCK_HPP
+#define SIMPLE_SOCKET_MODBUS_SEQLOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace simple_socket::modbus {
+
+    // Reader side of a sequence lock. copy loads the protected data with relaxed atomics and is repeated
+    // until no write overlapped it.
+    template<typename Copy>
+    void seqlockRead(const std::atomic<uint64_t>& sequence, Copy copy) {
+        for (;;) {
+            const auto before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();// let the writer finish, it may share our CPU
+                continue;
+            }
+            copy();
+            // the copy must be complete before the sequence is checked again
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) return;
+        }
+    }
+
+    // Writer side, the caller makes sure there is only one writer at a time. write stores with relaxed atomics.
+    template<typename Write>
+    void seqlockWrite(std::atomic<uint64_t>& sequence, Write write) {
+        const auto before = sequence.load(std::memory_order_relaxed);
+        sequence.store(before + 1, std::memory_order_relaxed);
+        // readers that see any of the new values also see the odd sequence
+        std::atomic_thread_fence(std::memory_order_release);
+        write();
+        sequence.store(before + 2, std::memory_order_release);
+    }
+
+}// namespace simple_socket::modbus
+
+#endif//SIMPLE_SOCKET_MODBUS_SEQLOCK_HPP
@@ -0,0 +1,100 @@
+
+#include "simple_socket/shm/NamedSemaphore.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <thread>
+#endif
+
+using namespace simple_socket::shm;
+
+#ifdef _WIN32
+
+NamedSemaphore::NamedSemaphore(const std::string& name)
+    : handle_(CreateSemaphore(nullptr, 0, 1, name.c_str())) {
+
+    if (!handle_) {
+        throw std::runtime_error("Failed to open semaphore '" + name + "'");
+    }
+}
+
+void NamedSemaphore::wait() {
+    WaitForSingleObject(handle_, INFINITE);
+}
+
+bool NamedSemaphore::waitFor(std::chrono::milliseconds timeout) {
+    return WaitForSingleObject(handle_, static_cast<DWORD>(timeout.count())) == WAIT_OBJECT_0;
+}
+
+void NamedSemaphore::post() {
+    ReleaseSemaphore(handle_, 1, nullptr);
+}
+
+void NamedSemaphore::remove(const std::string&) {}
+
+NamedSemaphore::~NamedSemaphore() {
+    CloseHandle(handle_);
+}
+
+#else
+
+namespace {
+    sem_t* sem(void* handle) {
+        return static_cast<sem_t*>(handle);
+    }
+}// namespace
+
+NamedSemaphore::NamedSemaphore(const std::string& name)
+    : handle_(sem_open(("/" + name).c_str(), O_CREAT, 0666, 0)) {
+
+    if (handle_ == SEM_FAILED) {
+        throw std::runtime_error("Failed to open semaphore '" + name + "'");
+    }
+}
+
+void NamedSemaphore::wait() {
+    while (sem_wait(sem(handle_)) == -1 && errno == EINTR) {}
+}
+
+bool NamedSemaphore::waitFor(std::chrono::milliseconds timeout) {
+#ifdef __APPLE__
+    // no sem_timedwait on macOS
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (sem_trywait(sem(handle_)) == -1) {
+        if (std::chrono::steady_clock::now() >= deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+#else
+    timespec deadline{};
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    const auto ns = deadline.tv_nsec + std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+    deadline.tv_sec += static_cast<time_t>(ns / 1000000000);
+    deadline.tv_nsec = static_cast<long>(ns % 1000000000);
+
+    int result;
+    while ((result = sem_timedwait(sem(handle_), &deadline)) == -1 && errno == EINTR) {}
+    return result == 0;
+#endif
+}
+
+void NamedSemaphore::post() {
+    sem_post(sem(handle_));
+}
+
+void NamedSemaphore::remove(const std::string& name) {
+    sem_unlink(("/" + name).c_str());
+}
+
+NamedSemaphore::~NamedSemaphore() {
+    sem_close(sem(handle_));
+}
+
+#endif
@@ -0,0 +1,39 @@
+
+#ifndef SIMPLE_SOCKET_NAMED_SEMAPHORE_HPP
+#define SIMPLE_SOCKET_NAMED_SEMAPHORE_HPP
+
+#include <chrono>
+#include <string>
+
+namespace simple_socket::shm {
+
+    // Counting semaphore shared between processes by name, created with a count of 0 if it does not exist.
+    // Only used to sleep and wake: callers always re-check the shared state after waking, so stray counts
+    // left behind by an earlier run are harmless.
+    class NamedSemaphore {
+    public:
+        // Throws std::runtime_error if the semaphore can not be opened
+        explicit NamedSemaphore(const std::string& name);
+
+        NamedSemaphore(const NamedSemaphore&) = delete;
+        NamedSemaphore& operator=(const NamedSemaphore&) = delete;
+
+        void wait();
+
+        // Returns false if the timeout expired first
+        bool waitFor(std::chrono::milliseconds timeout);
+
+        void post();
+
+        // Removes the name, the semaphore lives on until the last handle is closed. A no-op on Windows.
+        static void remove(const std::string& name);
+
+        ~NamedSemaphore();
+
+    private:
+        void* handle_;// HANDLE / sem_t*
+    };
+
+}// namespace simple_socket::shm
+
+#endif//SIMPLE_SOCKET_NAMED_SEMAPHORE_HPP
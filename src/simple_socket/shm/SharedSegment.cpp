@@ -0,0 +1,263 @@
+
+#include "simple_socket/shm/SharedSegment.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <vector>
+#endif
+
+using namespace simple_socket;
+using namespace simple_socket::shm;
+
+namespace {
+
+    constexpr size_t defaultHugePageSize = 2 * 1024 * 1024;
+
+    size_t roundUp(size_t size, size_t multiple) {
+        return (size + multiple - 1) / multiple * multiple;
+    }
+
+    // Faults in every page up front. Only the creator writes, before anyone else can look at the segment.
+    void touchPages(uint8_t* data, size_t size, size_t pageSize, bool write) {
+        for (size_t i = 0; i < size; i += pageSize) {
+            volatile auto* p = data + i;
+            if (write) {
+                *p = *p;
+            } else {
+                (void) *p;
+            }
+        }
+    }
+
+#ifdef _WIN32
+    std::string lastError() {
+        return "error " + std::to_string(GetLastError());
+    }
+
+    size_t pageSize() {
+        SYSTEM_INFO info{};
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+    }
+
+    // Large pages need SeLockMemoryPrivilege, which has to be granted to the account and enabled in the token
+    bool enableLockMemoryPrivilege() {
+        HANDLE token;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+
+        TOKEN_PRIVILEGES privileges{};
+        privileges.PrivilegeCount = 1;
+        privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+        bool ok = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+                  AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+                  GetLastError() == ERROR_SUCCESS;
+        CloseHandle(token);
+        return ok;
+    }
+
+#ifndef FILE_MAP_LARGE_PAGES
+#define FILE_MAP_LARGE_PAGES 0x20000000
+#endif
+#else
+    std::string lastError() {
+        return std::strerror(errno);
+    }
+
+    size_t pageSize() {
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+
+#ifdef __linux__
+    size_t hugePageSize(const std::string& directory) {
+        struct statfs fs {};
+        if (statfs(directory.c_str(), &fs) == 0 && fs.f_bsize > 0) {
+            return static_cast<size_t>(fs.f_bsize);
+        }
+        return defaultHugePageSize;
+    }
+
+    // mbind(2) through the raw syscall, so there is no dependency on libnuma
+    bool bindToNode(void* addr, size_t size, int node) {
+        constexpr int mpolBind = 2;
+        constexpr unsigned mpolMfMove = 1 << 1;
+        constexpr size_t bits = sizeof(unsigned long) * 8;
+
+        std::vector<unsigned long> mask(node / bits + 1);
+        mask[node / bits] |= 1UL << (node % bits);
+        return syscall(SYS_mbind, addr, size, mpolBind, mask.data(), mask.size() * bits + 1, mpolMfMove) == 0;
+    }
+
+    std::string hugePagePath(const std::string& directory, const std::string& name) {
+        return directory + "/" + (name.starts_with('/') ? name.substr(1) : name);
+    }
+#endif
+
+}// namespace
+
+SharedSegment::SharedSegment(const std::string& name, size_t size, const SharedMemoryOptions& options)
+    : name_(name), owner_(true) {
+
+    map(size, options);
+}
+
+SharedSegment::SharedSegment(const std::string& name, const SharedMemoryOptions& options)
+    : name_(name), owner_(false) {
+
+    map(0, options);
+}
+
+void SharedSegment::map(size_t size, const SharedMemoryOptions& options) {
+#ifdef _WIN32
+    if (owner_) {
+        DWORD protect = PAGE_READWRITE;
+        if (options.hugePages) {
+            const auto largePage = GetLargePageMinimum();
+            if (largePage == 0 || !enableLockMemoryPrivilege()) {
+                fail("Large pages (which need SeLockMemoryPrivilege) are not available for");
+            }
+            protect |= SEC_COMMIT | SEC_LARGE_PAGES;
+            size = roundUp(size, largePage);
+        }
+        const auto high = static_cast<DWORD>(static_cast<uint64_t>(size) >> 32);
+        const auto low = static_cast<DWORD>(size);
+        mapping_ = options.numaNode >= 0
+                           ? CreateFileMappingNuma(INVALID_HANDLE_VALUE, nullptr, protect, high, low, name_.c_str(), static_cast<DWORD>(options.numaNode))
+                           : CreateFileMapping(INVALID_HANDLE_VALUE, nullptr, protect, high, low, name_.c_str());
+    } else {
+        mapping_ = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, name_.c_str());
+    }
+    if (!mapping_) fail("Failed to open");
+
+    DWORD access = FILE_MAP_ALL_ACCESS;
+    if (owner_ && options.hugePages) access |= FILE_MAP_LARGE_PAGES;
+    data_ = static_cast<uint8_t*>(options.numaNode >= 0
+                                          ? MapViewOfFileExNuma(mapping_, access, 0, 0, size, nullptr, static_cast<DWORD>(options.numaNode))
+                                          : MapViewOfFile(mapping_, access, 0, 0, size));
+    if (!data_) fail("Failed to map");
+
+    if (size == 0) {
+        MEMORY_BASIC_INFORMATION info{};
+        VirtualQuery(data_, &info, sizeof(info));
+        size = info.RegionSize;
+    }
+#else
+#ifdef __linux__
+    if (options.hugePages && !options.hugePageDirectory.empty()) {
+        // hugetlbfs: every page of the file is a huge page
+        path_ = hugePagePath(options.hugePageDirectory, name_);
+        if (owner_) size = roundUp(size, hugePageSize(options.hugePageDirectory));
+        fd_ = ::open(path_.c_str(), owner_ ? O_CREAT | O_RDWR : O_RDWR, 0666);
+    } else
+#endif
+    {
+        if (options.hugePages) size = roundUp(size, defaultHugePageSize);
+        fd_ = shm_open(name_.c_str(), owner_ ? O_CREAT | O_RDWR : O_RDWR, 0666);
+    }
+    if (fd_ == -1) fail("Failed to open");
+
+    if (owner_) {
+        if (ftruncate(fd_, static_cast<off_t>(size)) == -1) fail("Failed to size");
+    } else {
+        struct stat st {};
+        if (fstat(fd_, &st) == -1) fail("Failed to stat");
+        size = static_cast<size_t>(st.st_size);
+    }
+    if (size == 0) {
+        errno = EINVAL;
+        fail("Failed to map empty");
+    }
+
+    int flags = MAP_SHARED;
+#ifdef __linux__
+    // pages must not be faulted in before they are bound to the node, place() populates them afterwards
+    if (options.populate && !(owner_ && options.numaNode >= 0)) flags |= MAP_POPULATE;
+#endif
+    const auto addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, fd_, 0);
+    if (addr == MAP_FAILED) fail("Failed to map");
+    data_ = static_cast<uint8_t*>(addr);
+#endif
+    size_ = size;
+
+    place(options);
+}
+
+void SharedSegment::place(const SharedMemoryOptions& options) {
+#ifdef _WIN32
+    if (options.populate) touchPages(data_, size_, pageSize(), owner_);
+
+    if (options.lockMemory) {
+        // VirtualLock is limited by the minimum working set size
+        SIZE_T minimum, maximum;
+        if (GetProcessWorkingSetSize(GetCurrentProcess(), &minimum, &maximum)) {
+            SetProcessWorkingSetSize(GetCurrentProcess(), minimum + size_, maximum + size_);
+        }
+        if (!VirtualLock(data_, size_)) fail("Failed to lock");
+    }
+#else
+#ifdef __linux__
+    if (options.hugePages && path_.empty()) {
+        // no hugetlbfs, ask for transparent huge pages instead (honoured when shmem_enabled allows it)
+        madvise(data_, size_, MADV_HUGEPAGE);
+    }
+    if (owner_ && options.numaNode >= 0) {
+        if (!bindToNode(data_, size_, options.numaNode)) fail("Failed to bind NUMA node " + std::to_string(options.numaNode) + " to");
+        if (options.populate) touchPages(data_, size_, pageSize(), true);
+    }
+#else
+    if (options.hugePages || options.numaNode >= 0) {
+        errno = ENOTSUP;
+        fail("Huge pages and NUMA binding are not supported for");
+    }
+    if (options.populate) touchPages(data_, size_, pageSize(), owner_);
+#endif
+    if (options.lockMemory && mlock(data_, size_) == -1) fail("Failed to lock");
+#endif
+}
+
+void SharedSegment::fail(const std::string& what) {
+    const auto message = what + " shared memory segment '" + name_ + "': " + lastError();
+    close();
+    throw std::runtime_error(message);
+}
+
+void SharedSegment::close() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    mapping_ = nullptr;
+#else
+    if (data_) munmap(data_, size_);
+    if (fd_ != -1) {
+        ::close(fd_);
+        if (owner_) {
+            if (path_.empty()) {
+                shm_unlink(name_.c_str());
+            } else {
+                ::unlink(path_.c_str());
+            }
+        }
+    }
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+SharedSegment::~SharedSegment() {
+    close();
+}
@@ -0,0 +1,58 @@
+
+#ifndef SIMPLE_SOCKET_SHARED_SEGMENT_HPP
+#define SIMPLE_SOCKET_SHARED_SEGMENT_HPP
+
+#include "simple_socket/SharedMemoryConnection.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace simple_socket::shm {
+
+    // A named shared memory mapping, placed according to SharedMemoryOptions (huge pages, prefaulting,
+    // locking, NUMA binding). Throws std::runtime_error if the segment can not be created or mapped as asked.
+    class SharedSegment {
+    public:
+        // Creates the segment, at least size bytes. It is removed again when this object closes.
+        SharedSegment(const std::string& name, size_t size, const SharedMemoryOptions& options);
+
+        // Opens and maps the whole of an existing segment
+        SharedSegment(const std::string& name, const SharedMemoryOptions& options);
+
+        SharedSegment(const SharedSegment&) = delete;
+        SharedSegment& operator=(const SharedSegment&) = delete;
+
+        [[nodiscard]] uint8_t* data() const {
+            return data_;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return size_;
+        }
+
+        void close();
+
+        ~SharedSegment();
+
+    private:
+        std::string name_;
+        bool owner_;
+        uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+
+#ifdef _WIN32
+        void* mapping_ = nullptr;
+#else
+        int fd_ = -1;
+        std::string path_;// set for hugetlbfs backed segments, which live outside of shm_open's namespace
+#endif
+
+        void map(size_t size, const SharedMemoryOptions& options);
+        void place(const SharedMemoryOptions& options);
+        void fail(const std::string& what);
+    };
+
+}// namespace simple_socket::shm
+
+#endif//SIMPLE_SOCKET_SHARED_SEGMENT_HPP
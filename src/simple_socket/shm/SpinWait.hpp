@@ -0,0 +1,54 @@
+
+#ifndef SIMPLE_SOCKET_SPIN_WAIT_HPP
+#define SIMPLE_SOCKET_SPIN_WAIT_HPP
+
+#include "simple_socket/SharedMemoryConnection.hpp"
+
+#include <cstddef>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+#include <intrin.h>
+#endif
+
+namespace simple_socket::shm {
+
+    // Tells the core we are in a spin loop: saves power, and on x86 avoids the memory order
+    // mis-speculation penalty when the awaited store finally lands.
+    inline void cpuRelax() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+        __yield();
+#elif defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        asm volatile("yield");
+#endif
+    }
+
+    // Polls ready() as the policy dictates. Returns true once it succeeds, or false when the policy says
+    // it is time to block instead (Block right away, SpinThenBlock after spinCount polls).
+    // Spin and SpinThenYield never give up.
+    template<typename Ready>
+    bool spinWait(WaitPolicy policy, size_t spinCount, Ready&& ready) {
+        if (ready()) return true;
+        if (policy == WaitPolicy::Block) return false;
+
+        for (size_t i = 0;; ++i) {
+            if (i < spinCount || policy == WaitPolicy::Spin) {
+                cpuRelax();
+            } else if (policy == WaitPolicy::SpinThenYield) {
+                std::this_thread::yield();
+            } else {
+                return false;
+            }
+            if (ready()) return true;
+        }
+    }
+
+}// namespace simple_socket::shm
+
+#endif//SIMPLE_SOCKET_SPIN_WAIT_HPP
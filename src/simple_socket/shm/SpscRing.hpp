@@ -0,0 +1,130 @@
+
+#ifndef SIMPLE_SOCKET_SPSC_RING_HPP
+#define SIMPLE_SOCKET_SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace simple_socket::shm {
+
+    inline constexpr size_t cacheLineSize = 64;
+
+    constexpr size_t alignToCacheLine(size_t size) {
+        return (size + cacheLineSize - 1) & ~(cacheLineSize - 1);
+    }
+
+    // Lives in shared memory. Each index sits on its own cache line, so the producer and the consumer only
+    // share a line when one of them actually needs to look at the other's progress.
+    struct RingControl {
+        alignas(cacheLineSize) std::atomic<uint64_t> head;         // next write position, written by the producer only
+        alignas(cacheLineSize) std::atomic<uint64_t> tail;         // next read position, written by the consumer only
+        alignas(cacheLineSize) std::atomic<uint32_t> readerWaiting;// set by a consumer about to block on an empty ring
+        alignas(cacheLineSize) std::atomic<uint32_t> writerWaiting;// set by a producer about to block on a full ring
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory rings need lock-free 64 bit atomics");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared memory rings need lock-free 32 bit atomics");
+
+    // Single-producer/single-consumer ring of variable length records, each one an 8 byte size followed by the payload,
+    // padded to a cache line. head and tail grow monotonically, a record starts at position % capacity and is always
+    // contiguous: the data area has room for one extra record past capacity, so a record never wraps and can be
+    // handed out as a plain span. One SpscRing object is used per side, it caches the other side's index so the
+    // shared cache line is only read when the cached value says the ring is full (producer) or empty (consumer).
+    class SpscRing {
+    public:
+        static constexpr size_t recordHeaderSize = sizeof(uint64_t);
+
+        SpscRing(RingControl* control, uint8_t* data, uint64_t capacity, size_t maxMessageSize)
+            : control_(control), data_(data), capacity_(capacity), maxMessageSize_(maxMessageSize),
+              head_(control->head.load(std::memory_order_relaxed)), tail_(control->tail.load(std::memory_order_relaxed)) {}
+
+        static constexpr size_t recordSize(size_t size) {
+            return alignToCacheLine(recordHeaderSize + size);
+        }
+
+        // Bytes needed for the data area of a ring that holds slots messages of maxMessageSize
+        static constexpr size_t capacityFor(size_t maxMessageSize, size_t slots) {
+            return recordSize(maxMessageSize) * slots;
+        }
+
+        static constexpr size_t dataSize(uint64_t capacity, size_t maxMessageSize) {
+            return capacity + recordSize(maxMessageSize);
+        }
+
+        [[nodiscard]] size_t maxMessageSize() const {
+            return maxMessageSize_;
+        }
+
+        [[nodiscard]] RingControl& control() const {
+            return *control_;
+        }
+
+        // Producer: room for a message of size bytes, or nullptr if the ring is too full right now
+        uint8_t* tryAcquire(size_t size) {
+            if (size > maxMessageSize_) return nullptr;
+
+            const auto needed = recordSize(size);
+            if (head_ - tail_ + needed > capacity_) {
+                tail_ = control_->tail.load(std::memory_order_acquire);
+                if (head_ - tail_ + needed > capacity_) return nullptr;
+            }
+            return data_ + (head_ % capacity_) + recordHeaderSize;
+        }
+
+        // Producer: publishes the message written into the buffer returned by the last tryAcquire.
+        // size may be smaller than what was acquired.
+        void commit(size_t size) {
+            const uint64_t recordHeader = size;
+            std::memcpy(data_ + (head_ % capacity_), &recordHeader, recordHeaderSize);
+            head_ += recordSize(size);
+            control_->head.store(head_, std::memory_order_release);
+        }
+
+        // Consumer: the oldest unread message, or an empty span if there is none.
+        // Stays valid until release().
+        std::span<const uint8_t> tryPeek() {
+            if (tail_ == head_) {
+                head_ = control_->head.load(std::memory_order_acquire);
+                if (tail_ == head_) return {};
+            }
+            const auto record = data_ + (tail_ % capacity_);
+            uint64_t size;
+            std::memcpy(&size, record, recordHeaderSize);
+            return {record + recordHeaderSize, static_cast<size_t>(size)};
+        }
+
+        // Consumer: frees the message returned by tryPeek
+        void release(size_t size) {
+            tail_ += recordSize(size);
+            control_->tail.store(tail_, std::memory_order_release);
+        }
+
+        // Full re-read of the producer's index, used right before deciding to block
+        [[nodiscard]] bool empty() {
+            head_ = control_->head.load(std::memory_order_acquire);
+            return tail_ == head_;
+        }
+
+        // Full re-read of the consumer's index, used right before deciding to block
+        [[nodiscard]] bool full(size_t size) {
+            tail_ = control_->tail.load(std::memory_order_acquire);
+            return head_ - tail_ + recordSize(size) > capacity_;
+        }
+
+    private:
+        RingControl* control_;
+        uint8_t* data_;
+        uint64_t capacity_;
+        size_t maxMessageSize_;
+
+        // local copies: our own index, and the last value seen of the peer's
+        uint64_t head_;
+        uint64_t tail_;
+    };
+
+}// namespace simple_socket::shm
+
+#endif//SIMPLE_SOCKET_SPSC_RING_HPP
@@ -11,10 +11,14 @@
 #include <ws2def.h>
 #else
 #include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
-#include <netdb.h>
 using SOCKET = int;
 #define INVALID_SOCKET (SOCKET)(~0)
 #define SOCKET_ERROR (-1)
@@ -46,6 +50,57 @@ namespace simple_socket {
         }
     }
 
+    // Ends both directions of a connection without closing the socket, whoever reads it then sees it closed
+    inline void shutdownSocket(SOCKET socket) {
+#ifdef _WIN32
+        shutdown(socket, SD_BOTH);
+#else
+        shutdown(socket, SHUT_RDWR);
+#endif
+    }
+
+    // Flags for send(): writing to a peer that went away fails rather than raising SIGPIPE, where the platform allows
+#ifdef MSG_NOSIGNAL
+    constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+    constexpr int sendFlags = 0;
+#endif
+
+    // Helper: put socket into (or out of) non-blocking mode
+    inline void set_nonblocking(SOCKET s, bool enable = true) {
+#ifdef _WIN32
+        u_long mode = enable ? 1 : 0;
+        ioctlsocket(s, FIONBIO, &mode);
+#else
+        int flags = fcntl(s, F_GETFL, 0);
+        if (flags >= 0) fcntl(s, F_SETFL, enable ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+#endif
+    }
+
+    // True if the last failed socket call would have blocked on a non-blocking socket
+    inline bool wouldBlock() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+
+    // Blocks until the socket is readable (or writable), or until timeoutMs has passed (-1 waits forever).
+    inline bool waitFor(SOCKET s, bool writable, int timeoutMs = -1) {
+#ifdef _WIN32
+        WSAPOLLFD pfd{s, static_cast<SHORT>(writable ? POLLWRNORM : POLLRDNORM), 0};
+        return WSAPoll(&pfd, 1, timeoutMs) > 0;
+#else
+        pollfd pfd{s, static_cast<short>(writable ? POLLOUT : POLLIN), 0};
+        int rc;
+        do {
+            rc = ::poll(&pfd, 1, timeoutMs);
+        } while (rc < 0 && errno == EINTR);
+        return rc > 0;
+#endif
+    }
+
 }// namespace simple_socket
 
 #endif//SIMPLE_SOCKET_COMMON_HPP
@@ -0,0 +1,251 @@
+
+#include "simple_socket/tcp/Connect.hpp"
+
+#include "simple_socket/SocketTuning.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <thread>
+
+using namespace simple_socket;
+using namespace simple_socket::tcp;
+
+namespace {
+
+    bool parseNumeric(std::string host, Endpoint& endpoint) {
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+
+        auto& v4 = reinterpret_cast<sockaddr_in&>(endpoint.address);
+        if (inet_pton(AF_INET, host.c_str(), &v4.sin_addr) == 1) {
+            v4.sin_family = AF_INET;
+            endpoint.length = sizeof(sockaddr_in);
+            return true;
+        }
+        auto& v6 = reinterpret_cast<sockaddr_in6&>(endpoint.address);
+        if (inet_pton(AF_INET6, host.c_str(), &v6.sin6_addr) == 1) {
+            v6.sin6_family = AF_INET6;
+            endpoint.length = sizeof(sockaddr_in6);
+            return true;
+        }
+        return false;
+    }
+
+    // Blocking getaddrinfo, interleaving the families of the results
+    std::vector<Endpoint> getAddresses(const std::string& host) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_ADDRCONFIG;// no IPv6 attempts on hosts without IPv6
+
+        addrinfo* res = nullptr;
+        if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res) {
+            return {};
+        }
+
+        std::vector<Endpoint> first, second;
+        for (const addrinfo* ai = res; ai; ai = ai->ai_next) {
+            if ((ai->ai_family != AF_INET && ai->ai_family != AF_INET6) || ai->ai_addrlen > sizeof(sockaddr_storage)) continue;
+
+            Endpoint endpoint;
+            std::memcpy(&endpoint.address, ai->ai_addr, ai->ai_addrlen);
+            endpoint.length = static_cast<socklen_t>(ai->ai_addrlen);
+            (first.empty() || first.front().family() == ai->ai_family ? first : second).push_back(endpoint);
+        }
+        freeaddrinfo(res);
+
+        std::vector<Endpoint> endpoints;
+        for (size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+            if (i < first.size()) endpoints.push_back(first[i]);
+            if (i < second.size()) endpoints.push_back(second[i]);
+        }
+        return endpoints;
+    }
+
+    bool connectInProgress() {
+#ifdef _WIN32
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EINPROGRESS;
+#endif
+    }
+
+#ifdef _WIN32
+    using PollFd = WSAPOLLFD;
+#else
+    using PollFd = pollfd;
+#endif
+
+    int pollFds(std::vector<PollFd>& fds, int timeoutMs) {
+#ifdef _WIN32
+        return WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeoutMs);
+#else
+        int rc;
+        do {
+            rc = ::poll(fds.data(), fds.size(), timeoutMs);
+        } while (rc < 0 && errno == EINTR);
+        return rc;
+#endif
+    }
+
+}// namespace
+
+void Endpoint::setPort(uint16_t port) {
+    if (family() == AF_INET6) {
+        reinterpret_cast<sockaddr_in6&>(address).sin6_port = htons(port);
+    } else {
+        reinterpret_cast<sockaddr_in&>(address).sin_port = htons(port);
+    }
+}
+
+std::vector<Endpoint> tcp::resolve(const std::string& host, uint16_t port, Clock::time_point deadline) {
+    auto future = resolveAsync(host, port);
+    if (future.wait_until(deadline) != std::future_status::ready) return {};
+    return future.get();
+}
+
+std::future<std::vector<Endpoint>> tcp::resolveAsync(const std::string& host, uint16_t port) {
+    std::promise<std::vector<Endpoint>> result;
+    auto future = result.get_future();
+
+    std::vector<Endpoint> endpoints(1);
+    if (parseNumeric(host, endpoints.front())) {
+        endpoints.front().setPort(port);
+        result.set_value(std::move(endpoints));
+        return future;
+    }
+
+    std::thread([host, port, result = std::move(result)]() mutable {
+        auto endpoints = getAddresses(host);
+        for (auto& endpoint : endpoints) {
+            endpoint.setPort(port);
+        }
+        result.set_value(std::move(endpoints));
+    }).detach();
+    return future;
+}
+
+Attempt tcp::startConnect(const Endpoint& endpoint, const SocketOptions& options) {
+    const SOCKET sock = socket(endpoint.family(), SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET) return {};
+
+    applySocketOptions(sock, options, SocketKind::TcpClient);
+
+    set_nonblocking(sock);
+    if (::connect(sock, reinterpret_cast<const sockaddr*>(&endpoint.address), endpoint.length) == 0) {
+        return {sock, true};
+    }
+    if (connectInProgress()) {
+        return {sock, false};
+    }
+    closeSocket(sock);
+    return {};
+}
+
+bool tcp::connectSucceeded(SOCKET sock) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    return getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len) == 0 && error == 0;
+}
+
+SOCKET tcp::connectAny(const std::vector<Endpoint>& endpoints, std::chrono::milliseconds attemptDelay, Clock::time_point deadline, const SocketOptions& options) {
+    std::vector<SOCKET> pending;
+    std::vector<PollFd> fds;
+    SOCKET winner = INVALID_SOCKET;
+    size_t next = 0;
+    auto nextStart = Clock::now();
+
+    while (winner == INVALID_SOCKET) {
+        const auto now = Clock::now();
+        if (now >= deadline) break;
+
+        if (next < endpoints.size() && (now >= nextStart || pending.empty())) {
+            const auto attempt = startConnect(endpoints[next++], options);
+            if (attempt.connected) {
+                winner = attempt.sock;
+            } else if (attempt.sock != INVALID_SOCKET) {
+                pending.push_back(attempt.sock);
+                nextStart = now + attemptDelay;
+            }
+            continue;
+        }
+        if (pending.empty()) break;
+
+        const auto wakeUp = next < endpoints.size() ? std::min(nextStart, deadline) : deadline;
+        const auto timeout = std::chrono::ceil<std::chrono::milliseconds>(wakeUp - now);
+
+        fds.clear();
+        for (const auto sock : pending) {
+            fds.push_back({sock, POLLOUT, 0});
+        }
+        if (pollFds(fds, static_cast<int>(timeout.count())) <= 0) continue;
+
+        for (size_t i = fds.size(); i-- > 0;) {
+            if (fds[i].revents == 0) continue;
+
+            if (winner == INVALID_SOCKET && connectSucceeded(pending[i])) {
+                winner = pending[i];
+            } else {
+                closeSocket(pending[i]);
+                nextStart = now;// a failed attempt hands over right away
+            }
+            pending.erase(pending.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+    }
+
+    for (const auto sock : pending) {
+        closeSocket(sock);
+    }
+    if (winner != INVALID_SOCKET) {
+        set_nonblocking(winner, false);
+    }
+    return winner;
+}
+
+std::vector<Endpoint> DnsCache::lookup(const std::string& host, uint16_t port, Clock::time_point deadline) {
+    if (auto endpoints = find(host, port)) {
+        return std::move(*endpoints);
+    }
+
+    // resolved without the lock, so lookups of different hosts run in parallel
+    auto endpoints = resolve(host, port, deadline);
+    insert(host, endpoints);
+    return endpoints;
+}
+
+std::optional<std::vector<Endpoint>> DnsCache::find(const std::string& host, uint16_t port) {
+    if (Endpoint numeric; parseNumeric(host, numeric)) {
+        numeric.setPort(port);
+        return std::vector{numeric};
+    }
+
+    std::lock_guard lock(mutex_);
+    const auto it = entries_.find(host);
+    if (it == entries_.end() || it->second.expires <= Clock::now()) return std::nullopt;
+
+    auto endpoints = it->second.endpoints;
+    for (auto& endpoint : endpoints) {
+        endpoint.setPort(port);
+    }
+    return endpoints;
+}
+
+void DnsCache::insert(const std::string& host, const std::vector<Endpoint>& endpoints) {
+    if (endpoints.empty()) return;
+
+    std::lock_guard lock(mutex_);
+    entries_[host] = Entry{endpoints, Clock::now() + ttl_};
+}
+
+void DnsCache::invalidate(const std::string& host) {
+    std::lock_guard lock(mutex_);
+    entries_.erase(host);
+}
+
+void DnsCache::clear() {
+    std::lock_guard lock(mutex_);
+    entries_.clear();
+}
@@ -0,0 +1,91 @@
+
+#ifndef SIMPLE_SOCKET_TCP_CONNECT_HPP
+#define SIMPLE_SOCKET_TCP_CONNECT_HPP
+
+#include "simple_socket/SocketOptions.hpp"
+#include "simple_socket/socket_common.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace simple_socket::tcp {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Endpoint {
+        sockaddr_storage address{};
+        socklen_t length{0};
+
+        [[nodiscard]] int family() const {
+            return address.ss_family;
+        }
+
+        void setPort(uint16_t port);
+    };
+
+    // Resolves host, a name or a numeric IPv4/IPv6 address, to stream endpoints. Names are resolved on a separate
+    // thread so that a hanging resolver can not hold the caller past deadline. Returns an empty list on failure.
+    // The addresses are ordered as RFC 8305 asks: alternating between families, starting with the resolver's first.
+    std::vector<Endpoint> resolve(const std::string& host, uint16_t port, Clock::time_point deadline);
+
+    // As resolve, without waiting. The resolver thread is left to finish on its own if the result is not waited for.
+    std::future<std::vector<Endpoint>> resolveAsync(const std::string& host, uint16_t port);
+
+    // A connect started on a fresh non-blocking socket with options applied. sock is INVALID_SOCKET if it failed
+    // right away, connected is set if it completed right away, otherwise the socket turns writable once it is over.
+    struct Attempt {
+        SOCKET sock{INVALID_SOCKET};
+        bool connected{false};
+    };
+
+    Attempt startConnect(const Endpoint& endpoint, const SocketOptions& options);
+
+    // Whether the connect of an attempt that turned writable succeeded
+    bool connectSucceeded(SOCKET sock);
+
+    // Connects to the first endpoint that accepts, RFC 8305 style: each attempt gets a head start of attemptDelay
+    // before the next address is tried in parallel, a failed attempt starts the next one right away.
+    // Each socket gets options before it connects.
+    // Returns a blocking, connected socket, or INVALID_SOCKET if every attempt failed or deadline passed.
+    SOCKET connectAny(const std::vector<Endpoint>& endpoints, std::chrono::milliseconds attemptDelay, Clock::time_point deadline, const SocketOptions& options = {});
+
+    // Thread safe cache of resolved addresses, keyed by host name. Numeric addresses are not cached.
+    class DnsCache {
+    public:
+        explicit DnsCache(std::chrono::seconds ttl)
+            : ttl_(ttl) {}
+
+        // Cached endpoints for host, with port applied, resolving on a miss
+        std::vector<Endpoint> lookup(const std::string& host, uint16_t port, Clock::time_point deadline);
+
+        // As lookup, without resolving: nothing if host is neither numeric nor cached
+        std::optional<std::vector<Endpoint>> find(const std::string& host, uint16_t port);
+
+        // Caches what resolving host returned, nothing if it failed
+        void insert(const std::string& host, const std::vector<Endpoint>& endpoints);
+
+        // Drops host, typically after none of its addresses could be reached
+        void invalidate(const std::string& host);
+
+        void clear();
+
+    private:
+        struct Entry {
+            std::vector<Endpoint> endpoints;
+            Clock::time_point expires;
+        };
+
+        std::chrono::seconds ttl_;
+        std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries_;
+    };
+
+}// namespace simple_socket::tcp
+
+#endif//SIMPLE_SOCKET_TCP_CONNECT_HPP
@@ -0,0 +1,202 @@
+
+#ifdef SIMPLE_SOCKET_WITH_TLS
+
+#include "simple_socket/tcp/TlsClient.hpp"
+
+#include <openssl/err.h>
+
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace simple_socket;
+using namespace simple_socket::tcp;
+
+namespace {
+
+    // Sessions per host:port, most recent at the back. Owned by the SSL_CTX, so it is still there when a
+    // connection that outlived its TCPClientContext receives a ticket.
+    class SessionStore {
+    public:
+        // Keeps a few, parallel connections to the same host each need a TLS 1.3 ticket of their own
+        static constexpr size_t maxPerHost = 4;
+
+        void put(const std::string& key, SSL_SESSION* session) {
+            std::lock_guard lock(mutex_);
+            auto& sessions = sessions_[key];
+            sessions.push_back(session);
+            if (sessions.size() > maxPerHost) {
+                SSL_SESSION_free(sessions.front());
+                sessions.pop_front();
+            }
+        }
+
+        // A session to resume, to be freed by the caller, or nullptr
+        SSL_SESSION* take(const std::string& key) {
+            std::lock_guard lock(mutex_);
+            const auto it = sessions_.find(key);
+            if (it == sessions_.end()) return nullptr;
+
+            auto& sessions = it->second;
+            while (!sessions.empty()) {
+                SSL_SESSION* session = sessions.back();
+                if (!SSL_SESSION_is_resumable(session) || expired(session)) {
+                    SSL_SESSION_free(session);
+                    sessions.pop_back();
+                    continue;
+                }
+                if (SSL_SESSION_get_protocol_version(session) < TLS1_3_VERSION) {
+                    // TLS 1.2 sessions may be resumed any number of times
+                    SSL_SESSION_up_ref(session);
+                } else {
+                    sessions.pop_back();// tickets are single use, the resumed connection receives new ones
+                }
+                return session;
+            }
+            return nullptr;
+        }
+
+        void remove(const std::string& key) {
+            std::lock_guard lock(mutex_);
+            const auto it = sessions_.find(key);
+            if (it == sessions_.end()) return;
+
+            for (const auto session : it->second) {
+                SSL_SESSION_free(session);
+            }
+            sessions_.erase(it);
+        }
+
+        void clear() {
+            std::lock_guard lock(mutex_);
+            for (const auto& [key, sessions] : sessions_) {
+                for (const auto session : sessions) {
+                    SSL_SESSION_free(session);
+                }
+            }
+            sessions_.clear();
+        }
+
+        ~SessionStore() {
+            clear();
+        }
+
+    private:
+        std::mutex mutex_;
+        std::unordered_map<std::string, std::deque<SSL_SESSION*>> sessions_;
+
+        static bool expired(const SSL_SESSION* session) {
+            return SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) <= std::time(nullptr);
+        }
+    };
+
+    void freeStore(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+        delete static_cast<SessionStore*>(ptr);
+    }
+
+    void freeKey(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*) {
+        delete static_cast<std::string*>(ptr);
+    }
+
+    // where the SessionStore hangs off the SSL_CTX
+    int storeIndex() {
+        static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, freeStore);
+        return index;
+    }
+
+    // where the host:port key hangs off each SSL
+    int keyIndex() {
+        static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, freeKey);
+        return index;
+    }
+
+    SessionStore* storeOf(SSL_CTX* ctx) {
+        return static_cast<SessionStore*>(SSL_CTX_get_ex_data(ctx, storeIndex()));
+    }
+
+    // Called by OpenSSL for every session the server hands out, during the handshake (TLS 1.2)
+    // or whenever a ticket is read afterwards (TLS 1.3)
+    int onNewSession(SSL* ssl, SSL_SESSION* session) {
+        const auto key = static_cast<const std::string*>(SSL_get_ex_data(ssl, keyIndex()));
+        const auto store = storeOf(SSL_get_SSL_CTX(ssl));
+        if (!key || !store) return 0;
+
+        store->put(*key, session);
+        return 1;// the store keeps the reference
+    }
+
+}// namespace
+
+TlsClient::TlsClient()
+    : ctx_(SSL_CTX_new(TLS_client_method())) {
+
+    if (!ctx_) {
+        throw std::runtime_error("Failed to create SSL_CTX");
+    }
+    SSL_CTX_set_ex_data(ctx_, storeIndex(), new SessionStore());
+
+    // sessions are looked up by host:port here, OpenSSL's own cache is keyed by session id, which is of no use to a client
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx_, onNewSession);
+}
+
+std::unique_ptr<SimpleConnection> TlsClient::handshake(SOCKET sock, const std::string& host, uint16_t port, bool kernelTLS) {
+    SSL* ssl = newSsl(sock, host, port, kernelTLS);
+    if (!ssl) return nullptr;
+
+    if (SSL_connect(ssl) <= 0) {
+        ERR_print_errors_fp(stderr);
+        failed(host, port);
+        SSL_free(ssl);
+        closeSocket(sock);
+        return nullptr;
+    }
+    return std::make_unique<TLSConnection>(sock, ssl);
+}
+
+std::unique_ptr<TLSConnection> TlsClient::prepare(SOCKET sock, const std::string& host, uint16_t port, bool kernelTLS) {
+    SSL* ssl = newSsl(sock, host, port, kernelTLS);
+    if (!ssl) return nullptr;
+
+    SSL_set_connect_state(ssl);
+    return std::make_unique<TLSConnection>(sock, ssl);
+}
+
+void TlsClient::failed(const std::string& host, uint16_t port) {
+    storeOf(ctx_)->remove(host + ":" + std::to_string(port));
+}
+
+SSL* TlsClient::newSsl(SOCKET sock, const std::string& host, uint16_t port, bool kernelTLS) {
+    SSL* ssl = SSL_new(ctx_);
+    if (!ssl) {
+        closeSocket(sock);
+        return nullptr;
+    }
+
+    const auto key = host + ":" + std::to_string(port);
+    SSL_set_ex_data(ssl, keyIndex(), new std::string(key));
+    SSL_set_fd(ssl, static_cast<int>(sock));
+    SSL_set_tlsext_host_name(ssl, host.c_str());
+    if (kernelTLS) {
+        requestKernelTLS(ssl);
+    }
+
+    if (SSL_SESSION* session = storeOf(ctx_)->take(key)) {
+        SSL_set_session(ssl, session);
+        SSL_SESSION_free(session);
+    }
+    return ssl;
+}
+
+void TlsClient::clearSessions() {
+    storeOf(ctx_)->clear();
+}
+
+TlsClient::~TlsClient() {
+    // connections still open hold their own reference
+    SSL_CTX_free(ctx_);
+}
+
+#endif
@@ -0,0 +1,58 @@
+
+#ifndef SIMPLE_SOCKET_TCP_TLS_CLIENT_HPP
+#define SIMPLE_SOCKET_TCP_TLS_CLIENT_HPP
+
+#ifdef SIMPLE_SOCKET_WITH_TLS
+
+#include "simple_socket/SimpleConnection.hpp"
+#include "simple_socket/Socket.hpp"
+#include "simple_socket/socket_common.hpp"
+
+#include <openssl/ssl.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace simple_socket::tcp {
+
+    // The client side TLS state shared by the connections of a TCPClientContext: one SSL_CTX, and the sessions
+    // servers handed out, kept per host:port so that reconnecting takes an abbreviated handshake.
+    // TLS 1.3 tickets arrive after the handshake and are single use, a connection only leaves one behind
+    // once it has read from the server.
+    class TlsClient {
+    public:
+        TlsClient();
+
+        TlsClient(const TlsClient&) = delete;
+        TlsClient& operator=(const TlsClient&) = delete;
+
+        // Runs the client handshake on a connected, blocking socket, resuming a cached session if there is one.
+        // Takes ownership of sock, returns nullptr (with sock closed) if the handshake failed.
+        // With kernelTLS, the record layer is moved into the kernel afterwards where possible.
+        std::unique_ptr<SimpleConnection> handshake(SOCKET sock, const std::string& host, uint16_t port, bool kernelTLS);
+
+        // As handshake, without running it: the returned connection is non-blocking and in connect state,
+        // for TLSConnection::continueHandshake to step through. Report a handshake that failed to failed.
+        std::unique_ptr<TLSConnection> prepare(SOCKET sock, const std::string& host, uint16_t port, bool kernelTLS);
+
+        // Drops the sessions of host:port, a resumption attempt may be what the server objected to
+        void failed(const std::string& host, uint16_t port);
+
+        void clearSessions();
+
+        ~TlsClient();
+
+    private:
+        SSL_CTX* ctx_;
+
+        // An SSL for sock, set up to resume a cached session of host:port if there is one.
+        // nullptr (with sock closed) if none could be created.
+        SSL* newSsl(SOCKET sock, const std::string& host, uint16_t port, bool kernelTLS);
+    };
+
+}// namespace simple_socket::tcp
+
+#endif
+
+#endif//SIMPLE_SOCKET_TCP_TLS_CLIENT_HPP
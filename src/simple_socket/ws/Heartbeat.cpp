@@ -0,0 +1,130 @@
+
+#include "simple_socket/ws/Heartbeat.hpp"
+
+#include "simple_socket/TimerWheel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace simple_socket;
+
+struct Heartbeat::Impl: std::enable_shared_from_this<Impl> {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        uint64_t id;
+        uint32_t pingTicks;
+        uint32_t pongTicks;
+    };
+
+    // The timers of one loop thread
+    struct Wheel {
+        std::mutex m;
+        TimerWheel<Entry> timers;
+        Clock::time_point start;// the time of tick 0
+        bool ticking = false;
+        // only touched by the loop thread
+        std::vector<Entry> due;
+        std::vector<std::pair<uint32_t, Entry>> rearm;// with the ticks until they are next due
+    };
+
+    Impl(EventLoop& loop, std::chrono::milliseconds tick, Check check)
+        : loop(loop), tick(std::max(tick, std::chrono::milliseconds(1))), check(std::move(check)) {
+        for (size_t i = 0; i < loop.size(); ++i) {
+            wheels.push_back(std::make_unique<Wheel>());
+        }
+    }
+
+    void watch(uint64_t id, const HeartbeatOptions& options) {
+        const auto thread = loop.currentThread().value_or(next++ % wheels.size());
+        const Entry entry{id, ticks(options.pingInterval), ticks(options.pongTimeout)};
+
+        auto& wheel = *wheels[thread];
+        std::lock_guard lck(wheel.m);
+        wheel.timers.add(entry.pingTicks, entry);
+        if (!wheel.ticking) {
+            // resumes the clock of the wheel where it stopped
+            wheel.ticking = true;
+            wheel.start = Clock::now() - tick * static_cast<int64_t>(wheel.timers.now());
+            arm(thread);
+        }
+    }
+
+    // Runs on the loop thread, every tick while the wheel has timers
+    void advance(size_t thread) {
+        auto& wheel = *wheels[thread];
+        {
+            std::lock_guard lck(wheel.m);
+            const auto target = static_cast<uint64_t>((Clock::now() - wheel.start) / tick);
+            while (wheel.timers.now() < target) {
+                wheel.timers.tick([&](Entry entry) { wheel.due.push_back(entry); });
+            }
+        }
+
+        // outside the lock, a check sends pings and shuts connections down
+        auto& rearm = wheel.rearm;
+        rearm.clear();
+        for (const auto& entry : wheel.due) {
+            // Alive ones are counted from now rather than from when something last arrived, so a peer gone
+            // quiet is pinged after between one and two intervals
+            switch (check(entry.id).value_or(Liveness::Dead)) {
+                case Liveness::Alive:
+                    rearm.emplace_back(entry.pingTicks, entry);
+                    break;
+                case Liveness::Pinged:
+                    rearm.emplace_back(entry.pongTicks, entry);
+                    break;
+                case Liveness::Dead:
+                    break;
+            }
+        }
+
+        std::lock_guard lck(wheel.m);
+        for (const auto& [ticks, entry] : rearm) {
+            wheel.timers.add(ticks, entry);
+        }
+        wheel.due.clear();
+        if (wheel.timers.empty()) {
+            wheel.ticking = false;
+        } else {
+            arm(thread);
+        }
+    }
+
+    EventLoop& loop;
+    const std::chrono::milliseconds tick;
+    const Check check;
+    std::vector<std::unique_ptr<Wheel>> wheels;
+    std::atomic_size_t next{0};
+
+private:
+    uint32_t ticks(std::chrono::milliseconds duration) const {
+        const auto n = (duration + tick - std::chrono::milliseconds(1)) / tick;
+        return static_cast<uint32_t>(std::clamp<int64_t>(n, 1, UINT32_MAX));
+    }
+
+    // Requires the lock of the wheel
+    void arm(size_t thread) {
+        auto& wheel = *wheels[thread];
+        const auto at = wheel.start + tick * static_cast<int64_t>(wheel.timers.now() + 1);
+        const auto delay = std::chrono::ceil<std::chrono::milliseconds>(at - Clock::now());
+        loop.schedule(std::max(delay, std::chrono::milliseconds(1)), [self = shared_from_this(), thread] {
+            self->advance(thread);
+        }, thread);
+    }
+};
+
+Heartbeat::Heartbeat(EventLoop& loop, std::chrono::milliseconds tick, Check check)
+    : pimpl_(std::make_shared<Impl>(loop, tick, std::move(check))) {}
+
+void Heartbeat::watch(uint64_t id, const HeartbeatOptions& options) {
+    pimpl_->watch(id, options);
+}
+
+std::chrono::milliseconds Heartbeat::tickFor(const HeartbeatOptions& options) {
+    const auto shortest = std::min(options.pingInterval, options.pongTimeout);
+    return std::clamp(shortest / 8, std::chrono::milliseconds(1), std::chrono::milliseconds(1000));
+}
@@ -0,0 +1,47 @@
+
+#ifndef SIMPLE_SOCKET_HEARTBEAT_HPP
+#define SIMPLE_SOCKET_HEARTBEAT_HPP
+
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/WebSocket.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace simple_socket {
+
+    // What a connection whose heartbeat is due has heard from its peer
+    enum class Liveness {
+        Alive, // something arrived since the last check
+        Pinged,// nothing did, a ping has now been sent
+        Dead   // not even an answer to the ping
+    };
+
+    // Times the heartbeat of many connections with a TimerWheel per thread of an EventLoop, advanced by a single
+    // loop timer that only runs while there are connections to watch. Connections are known by id alone and are
+    // looked up when due, so there is nothing to cancel when one closes.
+    class Heartbeat {
+    public:
+        // Checks the connection with the given id on the loop thread it is due on, empty if it is gone
+        using Check = std::function<std::optional<Liveness>(uint64_t id)>;
+
+        Heartbeat(EventLoop& loop, std::chrono::milliseconds tick, Check check);
+
+        // Checks the connection every options.pingInterval while it is Alive, after options.pongTimeout once
+        // Pinged, and stops once it is Dead or gone. On a loop thread, the connection is timed by that thread.
+        void watch(uint64_t id, const HeartbeatOptions& options);
+
+        // A tick fine enough to time options, and coarse enough not to wake the loop for nothing
+        static std::chrono::milliseconds tickFor(const HeartbeatOptions& options);
+
+    private:
+        struct Impl;
+        std::shared_ptr<Impl> pimpl_;// shared with the loop timers
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_HEARTBEAT_HPP
@@ -0,0 +1,103 @@
+
+#include "simple_socket/ws/HttpRequestParser.hpp"
+
+#include <algorithm>
+
+using namespace simple_socket;
+
+namespace {
+
+    constexpr std::string_view endOfHead = "\r\n\r\n";
+
+    char lower(char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    bool isWhitespace(char c) {
+        return c == ' ' || c == '\t';
+    }
+
+    std::string_view trim(std::string_view s) {
+        while (!s.empty() && isWhitespace(s.front())) s.remove_prefix(1);
+        while (!s.empty() && isWhitespace(s.back())) s.remove_suffix(1);
+        return s;
+    }
+
+    // Splits off everything up to delim, which is dropped. The rest if there is no delim.
+    std::string_view next(std::string_view& s, std::string_view delim) {
+        const auto pos = s.find(delim);
+        const auto part = s.substr(0, pos);
+        s = pos == std::string_view::npos ? std::string_view() : s.substr(pos + delim.size());
+        return part;
+    }
+
+}// namespace
+
+bool simple_socket::equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+        return lower(x) == lower(y);
+    });
+}
+
+HttpRequestParser::Result HttpRequestParser::parse(std::string_view data, size_t maxSize) {
+    if (size_ > 0) return Result::Complete;
+
+    // the end may straddle what was scanned before and the new bytes
+    const auto from = scanned_ < endOfHead.size() ? 0 : scanned_ - (endOfHead.size() - 1);
+    const auto pos = data.find(endOfHead, from);
+    if (pos == std::string_view::npos) {
+        scanned_ = data.size();
+        return data.size() > maxSize ? Result::Invalid : Result::Incomplete;
+    }
+
+    const auto size = pos + endOfHead.size();
+    if (size > maxSize) return Result::Invalid;
+
+    const auto result = parseHead(data.substr(0, pos));
+    if (result == Result::Complete) size_ = size;
+    return result;
+}
+
+HttpRequestParser::Result HttpRequestParser::parseHead(std::string_view head) {
+    auto requestLine = next(head, "\r\n");
+    method_ = next(requestLine, " ");
+    target_ = next(requestLine, " ");
+    if (method_.empty() || target_.empty() || requestLine.substr(0, 5) != "HTTP/") return Result::Invalid;
+
+    count_ = 0;
+    while (!head.empty()) {
+        const auto line = next(head, "\r\n");
+        const auto colon = line.find(':');
+        // obsolete line folding starts with whitespace, and names have none either
+        if (colon == std::string_view::npos || colon == 0 || isWhitespace(line.front())) return Result::Invalid;
+        if (count_ == maxHeaders) return Result::Invalid;
+
+        const auto name = line.substr(0, colon);
+        if (std::any_of(name.begin(), name.end(), isWhitespace)) return Result::Invalid;
+        headers_[count_++] = {name, trim(line.substr(colon + 1))};
+    }
+    return Result::Complete;
+}
+
+std::optional<std::string_view> HttpRequestParser::header(std::string_view name) const {
+    for (const auto& h : headers()) {
+        if (equalsIgnoreCase(h.name, name)) return h.value;
+    }
+    return std::nullopt;
+}
+
+bool HttpRequestParser::hasToken(std::string_view name, std::string_view token) const {
+    for (const auto& h : headers()) {
+        if (!equalsIgnoreCase(h.name, name)) continue;
+
+        auto values = h.value;
+        while (!values.empty()) {
+            if (equalsIgnoreCase(trim(next(values, ",")), token)) return true;
+        }
+    }
+    return false;
+}
+
+void HttpRequestParser::reset() {
+    *this = {};
+}
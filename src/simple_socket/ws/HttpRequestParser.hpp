@@ -0,0 +1,78 @@
+
+#ifndef SIMPLE_SOCKET_HTTP_REQUEST_PARSER_HPP
+#define SIMPLE_SOCKET_HTTP_REQUEST_PARSER_HPP
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace simple_socket {
+
+    // Incremental parser for the head of an HTTP/1.1 request (request line and headers), as sent to upgrade to a
+    // WebSocket. Nothing is copied or allocated: the request line and headers are views into the bytes last passed
+    // to parse(), valid as long as those are.
+    class HttpRequestParser {
+    public:
+        enum class Result {
+            Incomplete,
+            Complete,
+            Invalid// malformed, too long or too many headers
+        };
+
+        struct Header {
+            std::string_view name;
+            std::string_view value;// without surrounding whitespace
+        };
+
+        static constexpr size_t maxHeaders = 64;
+
+        // data is everything received so far: what was passed before, followed by any new bytes. Only the new bytes
+        // are searched for the end of the head. Heads longer than maxSize are Invalid.
+        Result parse(std::string_view data, size_t maxSize);
+
+        // Of the head, including the empty line ending it, once Complete
+        [[nodiscard]] size_t size() const {
+            return size_;
+        }
+
+        [[nodiscard]] std::string_view method() const {
+            return method_;
+        }
+
+        [[nodiscard]] std::string_view target() const {
+            return target_;
+        }
+
+        [[nodiscard]] std::span<const Header> headers() const {
+            return {headers_.data(), count_};
+        }
+
+        // The first header called name, which is matched case-insensitively
+        [[nodiscard]] std::optional<std::string_view> header(std::string_view name) const;
+
+        // Whether any header called name lists token (case-insensitive) among its comma separated values,
+        // e.g. "Connection: keep-alive, Upgrade"
+        [[nodiscard]] bool hasToken(std::string_view name, std::string_view token) const;
+
+        void reset();
+
+    private:
+        size_t scanned_ = 0;// bytes searched for the end of the head
+        size_t size_ = 0;
+
+        std::string_view method_;
+        std::string_view target_;
+        std::array<Header, maxHeaders> headers_{};
+        size_t count_ = 0;
+
+        Result parseHead(std::string_view head);
+    };
+
+    // ASCII case-insensitive comparison, as for HTTP header names and tokens
+    bool equalsIgnoreCase(std::string_view a, std::string_view b);
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_HTTP_REQUEST_PARSER_HPP
@@ -0,0 +1,353 @@
+
+#include "simple_socket/ws/PerMessageDeflate.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <stdexcept>
+
+#ifdef SIMPLE_SOCKET_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace simple_socket;
+
+namespace {
+
+    std::string_view trim(std::string_view s) {
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) s.remove_prefix(1);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) s.remove_suffix(1);
+        return s;
+    }
+
+    bool iequals(std::string_view a, std::string_view b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y) {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    std::vector<std::string_view> split(std::string_view s, char delim) {
+        std::vector<std::string_view> parts;
+        size_t start = 0;
+        for (;;) {
+            const auto pos = s.find(delim, start);
+            parts.emplace_back(trim(s.substr(start, pos - start)));
+            if (pos == std::string_view::npos) break;
+            start = pos + 1;
+        }
+        return parts;
+    }
+
+    // zlib cannot produce raw deflate streams with a 256 byte window, so 9 is the smallest we compress with
+    int clampWindowBits(int bits) {
+        return std::clamp(bits, 9, 15);
+    }
+
+    std::optional<int> parseWindowBits(std::string_view value) {
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.substr(1, value.size() - 2);
+        }
+        if (value.empty() || value.size() > 2 || !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            return std::nullopt;
+        }
+        const int bits = std::stoi(std::string(value));
+        if (bits < 8 || bits > 15) return std::nullopt;
+        return bits;
+    }
+
+    struct Extension {
+        bool serverNoContextTakeover{false};
+        bool clientNoContextTakeover{false};
+        std::optional<int> serverMaxWindowBits;
+        bool clientMaxWindowBitsPresent{false};
+        std::optional<int> clientMaxWindowBits;
+    };
+
+    // Parses "permessage-deflate; param[=value]; ...", std::nullopt if it is another extension or has invalid parameters
+    std::optional<Extension> parseExtension(std::string_view extension) {
+        const auto params = split(extension, ';');
+        if (!iequals(params.front(), "permessage-deflate")) return std::nullopt;
+
+        Extension result;
+        bool seen[4]{};
+        for (size_t i = 1; i < params.size(); ++i) {
+            const auto eq = params[i].find('=');
+            const auto name = trim(params[i].substr(0, eq));
+            const auto value = eq == std::string_view::npos ? std::optional<std::string_view>() : trim(params[i].substr(eq + 1));
+
+            if (iequals(name, "server_no_context_takeover")) {
+                if (value || seen[0]) return std::nullopt;
+                seen[0] = result.serverNoContextTakeover = true;
+            } else if (iequals(name, "client_no_context_takeover")) {
+                if (value || seen[1]) return std::nullopt;
+                seen[1] = result.clientNoContextTakeover = true;
+            } else if (iequals(name, "server_max_window_bits")) {
+                if (!value || seen[2]) return std::nullopt;
+                result.serverMaxWindowBits = parseWindowBits(*value);
+                if (!result.serverMaxWindowBits) return std::nullopt;
+                seen[2] = true;
+            } else if (iequals(name, "client_max_window_bits")) {
+                if (seen[3]) return std::nullopt;
+                if (value) {
+                    result.clientMaxWindowBits = parseWindowBits(*value);
+                    if (!result.clientMaxWindowBits) return std::nullopt;
+                }
+                seen[3] = result.clientMaxWindowBitsPresent = true;
+            } else {
+                return std::nullopt;
+            }
+        }
+        return result;
+    }
+
+    constexpr uint8_t deflateTail[4] = {0x00, 0x00, 0xff, 0xff};
+
+}// namespace
+
+namespace simple_socket {
+
+    bool deflateSupported() {
+#ifdef SIMPLE_SOCKET_WITH_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    std::string extensionsHeader(std::string_view headers) {
+        constexpr std::string_view name = "sec-websocket-extensions:";
+
+        std::string result;
+        size_t pos = headers.find("\r\n");
+        while (pos != std::string_view::npos) {
+            pos += 2;
+            const auto end = headers.find("\r\n", pos);
+            const auto line = headers.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+            if (line.size() > name.size() && iequals(line.substr(0, name.size()), name)) {
+                if (!result.empty()) result += ", ";
+                result += trim(line.substr(name.size()));
+            }
+            pos = end;
+        }
+        return result;
+    }
+
+    std::optional<DeflateParams> negotiateDeflate(std::string_view offers, const PerMessageDeflateOptions& options) {
+        if (offers.empty()) return std::nullopt;
+
+        for (const auto& offer : split(offers, ',')) {
+            const auto extension = parseExtension(offer);
+            if (!extension) continue;
+
+            DeflateParams params;
+            params.serverNoContextTakeover = extension->serverNoContextTakeover || options.serverNoContextTakeover;
+            params.clientNoContextTakeover = extension->clientNoContextTakeover || options.clientNoContextTakeover;
+
+            params.serverMaxWindowBits = clampWindowBits(options.serverMaxWindowBits);
+            if (extension->serverMaxWindowBits) {
+                if (*extension->serverMaxWindowBits < 9) continue;// can't honour it, try the next offer
+                params.serverMaxWindowBits = std::min(params.serverMaxWindowBits, *extension->serverMaxWindowBits);
+            }
+
+            // the server may only limit the client's window if the client said it supports that
+            if (extension->clientMaxWindowBitsPresent) {
+                params.clientMaxWindowBits = std::min(clampWindowBits(options.clientMaxWindowBits), extension->clientMaxWindowBits.value_or(15));
+            }
+
+            return params;
+        }
+        return std::nullopt;
+    }
+
+    std::string deflateResponse(const DeflateParams& params) {
+        std::string response = "permessage-deflate";
+        if (params.serverNoContextTakeover) response += "; server_no_context_takeover";
+        if (params.clientNoContextTakeover) response += "; client_no_context_takeover";
+        if (params.serverMaxWindowBits < 15) response += "; server_max_window_bits=" + std::to_string(params.serverMaxWindowBits);
+        if (params.clientMaxWindowBits < 15) response += "; client_max_window_bits=" + std::to_string(params.clientMaxWindowBits);
+        return response;
+    }
+
+    std::string deflateOffer(const PerMessageDeflateOptions& options) {
+        std::string offer = "permessage-deflate; client_max_window_bits";
+        const auto clientBits = clampWindowBits(options.clientMaxWindowBits);
+        if (clientBits < 15) offer += "=" + std::to_string(clientBits);
+        const auto serverBits = clampWindowBits(options.serverMaxWindowBits);
+        if (serverBits < 15) offer += "; server_max_window_bits=" + std::to_string(serverBits);
+        if (options.serverNoContextTakeover) offer += "; server_no_context_takeover";
+        if (options.clientNoContextTakeover) offer += "; client_no_context_takeover";
+        return offer;
+    }
+
+    std::optional<DeflateParams> parseDeflateResponse(std::string_view extensions, const PerMessageDeflateOptions& options) {
+        if (extensions.empty()) return std::nullopt;
+
+        const auto accepted = split(extensions, ',');
+        const auto extension = accepted.size() == 1 ? parseExtension(accepted.front()) : std::nullopt;
+        if (!extension || (extension->clientMaxWindowBitsPresent && !extension->clientMaxWindowBits)) {
+            throw std::runtime_error("Server accepted extensions that were not offered: " + std::string(extensions));
+        }
+
+        DeflateParams params;
+        params.serverNoContextTakeover = extension->serverNoContextTakeover;
+        params.clientNoContextTakeover = extension->clientNoContextTakeover || options.clientNoContextTakeover;
+        params.serverMaxWindowBits = extension->serverMaxWindowBits.value_or(15);
+        params.clientMaxWindowBits = extension->clientMaxWindowBits.value_or(clampWindowBits(options.clientMaxWindowBits));
+        return params;
+    }
+
+}// namespace simple_socket
+
+#ifdef SIMPLE_SOCKET_WITH_ZLIB
+
+struct PerMessageDeflate::Impl {
+
+    Impl(const DeflateParams& params, bool isServer, const PerMessageDeflateOptions& options)
+        : sendWindowBits(isServer ? params.serverMaxWindowBits : params.clientMaxWindowBits),
+          sendNoContextTakeover(isServer ? params.serverNoContextTakeover : params.clientNoContextTakeover),
+          receiveNoContextTakeover(isServer ? params.clientNoContextTakeover : params.serverNoContextTakeover),
+          minSize(options.minCompressSize) {
+
+        // With a window of 8 bits negotiated, messages are simply sent uncompressed
+        if (sendWindowBits >= 9) {
+            if (deflateInit2(&deflater, options.compressionLevel, Z_DEFLATED, -sendWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                throw std::runtime_error("Failed to initialize deflate");
+            }
+            deflaterReady = true;
+        }
+        // a window at least as large as the sender's is all that is required
+        if (inflateInit2(&inflater, -15) != Z_OK) {
+            if (deflaterReady) deflateEnd(&deflater);
+            throw std::runtime_error("Failed to initialize inflate");
+        }
+    }
+
+    bool compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+        out.resize(deflateBound(&deflater, static_cast<uLong>(std::min<size_t>(size, ULONG_MAX))) + 16);
+
+        size_t produced = 0;
+        size_t remaining = size;
+        do {
+            const auto chunk = std::min<size_t>(remaining, UINT_MAX);
+            deflater.next_in = const_cast<Bytef*>(data);
+            deflater.avail_in = static_cast<uInt>(chunk);
+            data += chunk;
+            remaining -= chunk;
+
+            const int flush = remaining == 0 ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+            do {
+                if (out.size() - produced < 64) out.resize(out.size() * 2);
+                deflater.next_out = out.data() + produced;
+                deflater.avail_out = static_cast<uInt>(std::min<size_t>(out.size() - produced, UINT_MAX));
+                if (deflate(&deflater, flush) == Z_STREAM_ERROR) return false;
+                produced = deflater.next_out - out.data();
+            } while (deflater.avail_out == 0);
+        } while (remaining > 0);
+
+        // the sync flush ends with an empty stored block, which the receiver appends again
+        if (produced >= 4 && std::equal(deflateTail, deflateTail + 4, out.begin() + static_cast<std::ptrdiff_t>(produced - 4))) {
+            produced -= 4;
+        }
+        out.resize(produced);
+
+        if (sendNoContextTakeover) deflateReset(&deflater);
+        return true;
+    }
+
+    Result decompress(const uint8_t* data, size_t size, std::string& out, size_t maxSize) {
+        const size_t limit = maxSize < SIZE_MAX ? maxSize + 1 : maxSize;
+        size_t produced = 0;
+
+        auto run = [&](const uint8_t* in, size_t n) {
+            while (n > 0) {
+                const auto chunk = std::min<size_t>(n, UINT_MAX);
+                inflater.next_in = const_cast<Bytef*>(in);
+                inflater.avail_in = static_cast<uInt>(chunk);
+                in += chunk;
+                n -= chunk;
+
+                do {
+                    if (produced == out.size()) {
+                        if (produced >= limit) return Result::TooLarge;
+                        out.resize(std::min(std::max<size_t>(out.size() * 2, 1024), limit));
+                    }
+                    inflater.next_out = reinterpret_cast<Bytef*>(out.data() + produced);
+                    inflater.avail_out = static_cast<uInt>(std::min<size_t>(out.size() - produced, UINT_MAX));
+
+                    const auto ret = inflate(&inflater, Z_SYNC_FLUSH);
+                    produced = reinterpret_cast<char*>(inflater.next_out) - out.data();
+                    if (produced > maxSize) return Result::TooLarge;
+
+                    if (ret == Z_STREAM_END) {
+                        inflateReset(&inflater);// the peer terminated its stream, a new one may follow
+                    } else if (ret == Z_BUF_ERROR) {
+                        if (inflater.avail_in == 0) break;
+                    } else if (ret != Z_OK) {
+                        return Result::Error;
+                    }
+                } while (inflater.avail_in > 0 || inflater.avail_out == 0);
+            }
+            return Result::Ok;
+        };
+
+        auto result = run(data, size);
+        if (result == Result::Ok) result = run(deflateTail, sizeof(deflateTail));
+        out.resize(std::min(produced, out.size()));
+
+        if (receiveNoContextTakeover || result != Result::Ok) inflateReset(&inflater);
+        return result;
+    }
+
+    ~Impl() {
+        if (deflaterReady) deflateEnd(&deflater);
+        inflateEnd(&inflater);
+    }
+
+    const int sendWindowBits;
+    const bool sendNoContextTakeover;
+    const bool receiveNoContextTakeover;
+    const size_t minSize;
+
+    bool deflaterReady{false};
+    z_stream deflater{};
+    z_stream inflater{};
+};
+
+#else
+
+struct PerMessageDeflate::Impl {
+
+    Impl(const DeflateParams&, bool, const PerMessageDeflateOptions&) {
+        throw std::runtime_error("permessage-deflate support is not enabled in this build.");
+    }
+
+    bool compress(const uint8_t*, size_t, std::vector<uint8_t>&) {
+        return false;
+    }
+
+    Result decompress(const uint8_t*, size_t, std::string&, size_t) {
+        return Result::Error;
+    }
+
+    const bool deflaterReady{false};
+    const size_t minSize{0};
+};
+
+#endif
+
+PerMessageDeflate::PerMessageDeflate(const DeflateParams& params, bool isServer, const PerMessageDeflateOptions& options)
+    : pimpl_(std::make_unique<Impl>(params, isServer, options)) {}
+
+bool PerMessageDeflate::shouldCompress(size_t size) const {
+    return pimpl_->deflaterReady && size >= pimpl_->minSize;
+}
+
+bool PerMessageDeflate::compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    return pimpl_->compress(data, size, out);
+}
+
+PerMessageDeflate::Result PerMessageDeflate::decompress(const uint8_t* data, size_t size, std::string& out, size_t maxSize) {
+    return pimpl_->decompress(data, size, out, maxSize);
+}
+
+PerMessageDeflate::~PerMessageDeflate() = default;
@@ -0,0 +1,75 @@
+
+#ifndef SIMPLE_SOCKET_PER_MESSAGE_DEFLATE_HPP
+#define SIMPLE_SOCKET_PER_MESSAGE_DEFLATE_HPP
+
+#include "simple_socket/WebSocket.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace simple_socket {
+
+    // Parameters agreed on during the handshake (RFC 7692 section 7.1)
+    struct DeflateParams {
+        bool serverNoContextTakeover{false};
+        bool clientNoContextTakeover{false};
+        int serverMaxWindowBits{15};
+        int clientMaxWindowBits{15};
+    };
+
+    // Whether permessage-deflate is available, i.e. the library was built with SIMPLE_SOCKET_WITH_ZLIB
+    bool deflateSupported();
+
+    // Value of the Sec-WebSocket-Extensions header(s) in an HTTP request or response, empty if absent
+    std::string extensionsHeader(std::string_view headers);
+
+    // Server side: picks the first acceptable permessage-deflate offer from the client's Sec-WebSocket-Extensions
+    std::optional<DeflateParams> negotiateDeflate(std::string_view offers, const PerMessageDeflateOptions& options);
+
+    // Server side: the Sec-WebSocket-Extensions value accepting params
+    std::string deflateResponse(const DeflateParams& params);
+
+    // Client side: the Sec-WebSocket-Extensions value offering permessage-deflate
+    std::string deflateOffer(const PerMessageDeflateOptions& options);
+
+    // Client side: the parameters accepted by the server. Throws if the response is not a valid reply to the offer.
+    std::optional<DeflateParams> parseDeflateResponse(std::string_view extensions, const PerMessageDeflateOptions& options);
+
+    // The compression state of one connection endpoint
+    class PerMessageDeflate {
+    public:
+        enum class Result {
+            Ok,
+            Error,
+            TooLarge
+        };
+
+        PerMessageDeflate(const DeflateParams& params, bool isServer, const PerMessageDeflateOptions& options);
+
+        PerMessageDeflate(const PerMessageDeflate&) = delete;
+        PerMessageDeflate& operator=(const PerMessageDeflate&) = delete;
+
+        // Whether a message of the given size should be sent compressed
+        [[nodiscard]] bool shouldCompress(size_t size) const;
+
+        // Compresses one message into out, without the trailing 0x00 0x00 0xff 0xff
+        bool compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+
+        // Decompresses one message into out, failing with TooLarge once the output exceeds maxSize
+        Result decompress(const uint8_t* data, size_t size, std::string& out, size_t maxSize);
+
+        ~PerMessageDeflate();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> pimpl_;
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_PER_MESSAGE_DEFLATE_HPP
@@ -1,18 +1,30 @@
 
 #include "simple_socket/WebSocket.hpp"
 
+#include "simple_socket/Counters.hpp"
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/Socket.hpp"
 #include "simple_socket/TCPSocket.hpp"
 #include "simple_socket/socket_common.hpp"
 
 #include "simple_socket/util/uuid.hpp"
 
+#include "simple_socket/ws/Heartbeat.hpp"
+#include "simple_socket/ws/HttpRequestParser.hpp"
+#include "simple_socket/ws/PerMessageDeflate.hpp"
 #include "simple_socket/ws/WebSocketConnection.hpp"
 #include "simple_socket/ws/WebSocketHandshake.hpp"
 
-#include <algorithm>
+#include <array>
 #include <atomic>
-#include <sstream>
-#include <thread>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -20,110 +32,524 @@ using namespace simple_socket;
 
 namespace {
 
-    void handshake(SimpleConnection& conn) {
-        std::vector<unsigned char> buffer(1024);
-        const auto bytesReceived = conn.read(buffer);
-        if (bytesReceived == -1) {
-            throwSocketError("Failed to read handshake request from client.");
+    // Upper bound for the HTTP upgrade request, guards against clients that never finish their headers
+    constexpr size_t maxHandshakeSize = 16 * 1024;
+
+    // The handshake response, assembled in place
+    class Response {
+    public:
+        Response& operator<<(std::string_view s) {
+            if (s.size() > buffer_.size() - size_) throw std::runtime_error("Handshake response is too large");
+            std::memcpy(buffer_.data() + size_, s.data(), s.size());
+            size_ += s.size();
+            return *this;
         }
 
-        std::string request(buffer.begin(), buffer.begin() + bytesReceived);
-        std::string::size_type keyPos = request.find("Sec-WebSocket-Key: ");
-        if (keyPos == std::string::npos) {
-            throwSocketError("Client handshake request is invalid.");
+        bool writeTo(SimpleConnection& conn) const {
+            return conn.write(buffer_.data(), size_);
+        }
+
+    private:
+        std::array<char, 1024> buffer_;
+        size_t size_ = 0;
+    };
+
+    struct Upgrade {
+        std::optional<DeflateParams> deflate;
+        std::string_view subprotocol;
+    };
+
+    // Answers a request that is not a valid upgrade and throws
+    [[noreturn]] void refuse(SimpleConnection& conn, std::string_view response) {
+        conn.write(response.data(), response.size());
+        throw std::runtime_error("Client handshake request is invalid.");
+    }
+
+    // Sends the 101 response with the negotiated permessage-deflate parameters and subprotocol, if any
+    Upgrade handshake(SimpleConnection& conn, const HttpRequestParser& request, const WebSocket& server) {
+        const auto version = request.header("Sec-WebSocket-Version");
+        if (version && *version != "13") {
+            refuse(conn, "HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\n\r\n");
+        }
+        // 24 characters of base64, clients of earlier versions of this library send a longer key whose start is used
+        const auto clientKey = request.header("Sec-WebSocket-Key");
+        if (request.method() != "GET" || !version || !clientKey || clientKey->size() < 24 ||
+            !request.hasToken("Upgrade", "websocket") || !request.hasToken("Connection", "upgrade")) {
+            refuse(conn, "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n");
         }
-        keyPos += 19;
-        const auto keyEnd = request.find("\r\n", keyPos);
-        const auto clientKey = request.substr(keyPos, keyEnd - keyPos);
 
         char secWebSocketAccept[29] = {};
-        WebSocketHandshake::generate(clientKey.data(), secWebSocketAccept);
+        WebSocketHandshake::generate(clientKey->data(), secWebSocketAccept);
+
+        Upgrade upgrade;
+        if (server.perMessageDeflate.enabled) {
+            // the offers may be spread over several headers
+            for (const auto& h : request.headers()) {
+                if (!equalsIgnoreCase(h.name, "Sec-WebSocket-Extensions")) continue;
+                upgrade.deflate = negotiateDeflate(h.value, server.perMessageDeflate);
+                if (upgrade.deflate) break;
+            }
+        }
+        for (const auto& subprotocol : server.subprotocols) {
+            if (request.hasToken("Sec-WebSocket-Protocol", subprotocol)) {
+                upgrade.subprotocol = subprotocol;
+                break;
+            }
+        }
 
-        std::ostringstream response;
+        Response response;
         response << "HTTP/1.1 101 Switching Protocols\r\n"
                  << "Upgrade: websocket\r\n"
                  << "Connection: Upgrade\r\n"
-                 << "Sec-WebSocket-Accept: " << secWebSocketAccept << "\r\n\r\n";
+                 << "Sec-WebSocket-Accept: " << std::string_view(secWebSocketAccept, 28) << "\r\n";
+        if (upgrade.deflate) {
+            response << "Sec-WebSocket-Extensions: " << deflateResponse(*upgrade.deflate) << "\r\n";
+        }
+        if (!upgrade.subprotocol.empty()) {
+            response << "Sec-WebSocket-Protocol: " << upgrade.subprotocol << "\r\n";
+        }
+        response << "\r\n";
 
-        const std::string responseStr = response.str();
-        if (!conn.write(responseStr)) {
+        if (!response.writeTo(conn)) {
             throwSocketError("Failed to send handshake response");
         }
+        return upgrade;
+    }
+
+    // The loop thread of the connection then reads its end and closes it as any other
+    void shutdown(SimpleConnection& conn) {
+        if (const auto native = dynamic_cast<NativeConnection*>(&conn)) {
+            shutdownSocket(native->nativeHandle());
+        }
+    }
+
+    TCPServerOptions serverOptions(const std::string& cert_file, const std::string& key_file, size_t numThreads) {
+        TCPServerOptions options;
+        options.useTLS = !cert_file.empty() && !key_file.empty();
+        options.certFile = cert_file;
+        options.keyFile = key_file;
+        options.reusePort = numThreads > 1;
+        return options;
     }
 }// namespace
 
 struct WebSocket::Impl {
 
-    explicit Impl(WebSocket* scope, uint16_t port, const std::string& cert_file = "", const std::string& key_file = "")
-        : scope(scope), socket(port, 1, !cert_file.empty() && !key_file.empty(), cert_file, key_file) {}
+    explicit Impl(WebSocket* scope, uint16_t port, const std::string& cert_file = "", const std::string& key_file = "", size_t numThreads = 1)
+        : scope(scope), loop(numThreads), socket(port, serverOptions(cert_file, key_file, numThreads)) {}
 
-    void run() {
+    void start() {
+        if (scope->perMessageDeflate.enabled && !deflateSupported()) {
+            throw std::runtime_error("permessage-deflate support is not enabled in this build.");
+        }
+        if (scope->heartbeat.pingInterval.count() > 0) {
+            heartbeat = std::make_unique<Heartbeat>(loop, Heartbeat::tickFor(scope->heartbeat), [this](uint64_t id) {
+                return checkHeartbeat(id);
+            });
+        }
+        socket.acceptAsync(loop, [this](std::unique_ptr<SimpleConnection> conn) {
+            onConnection(std::move(conn));
+        });
+    }
 
-        std::vector<std::unique_ptr<WebSocketConnectionImpl>> connections;
+    size_t broadcast(uint8_t opcode, const uint8_t* payload, size_t size) {
+        const auto frame = WebSocketConnectionImpl::encodeFrame(opcode, payload, size);
 
-        while (!stop_) {
+        std::lock_guard lck(m);
+        size_t count = 0;
+        for (const auto s : active) {
+            if (!s->open) continue;
+            s->ws->sendEncoded(frame);
+            ++count;
+        }
+        return count;
+    }
 
-            try {
-                auto ws = std::make_unique<WebSocketConnectionImpl>(WebSocketCallbacks{scope->onOpen, scope->onClose, scope->onMessage}, socket.accept());
-                ws->run(handshake);
-                connections.emplace_back(std::move(ws));
-            } catch (std::exception&) {
-                // std::cerr << ex.what() << std::endl;
-            }
+    void subscribe(WebSocketConnection* conn, const std::string& topic) {
+        std::lock_guard lck(m);
+        const auto s = find(conn);
+        if (!s) return;
 
-            //cleanup connections
-            for (auto it = connections.begin(); it != connections.end();) {
+        topics[topic].insert(s);
+        s->topics.insert(topic);
+    }
 
-                if ((*it)->closed()) {
-                    it = connections.erase(it);
-                } else {
-                    ++it;
-                }
-            }
+    void unsubscribe(WebSocketConnection* conn, const std::string& topic) {
+        std::lock_guard lck(m);
+        const auto s = find(conn);
+        if (!s) return;
+
+        s->topics.erase(topic);
+        removeFromTopic(s, topic);
+    }
+
+    size_t publish(const std::string& topic, uint8_t opcode, const uint8_t* payload, size_t size) {
+        const auto frame = WebSocketConnectionImpl::encodeFrame(opcode, payload, size);
+        const auto key = std::hash<std::string>{}(topic);
+
+        std::lock_guard lck(m);
+        const auto it = topics.find(topic);
+        if (it == topics.end()) return 0;
+
+        for (const auto s : it->second) {
+            s->ws->sendEncoded(frame, key);
         }
+        return it->second.size();
     }
 
-    void start() {
-        thread = std::thread([this] {
-            run();
-        });
+    template<typename Send>
+    bool send(uint64_t id, Send send) {
+        std::lock_guard lck(m);
+        const auto s = find(id);
+        if (!s || !s->open) return false;
+
+        send(*s->ws);
+        return true;
+    }
+
+    bool disconnect(uint64_t id) {
+        std::lock_guard lck(m);
+        const auto s = find(id);
+        if (!s) return false;
+
+        shutdown(s->ws->connection());
+        return true;
+    }
+
+    size_t connectionCount() {
+        std::lock_guard lck(m);
+        return active.size();
+    }
+
+    WebSocketServerStats stats() {
+        WebSocketServerStats stats;
+        stats.accepted = load(accepted);
+        stats.handshakesFailed = load(handshakesFailed);
+        stats.messageHandling = messageHandling.snapshot();
+
+        std::lock_guard lck(m);
+        stats.open = active.size();
+        stats.traffic = retired;
+        for (const auto s : active) {
+            stats.traffic += s->ws->stats();
+        }
+        return stats;
     }
 
     void stop() {
-        stop_ = true;
+        if (stop_.exchange(true)) return;
+
         socket.close();
+        loop.stop();
+
+        // sessions are destroyed outside the lock, as their onClose may call back into the server
+        std::vector<std::unique_ptr<Session>> sessions;
+        {
+            std::lock_guard lck(m);
+            for (auto& slot : slots) {
+                if (slot.session) sessions.push_back(std::move(slot.session));
+            }
+            for (auto& [s, session] : closing) {
+                sessions.push_back(std::move(session));
+            }
+            slots.clear();
+            closing.clear();
+            freeSlots.clear();
+            active.clear();
+            topics.clear();
+        }
     }
 
     ~Impl() {
         stop();
-        if (thread.joinable()) {
-            thread.join();
+    }
+
+private:
+    struct Session {
+        std::unique_ptr<WebSocketConnectionImpl> ws;
+        std::string request;                       // an upgrade request that arrived in part
+        std::unique_ptr<HttpRequestParser> pending;// and where its parsing got to
+        std::atomic_bool open{false};// also read by broadcasts
+        std::unordered_set<std::string> topics;
+        size_t position = 0;// in active
+    };
+
+    // The registry owns the sessions. An id is the index of its slot in the low 32 bits and the slot's generation,
+    // counted up whenever a session leaves it, in the high ones; ids of closed connections thus never resolve again.
+    struct Slot {
+        std::unique_ptr<Session> session;
+        uint32_t generation = 1;// ids are never 0
+    };
+
+    void onConnection(std::unique_ptr<SimpleConnection> conn) {
+        auto session = std::make_unique<Session>();
+        session->ws = std::make_unique<WebSocketConnectionImpl>(WebSocketCallbacks{scope->onOpen, scope->onClose, scope->onMessage, scope->onBinaryMessage}, std::move(conn), WebSocketConnectionImpl::Role::Server);
+
+        Session* s = session.get();
+        count(accepted);
+        s->ws->setHandlingHistogram(&messageHandling);
+        auto sendOptions = scope->sendQueue;
+        sendOptions.onDrain = [this, ws = s->ws.get()] {
+            if (scope->onDrain) scope->onDrain(ws);
+        };
+        s->ws->useSendQueue(loop, sendOptions);
+        auto& transport = s->ws->connection();
+        s->ws->setCloseHandler([this, s, &transport] {
+            loop.unwatch(transport);
+            unregister(s);
+        });
+        uint64_t id;
+        {
+            std::lock_guard lck(m);
+            insert(std::move(session));
+            id = s->ws->id();
         }
+        loop.watch(transport, [this, s] {
+            onReadable(*s);
+            if (s->ws->closed()) {
+                release(s);
+            }
+        });
+        loop.schedule(scope->handshakeTimeout, [this, id] {
+            std::lock_guard lck(m);
+            const auto s = find(id);
+            if (s && !s->open) shutdown(s->ws->connection());
+        });
+    }
+
+    // Takes a closing session out of the registry, right before its onClose. It is destroyed by release().
+    void unregister(Session* s) {
+        std::lock_guard lck(m);
+        if (find(s->ws->id()) != s) return;
+
+        // closing before the upgrade completed means it was refused, malformed, timed out or abandoned
+        if (!s->open) count(handshakesFailed);
+        auto stats = s->ws->stats();
+        stats.queuedBytes = 0;
+        retired += stats;
+
+        auto& slot = slots[static_cast<uint32_t>(s->ws->id())];
+        closing.emplace(s, std::move(slot.session));
+        if (++slot.generation == 0) slot.generation = 1;
+        freeSlots.push_back(static_cast<uint32_t>(s->ws->id()));
+
+        active[s->position] = active.back();
+        active[s->position]->position = s->position;
+        active.pop_back();
+
+        for (const auto& topic : s->topics) {
+            removeFromTopic(s, topic);
+        }
+    }
+
+    // Destroys a closed session, on its loop thread once its callback has returned
+    void release(Session* s) {
+        std::unique_ptr<Session> session;
+        {
+            std::lock_guard lck(m);
+            const auto it = closing.find(s);
+            if (it == closing.end()) return;
+            session = std::move(it->second);
+            closing.erase(it);
+        }
+    }
+
+    // Requires m to be held
+    void insert(std::unique_ptr<Session> session) {
+        uint32_t index;
+        if (freeSlots.empty()) {
+            index = static_cast<uint32_t>(slots.size());
+            slots.emplace_back();
+        } else {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+
+        auto& slot = slots[index];
+        session->ws->setId(static_cast<uint64_t>(slot.generation) << 32 | index);
+        session->position = active.size();
+        active.push_back(session.get());
+        slot.session = std::move(session);
+    }
+
+    // Requires m to be held
+    Session* find(uint64_t id) const {
+        const auto index = static_cast<uint32_t>(id);
+        if (index >= slots.size() || slots[index].generation != id >> 32) return nullptr;
+        return slots[index].session.get();
+    }
+
+    // Requires m to be held
+    Session* find(WebSocketConnection* conn) const {
+        const auto s = find(conn->id());
+        return s && s->ws.get() == conn ? s : nullptr;
+    }
+
+    std::optional<Liveness> checkHeartbeat(uint64_t id) {
+        std::lock_guard lck(m);
+        const auto s = find(id);
+        if (!s) return std::nullopt;
+
+        const auto liveness = s->ws->heartbeat();
+        if (liveness == Liveness::Dead) shutdown(s->ws->connection());
+        return liveness;
+    }
+
+    // Requires m to be held
+    void removeFromTopic(Session* s, const std::string& topic) {
+        const auto it = topics.find(topic);
+        if (it == topics.end()) return;
+
+        it->second.erase(s);
+        if (it->second.empty()) topics.erase(it);
+    }
+
+    void onReadable(Session& s) {
+        thread_local std::vector<uint8_t> buffer(16 * 1024);
+        // never blocks the loop thread, a TLS record may have arrived only in part
+        const auto bytesRead = s.ws->connection().tryRead(buffer);
+        if (bytesRead == 0) return;
+        if (bytesRead < 0) {
+            s.ws->close(false);
+            return;
+        }
+
+        if (s.open) {
+            s.ws->onData(buffer.data(), bytesRead);
+            return;
+        }
+
+        // usually the whole upgrade request arrives at once and is parsed right where it was read to
+        thread_local HttpRequestParser parser;
+        std::string_view request(reinterpret_cast<const char*>(buffer.data()), bytesRead);
+        auto* p = &parser;
+        if (s.pending) {
+            s.request.append(request);
+            request = s.request;
+            p = s.pending.get();
+        } else {
+            parser.reset();
+        }
+
+        switch (p->parse(request, maxHandshakeSize)) {
+            case HttpRequestParser::Result::Incomplete:
+                if (!s.pending) {
+                    s.pending = std::make_unique<HttpRequestParser>(parser);
+                    s.request.assign(request);
+                }
+                return;
+            case HttpRequestParser::Result::Invalid:
+                s.ws->close(false);
+                return;
+            case HttpRequestParser::Result::Complete:
+                break;
+        }
+
+        try {
+            const auto upgrade = handshake(s.ws->connection(), *p, *scope);
+            if (upgrade.deflate) {
+                s.ws->enableCompression(std::make_unique<PerMessageDeflate>(*upgrade.deflate, true, scope->perMessageDeflate));
+            }
+            s.ws->setSubprotocol(upgrade.subprotocol);
+        } catch (const std::exception&) {
+            s.ws->close(false);
+            return;
+        }
+
+        s.open = true;
+        if (heartbeat) heartbeat->watch(s.ws->id(), scope->heartbeat);
+        s.ws->open();
+
+        // frames sent right behind the upgrade request
+        const auto leftover = request.substr(p->size());
+        if (!leftover.empty()) {
+            s.ws->onData(reinterpret_cast<const uint8_t*>(leftover.data()), leftover.size());
+        }
+        s.pending.reset();
+        s.request.clear();
+        s.request.shrink_to_fit();
     }
 
     std::atomic_bool stop_{false};
 
     WebSocket* scope;
+    EventLoop loop;
     TCPServer socket;
-    std::thread thread;
+    std::unique_ptr<Heartbeat> heartbeat;
+
+    std::atomic_uint64_t accepted{0};
+    std::atomic_uint64_t handshakesFailed{0};
+    Histogram messageHandling;
+
+    std::mutex m;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<Session*> active;// dense, for broadcasts
+    std::unordered_map<Session*, std::unique_ptr<Session>> closing;
+    std::unordered_map<std::string, std::unordered_set<Session*>> topics;
+    ConnectionStats retired;// of the connections that closed
 };
 
 
-WebSocketConnection::WebSocketConnection()
-    : uuid_(generateUUID()) {}
+WebSocketConnection::WebSocketConnection() = default;
 
 const std::string& WebSocketConnection::uuid() {
+    std::call_once(uuidOnce_, [this] { uuid_ = generateUUID(); });
     return uuid_;
 }
 
-WebSocket::WebSocket(uint16_t port, const std::string& cert_file, const std::string& key_file)
-    : pimpl_(std::make_unique<Impl>(this, port, cert_file, key_file)) {}
+WebSocket::WebSocket(uint16_t port, const std::string& cert_file, const std::string& key_file, size_t numThreads)
+    : pimpl_(std::make_unique<Impl>(this, port, cert_file, key_file, numThreads)) {}
 
 
 void WebSocket::start() {
     pimpl_->start();
 }
 
+size_t WebSocket::broadcast(const std::string& message) {
+    return pimpl_->broadcast(ws::Text, reinterpret_cast<const uint8_t*>(message.data()), message.size());
+}
+
+size_t WebSocket::broadcastBinary(std::span<const uint8_t> data) {
+    return pimpl_->broadcast(ws::Binary, data.data(), data.size());
+}
+
+void WebSocket::subscribe(WebSocketConnection* conn, const std::string& topic) {
+    pimpl_->subscribe(conn, topic);
+}
+
+void WebSocket::unsubscribe(WebSocketConnection* conn, const std::string& topic) {
+    pimpl_->unsubscribe(conn, topic);
+}
+
+size_t WebSocket::publish(const std::string& topic, const std::string& message) {
+    return pimpl_->publish(topic, ws::Text, reinterpret_cast<const uint8_t*>(message.data()), message.size());
+}
+
+size_t WebSocket::publishBinary(const std::string& topic, std::span<const uint8_t> data) {
+    return pimpl_->publish(topic, ws::Binary, data.data(), data.size());
+}
+
+bool WebSocket::send(uint64_t id, const std::string& message) {
+    return pimpl_->send(id, [&](WebSocketConnection& conn) { conn.send(message); });
+}
+
+bool WebSocket::sendBinary(uint64_t id, std::span<const uint8_t> data) {
+    return pimpl_->send(id, [&](WebSocketConnection& conn) { conn.sendBinary(data); });
+}
+
+bool WebSocket::disconnect(uint64_t id) {
+    return pimpl_->disconnect(id);
+}
+
+size_t WebSocket::connectionCount() const {
+    return pimpl_->connectionCount();
+}
+
+WebSocketServerStats WebSocket::stats() const {
+    return pimpl_->stats();
+}
+
 void WebSocket::stop() {
     pimpl_->stop();
 }
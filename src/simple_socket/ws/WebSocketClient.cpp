@@ -2,13 +2,21 @@
 
 #include "simple_socket/WebSocket.hpp"
 
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/Socket.hpp"
 #include "simple_socket/TCPSocket.hpp"
 #include "simple_socket/socket_common.hpp"
 
+#include "simple_socket/ws/Heartbeat.hpp"
+#include "simple_socket/ws/PerMessageDeflate.hpp"
 #include "simple_socket/ws/WebSocketConnection.hpp"
 #include "simple_socket/ws/WebSocketHandshakeKeyGen.hpp"
 
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 
 using namespace simple_socket;
 
@@ -42,7 +50,10 @@ namespace {
         }
     }
 
-    void performHandshake(SimpleConnection& conn, const std::string& url, const std::string& host, uint16_t port) {
+    // Returns any bytes received after the response headers, i.e. the start of the first frame.
+    // deflate is set if the server accepted permessage-deflate.
+    std::vector<uint8_t> performHandshake(SimpleConnection& conn, const std::string& url, const std::string& host, uint16_t port,
+                                          const PerMessageDeflateOptions& deflateOptions, std::optional<DeflateParams>& deflate) {
 
         // Extract path from URL
         std::string path = "/";
@@ -62,24 +73,91 @@ namespace {
                 << "Upgrade: websocket\r\n"
                 << "Connection: Upgrade\r\n"
                 << "Sec-WebSocket-Key: " << base64Key << "\r\n"
-                << "Sec-WebSocket-Version: 13\r\n\r\n";
+                << "Sec-WebSocket-Version: 13\r\n";
+        if (deflateOptions.enabled) {
+            request << "Sec-WebSocket-Extensions: " << deflateOffer(deflateOptions) << "\r\n";
+        }
+        request << "\r\n";
 
         const std::string requestStr = request.str();
         if (!conn.write(requestStr)) {
             throwSocketError("Failed to send handshake request");
         }
 
+        std::string response;
         std::vector<uint8_t> buffer(1024);
-        const auto bytesReceived = conn.read(buffer);
-        if (bytesReceived == -1) {
-            throwSocketError("Failed to read handshake response from server.");
+        std::string::size_type headerEnd;
+        while ((headerEnd = response.find("\r\n\r\n")) == std::string::npos) {
+            const auto bytesReceived = conn.read(buffer);
+            if (bytesReceived == -1) {
+                throwSocketError("Failed to read handshake response from server.");
+            }
+            response.append(buffer.begin(), buffer.begin() + bytesReceived);
         }
 
-        const std::string response(buffer.begin(), buffer.begin() + bytesReceived);
         if (response.find(" 101 ") == std::string::npos) {
             throwSocketError("Handshake failed with the server.");
         }
+
+        const auto extensions = extensionsHeader(std::string_view(response).substr(0, headerEnd + 2));
+        if (!deflateOptions.enabled && !extensions.empty()) {
+            throw std::runtime_error("Server accepted extensions that were not offered: " + extensions);
+        }
+        if (deflateOptions.enabled) {
+            deflate = parseDeflateResponse(extensions, deflateOptions);
+        }
+
+        return {response.begin() + static_cast<std::ptrdiff_t>(headerEnd + 4), response.end()};
     }
+
+    // The connections of all clients with a heartbeat, timed by one loop thread
+    class ClientHeartbeats {
+    public:
+        // Never destroyed, clients may outlive static destruction
+        static ClientHeartbeats& instance() {
+            static auto* heartbeats = new ClientHeartbeats();
+            return *heartbeats;
+        }
+
+        uint64_t add(WebSocketConnectionImpl* conn) {
+            std::lock_guard lck(m_);
+            const auto id = nextId_++;
+            connections_.emplace(id, conn);
+            return id;
+        }
+
+        void watch(uint64_t id, const HeartbeatOptions& options) {
+            heartbeat_.watch(id, options);
+        }
+
+        void remove(uint64_t id) {
+            std::lock_guard lck(m_);
+            connections_.erase(id);
+        }
+
+    private:
+        std::mutex m_;
+        std::unordered_map<uint64_t, WebSocketConnectionImpl*> connections_;
+        uint64_t nextId_ = 1;
+
+        EventLoop loop_{1};
+        Heartbeat heartbeat_{loop_, std::chrono::milliseconds(100), [this](uint64_t id) { return check(id); }};
+
+        std::optional<Liveness> check(uint64_t id) {
+            std::lock_guard lck(m_);
+            const auto it = connections_.find(id);
+            if (it == connections_.end()) return std::nullopt;
+
+            const auto liveness = it->second->heartbeat();
+            if (liveness == Liveness::Dead) {
+                // wakes the reader thread of the client, which then closes the connection
+                if (const auto native = dynamic_cast<NativeConnection*>(&it->second->connection())) {
+                    shutdownSocket(native->nativeHandle());
+                }
+            }
+            return liveness;
+        }
+    };
 }// namespace
 
 struct WebSocketClient::Impl {
@@ -96,10 +174,33 @@ struct WebSocketClient::Impl {
         const auto [host, port] = parseWebSocketURL(url);
         auto c = ctx_.connect(host, port, useTLS);
 
-        conn = std::make_unique<WebSocketConnectionImpl>(WebSocketCallbacks {scope_->onOpen, scope_->onClose, scope_->onMessage}, std::move(c));
-        conn->run([url, host, port](SimpleConnection& conn) {
-            performHandshake(conn, url, host, port);
+        conn = std::make_unique<WebSocketConnectionImpl>(WebSocketCallbacks {scope_->onOpen, scope_->onClose, scope_->onMessage, scope_->onBinaryMessage}, std::move(c), WebSocketConnectionImpl::Role::Client);
+        if (scope_->perMessageDeflate.enabled && !deflateSupported()) {
+            throw std::runtime_error("permessage-deflate support is not enabled in this build.");
+        }
+
+        // registered before the connection can close, which takes it out again
+        const bool heartbeat = scope_->heartbeat.pingInterval.count() > 0;
+        uint64_t heartbeatId = 0;
+        if (heartbeat) {
+            heartbeatId = ClientHeartbeats::instance().add(conn.get());
+            conn->setCloseHandler([heartbeatId] {
+                ClientHeartbeats::instance().remove(heartbeatId);
+            });
+        }
+
+        conn->run([this, url, host, port](SimpleConnection& c) {
+            std::optional<DeflateParams> deflate;
+            auto leftover = performHandshake(c, url, host, port, scope_->perMessageDeflate, deflate);
+            if (deflate) {
+                conn->enableCompression(std::make_unique<PerMessageDeflate>(*deflate, false, scope_->perMessageDeflate));
+            }
+            return leftover;
         });
+
+        if (heartbeat) {
+            ClientHeartbeats::instance().watch(heartbeatId, scope_->heartbeat);
+        }
     }
 
     void send(const std::string& message) {
@@ -107,6 +208,11 @@ struct WebSocketClient::Impl {
         conn->send(message);
     }
 
+    void sendBinary(std::span<const uint8_t> data) {
+
+        conn->sendBinary(data);
+    }
+
     void close() {
         conn->close(true);
     }
@@ -132,6 +238,10 @@ void WebSocketClient::send(const std::string& message) {
     pimpl_->send(message);
 }
 
+void WebSocketClient::sendBinary(std::span<const uint8_t> data) {
+    pimpl_->sendBinary(data);
+}
+
 void WebSocketClient::close() {
     pimpl_->close();
 }
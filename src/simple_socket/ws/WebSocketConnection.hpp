@@ -2,16 +2,29 @@
 #ifndef SIMPLE_SOCKET_WEBSOCKET_CONNECTION_HPP
 #define SIMPLE_SOCKET_WEBSOCKET_CONNECTION_HPP
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdint>
-#include <iostream>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <random>
+#include <span>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
+#include "simple_socket/BufferPool.hpp"
+#include "simple_socket/Counters.hpp"
+#include "simple_socket/SendQueue.hpp"
 #include "simple_socket/WebSocket.hpp"
+#include "simple_socket/ws/Heartbeat.hpp"
+#include "simple_socket/ws/PerMessageDeflate.hpp"
+#include "simple_socket/ws/WebSocketFrameDecoder.hpp"
 
 namespace simple_socket {
 
@@ -19,26 +32,45 @@ namespace simple_socket {
         std::function<void(WebSocketConnection*)>& onOpen;
         std::function<void(WebSocketConnection*)>& onClose;
         std::function<void(WebSocketConnection*, const std::string&)>& onMessage;
+        std::function<void(WebSocketConnection*, std::span<const uint8_t>)>& onBinaryMessage;
 
         WebSocketCallbacks(std::function<void(WebSocketConnection*)>& onOpen,
                            std::function<void(WebSocketConnection*)>& onClose,
                            std::function<void(WebSocketConnection*,
-                                              const std::string&)>& onMessage)
+                                              const std::string&)>& onMessage,
+                           std::function<void(WebSocketConnection*,
+                                              std::span<const uint8_t>)>& onBinaryMessage)
             : onOpen(onOpen),
               onClose(onClose),
-              onMessage(onMessage) {}
+              onMessage(onMessage),
+              onBinaryMessage(onBinaryMessage) {}
     };
 
     struct WebSocketConnectionImpl: WebSocketConnection {
 
-        explicit WebSocketConnectionImpl(const WebSocketCallbacks& callbacks, std::unique_ptr<SimpleConnection> conn)
-            : callbacks_(callbacks), conn_(std::move(conn)) {}
+        // Clients mask every frame they send and servers never do (RFC 6455 section 5.1)
+        enum class Role {
+            Server,
+            Client
+        };
 
-        void run(const std::function<void(SimpleConnection&)>& handshake) {
+        WebSocketConnectionImpl(const WebSocketCallbacks& callbacks, std::unique_ptr<SimpleConnection> conn, Role role)
+            : role_(role), conn_(std::move(conn)), callbacks_(callbacks) {
 
-            handshake(*conn_);
-            if (callbacks_.onOpen) {
-                callbacks_.onOpen(this);
+            decoder_.setMaskPolicy(role == Role::Server ? WebSocketFrameDecoder::MaskPolicy::Required : WebSocketFrameDecoder::MaskPolicy::Forbidden);
+            if (role == Role::Client) {
+                std::random_device rd;
+                maskState_ = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+            }
+        }
+
+        // Performs the (blocking) handshake and starts a listener thread. The handshake returns any bytes read past the HTTP headers.
+        void run(const std::function<std::vector<uint8_t>(SimpleConnection&)>& handshake) {
+
+            const auto leftover = handshake(*conn_);
+            open();
+            if (!leftover.empty() && !onData(leftover.data(), leftover.size())) {
+                return;
             }
 
             thread_ = std::thread([this] {
@@ -46,10 +78,92 @@ namespace simple_socket {
             });
         }
 
+        // Marks the handshake as completed, for connections driven by an EventLoop
+        void open() {
+            if (callbacks_.onOpen) {
+                callbacks_.onOpen(this);
+            }
+        }
+
+        // Enables permessage-deflate as negotiated during the handshake, must be called before any data is exchanged
+        void enableCompression(std::unique_ptr<PerMessageDeflate> deflate) {
+            deflate_ = std::move(deflate);
+            decoder_.setCompression(deflate_ != nullptr);
+        }
+
+        // From then on frames are queued and written by the loop thread watching the connection, rather than by the sender
+        void useSendQueue(EventLoop& loop, const SendQueueOptions& options) {
+            sendQueue_ = std::make_unique<SendQueue>(loop, *conn_, options);
+        }
+
+        // Assigned by the server's registry
+        void setId(uint64_t id) {
+            id_ = id;
+        }
+
+        // Agreed on by the server during the handshake
+        void setSubprotocol(std::string_view subprotocol) {
+            subprotocol_ = subprotocol;
+        }
+
+        // Times onMessage and onBinaryMessage into histogram, which must outlive the connection
+        void setHandlingHistogram(Histogram* histogram) {
+            handling_ = histogram;
+        }
+
+        // Invoked right before the underlying connection is closed
+        void setCloseHandler(std::function<void()> handler) {
+            closeHandler_ = std::move(handler);
+        }
+
+        [[nodiscard]] SimpleConnection& connection() const {
+            return *conn_;
+        }
+
         void send(const std::string& message) override {
-            const auto frame = createFrame(message);
+            sendFrame(ws::Text, reinterpret_cast<const uint8_t*>(message.data()), message.size());
+        }
+
+        void sendBinary(std::span<const uint8_t> data) override {
+            sendFrame(ws::Binary, data.data(), data.size());
+        }
+
+        void send(const std::string& message, uint64_t key) override {
+            sendFrame(ws::Text, reinterpret_cast<const uint8_t*>(message.data()), message.size(), key);
+        }
+
+        void sendBinary(std::span<const uint8_t> data, uint64_t key) override {
+            sendFrame(ws::Binary, data.data(), data.size(), key);
+        }
+
+        [[nodiscard]] ConnectionStats stats() const override {
+            auto stats = conn_->stats();
+            stats.messagesReceived = load(messages_.received);
+            stats.messagesSent = load(messages_.sent);
+            stats.queuedBytes = sendQueue_ ? sendQueue_->queued() : 0;
+            return stats;
+        }
+
+        // Writes a frame encoded by encodeFrame, which may be shared with other connections
+        void sendEncoded(const std::shared_ptr<const PooledBuffer>& frame, std::optional<uint64_t> key = std::nullopt) {
+            if (closed_) return;
+            count(messages_.sent);
+
             std::lock_guard lg(tx_mtx_);
-            conn_->write(frame);
+            if (sendQueue_) {
+                sendQueue_->push(frame, key);
+            } else {
+                conn_->write(frame->data(), frame->size());
+            }
+        }
+
+        // Encodes a complete unmasked frame, as sent by servers, into a buffer of the global pool
+        static std::shared_ptr<const PooledBuffer> encodeFrame(uint8_t opcode, const uint8_t* payload, size_t payloadLen) {
+            auto frame = BufferPool::global().acquire(14 + payloadLen);
+            const auto headerLen = createHeader(frame.data(), opcode, payloadLen, nullptr);
+            std::copy_n(payload, payloadLen, frame.data() + headerLen);
+            frame.resize(headerLen + payloadLen);
+            return std::make_shared<const PooledBuffer>(std::move(frame));
         }
 
         void close(bool byClient) {
@@ -57,12 +171,12 @@ namespace simple_socket {
 
             if (byClient) {
                 // Best-effort close frame (no locks that can invert with TLS)
-                std::vector<uint8_t> closeFrame = {0x88, 0x00};
-                std::lock_guard lg(tx_mtx_);
-                conn_->write(closeFrame);
+                sendFrame(ws::Close, nullptr, 0);
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
             }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (sendQueue_) sendQueue_->close();
+            if (closeHandler_) closeHandler_();
             conn_->close();
 
             // Avoid joining from within the listener thread
@@ -76,6 +190,53 @@ namespace simple_socket {
             return closed_;
         }
 
+        // Called by the Heartbeat when the connection is due, which pings the peer if nothing arrived since the
+        // previous call. Only ever called from one thread at a time.
+        Liveness heartbeat() {
+            if (closed_) return Liveness::Dead;
+            if (received_.exchange(false, std::memory_order_relaxed)) {
+                pinged_ = false;
+                return Liveness::Alive;
+            }
+            if (pinged_) return Liveness::Dead;
+
+            pinged_ = true;
+            sendFrame(ws::Ping, nullptr, 0);
+            return Liveness::Pinged;
+        }
+
+        // Consumes received bytes, dispatching every complete message. Returns false once the connection is closed.
+        bool onData(const uint8_t* data, size_t size) {
+            received_.store(true, std::memory_order_relaxed);
+            const auto result = decoder_.feed(data, size, [this](uint8_t opcode, const std::string& payload, bool compressed) {
+                if (!compressed) return onFrame(opcode, payload);
+
+                switch (deflate_->decompress(reinterpret_cast<const uint8_t*>(payload.data()), payload.size(), inflated_, decoder_.maxMessageSize())) {
+                    case PerMessageDeflate::Result::Ok:
+                        return onFrame(opcode, inflated_);
+                    case PerMessageDeflate::Result::TooLarge:
+                        fail(1009);
+                        return false;
+                    default:
+                        fail(1007);
+                        return false;
+                }
+            });
+
+            switch (result) {
+                case WebSocketFrameDecoder::Result::ProtocolError:
+                    fail(1002);
+                    break;
+                case WebSocketFrameDecoder::Result::TooLarge:
+                    fail(1009);
+                    break;
+                default:
+                    break;
+            }
+
+            return !closed_;
+        }
+
         ~WebSocketConnectionImpl() override {
             close(true);
             if (thread_.joinable()) {
@@ -84,117 +245,176 @@ namespace simple_socket {
         }
 
     private:
-        std::mutex tx_mtx_;// serialize writes only
+        // Apart from the transport's, on a cache line of their own
+        struct alignas(64) MessageCounters {
+            std::atomic_uint64_t received{0};
+            std::atomic_uint64_t sent{0};
+        };
+
+        Role role_;
+        uint64_t maskState_{0};// guarded by tx_mtx_
+        std::mutex tx_mtx_;    // serialize writes only
         std::atomic_bool closed_{false};
+        std::atomic_bool received_{false};// since the last heartbeat
+        bool pinged_ = false;             // by the heartbeat, and not answered yet
         WebSocket* socket_{};
         std::unique_ptr<SimpleConnection> conn_;
+        std::unique_ptr<SendQueue> sendQueue_;// server connections on an EventLoop
         WebSocketCallbacks callbacks_;
         std::thread thread_;
+        std::function<void()> closeHandler_;
+        WebSocketFrameDecoder decoder_;
+        std::unique_ptr<PerMessageDeflate> deflate_;
+        std::string inflated_;             // decompressed message being delivered
+        std::vector<uint8_t> txBuffer_;    // masked payload of the frame being sent, guarded by tx_mtx_
+        std::vector<uint8_t> txCompressed_;// compressed payload of the frame being sent, guarded by tx_mtx_
+        MessageCounters messages_;
+        Histogram* handling_ = nullptr;
 
 
         void listen() {
-            std::vector<unsigned char> buffer(1024);
+            std::vector<unsigned char> buffer(16 * 1024);
             while (!closed_) {
 
                 const auto recv = conn_->read(buffer);
                 if (recv <= 0) {
+                    // the peer went away without a close frame, or the heartbeat gave up on it
+                    close(false);
                     break;
                 }
 
-                std::vector<uint8_t> frame{buffer.begin(), buffer.begin() + recv};
-
-                if (frame.size() < 2) return;
-
-                uint8_t opcode = frame[0] & 0x0F;
-                // bool isFinal = (frame[0] & 0x80) != 0;
-                bool isMasked = (frame[1] & 0x80) != 0;
-                uint64_t payloadLen = frame[1] & 0x7F;
-
-                size_t pos = 2;
-                if (payloadLen == 126) {
-                    payloadLen = (frame[2] << 8) | frame[3];
-                    pos += 2;
-                } else if (payloadLen == 127) {
-                    payloadLen = 0;
-                    for (int i = 0; i < 8; ++i) {
-                        payloadLen = (payloadLen << 8) | frame[2 + i];
-                    }
-                    pos += 8;
+                if (!onData(buffer.data(), recv)) {
+                    break;
                 }
+            }
+        }
 
-                static std::vector<uint8_t> mask(4);
-                if (isMasked) {
-                    for (int i = 0; i < 4; ++i) {
-                        mask[i] = frame[pos++];
-                    }
-                }
+        bool onFrame(uint8_t opcode, const std::string& payload) {
+            switch (opcode) {
+                case ws::Text:
+                    deliver([&] {
+                        if (callbacks_.onMessage) callbacks_.onMessage(this, payload);
+                    });
+                    break;
+                case ws::Binary:
+                    deliver([&] {
+                        if (callbacks_.onBinaryMessage) {
+                            callbacks_.onBinaryMessage(this, std::span(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()));
+                        }
+                    });
+                    break;
+                case ws::Close:
+                    close(false);
+                    break;
+                case ws::Ping:
+                    sendFrame(ws::Pong, reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+                    break;
+                default:// Pong
+                    break;
+            }
+            return !closed_;
+        }
+
+        // Hands a received message to its callback, counting it and timing the callback
+        template<typename Callback>
+        void deliver(Callback&& callback) {
+            count(messages_.received);
+            const Stopwatch stopwatch;
+            callback();
+            if (handling_) handling_->record(stopwatch);
+        }
+
+        // Fails the connection with the given close status code (RFC 6455 section 7.4.1)
+        void fail(uint16_t statusCode) {
+            if (closed_) return;
+
+            const uint8_t status[2] = {static_cast<uint8_t>(statusCode >> 8), static_cast<uint8_t>(statusCode & 0xFF)};
+            sendFrame(ws::Close, status, sizeof(status));
+            close(false);
+        }
+
+        // Writes header and payload with a single vectored write. The payload is only copied when it is compressed
+        // or masked, into buffers owned by the connection, so sending does not allocate once they have grown.
+        // With a send queue the frame is assembled in a pooled buffer and queued instead.
+        void sendFrame(uint8_t opcode, const uint8_t* payload, size_t payloadLen, std::optional<uint64_t> key = std::nullopt) {
+            std::array<uint8_t, 14> header{};
+            if (opcode == ws::Text || opcode == ws::Binary) count(messages_.sent);
+
+            std::lock_guard lg(tx_mtx_);
 
-                std::vector payload(frame.begin() + pos, frame.begin() + pos + payloadLen);
-                if (isMasked) {
-                    for (size_t i = 0; i < payload.size(); ++i) {
-                        payload[i] ^= mask[i % 4];
-                    }
+            // the compression context is shared by all messages, so this must happen in send order
+            bool compressed = false;
+            if (deflate_ && (opcode == ws::Text || opcode == ws::Binary) && deflate_->shouldCompress(payloadLen)) {
+                compressed = deflate_->compress(payload, payloadLen, txCompressed_);
+                if (compressed) {
+                    payload = txCompressed_.data();
+                    payloadLen = txCompressed_.size();
                 }
+            }
 
-                switch (opcode) {
-                    case 0x1:// Text frame
-                    {
-                        std::string message(payload.begin(), payload.end());
-                        if (callbacks_.onMessage) callbacks_.onMessage(this, message);
-                    } break;
-                    case 0x8:// Close frame
-                        close(false);
-
-                        break;
-                    case 0x9:// Ping frame
-                    {
-                        std::vector<uint8_t> pongFrame = {0x8A};// FIN, Pong frame
-                        pongFrame.push_back(static_cast<uint8_t>(payload.size()));
-                        pongFrame.insert(pongFrame.end(), payload.begin(), payload.end());
-                        conn_->write(pongFrame);
-                    } break;
-                    case 0xA:// Pong frame
-                        break;
-                    default:
-                        std::cerr << "Unsupported opcode: " << static_cast<int>(opcode) << std::endl;
-                        break;
+            if (role_ == Role::Server) {
+                const auto headerLen = createHeader(header.data(), opcode, payloadLen, nullptr, compressed);
+                if (sendQueue_) {
+                    auto frame = BufferPool::global().acquire(headerLen + payloadLen);
+                    std::copy_n(header.data(), headerLen, frame.data());
+                    std::copy_n(payload, payloadLen, frame.data() + headerLen);
+                    sendQueue_->push(std::move(frame), key);
+                    return;
                 }
+                const std::array<std::span<const uint8_t>, 2> buffers{
+                        std::span<const uint8_t>(header.data(), headerLen),
+                        std::span<const uint8_t>(payload, payloadLen)};
+                conn_->writev(buffers);
+                return;
             }
+
+            uint8_t mask[4];
+            nextMask(mask);
+            const auto headerLen = createHeader(header.data(), opcode, payloadLen, mask, compressed);
+
+            txBuffer_.resize(payloadLen);
+            ws::applyMask(txBuffer_.data(), payload, payloadLen, mask);
+
+            const std::array<std::span<const uint8_t>, 2> buffers{
+                    std::span<const uint8_t>(header.data(), headerLen),
+                    std::span<const uint8_t>(txBuffer_)};
+            conn_->writev(buffers);
         }
 
-        static std::vector<uint8_t> createFrame(const std::string& message) {
-            std::vector<uint8_t> frame;
-            frame.push_back(0x81);// FIN, text frame
+        // splitmix64, seeded once per connection. Masking guards proxies against payloads chosen by untrusted
+        // scripts, which a native client doesn't run, so this avoids a std::random_device syscall per frame.
+        void nextMask(uint8_t* mask) {
+            uint64_t z = (maskState_ += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z ^= z >> 31;
+            std::memcpy(mask, &z, 4);
+        }
 
-            size_t payloadLen = message.size();
-            uint8_t maskBit = 0x80;// Mask bit set
+        // Writes the frame header (at most 14 bytes) for a final frame and returns its size
+        static size_t createHeader(uint8_t* header, uint8_t opcode, size_t payloadLen, const uint8_t* mask, bool compressed = false) {
+            size_t pos = 0;
+            header[pos++] = 0x80 | (compressed ? 0x40 : 0x00) | opcode;// FIN, RSV1
 
+            const uint8_t maskBit = mask ? 0x80 : 0x00;
             if (payloadLen <= 125) {
-                frame.push_back(static_cast<uint8_t>(payloadLen) | maskBit);
+                header[pos++] = static_cast<uint8_t>(payloadLen) | maskBit;
             } else if (payloadLen <= 65535) {
-                frame.push_back(126 | maskBit);
-                frame.push_back((payloadLen >> 8) & 0xFF);
-                frame.push_back(payloadLen & 0xFF);
+                header[pos++] = 126 | maskBit;
+                header[pos++] = (payloadLen >> 8) & 0xFF;
+                header[pos++] = payloadLen & 0xFF;
             } else {
-                frame.push_back(127 | maskBit);
+                header[pos++] = 127 | maskBit;
                 for (int i = 7; i >= 0; --i) {
-                    frame.push_back((payloadLen >> (i * 8)) & 0xFF);
+                    header[pos++] = (static_cast<uint64_t>(payloadLen) >> (i * 8)) & 0xFF;
                 }
             }
 
-            // Generate random mask
-            uint8_t mask[4];
-            std::random_device rd;
-            for (int i = 0; i < 4; ++i) mask[i] = rd();
-
-            frame.insert(frame.end(), mask, mask + 4);
-
-            // Mask payload
-            for (size_t i = 0; i < payloadLen; ++i) {
-                frame.push_back(message[i] ^ mask[i % 4]);
+            if (mask) {
+                for (int i = 0; i < 4; ++i) header[pos++] = mask[i];
             }
 
-            return frame;
+            return pos;
         }
     };
 };// namespace simple_socket
@@ -0,0 +1,231 @@
+
+#ifndef SIMPLE_SOCKET_WEBSOCKET_FRAME_DECODER_HPP
+#define SIMPLE_SOCKET_WEBSOCKET_FRAME_DECODER_HPP
+
+#include "simple_socket/ws/WebSocketMask.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace simple_socket {
+
+    namespace ws {
+
+        enum Opcode : uint8_t {
+            Continuation = 0x0,
+            Text = 0x1,
+            Binary = 0x2,
+            Close = 0x8,
+            Ping = 0x9,
+            Pong = 0xA
+        };
+
+    }// namespace ws
+
+    // Incremental RFC 6455 frame decoder. Bytes can be fed in arbitrary chunks, a chunk may hold any number
+    // of (partial) frames. Payloads are unmasked while being copied straight into the message being assembled,
+    // which is the only copy made. Fragmented messages are reassembled, control frames may be interleaved.
+    class WebSocketFrameDecoder {
+    public:
+        enum class Result {
+            Ok,           // all bytes consumed, waiting for more
+            Stopped,      // the handler asked to stop, remaining bytes were not consumed
+            ProtocolError,// the peer violated the protocol, the connection should be failed
+            TooLarge      // the message exceeds maxMessageSize
+        };
+
+        enum class MaskPolicy {
+            Any,
+            Required, // servers fail connections sending unmasked frames
+            Forbidden // clients fail connections sending masked frames
+        };
+
+        explicit WebSocketFrameDecoder(size_t maxMessageSize = 64 * 1024 * 1024)
+            : maxMessageSize_(maxMessageSize) {}
+
+        void setMaskPolicy(MaskPolicy policy) {
+            maskPolicy_ = policy;
+        }
+
+        // Accept the RSV1 bit on the first frame of a message, which marks it as compressed (RFC 7692)
+        void setCompression(bool enabled) {
+            compression_ = enabled;
+        }
+
+        [[nodiscard]] size_t maxMessageSize() const {
+            return maxMessageSize_;
+        }
+
+        // handler(uint8_t opcode, const std::string& payload, bool compressed) -> bool is invoked for each complete
+        // message (Text/Binary, after reassembly) and control frame. Returning false stops decoding.
+        // The payload is only valid during the call.
+        template<typename Handler>
+        Result feed(const uint8_t* data, size_t size, Handler&& handler) {
+            const uint8_t* const end = data + size;
+
+            while (data != end) {
+                switch (state_) {
+                    case State::Header: {
+                        const auto n = std::min<size_t>(end - data, headerNeeded() - headerLen_);
+                        std::copy_n(data, n, header_ + headerLen_);
+                        headerLen_ += n;
+                        data += n;
+                        if (headerLen_ < 2 || headerLen_ < headerNeeded()) break;
+
+                        const auto result = parseHeader();
+                        if (result != Result::Ok) return result;
+
+                        if (remaining_ == 0 && !completeFrame(handler)) return Result::Stopped;
+                    } break;
+
+                    case State::Payload: {
+                        const auto n = static_cast<size_t>(std::min<uint64_t>(end - data, remaining_));
+                        auto& target = control() ? control_ : message_;
+                        const auto offset = target.size();
+                        target.resize(offset + n);
+                        auto out = reinterpret_cast<uint8_t*>(target.data() + offset);
+                        if (masked_) {
+                            ws::applyMask(out, data, n, mask_, maskOffset_);
+                            maskOffset_ = (maskOffset_ + n) & 3;
+                        } else {
+                            std::copy_n(data, n, out);
+                        }
+                        data += n;
+                        remaining_ -= n;
+
+                        if (remaining_ == 0 && !completeFrame(handler)) return Result::Stopped;
+                    } break;
+                }
+            }
+
+            return Result::Ok;
+        }
+
+        // True while a fragmented message is being assembled
+        [[nodiscard]] bool fragmented() const {
+            return messageOpcode_ != ws::Continuation;
+        }
+
+    private:
+        enum class State {
+            Header,
+            Payload
+        };
+
+        State state_{State::Header};
+        uint8_t header_[14]{};
+        size_t headerLen_{0};
+
+        uint8_t opcode_{0};
+        bool fin_{false};
+        bool masked_{false};
+        uint8_t mask_[4]{};
+        size_t maskOffset_{0};
+        uint64_t remaining_{0};
+
+        uint8_t messageOpcode_{ws::Continuation};// opcode of the message being assembled
+        bool messageCompressed_{false};
+        bool compression_{false};
+        MaskPolicy maskPolicy_{MaskPolicy::Any};
+        std::string message_;
+        std::string control_;
+        size_t maxMessageSize_;
+
+        [[nodiscard]] bool control() const {
+            return (opcode_ & 0x8) != 0;
+        }
+
+        // Size of the full header, as far as it is known from the bytes received so far
+        [[nodiscard]] size_t headerNeeded() const {
+            if (headerLen_ < 2) return 2;
+
+            size_t size = 2;
+            const auto len = header_[1] & 0x7F;
+            if (len == 126) size += 2;
+            else if (len == 127) size += 8;
+            if (header_[1] & 0x80) size += 4;
+            return size;
+        }
+
+        Result parseHeader() {
+            fin_ = (header_[0] & 0x80) != 0;
+            opcode_ = header_[0] & 0x0F;
+            masked_ = (header_[1] & 0x80) != 0;
+
+            const bool rsv1 = (header_[0] & 0x40) != 0;
+            if (header_[0] & 0x30) return Result::ProtocolError;// no extension uses these
+            if ((maskPolicy_ == MaskPolicy::Required && !masked_) || (maskPolicy_ == MaskPolicy::Forbidden && masked_)) {
+                return Result::ProtocolError;
+            }
+            if (rsv1 && (!compression_ || opcode_ == ws::Continuation || (opcode_ & 0x8))) return Result::ProtocolError;
+
+            size_t pos = 2;
+            uint64_t len = header_[1] & 0x7F;
+            if (len == 126) {
+                len = (header_[2] << 8) | header_[3];
+                pos += 2;
+            } else if (len == 127) {
+                len = 0;
+                for (int i = 0; i < 8; ++i) {
+                    len = (len << 8) | header_[2 + i];
+                }
+                if (len >> 63) return Result::ProtocolError;// most significant bit must be 0
+                pos += 8;
+            }
+            if (masked_) {
+                std::copy_n(header_ + pos, 4, mask_);
+            }
+            maskOffset_ = 0;
+            remaining_ = len;
+
+            switch (opcode_) {
+                case ws::Continuation:
+                    if (!fragmented()) return Result::ProtocolError;
+                    break;
+                case ws::Text:
+                case ws::Binary:
+                    if (fragmented()) return Result::ProtocolError;
+                    messageOpcode_ = opcode_;
+                    messageCompressed_ = rsv1;
+                    break;
+                case ws::Close:
+                case ws::Ping:
+                case ws::Pong:
+                    if (!fin_ || len > 125) return Result::ProtocolError;
+                    control_.clear();
+                    break;
+                default:
+                    return Result::ProtocolError;
+            }
+            if (!control() && len > maxMessageSize_ - message_.size()) {
+                return Result::TooLarge;
+            }
+
+            headerLen_ = 0;
+            state_ = State::Payload;
+            return Result::Ok;
+        }
+
+        template<typename Handler>
+        bool completeFrame(Handler& handler) {
+            state_ = State::Header;
+
+            if (control()) {
+                return handler(opcode_, std::as_const(control_), false);
+            }
+            if (!fin_) return true;
+
+            const auto opcode = messageOpcode_;
+            messageOpcode_ = ws::Continuation;
+            const bool proceed = handler(opcode, std::as_const(message_), messageCompressed_);
+            message_.clear();
+            return proceed;
+        }
+    };
+
+}// namespace simple_socket
+
+#endif//SIMPLE_SOCKET_WEBSOCKET_FRAME_DECODER_HPP
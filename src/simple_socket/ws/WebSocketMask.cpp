@@ -0,0 +1,170 @@
+
+#include "simple_socket/ws/WebSocketMask.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define SIMPLE_SOCKET_MASK_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SIMPLE_SOCKET_MASK_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(SIMPLE_SOCKET_MASK_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMPLE_SOCKET_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMPLE_SOCKET_TARGET_AVX2
+#endif
+
+namespace {
+
+    // Kernels take the mask already rotated by the offset, and process as many bytes as they can in
+    // multiples of 4, which leaves the rotation unchanged for whatever follows.
+    using MaskKernel = size_t (*)(uint8_t* out, const uint8_t* in, size_t size, uint32_t mask);
+
+    size_t maskWords(uint8_t* out, const uint8_t* in, size_t size, uint32_t mask) {
+        const uint64_t mask64 = (static_cast<uint64_t>(mask) << 32) | mask;
+
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, in + i, 8);
+            word ^= mask64;
+            std::memcpy(out + i, &word, 8);
+        }
+        return i;
+    }
+
+#ifdef SIMPLE_SOCKET_MASK_X86
+    size_t maskSSE2(uint8_t* out, const uint8_t* in, size_t size, uint32_t mask) {
+        const __m128i mask128 = _mm_set1_epi32(static_cast<int>(mask));
+
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 16));
+            const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 32));
+            const auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 48));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(a, mask128));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 16), _mm_xor_si128(b, mask128));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 32), _mm_xor_si128(c, mask128));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 48), _mm_xor_si128(d, mask128));
+        }
+        for (; i + 16 <= size; i += 16) {
+            const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(a, mask128));
+        }
+        return i;
+    }
+
+    SIMPLE_SOCKET_TARGET_AVX2
+    size_t maskAVX2(uint8_t* out, const uint8_t* in, size_t size, uint32_t mask) {
+        const __m256i mask256 = _mm256_set1_epi32(static_cast<int>(mask));
+
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64) {
+            const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 32));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(a, mask256));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 32), _mm256_xor_si256(b, mask256));
+        }
+        for (; i + 32 <= size; i += 32) {
+            const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_xor_si256(a, mask256));
+        }
+        return i;
+    }
+
+    bool hasAVX2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;// OS must save the ymm registers
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+#ifdef SIMPLE_SOCKET_MASK_NEON
+    size_t maskNEON(uint8_t* out, const uint8_t* in, size_t size, uint32_t mask) {
+        const uint8x16_t mask128 = vreinterpretq_u8_u32(vdupq_n_u32(mask));
+
+        size_t i = 0;
+        for (; i + 64 <= size; i += 64) {
+            const auto a = vld1q_u8(in + i);
+            const auto b = vld1q_u8(in + i + 16);
+            const auto c = vld1q_u8(in + i + 32);
+            const auto d = vld1q_u8(in + i + 48);
+            vst1q_u8(out + i, veorq_u8(a, mask128));
+            vst1q_u8(out + i + 16, veorq_u8(b, mask128));
+            vst1q_u8(out + i + 32, veorq_u8(c, mask128));
+            vst1q_u8(out + i + 48, veorq_u8(d, mask128));
+        }
+        for (; i + 16 <= size; i += 16) {
+            vst1q_u8(out + i, veorq_u8(vld1q_u8(in + i), mask128));
+        }
+        return i;
+    }
+#endif
+
+    struct Kernel {
+        MaskKernel fn;
+        const char* name;
+    };
+
+    Kernel selectKernel() {
+#if defined(SIMPLE_SOCKET_MASK_X86)
+        if (hasAVX2()) return {maskAVX2, "avx2"};
+        return {maskSSE2, "sse2"};
+#elif defined(SIMPLE_SOCKET_MASK_NEON)
+        return {maskNEON, "neon"};
+#else
+        return {maskWords, "word64"};
+#endif
+    }
+
+    const Kernel& kernel() {
+        static const Kernel k = selectKernel();
+        return k;
+    }
+
+    // Below this size the dispatch costs more than it saves
+    constexpr size_t vectorThreshold = 32;
+
+}// namespace
+
+namespace simple_socket::ws {
+
+    void applyMask(uint8_t* out, const uint8_t* in, size_t size, const uint8_t mask[4], size_t offset) {
+        const uint8_t rotated[4] = {mask[offset & 3], mask[(offset + 1) & 3], mask[(offset + 2) & 3], mask[(offset + 3) & 3]};
+        uint32_t mask32;
+        std::memcpy(&mask32, rotated, 4);
+
+        size_t i = 0;
+        if (size >= vectorThreshold) {
+            i = kernel().fn(out, in, size, mask32);
+        }
+        i += maskWords(out + i, in + i, size - i, mask32);
+        for (; i < size; ++i) {
+            out[i] = in[i] ^ rotated[i & 3];
+        }
+    }
+
+    const char* maskKernel() {
+        return kernel().name;
+    }
+
+}// namespace simple_socket::ws
@@ -0,0 +1,19 @@
+
+#ifndef SIMPLE_SOCKET_WEBSOCKET_MASK_HPP
+#define SIMPLE_SOCKET_WEBSOCKET_MASK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_socket::ws {
+
+    // out[i] = in[i] ^ mask[(offset + i) % 4], where out may equal in (masking in place).
+    // Dispatches to an AVX2/SSE2/NEON kernel, picked once based on the CPU, or a 64-bit word loop.
+    void applyMask(uint8_t* out, const uint8_t* in, size_t size, const uint8_t mask[4], size_t offset = 0);
+
+    // Name of the kernel used by applyMask, e.g. "avx2"
+    const char* maskKernel();
+
+}// namespace simple_socket::ws
+
+#endif//SIMPLE_SOCKET_WEBSOCKET_MASK_HPP
@@ -0,0 +1,54 @@
+
+#include "simple_socket/ws/WebSocketMask.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using namespace simple_socket;
+
+namespace {
+
+    void scalarMask(uint8_t* data, size_t size, const uint8_t mask[4]) {
+        for (size_t i = 0; i < size; ++i) {
+            data[i] ^= mask[i % 4];
+        }
+    }
+
+    template<typename Fn>
+    double throughput(std::vector<uint8_t>& data, size_t iterations, Fn&& fn) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i) {
+            fn(data.data(), data.size());
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(data.size() * iterations) / elapsed.count() / 1e9;// GB/s
+    }
+
+}// namespace
+
+int main() {
+
+    const uint8_t mask[4] = {0x37, 0xFA, 0x21, 0x3D};
+
+    std::cout << "mask kernel: " << ws::maskKernel() << std::endl;
+
+    for (const size_t size : {size_t(125), size_t(4 * 1024), size_t(64 * 1024), size_t(4 * 1024 * 1024)}) {
+        std::vector<uint8_t> data(size, 0x55);
+        const size_t iterations = std::max<size_t>(1, (512 * 1024 * 1024) / size);
+
+        const auto scalar = throughput(data, iterations, [&](uint8_t* p, size_t n) {
+            scalarMask(p, n, mask);
+        });
+        const auto vectorized = throughput(data, iterations, [&](uint8_t* p, size_t n) {
+            ws::applyMask(p, p, n, mask);
+        });
+
+        std::cout << size << " bytes: scalar " << scalar << " GB/s, "
+                  << ws::maskKernel() << " " << vectorized << " GB/s (x" << vectorized / scalar << ")" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+
+#include "simple_socket/BufferedConnection.hpp"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+namespace {
+
+    // Serves a scripted sequence of chunks, one per read
+    struct ScriptedConnection: SimpleConnection {
+
+        explicit ScriptedConnection(std::deque<std::string> chunks, int& reads)
+            : chunks(std::move(chunks)), reads(reads) {}
+
+        int read(uint8_t* buffer, size_t size) override {
+            ++reads;
+            if (chunks.empty()) return -1;
+
+            auto& chunk = chunks.front();
+            const auto n = std::min(size, chunk.size());
+            std::copy_n(chunk.begin(), n, buffer);
+            chunk.erase(0, n);
+            if (chunk.empty()) chunks.pop_front();
+            return static_cast<int>(n);
+        }
+
+        bool write(const uint8_t*, size_t) override {
+            return true;
+        }
+
+        void close() override {}
+
+        std::deque<std::string> chunks;
+        int& reads;
+    };
+
+    std::string str(std::span<const uint8_t> view) {
+        return {view.begin(), view.end()};
+    }
+
+}// namespace
+
+TEST_CASE("BufferedConnection readExact") {
+
+    int reads = 0;
+    BufferedConnection conn(std::make_unique<ScriptedConnection>(std::deque<std::string>{"headerbody1headerbody2"}, reads));
+
+    std::string header(6, '\0');
+    std::string body(5, '\0');
+    for (int i = 1; i <= 2; ++i) {
+        REQUIRE(conn.readExact(reinterpret_cast<uint8_t*>(header.data()), header.size()));
+        REQUIRE(conn.readExact(reinterpret_cast<uint8_t*>(body.data()), body.size()));
+        CHECK(header == "header");
+        CHECK(body == "body" + std::to_string(i));
+    }
+    CHECK(reads == 1);
+    CHECK(conn.available() == 0);
+}
+
+TEST_CASE("BufferedConnection peek") {
+
+    int reads = 0;
+    BufferedConnection conn(std::make_unique<ScriptedConnection>(std::deque<std::string>{"ab", "cd", "ef"}, reads));
+
+    CHECK(str(conn.peek(3)) == "abc");
+    CHECK(reads == 2);
+    CHECK(str(conn.peek(2)) == "ab");
+    conn.consume(2);
+    CHECK(str(conn.peek(4)) == "cdef");
+    conn.consume(4);
+    CHECK(conn.peek(1).empty());// closed
+}
+
+TEST_CASE("BufferedConnection readUntil") {
+
+    int reads = 0;
+    BufferedConnection conn(std::make_unique<ScriptedConnection>(std::deque<std::string>{"GET / HTTP/1.1\r\nHost: x\r", "\n\r\nleftover"}, reads), 64);
+
+    CHECK(str(conn.readUntil("\r\n\r\n")) == "GET / HTTP/1.1\r\nHost: x\r\n\r\n");
+    CHECK(conn.available() == 8);
+
+    std::vector<char> rest(8);
+    REQUIRE(conn.readExact(rest));
+    CHECK(std::string(rest.begin(), rest.end()) == "leftover");
+
+    SECTION("delimiter not found before the buffer is full") {
+        int n = 0;
+        BufferedConnection small(std::make_unique<ScriptedConnection>(std::deque<std::string>{std::string(64, 'x')}, n), 16);
+        CHECK(small.readUntil("\r\n").empty());
+    }
+}
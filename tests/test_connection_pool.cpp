@@ -0,0 +1,183 @@
+#include "simple_socket/ConnectionPool.hpp"
+#include "simple_socket/modbus/HoldingRegister.hpp"
+#include "simple_socket/modbus/ModbusClient.hpp"
+#include "simple_socket/modbus/ModbusServer.hpp"
+#include "simple_socket/util/port_query.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+namespace {
+
+    // Accepts connections and keeps them open until told otherwise
+    struct HoldingServer {
+
+        explicit HoldingServer(uint16_t port)
+            : server(port) {
+            thread = std::thread([this] {
+                try {
+                    while (auto conn = server.accept()) {
+                        std::lock_guard lock(mutex);
+                        connections.push_back(std::move(conn));
+                        ++accepted;
+                    }
+                } catch (std::exception&) {}
+            });
+        }
+
+        void closeAll() {
+            std::lock_guard lock(mutex);
+            connections.clear();
+        }
+
+        void sendToAll(const std::string& message) {
+            std::lock_guard lock(mutex);
+            for (auto& conn : connections) {
+                conn->write(message);
+            }
+        }
+
+        ~HoldingServer() {
+            server.close();
+            thread.join();
+        }
+
+        TCPServer server;
+        std::thread thread;
+        std::mutex mutex;
+        std::vector<std::unique_ptr<SimpleConnection>> connections;
+        std::atomic_int accepted{0};
+    };
+
+    void waitForAccepted(const HoldingServer& server, int count) {
+        for (int i = 0; i < 200 && server.accepted < count; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+}// namespace
+
+TEST_CASE("Connection pool reuses and replaces connections") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    HoldingServer server(*port);
+
+    ConnectionPoolOptions options;
+    options.maxPerHost = 1;
+    options.acquireTimeout = std::chrono::milliseconds(100);
+    ConnectionPool pool(options);
+
+    SimpleConnection* first;
+    {
+        auto lease = pool.acquire("127.0.0.1", *port);
+        REQUIRE(lease);
+        first = lease.get();
+    }
+    CHECK(pool.idleCount() == 1);
+    waitForAccepted(server, 1);
+
+    SECTION("reuses an idle connection") {
+        auto lease = pool.acquire("127.0.0.1", *port);
+        REQUIRE(lease);
+        CHECK(lease.get() == first);
+        CHECK(pool.idleCount() == 0);
+        CHECK(server.accepted == 1);
+    }
+
+    SECTION("waits while maxPerHost are in use") {
+        auto lease = pool.acquire("127.0.0.1", *port);
+        REQUIRE(lease);
+
+        const auto start = std::chrono::steady_clock::now();
+        CHECK_FALSE(pool.acquire("127.0.0.1", *port));
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100));
+
+        std::thread releaser([&lease] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            lease = {};
+        });
+        CHECK(pool.acquire("127.0.0.1", *port));
+        releaser.join();
+    }
+
+    SECTION("replaces a connection the server closed") {
+        const int accepted = server.accepted;
+        server.closeAll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        auto lease = pool.acquire("127.0.0.1", *port);
+        REQUIRE(lease);
+        waitForAccepted(server, accepted + 1);
+        CHECK(server.accepted == accepted + 1);
+        CHECK(lease->write(std::string("ok")));
+    }
+
+    SECTION("replaces a connection with unread data") {
+        const int accepted = server.accepted;
+        server.sendToAll("stale");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+        auto lease = pool.acquire("127.0.0.1", *port);
+        REQUIRE(lease);
+        waitForAccepted(server, accepted + 1);
+        CHECK(server.accepted == accepted + 1);
+    }
+
+    SECTION("invalidated connections are not returned") {
+        {
+            auto lease = pool.acquire("127.0.0.1", *port);
+            REQUIRE(lease);
+            lease.invalidate();
+        }
+        CHECK(pool.idleCount() == 0);
+        CHECK(pool.acquire("127.0.0.1", *port));// the slot was given back
+    }
+
+    SECTION("clear closes idle connections") {
+        pool.clear();
+        CHECK(pool.idleCount() == 0);
+    }
+}
+
+TEST_CASE("Modbus clients share a connection pool") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    HoldingRegister reg(4);
+    reg.setUint16(0, 42);
+
+    ConnectionPoolOptions options;
+    options.maxPerHost = 1;
+    ConnectionPool pool(options);
+
+    ModbusClient client1(pool, "127.0.0.1", *port);
+    ModbusClient client2(pool, "127.0.0.1", *port);
+
+    {
+        ModbusServer server(reg, *port);
+        server.start();
+
+        CHECK(client1.read_uint16(0) == 42);
+        CHECK(client2.write_single_register(1, 7));
+        CHECK(client1.read_uint16(1) == 7);
+        CHECK(pool.idleCount() == 1);
+    }
+
+    // the pooled connection died with the server, the next request goes out on a new one
+    ModbusServer server(reg, *port);
+    server.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    CHECK(client2.read_uint16(0) == 42);
+
+    server.stop();
+}
@@ -0,0 +1,578 @@
+
+#include "simple_socket/Async.hpp"
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/Reactor.hpp"
+#include "simple_socket/SendQueue.hpp"
+#include "simple_socket/TCPSocket.hpp"
+#include "simple_socket/util/port_query.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+TEST_CASE("EventLoop post") {
+
+    EventLoop loop(2);
+    REQUIRE(loop.size() == 2);
+
+    std::atomic_int count{0};
+    for (int i = 0; i < 10; ++i) {
+        loop.post([&count] { ++count; });
+    }
+
+    while (count < 10) {
+        std::this_thread::yield();
+    }
+    loop.stop();
+
+    CHECK(count == 10);
+}
+
+TEST_CASE("EventLoop stopped from a callback") {
+
+    auto loop = std::make_unique<EventLoop>(1);
+    std::promise<void> stopped;
+    std::atomic_bool finished{false};
+    loop->post([&] {
+        loop->stop();
+        stopped.set_value();
+        // still running on the loop's reactor when the loop is destroyed below
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        finished = true;
+    });
+    stopped.get_future().wait();
+
+    // destroying the loop waits for its thread, which would use the freed reactor otherwise
+    loop.reset();
+    CHECK(finished);
+}
+
+TEST_CASE("TCP echo server on EventLoop") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    EventLoop loop(2);
+    TCPServer server(*port, 16);
+
+    std::mutex m;
+    std::set<std::thread::id> loopThreads;
+    std::unordered_map<SimpleConnection*, std::unique_ptr<SimpleConnection>> connections;
+
+    server.acceptAsync(loop, [&](std::unique_ptr<SimpleConnection> conn) {
+        auto c = conn.get();
+        {
+            std::lock_guard lck(m);
+            connections[c] = std::move(conn);
+        }
+        loop.watch(*c, [&, c] {
+            {
+                std::lock_guard lck(m);
+                loopThreads.insert(std::this_thread::get_id());
+            }
+            std::vector<unsigned char> buffer(1024);
+            const auto bytesRead = c->read(buffer);
+            if (bytesRead <= 0) {
+                loop.unwatch(*c);
+                std::lock_guard lck(m);
+                connections.erase(c);
+                return;
+            }
+            c->write(buffer.data(), bytesRead);
+        });
+    });
+
+    const int numClients = 8;
+    std::vector<std::thread> clients;
+    std::atomic_int echoed{0};
+    for (int i = 0; i < numClients; ++i) {
+        clients.emplace_back([&, i] {
+            TCPClientContext ctx;
+            auto conn = ctx.connect("127.0.0.1", *port);
+            REQUIRE(conn);
+
+            const std::string message = "Hello from client " + std::to_string(i);
+            for (int j = 0; j < 10; ++j) {
+                REQUIRE(conn->write(message));
+                std::vector<unsigned char> buffer(message.size());
+                REQUIRE(conn->readExact(buffer));
+                CHECK(std::string(buffer.begin(), buffer.end()) == message);
+            }
+            ++echoed;
+        });
+    }
+
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    server.close();
+    loop.stop();
+
+    CHECK(echoed == numClients);
+    CHECK(loopThreads.size() <= loop.size());
+}
+
+TEST_CASE("TCP server with SO_REUSEPORT shards") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    EventLoop loop(2, true);
+    TCPServerOptions options;
+    options.reusePort = true;
+    TCPServer server(*port, options);
+
+    std::mutex m;
+    std::vector<std::unique_ptr<SimpleConnection>> connections;
+
+    server.acceptAsync(loop, [&](std::unique_ptr<SimpleConnection> conn) {
+        const std::string greeting = "hello";
+        conn->write(greeting);
+        std::lock_guard lck(m);
+        connections.emplace_back(std::move(conn));
+    });
+
+    const int numClients = 16;
+    for (int i = 0; i < numClients; ++i) {
+        TCPClientContext ctx;
+        auto conn = ctx.connect("127.0.0.1", *port);
+        REQUIRE(conn);
+
+        std::vector<unsigned char> buffer(5);
+        REQUIRE(conn->readExact(buffer));
+        CHECK(std::string(buffer.begin(), buffer.end()) == "hello");
+    }
+
+    server.close();
+    loop.stop();
+
+    CHECK(connections.size() == numClients);
+}
+
+#ifndef _WIN32
+TEST_CASE("Reactor is level-triggered") {
+
+    int fds[2];
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    Reactor reactor;
+    std::thread loopThread([&] { reactor.run(); });
+
+    const auto waitUntil = [](const std::atomic_int& counter, int value) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (counter < value && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        return counter >= value;
+    };
+
+    // an empty socket stays writable, so the handler keeps being called
+    std::atomic_int writable{0};
+    std::atomic_int readable{0};
+    reactor.add(fds[0], Reactor::Writable, [&](unsigned events) {
+        if (events & Reactor::Writable) ++writable;
+        if (events & Reactor::Readable) ++readable;
+    });
+    CHECK(waitUntil(writable, 3));
+
+    // unread data keeps it readable
+    reactor.modify(fds[0], Reactor::Readable);
+    REQUIRE(::write(fds[1], "x", 1) == 1);
+    CHECK(waitUntil(readable, 3));
+
+    reactor.remove(fds[0]);
+    // a pending callback may still be running
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const int after = readable;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(readable == after);
+
+    reactor.stop();
+    loopThread.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_CASE("Reactor accepts on a listener") {
+
+    const int listener = socket(AF_INET, SOCK_STREAM, 0);
+    REQUIRE(listener >= 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    REQUIRE(::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+    REQUIRE(::listen(listener, 16) == 0);
+    REQUIRE(getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) == 0);
+    set_nonblocking(listener);
+
+    Reactor reactor;
+    std::thread loopThread([&] { reactor.run(); });
+
+    std::mutex m;
+    std::vector<int> accepted;
+    reactor.addListener(listener, [&](SOCKET sock) {
+        if (sock == INVALID_SOCKET) return;
+        std::lock_guard lck(m);
+        accepted.push_back(sock);
+    });
+    const auto count = [&] {
+        std::lock_guard lck(m);
+        return accepted.size();
+    };
+
+    std::vector<int> clients;
+    const auto connectOne = [&] {
+        const int client = socket(AF_INET, SOCK_STREAM, 0);
+        REQUIRE(::connect(client, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        clients.push_back(client);
+    };
+    for (int i = 0; i < 3; ++i) {
+        connectOne();
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (count() < 3 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    CHECK(count() == 3);
+
+    // left in the backlog once the listener is removed
+    reactor.remove(listener);
+    connectOne();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(count() == 3);
+
+    reactor.stop();
+    loopThread.join();
+    for (const int fd : accepted) ::close(fd);
+    for (const int fd : clients) ::close(fd);
+    ::close(listener);
+}
+#endif
+
+namespace {
+
+    Task<void> echo(EventLoop& loop, std::unique_ptr<SimpleConnection> conn, std::atomic_int& closed) {
+        std::vector<uint8_t> buffer(1024);
+        for (;;) {
+            const auto n = co_await asyncRead(loop, *conn, buffer);
+            if (n <= 0) break;
+            if (!co_await asyncWrite(loop, *conn, std::span(buffer.data(), n))) break;
+        }
+        ++closed;
+    }
+
+    Task<void> serve(EventLoop& loop, TCPServer& server, int connections, std::atomic_int& closed) {
+        for (int i = 0; i < connections; ++i) {
+            spawn(loop, echo(loop, co_await server.asyncAccept(loop), closed));
+        }
+    }
+
+    Task<std::string> exchange(EventLoop& loop, TCPClientContext& ctx, uint16_t port, std::string message) {
+        const auto conn = co_await ctx.asyncConnect(loop, "127.0.0.1", port);
+        if (!conn) co_return "";
+
+        // large enough to fill the socket buffers, so writing has to wait for the echo to be read
+        std::string reply(message.size(), '\0');
+        auto reading = asyncReadExact(loop, *conn, std::span(reinterpret_cast<uint8_t*>(reply.data()), reply.size()));
+        std::promise<void> written;
+        spawn(loop, [](EventLoop& loop, SimpleConnection& conn, const std::string& message, std::promise<void>& done) -> Task<void> {
+            co_await asyncWrite(loop, conn, message);
+            done.set_value();
+        }(loop, *conn, message, written));
+
+        if (!co_await std::move(reading)) co_return "";
+        written.get_future().wait();
+        co_return reply;
+    }
+
+}// namespace
+
+TEST_CASE("TCP echo server with coroutines") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    EventLoop loop(2);
+    TCPServer server(*port);
+
+    const int numClients = 8;
+    std::atomic_int closed{0};
+    spawn(loop, serve(loop, server, numClients, closed));
+
+    TCPClientContext ctx;
+    std::vector<std::future<std::string>> replies;
+    std::vector<std::string> messages;
+    for (int i = 0; i < numClients; ++i) {
+        messages.push_back(std::string(1 << 20, static_cast<char>('a' + i)) + std::to_string(i));
+
+        auto promise = std::make_shared<std::promise<std::string>>();
+        replies.push_back(promise->get_future());
+        spawn(loop, [](EventLoop& loop, TCPClientContext& ctx, uint16_t port, std::string message, std::shared_ptr<std::promise<std::string>> promise) -> Task<void> {
+            promise->set_value(co_await exchange(loop, ctx, port, std::move(message)));
+        }(loop, ctx, *port, messages.back(), promise));
+    }
+
+    for (int i = 0; i < numClients; ++i) {
+        REQUIRE(replies[i].wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+        CHECK(replies[i].get() == messages[i]);
+    }
+
+    // the clients have closed their connections, which ends the echo coroutines
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (closed < numClients && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    CHECK(closed == numClients);
+
+    server.close();
+    loop.stop();
+}
+
+TEST_CASE("Coroutine connect failures") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    EventLoop loop(1);
+    TCPClientContext ctx;
+
+    auto connect = [](EventLoop& loop, TCPClientContext& ctx, std::string host, uint16_t port, std::promise<bool>& failed) -> Task<void> {
+        TCPConnectOptions options;
+        options.timeout = std::chrono::milliseconds(300);
+        const auto conn = co_await ctx.asyncConnect(loop, std::move(host), port, options);
+        failed.set_value(!conn && loop.currentThread());
+    };
+
+    // nothing listens on the port
+    std::promise<bool> refused;
+    spawn(loop, connect(loop, ctx, "127.0.0.1", *port, refused));
+    auto refusedFuture = refused.get_future();
+    REQUIRE(refusedFuture.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK(refusedFuture.get());
+
+    // an address that never answers, the only loop thread keeps running other tasks meanwhile
+    const auto start = std::chrono::steady_clock::now();
+    std::promise<bool> timedOut;
+    spawn(loop, connect(loop, ctx, "10.255.255.1", 9, timedOut));
+    std::promise<void> ran;
+    loop.post([&ran] { ran.set_value(); });
+    CHECK(ran.get_future().wait_for(std::chrono::milliseconds(200)) == std::future_status::ready);
+
+    auto timedOutFuture = timedOut.get_future();
+    REQUIRE(timedOutFuture.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK(timedOutFuture.get());
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+
+    loop.stop();
+}
+
+TEST_CASE("Coroutine exceptions and sleep") {
+
+    EventLoop loop(1);
+
+    std::promise<std::string> result;
+    spawn(loop, [](EventLoop& loop, std::promise<std::string>& result) -> Task<void> {
+        auto failing = [](EventLoop& loop) -> Task<int> {
+            co_await asyncSleep(loop, std::chrono::milliseconds(20));
+            throw std::runtime_error("failed");
+        };
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            co_await failing(loop);
+            result.set_value("no exception");
+        } catch (const std::runtime_error& e) {
+            const bool slept = std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20);
+            result.set_value(slept ? e.what() : "did not sleep");
+        }
+    }(loop, result));
+
+    auto future = result.get_future();
+    REQUIRE(future.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    CHECK(future.get() == "failed");
+
+    loop.stop();
+}
+
+namespace {
+
+    TCPServerOptions serverOptions(const SocketOptions& socketOptions) {
+        TCPServerOptions options;
+        options.socketOptions = socketOptions;
+        return options;
+    }
+
+    // A server side connection watched by loop, and the client it is connected to, both with socketOptions
+    struct WatchedConnection {
+
+        WatchedConnection(EventLoop& loop, uint16_t port, const SocketOptions& socketOptions = {})
+            : loop(loop), server(port, serverOptions(socketOptions)) {
+
+            TCPConnectOptions options;
+            options.socketOptions = socketOptions;
+            client = ctx.connect("127.0.0.1", port, options);
+            conn = server.accept();
+            loop.watch(*conn, [this] {
+                uint8_t buffer[256];
+                if (conn->tryRead(buffer, sizeof(buffer)) < 0) this->loop.unwatch(*conn);
+            });
+        }
+
+        std::string receive(size_t size) const {
+            std::string data(size, '\0');
+            return client->readExact(data) ? data : "";
+        }
+
+        ~WatchedConnection() {
+            loop.unwatch(*conn);
+        }
+
+        EventLoop& loop;
+        TCPServer server;
+        TCPClientContext ctx;
+        std::unique_ptr<SimpleConnection> client;
+        std::unique_ptr<SimpleConnection> conn;
+    };
+
+    std::span<const uint8_t> bytes(std::string_view s) {
+        return {reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+    }
+
+}// namespace
+
+TEST_CASE("SendQueue overflow policies") {
+
+    EventLoop loop;
+
+    // nothing is written before close(), so the queue holds everything pushed
+    const auto holding = [](OverflowPolicy overflow) {
+        SendQueueOptions options;
+        options.flushDelay = std::chrono::hours(1);
+        options.flushThreshold = std::numeric_limits<size_t>::max();
+        options.highWatermark = 10;
+        options.overflow = overflow;
+        return options;
+    };
+
+    {
+        const auto port = getAvailablePort(8000, 9000);
+        REQUIRE(port);
+        WatchedConnection watched(loop, *port);
+        SendQueue queue(loop, *watched.conn, holding(OverflowPolicy::DropNewest));
+        CHECK(queue.push(bytes("aaaa")));
+        CHECK(queue.push(bytes("bbbb")));
+        CHECK_FALSE(queue.push(bytes("cccc")));
+        CHECK(queue.queued() == 8);
+        queue.close();
+        CHECK(watched.receive(8) == "aaaabbbb");
+    }
+    {
+        const auto port = getAvailablePort(8000, 9000);
+        REQUIRE(port);
+        WatchedConnection watched(loop, *port);
+        SendQueue queue(loop, *watched.conn, holding(OverflowPolicy::DropOldest));
+        CHECK(queue.push(bytes("aaaa")));
+        CHECK(queue.push(bytes("bbbb")));
+        CHECK(queue.push(bytes("cccc")));
+        CHECK(queue.queued() == 8);
+        queue.close();
+        CHECK(watched.receive(8) == "bbbbcccc");
+    }
+    {
+        const auto port = getAvailablePort(8000, 9000);
+        REQUIRE(port);
+        WatchedConnection watched(loop, *port);
+        auto options = holding(OverflowPolicy::Conflate);
+        options.highWatermark = 6;
+        SendQueue queue(loop, *watched.conn, options);
+        CHECK(queue.push(bytes("a1"), 1));
+        CHECK(queue.push(bytes("b2"), 2));
+        CHECK(queue.push(bytes("c1"), 1));// replaces a1 in place
+        CHECK(queue.push(bytes("dd")));
+        CHECK(queue.push(bytes("e2"), 2));
+        CHECK_FALSE(queue.push(bytes("ff")));
+        CHECK(queue.queued() == 6);
+        queue.close();
+        CHECK(watched.receive(6) == "c1e2dd");
+    }
+    {
+        const auto port = getAvailablePort(8000, 9000);
+        REQUIRE(port);
+        WatchedConnection watched(loop, *port);
+        SendQueue queue(loop, *watched.conn, holding(OverflowPolicy::Disconnect));
+        CHECK(queue.push(bytes("aaaa")));
+        CHECK(queue.push(bytes("bbbb")));
+        CHECK_FALSE(queue.push(bytes("cccc")));
+        CHECK_FALSE(queue.push(bytes("d")));
+        uint8_t c;
+        CHECK(watched.client->read(&c, 1) <= 0);
+    }
+
+    loop.stop();
+}
+
+TEST_CASE("SendQueue drains a slow reader") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    // socket buffers far below highWatermark, so once a push overflowed the queue only drains as the client reads
+    SocketOptions socketOptions;
+    socketOptions.sendBufferSize = 16 * 1024;
+    socketOptions.receiveBufferSize = 16 * 1024;
+    EventLoop loop;
+    WatchedConnection watched(loop, *port, socketOptions);
+
+    std::atomic_int drained{0};
+    SendQueueOptions options;
+    options.highWatermark = 256 * 1024;
+    options.lowWatermark = 0;
+    options.overflow = OverflowPolicy::DropNewest;
+    options.onDrain = [&] { ++drained; };
+    SendQueue queue(loop, *watched.conn, options);
+
+    // more than the socket buffers and the queue hold together, so the last messages are dropped
+    const int count = 4000;
+    const std::string message(4096, 'x');
+    size_t pushed = 0;
+    for (int i = 0; i < count; ++i) {
+        if (queue.push(bytes(message))) ++pushed;
+    }
+    CHECK(pushed < count);
+    CHECK(queue.queued() <= options.highWatermark);
+    CHECK(drained == 0);
+
+    // one overflow episode, however many pushes it rejected, so one drain once the client caught up
+    CHECK(watched.receive(pushed * message.size()).size() == pushed * message.size());
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (drained == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    CHECK(queue.queued() == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(drained == 1);
+
+    queue.close();
+    loop.stop();
+}
@@ -0,0 +1,63 @@
+#include "simple_socket/ws/HttpRequestParser.hpp"
+
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+TEST_CASE("HttpRequestParser") {
+
+    HttpRequestParser parser;
+    using Result = HttpRequestParser::Result;
+
+    SECTION("complete request") {
+        const std::string request = "GET /path?x=1 HTTP/1.1\r\n"
+                                    "Host: example.com\r\n"
+                                    "Connection:  keep-alive ,Upgrade \r\n"
+                                    "X-Empty:\r\n"
+                                    "\r\n"
+                                    "frame bytes";
+        REQUIRE(parser.parse(request, 1024) == Result::Complete);
+        CHECK(parser.size() == request.size() - 11);
+        CHECK(parser.method() == "GET");
+        CHECK(parser.target() == "/path?x=1");
+        CHECK(parser.headers().size() == 3);
+        CHECK(parser.header("host") == "example.com");
+        CHECK(parser.header("CONNECTION") == "keep-alive ,Upgrade");
+        CHECK(parser.header("x-empty") == "");
+        CHECK_FALSE(parser.header("Upgrade"));
+
+        CHECK(parser.hasToken("connection", "upgrade"));
+        CHECK(parser.hasToken("Connection", "Keep-Alive"));
+        CHECK_FALSE(parser.hasToken("Connection", "close"));
+        CHECK_FALSE(parser.hasToken("Connection", "Upgrad"));
+    }
+
+    SECTION("request arriving in parts") {
+        parser.reset();
+        const std::string request = "GET / HTTP/1.1\r\nUpgrade: websocket\r\n\r\n";
+        // ends in the middle of the empty line
+        for (size_t n : {5, 20, 36, 37}) {
+            CHECK(parser.parse(std::string_view(request).substr(0, n), 1024) == Result::Incomplete);
+        }
+        REQUIRE(parser.parse(request, 1024) == Result::Complete);
+        CHECK(parser.header("upgrade") == "websocket");
+    }
+
+    SECTION("invalid requests") {
+        const auto parse = [](const std::string& request, size_t maxSize = 1024) {
+            HttpRequestParser p;
+            return p.parse(request, maxSize);
+        };
+        CHECK(parse("GET /\r\n\r\n") == Result::Invalid);
+        CHECK(parse("GET / HTTP/1.1\r\nno colon\r\n\r\n") == Result::Invalid);
+        CHECK(parse("GET / HTTP/1.1\r\nName : value\r\n\r\n") == Result::Invalid);
+        CHECK(parse("GET / HTTP/1.1\r\nA: b\r\n folded\r\n\r\n") == Result::Invalid);
+        CHECK(parse("GET / HTTP/1.1\r\nA: " + std::string(100, 'x'), 64) == Result::Invalid);
+
+        std::string many = "GET / HTTP/1.1\r\n";
+        for (size_t i = 0; i <= HttpRequestParser::maxHeaders; ++i) many += "A: b\r\n";
+        CHECK(parse(many + "\r\n", 4096) == Result::Invalid);
+    }
+}
@@ -0,0 +1,190 @@
+#include "simple_socket/MessageConnection.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+namespace {
+
+    // Reads back what was written to it, counting the writes
+    struct LoopbackConnection: SimpleConnection {
+
+        explicit LoopbackConnection(int& writes)
+            : writes(writes) {}
+
+        int read(uint8_t* buffer, size_t size) override {
+            if (data.empty()) return -1;
+
+            const auto n = std::min(size, data.size());
+            std::copy_n(data.begin(), n, buffer);
+            data.erase(0, n);
+            return static_cast<int>(n);
+        }
+
+        bool write(const uint8_t* buffer, size_t size) override {
+            ++writes;
+            data.append(reinterpret_cast<const char*>(buffer), size);
+            return true;
+        }
+
+        void close() override {
+            data.clear();
+        }
+
+        std::string data;
+        int& writes;
+    };
+
+    std::span<const uint8_t> bytes(const std::string& s) {
+        return {reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+    }
+
+    std::string str(const PooledBuffer& buffer) {
+        return {buffer.data(), buffer.data() + buffer.size()};
+    }
+
+}// namespace
+
+TEST_CASE("MessageConnection round trip") {
+
+    int writes = 0;
+    auto loopback = std::make_unique<LoopbackConnection>(writes);
+    auto& raw = *loopback;
+    MessageConnection conn(std::move(loopback));
+
+    const std::string large(100000, 'x');
+    REQUIRE(conn.write(bytes("hello")));
+    REQUIRE(conn.write(bytes("")));
+    REQUIRE(conn.write(bytes(large)));
+    CHECK(writes == 3);
+
+    // big-endian length prefixes
+    CHECK(raw.data.substr(0, 9) == std::string("\0\0\0\5hello", 9));
+
+    CHECK(str(*conn.read()) == "hello");
+    CHECK(conn.read()->empty());
+    CHECK(str(*conn.read()) == large);
+    CHECK_FALSE(conn.read());
+}
+
+TEST_CASE("MessageConnection batching") {
+
+    int writes = 0;
+    MessageConnectionOptions options;
+    options.batchSize = 64;
+    MessageConnection conn(std::make_unique<LoopbackConnection>(writes), options);
+
+    SECTION("several messages in one write") {
+        const std::string a = "first", b = "second", c = "third";
+        const std::span<const uint8_t> messages[] = {bytes(a), bytes(b), bytes(c)};
+        REQUIRE(conn.write(messages));
+        CHECK(writes == 1);
+
+        CHECK(str(*conn.read()) == a);
+        CHECK(str(*conn.read()) == b);
+        CHECK(str(*conn.read()) == c);
+    }
+
+    SECTION("queued messages are written when the batch fills up") {
+        writes = 0;
+        // 4 + 10 bytes each, the fifth does not fit into 64
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(conn.queue(bytes("message " + std::to_string(i) + "!")));
+        }
+        CHECK(writes == 0);
+        CHECK(conn.queued() == 56);
+
+        REQUIRE(conn.queue(bytes("message 4!")));
+        CHECK(writes == 1);
+
+        // larger than a batch, written right after what is queued
+        REQUIRE(conn.queue(bytes(std::string(100, 'y'))));
+        CHECK(writes == 3);
+        CHECK(conn.queued() == 0);
+
+        for (int i = 0; i < 5; ++i) {
+            CHECK(str(*conn.read()) == "message " + std::to_string(i) + "!");
+        }
+        CHECK(str(*conn.read()) == std::string(100, 'y'));
+    }
+}
+
+TEST_CASE("MessageConnection writes queued messages first") {
+
+    int writes = 0;
+    MessageConnection conn(std::make_unique<LoopbackConnection>(writes));
+
+    REQUIRE(conn.queue(bytes("queued")));
+    REQUIRE(conn.write(bytes("written")));
+    CHECK(writes == 1);
+    CHECK(conn.queued() == 0);
+
+    CHECK(str(*conn.read()) == "queued");
+    CHECK(str(*conn.read()) == "written");
+}
+
+TEST_CASE("MessageConnection refuses oversized messages") {
+
+    int writes = 0;
+    auto loopback = std::make_unique<LoopbackConnection>(writes);
+    auto& raw = *loopback;
+    MessageConnectionOptions options;
+    options.maxMessageSize = 10;
+    MessageConnection conn(std::move(loopback), options);
+
+    CHECK_FALSE(conn.write(bytes("eleven char")));
+    CHECK_FALSE(conn.queue(bytes("eleven char")));
+    CHECK(writes == 0);
+
+    raw.data = std::string("\0\0\1\0", 4) + std::string(256, 'z');
+    CHECK_FALSE(conn.read());
+}
+
+TEST_CASE("BufferPool reuses buffers") {
+
+    BufferPool pool(2);
+
+    const uint8_t* first;
+    {
+        const auto buffer = pool.acquire(100);
+        CHECK(buffer.size() == 100);
+        CHECK(buffer.capacity() == 128);
+        first = buffer.data();
+    }
+    // the same size class gets the buffer back
+    auto again = pool.acquire(120);
+    CHECK(again.data() == first);
+    CHECK(pool.stats().acquired == 2);
+    CHECK(pool.stats().allocated <= 1);// none if this thread had a free one cached already
+    again.resize(128);
+    CHECK_THROWS_AS(again.resize(129), std::length_error);
+
+    CHECK(pool.acquire(0).data() == nullptr);
+
+    // beyond the pooled sizes buffers are not rounded up
+    const auto huge = pool.acquire((size_t{1} << 20) + 1);
+    CHECK(huge.capacity() == huge.size());
+    CHECK(pool.stats().acquired == 3);
+}
+
+TEST_CASE("BufferPool hands buffers between threads") {
+
+    auto& pool = BufferPool::global();
+
+    // released on another thread than they were acquired on, as with a reader thread handing messages over
+    const auto exchange = [&] {
+        std::vector<PooledBuffer> buffers;
+        for (int i = 0; i < 32; ++i) buffers.push_back(pool.acquire(1000));
+        std::thread([buffers = std::move(buffers)] {}).join();
+    };
+    exchange();
+    const auto warm = pool.stats();
+    for (int i = 0; i < 10; ++i) exchange();
+
+    CHECK(pool.stats().acquired == warm.acquired + 320);
+    CHECK(pool.stats().allocated == warm.allocated);
+}
@@ -0,0 +1,218 @@
+
+#include "simple_socket/Metrics.hpp"
+#include "simple_socket/TCPSocket.hpp"
+#include "simple_socket/WebSocket.hpp"
+#include "simple_socket/modbus/HoldingRegister.hpp"
+#include "simple_socket/modbus/ModbusClient.hpp"
+#include "simple_socket/modbus/ModbusServer.hpp"
+
+#include "simple_socket/util/port_query.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+namespace {
+
+    // Polls condition for up to 5 seconds
+    template<typename Condition>
+    bool eventually(Condition condition) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return true;
+    }
+
+    size_t occurrences(const std::string& text, const std::string& part) {
+        size_t n = 0;
+        for (auto pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + 1)) ++n;
+        return n;
+    }
+
+}// namespace
+
+TEST_CASE("LatencySnapshot quantiles") {
+
+    LatencySnapshot snapshot;
+    CHECK(snapshot.quantile(0.5).count() == 0);
+    CHECK(snapshot.mean().count() == 0);
+
+    snapshot.counts[10] = 90;// shorter than 1024 ns
+    snapshot.counts[20] = 10;// shorter than about a millisecond
+    snapshot.count = 100;
+    snapshot.sum = std::chrono::nanoseconds(100 * 1000);
+
+    CHECK(snapshot.quantile(0).count() == 1024);
+    CHECK(snapshot.quantile(0.5).count() == 1024);
+    CHECK(snapshot.quantile(0.9).count() == 1024);
+    CHECK(snapshot.quantile(0.91).count() == 1 << 20);
+    CHECK(snapshot.quantile(1).count() == 1 << 20);
+    CHECK(snapshot.mean().count() == 1000);
+    CHECK(LatencySnapshot::upperBound(LatencySnapshot::buckets + 5) == LatencySnapshot::upperBound(LatencySnapshot::buckets - 1));
+}
+
+TEST_CASE("PrometheusWriter") {
+
+    TCPServerStats a;
+    a.accepted = 3;
+    a.acceptLatency.counts[2] = 2;
+    a.acceptLatency.counts[LatencySnapshot::buckets - 1] = 1;
+    a.acceptLatency.count = 3;
+    a.acceptLatency.sum = std::chrono::seconds(1000);
+    TCPServerStats b;
+    b.acceptFailures = 1;
+
+    PrometheusWriter writer;
+    writer.write(a, R"(server="a")");
+    writer.write(b, R"(server="b")");
+    const auto text = writer.str();
+
+    // one family per metric, however many objects were written
+    CHECK(occurrences(text, "# TYPE simple_socket_tcp_accepted_total counter\n") == 1);
+    CHECK(occurrences(text, "# TYPE simple_socket_tcp_accept_seconds histogram\n") == 1);
+    CHECK(occurrences(text, "# HELP ") == 3);
+
+    CHECK(text.find("simple_socket_tcp_accepted_total{server=\"a\"} 3\n") != std::string::npos);
+    CHECK(text.find("simple_socket_tcp_accepted_total{server=\"b\"} 0\n") != std::string::npos);
+    CHECK(text.find("simple_socket_tcp_accept_failures_total{server=\"b\"} 1\n") != std::string::npos);
+
+    // cumulative buckets, with the open ended one in +Inf
+    CHECK(text.find("simple_socket_tcp_accept_seconds_bucket{server=\"a\",le=\"2e-09\"} 0\n") != std::string::npos);
+    CHECK(text.find("simple_socket_tcp_accept_seconds_bucket{server=\"a\",le=\"4e-09\"} 2\n") != std::string::npos);
+    CHECK(text.find("simple_socket_tcp_accept_seconds_bucket{server=\"a\",le=\"1\"}") == std::string::npos);
+    CHECK(text.find("simple_socket_tcp_accept_seconds_bucket{server=\"a\",le=\"+Inf\"} 3\n") != std::string::npos);
+    CHECK(text.find("simple_socket_tcp_accept_seconds_sum{server=\"a\"} 1000\n") != std::string::npos);
+    CHECK(text.find("simple_socket_tcp_accept_seconds_count{server=\"a\"} 3\n") != std::string::npos);
+
+    PrometheusWriter unlabelled;
+    unlabelled.write(ConnectionStats{});
+    CHECK(unlabelled.str().find("simple_socket_connection_read_bytes_total 0\n") != std::string::npos);
+}
+
+TEST_CASE("TCP connection and server stats") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    TCPServer server(*port);
+    TCPClientContext ctx;
+    auto client = ctx.connect("127.0.0.1", *port);
+    REQUIRE(client);
+    auto conn = server.accept();
+    REQUIRE(conn);
+
+    const std::string message = "hello";
+    REQUIRE(client->write(message));
+    std::array<uint8_t, 5> buffer{};
+    REQUIRE(conn->readExact(buffer));
+
+    const auto sent = client->stats();
+    const auto received = conn->stats();
+    const auto stats = server.stats();
+    if (metricsEnabled()) {
+        CHECK(sent.bytesWritten == 5);
+        CHECK(sent.writeCalls == 1);
+        CHECK(sent.bytesRead == 0);
+        CHECK(received.bytesRead == 5);
+        CHECK(received.readCalls >= 1);
+
+        CHECK(stats.accepted == 1);
+        CHECK(stats.acceptFailures == 0);
+        CHECK(stats.acceptLatency.count == 1);
+        CHECK(stats.acceptLatency.sum.count() > 0);
+    } else {
+        CHECK(sent.bytesWritten == 0);
+        CHECK(received.bytesRead == 0);
+        CHECK(stats.accepted == 0);
+        CHECK(stats.acceptLatency.count == 0);
+    }
+}
+
+TEST_CASE("WebSocket server stats") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    WebSocket ws(*port);
+    ws.onMessage = [](WebSocketConnection* c, const std::string& message) {
+        c->send(message);
+    };
+    ws.start();
+
+    std::atomic_int echoes{0};
+    WebSocketClient client;
+    client.onOpen = [](WebSocketConnection* c) {
+        for (int i = 0; i < 3; ++i) c->send("ping " + std::to_string(i));
+    };
+    client.onMessage = [&](WebSocketConnection*, const std::string&) {
+        ++echoes;
+    };
+    client.connect("ws://127.0.0.1:" + std::to_string(*port));
+    REQUIRE(eventually([&] { return echoes == 3; }));
+
+    // a request that is no upgrade
+    TCPClientContext ctx;
+    auto garbage = ctx.connect("127.0.0.1", *port);
+    REQUIRE(garbage);
+    REQUIRE(garbage->write("nonsense\r\n\r\n"));
+    // closed by the server once it is out of the registry
+    std::array<uint8_t, 64> buffer{};
+    CHECK(garbage->read(buffer) <= 0);
+
+    const auto stats = ws.stats();
+    CHECK(stats.open == 1);
+    if (metricsEnabled()) {
+        CHECK(stats.accepted == 2);
+        CHECK(stats.handshakesFailed == 1);
+        CHECK(stats.traffic.messagesReceived == 3);
+        CHECK(stats.traffic.messagesSent == 3);
+        CHECK(stats.traffic.bytesRead > stats.traffic.bytesWritten);// the requests are masked, and there is the garbage
+        CHECK(stats.messageHandling.count == 3);
+    } else {
+        CHECK(stats.accepted == 0);
+        CHECK(stats.traffic.messagesReceived == 0);
+        CHECK(stats.messageHandling.count == 0);
+    }
+
+    client.close();
+    ws.stop();
+}
+
+TEST_CASE("Modbus client stats") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    HoldingRegister reg(4);
+    reg.setUint16(0, 42);
+    ModbusServer server(reg, *port);
+    server.start();
+
+    ModbusClient client("127.0.0.1", *port);
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(client.read_uint16(0) == 42);
+    }
+    REQUIRE(client.read_holding_registers_async(0, 1).get().front() == 42);
+
+    const auto stats = client.stats();
+    if (metricsEnabled()) {
+        CHECK(stats.transactions == 11);
+        CHECK(stats.failures == 0);
+        CHECK(stats.reconnects == 0);
+        CHECK(stats.transactionLatency.count == 11);
+        CHECK(stats.transactionLatency.quantile(0.5) > std::chrono::nanoseconds(0));
+    } else {
+        CHECK(stats.transactions == 0);
+        CHECK(stats.transactionLatency.count == 0);
+    }
+
+    server.stop();
+}
@@ -2,12 +2,24 @@
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
+#include "simple_socket/BufferPool.hpp"
+#include "simple_socket/TCPSocket.hpp"
+#include "simple_socket/modbus/CoilRegister.hpp"
 #include "simple_socket/modbus/HoldingRegister.hpp"
 #include "simple_socket/modbus/ModbusClient.hpp"
+#include "simple_socket/modbus/ModbusReadPlan.hpp"
+#include "simple_socket/modbus/ModbusRtuClient.hpp"
 #include "simple_socket/modbus/ModbusServer.hpp"
+#include "simple_socket/modbus/modbus_helper.hpp"
 
 #include "simple_socket/util/port_query.hpp"
 
+#include <array>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
 
 using namespace simple_socket;
 
@@ -89,6 +101,150 @@ TEST_CASE("HoldingRegister basic operations", "[HoldingRegister]") {
         REQUIRE_THROWS_AS(reg.setDouble(7, value), std::out_of_range);// Not enough space for four registers
         REQUIRE_THROWS_AS(reg.getDouble(7), std::out_of_range);       // Not enough space for four registers
     }
+
+    SECTION("Reading and writing ranges") {
+        HoldingRegister reg(10);
+        const std::array<uint16_t, 3> values{1, 2, 3};
+
+        reg.writeRange(7, values);
+        std::array<uint16_t, 4> read{};
+        reg.readRange(6, read);
+        REQUIRE(read == std::array<uint16_t, 4>{0, 1, 2, 3});
+
+        // Check out-of-bounds behavior
+        REQUIRE_THROWS_AS(reg.writeRange(8, values), std::out_of_range);
+        REQUIRE_THROWS_AS(reg.readRange(7, read), std::out_of_range);
+    }
+}
+
+TEST_CASE("HoldingRegister tracks changes", "[HoldingRegister]") {
+    HoldingRegister reg(100);
+    const auto subscription = reg.subscribe();
+    CHECK(subscription->poll().empty());
+
+    reg.setUint16(3, 1);
+    reg.setUint32(15, 2);// spans blocks 0 and 1
+    reg.setUint16(70, 3);
+    reg.setUint16(99, 4);
+    reg.setUint16(60, 0);// unchanged value
+
+    const auto changes = subscription->poll();
+    REQUIRE(changes.size() == 3);
+    CHECK(changes[0].index == 0);
+    CHECK(changes[0].count == 2 * HoldingRegister::blockSize);
+    CHECK(changes[1].index == 64);
+    CHECK(changes[2].index == 96);
+    CHECK(changes[2].count == 4);// clipped to the size of the register
+    CHECK(subscription->poll().empty());
+
+    // a waiting subscriber is woken by a write on another thread
+    std::thread writer([&reg] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        reg.setUint16(50, 7);
+    });
+    const auto woken = subscription->wait(std::chrono::seconds(5));
+    writer.join();
+    REQUIRE(woken.size() == 1);
+    CHECK(woken[0].index == 48);
+    CHECK(subscription->wait(std::chrono::milliseconds(10)).empty());
+}
+
+TEST_CASE("CoilRegister basic operations", "[CoilRegister]") {
+    CoilRegister coils(20);
+    REQUIRE(coils.size() == 20);
+
+    coils.set(3, true);
+    coils.set(12, true);
+    CHECK(coils.get(3));
+    CHECK_FALSE(coils.get(4));
+
+    // packed with the first coil in the least significant bit
+    std::array<uint8_t, 2> packed{};
+    coils.readRange(3, 10, packed);
+    CHECK(packed == std::array<uint8_t, 2>{0x01, 0x02});
+
+    const std::array<uint8_t, 1> values{0x05};
+    coils.writeRange(17, 3, values);
+    CHECK(coils.get(17));
+    CHECK_FALSE(coils.get(18));
+    CHECK(coils.get(19));
+
+    REQUIRE_THROWS_AS(coils.set(20, true), std::out_of_range);
+    REQUIRE_THROWS_AS(coils.readRange(15, 6, packed), std::out_of_range);
+}
+
+TEST_CASE("HoldingRegister reads are consistent while written", "[HoldingRegister]") {
+    HoldingRegister reg(125);
+
+    // every write sets all registers to the same value, so a torn read shows up as a mix
+    std::atomic_bool done{false};
+    std::thread writer([&] {
+        std::array<uint16_t, 125> values{};
+        for (uint16_t i = 1; i <= 5000; ++i) {
+            values.fill(i);
+            reg.writeRange(0, values);
+        }
+        done = true;
+    });
+
+    bool consistent = true;
+    std::array<uint16_t, 125> snapshot{};
+    while (!done) {
+        reg.readRange(0, snapshot);
+        for (const auto value : snapshot) {
+            if (value != snapshot.front()) consistent = false;
+        }
+    }
+    writer.join();
+
+    CHECK(consistent);
+    CHECK(reg.getUint16(124) == 5000);
+}
+
+TEST_CASE("Modbus register encoding", "[modbus_helper]") {
+    SECTION("Bulk conversion of big endian registers") {
+        // 125 registers, a full read, exercise the vector loop and its tail
+        std::array<uint8_t, 250> bytes{};
+        for (size_t i = 0; i < bytes.size(); ++i) bytes[i] = static_cast<uint8_t>(i);
+
+        std::array<uint16_t, 125> registers{};
+        decode_registers(bytes, registers);
+        for (size_t i = 0; i < registers.size(); ++i) {
+            REQUIRE(registers[i] == ((bytes[i * 2] << 8) | bytes[i * 2 + 1]));
+        }
+
+        std::array<uint8_t, 250> encoded{};
+        encode_registers(registers, encoded);
+        CHECK(encoded == bytes);
+
+        CHECK_THROWS_AS(decode_registers(std::span(bytes.data(), 249), registers), std::out_of_range);
+    }
+
+    SECTION("Word order of 32 and 64-bit values") {
+        constexpr std::array<uint16_t, 4> words{0x0102, 0x0304, 0x0506, 0x0708};
+        static_assert(decode_value<uint32_t>(words) == 0x01020304);
+        static_assert(decode_value<uint32_t, WordOrder::LowFirst>(words) == 0x03040102);
+        static_assert(decode_value<uint64_t>(words) == 0x0102030405060708);
+        static_assert(decode_value<uint64_t, WordOrder::LowFirst>(words) == 0x0708050603040102);
+        static_assert(decode_value<int16_t>(std::array<uint16_t, 1>{0xFFFF}) == -1);
+
+        std::array<uint16_t, 4> out{};
+        encode_value<uint64_t, WordOrder::LowFirst>(0x0708050603040102, out);
+        CHECK(out == words);
+        encode_value<double>(2.5, out);
+        CHECK(out == encode_double(2.5));
+        CHECK(decode_value<double>(out) == 2.5);
+
+        const std::array<float, 2> values{1.5f, -3.25f};
+        std::array<uint16_t, 4> registers{};
+        encode_values<float, WordOrder::LowFirst>(values, registers);
+        CHECK(registers[0] == encode_float(1.5f)[1]);
+        std::array<float, 2> decoded{};
+        decode_values<float, WordOrder::LowFirst>(registers, decoded);
+        CHECK(decoded == values);
+        std::array<double, 2> doubles{};// would take 8 registers
+        CHECK_THROWS_AS(decode_values<double>(registers, doubles), std::out_of_range);
+    }
 }
 
 TEST_CASE("Test modbus client/server") {
@@ -113,5 +269,333 @@ TEST_CASE("Test modbus client/server") {
     REQUIRE(client.read_uint32(1) == v2);
     REQUIRE_THAT(client.read_float(3), Catch::Matchers::WithinRel(v3));
 
+    std::array<uint16_t, 5> registers{};
+    client.read_holding_registers(0, registers);
+    CHECK(registers[0] == v1);
+    CHECK(decode_value<uint32_t>(registers, 1) == v2);
+    CHECK(decode_value<float>(registers, 3) == v3);
+    std::array<uint16_t, 126> tooMany{};
+    CHECK_THROWS_AS(client.read_holding_registers(0, tooMany), std::invalid_argument);
+
+    // request and response buffers come from the pool, which is warm by now
+    const auto before = BufferPool::global().stats();
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(client.read_uint16(0) == v1);
+    }
+    const auto after = BufferPool::global().stats();
+    CHECK(after.acquired - before.acquired == 200);
+    CHECK(after.allocated == before.allocated);
+
+    server.stop();
+}
+
+TEST_CASE("Modbus client pipelines requests") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    HoldingRegister reg(500);
+    for (uint16_t i = 0; i < 500; ++i) {
+        reg.setUint16(i, i * 3);
+    }
+
+    ModbusServer server(reg, *port);
+    server.start();
+
+    ModbusClient client("127.0.0.1", *port);
+
+    std::vector<std::future<std::vector<uint16_t>>> blocks;
+    for (uint16_t block = 0; block < 50; ++block) {
+        blocks.push_back(client.read_holding_registers_async(block * 10, 10));
+    }
+    for (uint16_t block = 0; block < 50; ++block) {
+        const auto values = blocks[block].get();
+        REQUIRE(values.size() == 10);
+        CHECK(values.front() == block * 30);
+        CHECK(values.back() == (block * 10 + 9) * 3);
+    }
+
+    const std::vector<uint16_t> values{7, 8, 9};
+    auto written = client.write_multiple_registers_async(100, values.data(), values.size());
+    auto single = client.write_single_register_async(103, 10);
+    CHECK(written.get());
+    CHECK(single.get());
+
+    // synchronous requests share the pipelined connection
+    CHECK(client.read_holding_registers(100, 4) == std::vector<uint16_t>{7, 8, 9, 10});
+    CHECK_THROWS_AS(client.read_holding_registers_async(499, 2).get(), std::runtime_error);// out of range, answered with an exception
+
+    server.stop();
+}
+
+TEST_CASE("Modbus client matches responses by transaction ID") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    // answers two read requests in reverse order, with the request's start address as the register value
+    TCPServer server(*port);
+    std::thread serverThread([&server] {
+        auto conn = server.accept();
+        std::vector<std::vector<uint8_t>> requests(2, std::vector<uint8_t>(12));
+        for (auto& request : requests) {
+            if (!conn->readExact(request)) return;
+        }
+        for (auto it = requests.rbegin(); it != requests.rend(); ++it) {
+            const auto& request = *it;
+            const std::vector<uint8_t> response{request[0], request[1], 0, 0, 0, 5, request[6], 0x03, 2, request[8], request[9]};
+            conn->write(response);
+        }
+        std::vector<uint8_t> buffer(16);
+        while (conn->read(buffer) > 0) {}
+    });
+
+    {
+        ModbusClient client("127.0.0.1", *port);
+        auto first = client.read_holding_registers_async(11, 1);
+        auto second = client.read_holding_registers_async(22, 1);
+        CHECK(first.get() == std::vector<uint16_t>{11});
+        CHECK(second.get() == std::vector<uint16_t>{22});
+    }
+
+    serverThread.join();
+    server.close();
+}
+
+TEST_CASE("Modbus client drops a connection after a malformed response") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    // answers reads with the start address as register value, the very first one followed by stray bytes
+    TCPServer server(*port);
+    std::atomic_bool first{true};
+    std::atomic_int accepted{0};
+    std::vector<std::thread> handlers;
+    std::thread serverThread([&] {
+        try {
+            while (auto conn = server.accept()) {
+                ++accepted;
+                handlers.emplace_back([&first, conn = std::move(conn)] {
+                    std::vector<uint8_t> request(12);
+                    while (conn->readExact(request)) {
+                        std::vector<uint8_t> response{request[0], request[1], 0, 0, 0, 5, request[6], 0x03, 2, request[8], request[9]};
+                        if (first.exchange(false)) response.insert(response.end(), {0, 0, 0});
+                        conn->write(response);
+                    }
+                });
+            }
+        } catch (std::exception&) {}
+    });
+
+    {
+        ModbusClient client("127.0.0.1", *port);
+        CHECK_THROWS_AS(client.read_holding_registers(11, 1), std::runtime_error);
+        CHECK(client.read_holding_registers(22, 1) == std::vector<uint16_t>{22});
+    }
+    CHECK(accepted == 2);
+
+    server.close();
+    serverThread.join();
+    for (auto& handler : handlers) handler.join();
+}
+
+TEST_CASE("Modbus read plan coalesces tags") {
+
+    SECTION("merges within the gap tolerance") {
+        const ModbusReadPlan plan({{10, ModbusType::Uint16},
+                                   {0, ModbusType::Float},
+                                   {4, ModbusType::Uint32},// gap of 2 after the float
+                                   {30, ModbusType::Double},// too far away
+                                   {32, ModbusType::Uint16},// inside the double's range
+                                   {0, ModbusType::Uint16, 2}},// other unit
+                                  4);
+        const auto& requests = plan.requests();
+        REQUIRE(requests.size() == 3);
+        CHECK((requests[0].unitId == 1 && requests[0].address == 0 && requests[0].count == 11));
+        CHECK((requests[1].unitId == 1 && requests[1].address == 30 && requests[1].count == 4));
+        CHECK((requests[2].unitId == 2 && requests[2].address == 0 && requests[2].count == 1));
+    }
+
+    SECTION("respects the 125 register limit") {
+        const ModbusReadPlan plan({{0, ModbusType::Uint16}, {123, ModbusType::Uint16}, {124, ModbusType::Uint32}}, 200);
+        const auto& requests = plan.requests();
+        REQUIRE(requests.size() == 2);
+        CHECK(requests[0].count == 124);
+        CHECK((requests[1].address == 124 && requests[1].count == 2));
+    }
+
+    SECTION("reads and decodes every tag") {
+        const auto port = getAvailablePort(5020, 5100);
+        REQUIRE(port);
+
+        HoldingRegister reg(400);
+        reg.setUint16(3, 42);
+        reg.setUint32(10, 123456789);
+        reg.setFloat(200, 2.5f);
+        reg.setDouble(205, -1.25);
+        reg.setUint64(390, 0x0102030405060708);
+
+        ModbusServer server(reg, *port);
+        server.start();
+
+        ModbusClient client("127.0.0.1", *port);
+        const ModbusReadPlan plan({{205, ModbusType::Double},
+                                   {3, ModbusType::Uint16},
+                                   {390, ModbusType::Uint64},
+                                   {10, ModbusType::Uint32},
+                                   {200, ModbusType::Float}});
+        CHECK(plan.requests().size() == 3);
+
+        const auto values = plan.execute(client);
+        REQUIRE(values.size() == 5);
+        CHECK(std::get<double>(values[0]) == -1.25);
+        CHECK(std::get<uint16_t>(values[1]) == 42);
+        CHECK(std::get<uint64_t>(values[2]) == 0x0102030405060708);
+        CHECK(std::get<uint32_t>(values[3]) == 123456789);
+        CHECK(std::get<float>(values[4]) == 2.5f);
+
+        server.stop();
+    }
+}
+
+TEST_CASE("Modbus server limits its clients") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    HoldingRegister reg(10);
+    reg.setUint16(0, 7);
+
+    ModbusServer server(reg, *port, ModbusServerOptions{.maxClients = 2, .idleTimeout = std::chrono::milliseconds(200)});
+    server.start();
+
+    // Read Holding Registers, one register at address 0
+    const std::vector<uint8_t> request{0, 1, 0, 0, 0, 6, 1, 0x03, 0, 0, 0, 1};
+    const auto served = [&request](SimpleConnection& conn) {
+        std::vector<uint8_t> response(11);
+        return conn.write(request) && conn.readExact(response) && response[10] == 7;
+    };
+
+    TCPClientContext ctx;
+    auto first = ctx.connect("127.0.0.1", *port);
+    auto second = ctx.connect("127.0.0.1", *port);
+    REQUIRE(first);
+    REQUIRE(second);
+    CHECK(served(*first));
+    CHECK(served(*second));
+
+    SECTION("connections beyond maxClients are closed") {
+        auto third = ctx.connect("127.0.0.1", *port);
+        REQUIRE(third);
+        CHECK_FALSE(served(*third));
+    }
+
+    SECTION("idle clients are disconnected") {
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        CHECK(served(*first));// activity resets the timeout
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+        std::vector<uint8_t> buffer(16);
+        CHECK(second->read(buffer) <= 0);
+        CHECK(served(*first));
+
+        // a freed slot can be taken again
+        auto third = ctx.connect("127.0.0.1", *port);
+        REQUIRE(third);
+        CHECK(served(*third));
+    }
+
+    server.stop();
+}
+
+TEST_CASE("Modbus server exposes coils, discrete inputs and input registers") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    HoldingRegister holding(20);
+    HoldingRegister input(10);
+    CoilRegister coils(30);
+    CoilRegister discrete(10);
+    input.setUint16(2, 1234);
+    discrete.set(9, true);
+
+    ModbusServer server(ModbusDataModel{&holding, &input, &coils, &discrete}, *port);
+    server.start();
+
+    ModbusClient client("127.0.0.1", *port);
+
+    CHECK(client.read_input_registers(2, 1) == std::vector<uint16_t>{1234});
+    CHECK(client.read_discrete_inputs(8, 2) == std::vector<bool>{false, true});
+
+    CHECK(client.write_single_coil(1, true));
+    CHECK(coils.get(1));
+    const std::vector<bool> pattern{true, false, true, true, false, false, true, false, true, true};
+    CHECK(client.write_multiple_coils(15, pattern));
+    CHECK(client.read_coils(15, 10) == pattern);
+    CHECK(client.read_coils(0, 2) == std::vector<bool>{false, true});
+
+    // the write happens before the read, in the same transaction
+    const std::vector<uint16_t> values{5, 6, 7};
+    CHECK(client.read_write_multiple_registers(4, 4, 5, values.data(), values.size()) == std::vector<uint16_t>{0, 5, 6, 7});
+    CHECK(holding.getUint16(7) == 7);
+
+    CHECK_THROWS_AS(client.read_coils(25, 10), std::runtime_error);          // out of range
+    CHECK_THROWS_AS(client.read_input_registers(9, 2), std::runtime_error);  // out of range
+
+    server.stop();
+}
+
+TEST_CASE("Modbus RTU over TCP") {
+
+    const auto port = getAvailablePort(5020, 5100);
+    REQUIRE(port);
+
+    HoldingRegister holding(20);
+    CoilRegister coils(10);
+    for (uint16_t i = 0; i < 10; ++i) {
+        holding.setUint16(i, 0x100 + i);
+    }
+
+    ModbusServer server(ModbusDataModel{.holdingRegisters = &holding, .coils = &coils}, *port, ModbusServerOptions{.framing = ModbusFraming::RtuOverTcp});
+    server.start();
+
+    TCPClientContext ctx;
+
+    SECTION("frames match the specification") {
+        auto conn = ctx.connect("127.0.0.1", *port);
+        REQUIRE(conn);
+
+        // unit 1, read 2 holding registers at 0, CRC low byte first
+        const std::vector<uint8_t> request{0x01, 0x03, 0x00, 0x00, 0x00, 0x02, 0xC4, 0x0B};
+        REQUIRE(conn->write(request));
+        std::vector<uint8_t> response(9);
+        REQUIRE(conn->readExact(response));
+        CHECK(response == std::vector<uint8_t>{0x01, 0x03, 0x04, 0x01, 0x00, 0x01, 0x01, 0x3B, 0x9F});
+    }
+
+    SECTION("client") {
+        ModbusRtuClient client(ctx.connect("127.0.0.1", *port));
+
+        CHECK(client.read_holding_registers(2, 3, 7) == std::vector<uint16_t>{0x102, 0x103, 0x104});
+        CHECK(client.write_single_register(0, 42));
+        CHECK(holding.getUint16(0) == 42);
+
+        const std::vector<uint16_t> values{1, 2, 3};
+        CHECK(client.write_multiple_registers(10, values.data(), values.size()));
+        CHECK(client.read_holding_registers(10, 3) == values);
+
+        CHECK(client.write_single_coil(4, true));
+        CHECK(client.read_coils(3, 3) == std::vector<bool>{false, true, false});
+
+        // broadcasts are carried out, but not answered
+        CHECK(client.write_single_register(1, 99, 0));
+        CHECK(client.read_holding_registers(1, 1) == std::vector<uint16_t>{99});
+
+        CHECK_THROWS_AS(client.read_holding_registers(19, 2), std::runtime_error);// answered with an exception
+        CHECK_THROWS_AS(client.read_input_registers(0, 1), std::runtime_error);   // no input registers
+    }
+
     server.stop();
 }
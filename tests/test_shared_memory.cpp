@@ -3,6 +3,7 @@
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
 #include <thread>
 #include <vector>
 #include <iostream>
@@ -142,3 +143,136 @@ TEST_CASE("Shared Memory buffer overflow handling") {
     std::vector<uint8_t> tooLargeData(smallBufferSize + 1);
     CHECK_FALSE(clientConn->write(tooLargeData));
 }
+
+TEST_CASE("Shared Memory pipelined writes") {
+    constexpr int numMessages = 5000;
+    constexpr size_t maxSize = 300;
+
+    const auto messageSize = [](int i) {
+        return static_cast<size_t>(1 + (i * 37) % maxSize);
+    };
+
+    SharedMemoryOptions options;
+    options.slots = 2;// small ring, so the writer keeps running into a full ring and wraps around often
+    auto serverConn = std::make_unique<SharedMemoryConnection>(sharedMemName, maxSize, true, options);
+    // the client takes the layout from the segment, whatever it asks for
+    auto clientConn = std::make_unique<SharedMemoryConnection>(sharedMemName, 1, false);
+
+    std::thread writer([&] {
+        std::vector<uint8_t> data(maxSize);
+        for (int i = 0; i < numMessages; ++i) {
+            const auto size = messageSize(i);
+            std::fill_n(data.begin(), size, static_cast<uint8_t>(i));
+            REQUIRE(serverConn->write(data.data(), size));
+        }
+    });
+
+    std::vector<uint8_t> buffer(maxSize);
+    bool intact = true;
+    for (int i = 0; i < numMessages && intact; ++i) {
+        const auto bytesRead = clientConn->read(buffer);
+        intact = bytesRead == static_cast<int>(messageSize(i)) &&
+                 std::all_of(buffer.begin(), buffer.begin() + bytesRead, [i](uint8_t b) { return b == static_cast<uint8_t>(i); });
+    }
+    CHECK(intact);
+
+    writer.join();
+}
+
+TEST_CASE("Shared Memory wait policies") {
+    constexpr int roundTrips = 1000;
+
+    for (const auto policy : {WaitPolicy::Block, WaitPolicy::Spin, WaitPolicy::SpinThenYield, WaitPolicy::SpinThenBlock}) {
+        // a pure spinner only makes progress once the scheduler preempts it
+        if (policy == WaitPolicy::Spin && std::thread::hardware_concurrency() < 2) continue;
+
+        SharedMemoryOptions options;
+        options.waitPolicy = policy;
+        options.spinCount = 100;
+        auto serverConn = std::make_unique<SharedMemoryConnection>(sharedMemName, bufferSize, true, options);
+        auto clientConn = std::make_unique<SharedMemoryConnection>(sharedMemName, bufferSize, false, options);
+
+        std::thread echo([&] {
+            std::vector<uint8_t> buffer(bufferSize);
+            for (int i = 0; i < roundTrips; ++i) {
+                const auto bytesRead = serverConn->read(buffer);
+                REQUIRE(bytesRead > 0);
+                REQUIRE(serverConn->write(buffer.data(), bytesRead));
+            }
+        });
+
+        std::vector<uint8_t> buffer(bufferSize);
+        int completed = 0;
+        for (int i = 0; i < roundTrips; ++i) {
+            const auto message = std::to_string(i);
+            REQUIRE(clientConn->write(message));
+            const auto bytesRead = clientConn->read(buffer);
+            if (std::string(buffer.begin(), buffer.begin() + std::max(bytesRead, 0)) == message) ++completed;
+        }
+        CHECK(completed == roundTrips);
+
+        echo.join();
+    }
+}
+
+TEST_CASE("Shared Memory loaned buffers") {
+    constexpr size_t frameSize = 1024 * 1024;
+    constexpr int numFrames = 20;
+
+    auto serverConn = std::make_unique<SharedMemoryConnection>(sharedMemName, frameSize, true);
+    auto clientConn = std::make_unique<SharedMemoryConnection>(sharedMemName, frameSize, false);
+
+    CHECK(serverConn->acquireWriteBuffer(frameSize + 1).empty());
+
+    std::thread producer([&] {
+        for (int i = 0; i < numFrames; ++i) {
+            // render straight into the segment, the last frame comes out shorter than the room asked for
+            const auto buffer = serverConn->acquireWriteBuffer(frameSize);
+            REQUIRE(buffer.size() == frameSize);
+            const auto size = i == numFrames - 1 ? frameSize / 2 : frameSize;
+            std::fill_n(buffer.begin(), size, static_cast<uint8_t>(i));
+            REQUIRE(serverConn->commit(size));
+        }
+    });
+
+    bool intact = true;
+    for (int i = 0; i < numFrames; ++i) {
+        const auto view = clientConn->acquireReadView();
+        const auto expectedSize = i == numFrames - 1 ? frameSize / 2 : frameSize;
+        intact = intact && view.size() == expectedSize &&
+                 std::all_of(view.begin(), view.end(), [i](uint8_t b) { return b == static_cast<uint8_t>(i); });
+
+        std::vector<uint8_t> buffer(16);
+        CHECK(clientConn->read(buffer) == -1);// the view is still held
+
+        clientConn->release();
+    }
+    CHECK(intact);
+
+    producer.join();
+}
+
+TEST_CASE("Shared Memory mapping options") {
+    SharedMemoryOptions options;
+    options.populate = true;
+#ifdef __linux__
+    options.hugePages = true;
+    options.hugePageDirectory = "";// transparent huge pages, best effort
+
+    SECTION("missing hugetlbfs mount") {
+        auto hugetlbfs = options;
+        hugetlbfs.hugePageDirectory = "/nonexistent/hugepages";
+        CHECK_THROWS_AS(SharedMemoryConnection(sharedMemName, bufferSize, true, hugetlbfs), std::runtime_error);
+    }
+#endif
+
+    auto serverConn = std::make_unique<SharedMemoryConnection>(sharedMemName, bufferSize, true, options);
+    auto clientConn = std::make_unique<SharedMemoryConnection>(sharedMemName, bufferSize, false, options);
+
+    const std::string message = generateMessage();
+    REQUIRE(clientConn->write(message));
+
+    std::vector<uint8_t> buffer(bufferSize);
+    const auto bytesRead = serverConn->read(buffer);
+    CHECK(std::string(buffer.begin(), buffer.begin() + std::max(bytesRead, 0)) == message);
+}
@@ -0,0 +1,99 @@
+
+#include "simple_socket/SharedMemoryPubSub.hpp"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace simple_socket;
+
+namespace {
+    const std::string sharedMemName{"test_shared_mem_pubsub"};
+}// namespace
+
+TEST_CASE("Shared Memory publish to many subscribers") {
+    constexpr int numSubscribers = 3;
+    constexpr int numMessages = 2000;
+    constexpr size_t maxSize = 200;
+
+    const auto messageSize = [](int i) {
+        return static_cast<size_t>(1 + (i * 13) % maxSize);
+    };
+
+    SharedMemoryOptions options;
+    options.slots = 2;// the publisher keeps having to wait for the slowest subscriber
+    options.maxSubscribers = numSubscribers;
+    SharedMemoryPublisher publisher(sharedMemName, maxSize, options);
+
+    std::vector<std::unique_ptr<SharedMemorySubscriber>> subscribers;
+    for (int i = 0; i < numSubscribers; ++i) {
+        subscribers.push_back(std::make_unique<SharedMemorySubscriber>(sharedMemName));
+    }
+    CHECK(publisher.subscriberCount() == numSubscribers);
+    CHECK_THROWS_AS(SharedMemorySubscriber(sharedMemName), std::runtime_error);
+
+    std::atomic_int intact{0};
+    std::vector<std::thread> readers;
+    for (int s = 0; s < numSubscribers; ++s) {
+        readers.emplace_back([&, s] {
+            auto& subscriber = *subscribers[s];
+            bool ok = true;
+            for (int i = 0; i < numMessages && ok; ++i) {
+                // one subscriber reads in place, the others copy out
+                if (s == 0) {
+                    const auto view = subscriber.acquireReadView();
+                    ok = view.size() == messageSize(i) &&
+                         std::all_of(view.begin(), view.end(), [i](uint8_t b) { return b == static_cast<uint8_t>(i); });
+                    subscriber.release();
+                } else {
+                    std::vector<uint8_t> buffer(maxSize);
+                    const auto bytesRead = subscriber.read(buffer);
+                    ok = bytesRead == static_cast<int>(messageSize(i)) &&
+                         std::all_of(buffer.begin(), buffer.begin() + bytesRead, [i](uint8_t b) { return b == static_cast<uint8_t>(i); });
+                }
+            }
+            // the end of the stream
+            std::vector<uint8_t> buffer(maxSize);
+            if (ok && subscriber.read(buffer) == -1) ++intact;
+        });
+    }
+
+    std::vector<uint8_t> data(maxSize);
+    for (int i = 0; i < numMessages; ++i) {
+        const auto size = messageSize(i);
+        std::fill_n(data.begin(), size, static_cast<uint8_t>(i));
+        REQUIRE(publisher.publish(data.data(), size));
+    }
+    publisher.close();
+
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    CHECK(intact == numSubscribers);
+}
+
+TEST_CASE("Shared Memory publisher without subscribers") {
+    SharedMemoryOptions options;
+    options.slots = 1;
+    SharedMemoryPublisher publisher(sharedMemName, 64, options);
+
+    // nobody listening, so nothing holds the ring back
+    const std::string message{"dropped"};
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(publisher.publish(message));
+    }
+
+    SharedMemorySubscriber late(sharedMemName);
+    CHECK(publisher.subscriberCount() == 1);
+    REQUIRE(publisher.publish(std::string("seen")));
+
+    std::string buffer(64, '\0');
+    const auto bytesRead = late.read(buffer);
+    CHECK(buffer.substr(0, std::max(bytesRead, 0)) == "seen");
+
+    late.close();
+    CHECK(publisher.subscriberCount() == 0);
+}
@@ -2,6 +2,8 @@
 #include "simple_socket/TCPSocket.hpp"
 #include "simple_socket/util/port_query.hpp"
 
+#include <filesystem>
+#include <fstream>
 #include <thread>
 #include <vector>
 
@@ -128,3 +130,246 @@ TEST_CASE("TCP readexact/write") {
     server.close();
     serverThread.join();
 }
+
+TEST_CASE("TCP writev") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    TCPServer server(*port);
+
+    // more buffers than fit in one batch, and large enough to cause partial writes
+    std::vector<std::vector<uint8_t>> chunks;
+    std::vector<uint8_t> expected;
+    for (int i = 0; i < 40; ++i) {
+        chunks.emplace_back((i % 3 == 0) ? 0 : 4096 * (i % 7) + i, static_cast<uint8_t>(i));
+        expected.insert(expected.end(), chunks.back().begin(), chunks.back().end());
+    }
+
+    std::thread serverThread([&] {
+        std::unique_ptr<SimpleConnection> conn;
+        REQUIRE_NOTHROW(conn = server.accept());
+
+        std::vector<std::span<const uint8_t>> buffers(chunks.begin(), chunks.end());
+        REQUIRE(conn->writev(buffers));
+    });
+
+    TCPClientContext client;
+    const auto conn = client.connect("127.0.0.1", *port);
+    REQUIRE(conn);
+
+    std::vector<uint8_t> received(expected.size());
+    REQUIRE(conn->readExact(received));
+    CHECK(received == expected);
+
+    serverThread.join();
+    server.close();
+}
+
+TEST_CASE("TCP connect with deadline and happy eyeballs") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    TCPServer server(*port);
+    std::thread serverThread([&server] {
+        try {
+            while (true) {
+                auto conn = server.accept();
+            }
+        } catch (std::exception&) {}
+    });
+
+    TCPClientContext client;
+
+    SECTION("falls back across addresses") {
+        // localhost may resolve to ::1 first, which the IPv4 only server refuses,
+        // the refusal hands over to 127.0.0.1 without waiting out the attempt delay
+        TCPConnectOptions options;
+        options.attemptDelay = std::chrono::seconds(5);
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(client.connect("localhost", *port, options));
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+
+        CHECK(client.connect("localhost:" + std::to_string(*port)));// served from the DNS cache
+    }
+
+    SECTION("gives up at the deadline") {
+        // non-routable, the SYN is never answered (or the network is unreachable altogether)
+        TCPConnectOptions options;
+        options.timeout = std::chrono::milliseconds(200);
+        const auto start = std::chrono::steady_clock::now();
+        CHECK_FALSE(client.connect("10.255.255.1", 9, options));
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+    }
+
+    SECTION("connects in parallel") {
+        std::vector<std::future<std::unique_ptr<SimpleConnection>>> connections;
+        for (int i = 0; i < 20; ++i) {
+            connections.push_back(client.connectAsync("127.0.0.1", *port));
+        }
+        int connected = 0;
+        for (auto& conn : connections) {
+            if (conn.get()) ++connected;
+        }
+        CHECK(connected == 20);
+    }
+
+    server.close();
+    serverThread.join();
+}
+
+TEST_CASE("TCP socket options") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    SocketOptions socketOptions;
+    socketOptions.quickAck = true;
+    socketOptions.sendBufferSize = 1 << 18;
+    socketOptions.receiveBufferSize = 1 << 18;
+    socketOptions.keepAlive = true;
+    socketOptions.keepAliveIdle = std::chrono::seconds(30);
+    socketOptions.keepAliveInterval = std::chrono::seconds(5);
+    socketOptions.keepAliveProbes = 3;
+    socketOptions.fastOpen = true;
+    socketOptions.busyPollMicros = 0;
+    socketOptions.incomingCpu = 0;
+
+    TCPServerOptions serverOptions;
+    serverOptions.socketOptions = socketOptions;
+    TCPServer server(*port, serverOptions);
+
+    constexpr int clients = 2;
+    std::thread serverThread([&] {
+        for (int i = 0; i < clients; ++i) {
+            socketHandler(server.accept());
+        }
+    });
+
+    TCPConnectOptions connectOptions;
+    connectOptions.socketOptions = socketOptions;
+    TCPClientContext client;
+    for (int i = 0; i < clients; ++i) {
+        const auto conn = client.connect("127.0.0.1", *port, connectOptions);
+        REQUIRE(conn);
+
+        REQUIRE(conn->write(generateMessage()));
+        std::vector<uint8_t> buffer(1024);
+        const auto bytesRead = conn->read(buffer);
+        REQUIRE(bytesRead == generateResponse(generateMessage()).size());
+        CHECK(std::string(buffer.begin(), buffer.begin() + bytesRead) == generateResponse(generateMessage()));
+    }
+
+    serverThread.join();
+    server.close();
+
+    // connecting waits for the handshake even with a Fast Open cookie at hand, so a closed port is noticed
+    CHECK_FALSE(client.connect("127.0.0.1", *port, connectOptions));
+}
+
+TEST_CASE("TCP server rebinds a port left in TIME_WAIT") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    {
+        TCPServer server(*port);
+        TCPClientContext client;
+        auto conn = client.connect("127.0.0.1", *port);
+        REQUIRE(conn);
+        auto accepted = server.accept();
+        REQUIRE(accepted);
+        accepted.reset();// the server side closes first and keeps the port in TIME_WAIT
+        server.close();
+    }
+
+    TCPServer server(*port);
+}
+
+TEST_CASE("TCP sendFile") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_sendfile.bin").string();
+    std::vector<uint8_t> content(3 * 1024 * 1024 + 17);
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<uint8_t>(i * 31 + i / 4096);
+    }
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(content.data()), static_cast<std::streamsize>(content.size()));
+    }
+
+    TCPServer server(*port);
+
+    constexpr uint64_t offset = 1000;
+    constexpr uint64_t length = 70000;
+
+    std::thread serverThread([&] {
+        const auto conn = server.accept();
+        CHECK(conn->sendFile(path));
+        CHECK(conn->sendFile(path, offset, length));
+        // past the end of the file
+        CHECK_FALSE(conn->sendFile(path, content.size() - 10, 20));
+        CHECK_FALSE(conn->sendFile(path + ".missing"));
+        CHECK(conn->write(std::string("done")));
+    });
+
+    TCPClientContext client;
+    const auto conn = client.connect("127.0.0.1", *port);
+    REQUIRE(conn);
+
+    std::vector<uint8_t> received(content.size());
+    REQUIRE(conn->readExact(received));
+    CHECK(received == content);
+
+    received.resize(length);
+    REQUIRE(conn->readExact(received));
+    CHECK(std::equal(received.begin(), received.end(), content.begin() + offset));
+
+    // what was left of the file when it ended early
+    received.resize(10);
+    REQUIRE(conn->readExact(received));
+    CHECK(std::equal(received.begin(), received.end(), content.end() - 10));
+
+    std::string done(4, '\0');
+    REQUIRE(conn->readExact(done));
+    CHECK(done == "done");
+
+    serverThread.join();
+    server.close();
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("TCP sendFile to a closed peer") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_sendfile_closed.bin").string();
+    {
+        const std::vector<char> content(8 * 1024 * 1024, 'x');
+        std::ofstream file(path, std::ios::binary);
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+
+    TCPServer server(*port);
+    TCPClientContext client;
+    auto conn = client.connect("127.0.0.1", *port);
+    REQUIRE(conn);
+    const auto accepted = server.accept();
+    REQUIRE(accepted);
+    conn.reset();
+
+    // fails, rather than raising SIGPIPE, once the peer's reset is in
+    bool sent = true;
+    for (int i = 0; i < 10 && sent; ++i) {
+        sent = accepted->sendFile(path);
+    }
+    CHECK_FALSE(sent);
+
+    server.close();
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,67 @@
+#include "simple_socket/TimerWheel.hpp"
+
+#include <random>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+TEST_CASE("TimerWheel fires timers on their tick") {
+
+    TimerWheel<uint64_t> wheel;
+    std::vector<uint64_t> fired;
+    const auto tick = [&] {
+        fired.clear();
+        wheel.tick([&](uint64_t deadline) { fired.push_back(deadline); });
+    };
+
+    SECTION("within the first level") {
+        wheel.add(0, 1);// on the next tick at the earliest
+        wheel.add(1, 1);
+        wheel.add(3, 3);
+        CHECK(wheel.size() == 3);
+
+        tick();
+        CHECK(fired == std::vector<uint64_t>{1, 1});
+        tick();
+        CHECK(fired.empty());
+        tick();
+        CHECK(fired == std::vector<uint64_t>{3});
+        CHECK(wheel.empty());
+    }
+
+    SECTION("across levels, added at any time") {
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<uint64_t> delay(1, 300000);
+        size_t pending = 0;
+
+        while (wheel.now() < 400000) {
+            if (wheel.now() < 100000 && wheel.now() % 7 == 0) {
+                const auto ticks = delay(rng);
+                wheel.add(ticks, wheel.now() + ticks);
+                ++pending;
+            }
+            tick();
+            for (const auto deadline : fired) {
+                CHECK(deadline == wheel.now());
+            }
+            pending -= fired.size();
+        }
+        CHECK(pending == 0);
+        CHECK(wheel.empty());
+    }
+
+    SECTION("beyond the last level") {
+        const auto far = (uint64_t{1} << (TimerWheel<uint64_t>::slotBits * TimerWheel<uint64_t>::levels)) + 100;
+        wheel.add(far, wheel.now() + far);
+
+        bool due = false;
+        while (!due) {
+            wheel.tick([&](uint64_t deadline) {
+                CHECK(deadline == wheel.now());
+                due = true;
+            });
+        }
+    }
+}
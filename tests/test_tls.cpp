@@ -0,0 +1,411 @@
+#include "simple_socket/Async.hpp"
+#include "simple_socket/EventLoop.hpp"
+#include "simple_socket/Socket.hpp"
+#include "simple_socket/TCPSocket.hpp"
+#include "simple_socket/util/port_query.hpp"
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+namespace {
+
+    // Writes a throwaway self-signed P-256 certificate for localhost
+    void writeCertificate(const std::string& certFile, const std::string& keyFile) {
+        EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+        EVP_PKEY* key = nullptr;
+        REQUIRE(EVP_PKEY_keygen_init(keyCtx) == 1);
+        REQUIRE(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyCtx, NID_X9_62_prime256v1) == 1);
+        REQUIRE(EVP_PKEY_keygen(keyCtx, &key) == 1);
+        EVP_PKEY_CTX_free(keyCtx);
+
+        X509* cert = X509_new();
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+        X509_set_pubkey(cert, key);
+        X509_NAME* name = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+        X509_set_issuer_name(cert, name);
+        REQUIRE(X509_sign(cert, key, EVP_sha256()) > 0);
+
+        FILE* f = std::fopen(keyFile.c_str(), "wb");
+        REQUIRE(f);
+        PEM_write_PrivateKey(f, key, nullptr, nullptr, 0, nullptr, nullptr);
+        std::fclose(f);
+
+        f = std::fopen(certFile.c_str(), "wb");
+        REQUIRE(f);
+        PEM_write_X509(f, cert);
+        std::fclose(f);
+
+        X509_free(cert);
+        EVP_PKEY_free(key);
+    }
+
+    bool greeted(SimpleConnection& conn) {
+        std::string greeting(5, '\0');
+        return conn.readExact(greeting) && greeting == "hello";
+    }
+
+    bool resumed(SimpleConnection& conn) {
+        const auto tls = dynamic_cast<TLSConnection*>(&conn);
+        return tls && tls->sessionReused();
+    }
+
+    struct Certificate {
+        Certificate() {
+            const auto dir = std::filesystem::temp_directory_path();
+            certFile = (dir / "simple_socket_test_cert.pem").string();
+            keyFile = (dir / "simple_socket_test_key.pem").string();
+            writeCertificate(certFile, keyFile);
+        }
+
+        [[nodiscard]] TCPServerOptions serverOptions() const {
+            TCPServerOptions options;
+            options.useTLS = true;
+            options.certFile = certFile;
+            options.keyFile = keyFile;
+            return options;
+        }
+
+        ~Certificate() {
+            std::filesystem::remove(certFile);
+            std::filesystem::remove(keyFile);
+        }
+
+        std::string certFile;
+        std::string keyFile;
+    };
+
+}// namespace
+
+TEST_CASE("TLS client sessions are resumed") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const Certificate certificate;
+    TCPServer server(*port, certificate.serverOptions());
+
+    std::thread serverThread([&server] {
+        try {
+            while (auto conn = server.accept()) {
+                conn->write(std::string("hello"));
+                std::vector<uint8_t> buffer(16);
+                while (conn->read(buffer) > 0) {}
+            }
+        } catch (std::exception&) {}
+    });
+
+    TCPClientContext client;
+    TCPConnectOptions options;
+    options.useTLS = true;
+
+    {
+        auto conn = client.connect("127.0.0.1", *port, options);
+        REQUIRE(conn);
+        CHECK_FALSE(resumed(*conn));
+        CHECK(greeted(*conn));// also reads the session tickets sent after the handshake
+    }
+    {
+        auto conn = client.connect("127.0.0.1", *port, options);
+        REQUIRE(conn);
+        CHECK(resumed(*conn));
+        CHECK(greeted(*conn));
+    }
+
+    client.clearTlsSessions();
+    {
+        auto conn = client.connect("127.0.0.1", *port, options);
+        REQUIRE(conn);
+        CHECK_FALSE(resumed(*conn));
+        CHECK(greeted(*conn));
+    }
+
+    server.close();
+    serverThread.join();
+}
+
+TEST_CASE("TLS client sessions are resumed by asyncConnect") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const Certificate certificate;
+    TCPServer server(*port, certificate.serverOptions());
+
+    std::thread serverThread([&server] {
+        try {
+            while (auto conn = server.accept()) {
+                conn->write(std::string("hello"));
+                std::vector<uint8_t> buffer(16);
+                while (conn->read(buffer) > 0) {}
+            }
+        } catch (std::exception&) {}
+    });
+
+    EventLoop loop(1);
+    TCPClientContext client;
+    TCPConnectOptions options;
+    options.useTLS = true;
+
+    const auto connect = [&] {
+        std::promise<std::unique_ptr<SimpleConnection>> result;
+        spawn(loop, [](EventLoop& loop, TCPClientContext& client, uint16_t port, TCPConnectOptions options,
+                       std::promise<std::unique_ptr<SimpleConnection>>& result) -> Task<void> {
+            result.set_value(co_await client.asyncConnect(loop, "127.0.0.1", port, options));
+        }(loop, client, *port, options, result));
+        auto future = result.get_future();
+        REQUIRE(future.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        return future.get();
+    };
+
+    {
+        auto conn = connect();
+        REQUIRE(conn);
+        CHECK_FALSE(resumed(*conn));
+        CHECK(greeted(*conn));
+    }
+    {
+        auto conn = connect();
+        REQUIRE(conn);
+        CHECK(resumed(*conn));
+        CHECK(greeted(*conn));
+    }
+
+    server.close();
+    serverThread.join();
+    loop.stop();
+}
+
+TEST_CASE("TLS reads wait for the socket") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const Certificate certificate;
+    TCPServer server(*port, certificate.serverOptions());
+
+    std::thread serverThread([&server] {
+        auto conn = server.accept();
+        std::vector<uint8_t> buffer(16);
+        while (conn->read(buffer) > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            conn->write(std::string("hello"));
+        }
+    });
+
+    TCPClientContext client;
+    TCPConnectOptions options;
+    options.useTLS = true;
+    auto conn = client.connect("127.0.0.1", *port, options);
+    REQUIRE(conn);
+
+    SECTION("blocking read") {
+        REQUIRE(conn->write(std::string("ping")));
+
+        const auto cpuStart = std::clock();
+        CHECK(greeted(*conn));
+        // waiting 200 ms for the reply used to keep a core busy
+        CHECK(std::clock() - cpuStart < CLOCKS_PER_SEC / 20);
+    }
+
+    SECTION("non-blocking read") {
+        std::string greeting(5, '\0');
+        CHECK(conn->tryRead(reinterpret_cast<uint8_t*>(greeting.data()), greeting.size()) == 0);
+
+        REQUIRE(conn->write(std::string("ping")));
+        int n = 0;
+        for (int i = 0; i < 100 && n == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            n = conn->tryRead(reinterpret_cast<uint8_t*>(greeting.data()), greeting.size());
+        }
+        CHECK(n == 5);
+        CHECK(greeting == "hello");
+    }
+
+    conn->close();
+    serverThread.join();
+    server.close();
+}
+
+namespace {
+
+    // Whether a task posted to loop runs within 100 ms, which it does not while a loop thread is blocked
+    bool responsive(EventLoop& loop) {
+        auto ran = std::make_shared<std::promise<void>>();
+        loop.post([ran] { ran->set_value(); });
+        return ran->get_future().wait_for(std::chrono::milliseconds(100)) == std::future_status::ready;
+    }
+
+    // Closed by the server, as seen by a client that never started its handshake
+    bool closedByServer(SimpleConnection& conn) {
+        std::vector<uint8_t> buffer(16);
+        return conn.read(buffer) <= 0;
+    }
+
+    Task<void> acceptTwo(EventLoop& loop, TCPServer& server, std::atomic_int& accepted, std::atomic_int& failed) {
+        std::vector<std::unique_ptr<SimpleConnection>> connections;
+        while (accepted + failed < 2) {
+            try {
+                connections.push_back(co_await server.asyncAccept(loop));
+                ++accepted;
+            } catch (const std::exception&) {
+                ++failed;
+            }
+        }
+    }
+
+}// namespace
+
+TEST_CASE("TLS handshakes do not block acceptAsync") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const Certificate certificate;
+    auto serverOptions = certificate.serverOptions();
+    serverOptions.tlsHandshakeTimeout = std::chrono::milliseconds(300);
+    EventLoop loop(1);
+    TCPServer server(*port, serverOptions);
+
+    TCPClientContext client;
+    TCPConnectOptions options;
+    options.useTLS = true;
+
+    std::mutex m;
+    std::vector<std::unique_ptr<SimpleConnection>> connections;
+    server.acceptAsync(loop, [&](std::unique_ptr<SimpleConnection> conn) {
+        std::lock_guard lck(m);
+        connections.push_back(std::move(conn));
+    });
+
+    // connects, but never sends a ClientHello
+    auto silent = client.connect("127.0.0.1", *port);
+    REQUIRE(silent);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(responsive(loop));
+
+    // handshakes while the silent one is pending
+    auto conn = client.connect("127.0.0.1", *port, options);
+    REQUIRE(conn);
+    CHECK(closedByServer(*silent));
+    const auto handedOver = [&] {
+        std::lock_guard lck(m);
+        return connections.size();
+    };
+    for (int i = 0; i < 100 && handedOver() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(handedOver() == 1);
+    server.close();
+
+    loop.stop();
+}
+
+TEST_CASE("TLS handshakes do not block asyncAccept") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const Certificate certificate;
+    auto serverOptions = certificate.serverOptions();
+    serverOptions.tlsHandshakeTimeout = std::chrono::milliseconds(300);
+    EventLoop loop(1);
+    TCPServer server(*port, serverOptions);
+
+    TCPClientContext client;
+    TCPConnectOptions options;
+    options.useTLS = true;
+
+    std::atomic_int accepted{0};
+    std::atomic_int failed{0};
+    spawn(loop, acceptTwo(loop, server, accepted, failed));
+
+    auto silent = client.connect("127.0.0.1", *port);
+    REQUIRE(silent);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(responsive(loop));
+    CHECK(closedByServer(*silent));
+
+    auto conn = client.connect("127.0.0.1", *port, options);
+    REQUIRE(conn);
+    for (int i = 0; i < 100 && accepted + failed < 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(failed == 1);
+    CHECK(accepted == 1);
+
+    loop.stop();
+}
+
+TEST_CASE("TLS with kernel offload requested") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    const Certificate certificate;
+    auto serverOptions = certificate.serverOptions();
+    serverOptions.kernelTLS = true;
+    TCPServer server(*port, serverOptions);
+
+    std::thread serverThread([&server] {
+        auto conn = server.accept();
+        std::vector<uint8_t> buffer(64 * 1024);
+        int n;
+        while ((n = conn->read(buffer)) > 0) {
+            conn->write(buffer.data(), n);
+        }
+    });
+
+    TCPClientContext client;
+    TCPConnectOptions options;
+    options.useTLS = true;
+    options.kernelTLS = true;
+    auto conn = client.connect("127.0.0.1", *port, options);
+    REQUIRE(conn);
+
+    // whether the kernel takes over depends on the host, the traffic must look the same either way
+    const auto tls = dynamic_cast<TLSConnection*>(conn.get());
+    REQUIRE(tls);
+    INFO("kernel send: " << tls->kernelSend() << ", kernel receive: " << tls->kernelReceive());
+
+    std::vector<uint8_t> message(100000);
+    for (size_t i = 0; i < message.size(); ++i) {
+        message[i] = static_cast<uint8_t>(i * 31);
+    }
+    REQUIRE(conn->write(message));
+
+    std::vector<uint8_t> echoed(message.size());
+    CHECK(conn->readExact(echoed));
+    CHECK(echoed == message);
+
+    // sendfile with kernel send, through SSL_write otherwise
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_tls_sendfile.bin").string();
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(message.data()), static_cast<std::streamsize>(message.size()));
+    }
+    REQUIRE(conn->sendFile(path));
+    std::filesystem::remove(path);
+    CHECK(conn->readExact(echoed));
+    CHECK(echoed == message);
+
+    conn->close();
+    serverThread.join();
+    server.close();
+}
@@ -1,9 +1,16 @@
 
+#include "simple_socket/ReliableUDPConnection.hpp"
 #include "simple_socket/UDPSocket.hpp"
 #include "simple_socket/util/port_query.hpp"
 
 #include <catch2/catch_test_macros.hpp>
 
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+
 using namespace simple_socket;
 
 TEST_CASE("Test UDP") {
@@ -44,6 +51,26 @@ TEST_CASE("Test UDP") {
     REQUIRE(!socket1.sendTo(address, *clientPort, toLargeBuffer));
 }
 
+TEST_CASE("Test UDP closed before destruction") {
+
+    const auto firstPort = getAvailablePort(8000, 9000);
+    const auto secondPort = getAvailablePort(8000, 9000, {*firstPort});
+
+    REQUIRE(firstPort);
+    REQUIRE(secondPort);
+
+    auto first = std::make_unique<UDPSocket>(*firstPort);
+    first->close();
+    first->close();
+
+    // likely gets the descriptor first had, which first must not close again
+    UDPSocket second(*secondPort);
+    first.reset();
+
+    REQUIRE(second.sendTo("127.0.0.1", *secondPort, "Hello"));
+    CHECK(second.recvFrom("127.0.0.1", *secondPort) == "Hello");
+}
+
 TEST_CASE("Test UDP SimpleConnection") {
 
     std::string address{"127.0.0.1"};
@@ -84,3 +111,372 @@ TEST_CASE("Test UDP SimpleConnection") {
     std::vector<unsigned char> toLargeBuffer(MAX_UDP_PACKET_SIZE+1);
     REQUIRE(!conn1->write(toLargeBuffer));
 }
+
+TEST_CASE("Test UDP batches") {
+
+    const auto serverPort = getAvailablePort(8000, 9000);
+    const auto clientPort = getAvailablePort(8000, 9000, {*serverPort});
+
+    REQUIRE(serverPort);
+    REQUIRE(clientPort);
+
+    UDPSocket socket1(*serverPort);
+    UDPSocket socket2(*clientPort);
+
+    const auto endpoint = UDPEndpoint::parse("127.0.0.1", *clientPort);
+    REQUIRE(endpoint);
+    CHECK(endpoint->address() == "127.0.0.1");
+    CHECK(endpoint->port() == *clientPort);
+    CHECK_FALSE(UDPEndpoint::parse("not an address", 1));
+
+    // more than fit in one sendmmsg/recvmmsg call
+    constexpr size_t count = 100;
+    std::vector<std::vector<uint8_t>> payloads;
+    std::vector<UDPMessage> outgoing(count);
+    for (size_t i = 0; i < count; ++i) {
+        payloads.emplace_back(i + 1, static_cast<uint8_t>(i));
+        outgoing[i].buffer = payloads.back();
+        outgoing[i].peer = *endpoint;
+    }
+    REQUIRE(socket1.sendBatch(outgoing) == count);
+
+    std::vector<std::vector<uint8_t>> buffers(count, std::vector<uint8_t>(256));
+    std::vector<UDPMessage> incoming(count);
+    for (size_t i = 0; i < count; ++i) {
+        incoming[i].buffer = buffers[i];
+    }
+
+    size_t received = 0;
+    while (received < count) {
+        const auto n = socket2.recvBatch(std::span(incoming).subspan(received));
+        REQUIRE(n > 0);
+        received += n;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto& message = incoming[i];
+        REQUIRE(message.size == i + 1);
+        CHECK(message.buffer[i] == static_cast<uint8_t>(i));
+        CHECK_FALSE(message.truncated);
+        CHECK(message.peer.port() == *serverPort);
+        CHECK(message.peer.address() == "127.0.0.1");
+    }
+
+    // datagrams larger than their buffer are cut short
+    std::vector<uint8_t> large(100, 1);
+    std::vector<uint8_t> small(10);
+    std::vector<UDPMessage> one{{.buffer = large, .peer = *endpoint}};
+    REQUIRE(socket1.sendBatch(one) == 1);
+    one[0] = {.buffer = small};
+    REQUIRE(socket2.recvBatch(one) == 1);
+    CHECK(one[0].size == small.size());
+#ifdef __linux__
+    CHECK(one[0].truncated);
+#endif
+}
+
+TEST_CASE("Test UDP endpoints") {
+
+    const auto serverPort = getAvailablePort(8000, 9000);
+    const auto clientPort = getAvailablePort(8000, 9000, {*serverPort});
+
+    REQUIRE(serverPort);
+    REQUIRE(clientPort);
+
+    UDPSocket socket1(*serverPort);
+    UDPSocket socket2(*clientPort);
+
+    const auto server = UDPEndpoint::parse("127.0.0.1", *serverPort);
+    const auto client = UDPEndpoint::parse("127.0.0.1", *clientPort);
+    REQUIRE(server);
+    REQUIRE(client);
+
+    SECTION("Sender is reported") {
+        const std::vector<uint8_t> data{1, 2, 3};
+        REQUIRE(socket1.sendTo(*client, data));
+
+        std::vector<uint8_t> buffer(16);
+        const auto [size, from] = socket2.recvFrom(buffer);
+        REQUIRE(size == data.size());
+        CHECK(std::equal(data.begin(), data.end(), buffer.begin()));
+        CHECK(from == *server);
+
+        // and can be replied to
+        REQUIRE(socket2.sendTo(from, std::span(buffer.data(), size)));
+        CHECK(socket1.recvFrom(buffer).second == *client);
+    }
+
+    SECTION("Connected") {
+        auto conn = socket2.makeConnection(*server);
+
+        const std::string message = "Hello";
+        REQUIRE(conn->write(message));
+
+        std::vector<uint8_t> buffer(16);
+        const auto [size, from] = socket1.recvFrom(buffer);
+        REQUIRE(size == message.size());
+        CHECK(from == *client);
+
+        REQUIRE(socket1.sendTo(from, std::span(buffer.data(), size)));
+        std::fill(buffer.begin(), buffer.end(), 0);
+        REQUIRE(conn->read(buffer) == message.size());
+        CHECK(std::string(buffer.begin(), buffer.begin() + message.size()) == message);
+    }
+}
+
+TEST_CASE("Test UDP IPv6") {
+
+    const auto serverPort = getAvailablePort(8000, 9000);
+    const auto clientPort = getAvailablePort(8000, 9000, {*serverPort});
+
+    REQUIRE(serverPort);
+    REQUIRE(clientPort);
+
+    std::unique_ptr<UDPSocket> socket1;
+    try {
+        socket1 = std::make_unique<UDPSocket>(*serverPort, true);
+    } catch (const std::exception&) {
+        return;// IPv6 not available
+    }
+    UDPSocket socket2(*clientPort, true);
+
+    // IPv6 and, as the sockets are dual-stack, IPv4 peers
+    for (const auto* address : {"::1", "127.0.0.1"}) {
+        const auto client = UDPEndpoint::parse(address, *clientPort);
+        REQUIRE(client);
+
+        const std::vector<uint8_t> data{4, 5, 6};
+        REQUIRE(socket1->sendTo(*client, data));
+
+        std::vector<uint8_t> buffer(16);
+        const auto [size, from] = socket2.recvFrom(buffer);
+        REQUIRE(size == data.size());
+        CHECK(from.address() == address);
+        CHECK(from.port() == *serverPort);
+    }
+}
+
+TEST_CASE("Test UDP segmentation offload") {
+
+    const auto serverPort = getAvailablePort(8000, 9000);
+    const auto clientPort = getAvailablePort(8000, 9000, {*serverPort});
+
+    REQUIRE(serverPort);
+    REQUIRE(clientPort);
+
+    UDPSocket socket1(*serverPort);
+    UDPSocket socket2(*clientPort);
+
+    const auto client = UDPEndpoint::parse("127.0.0.1", *clientPort);
+    REQUIRE(client);
+
+    constexpr size_t segmentSize = 1000;
+    constexpr size_t segments = 10;
+    std::vector<uint8_t> payload(segmentSize * segments - 500);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i / segmentSize);
+    }
+
+    // with or without GRO, the datagrams sent are what ends up in the buffers
+    for (const bool gro : {false, true}) {
+        if (gro && !socket2.setGro(true)) break;
+
+        std::vector<UDPMessage> outgoing{{.buffer = payload, .peer = *client, .segmentSize = segmentSize}};
+        REQUIRE(socket1.sendBatch(outgoing) == 1);
+
+        std::vector<std::vector<uint8_t>> buffers(segments, std::vector<uint8_t>(MAX_UDP_PACKET_SIZE));
+        std::vector<UDPMessage> incoming(segments);
+        for (size_t i = 0; i < segments; ++i) {
+            incoming[i].buffer = buffers[i];
+        }
+
+        std::vector<std::vector<uint8_t>> datagrams;
+        size_t bytes = 0;
+        while (bytes < payload.size()) {
+            const auto n = socket2.recvBatch(incoming);
+            REQUIRE(n > 0);
+            for (int i = 0; i < n; ++i) {
+                const auto& message = incoming[i];
+                REQUIRE(message.segmentSize > 0);
+                for (size_t offset = 0; offset < message.size; offset += message.segmentSize) {
+                    const auto size = std::min(message.segmentSize, message.size - offset);
+                    datagrams.emplace_back(message.buffer.begin() + offset, message.buffer.begin() + offset + size);
+                }
+                bytes += message.size;
+            }
+        }
+
+        REQUIRE(datagrams.size() == segments);
+        for (size_t i = 0; i < segments; ++i) {
+            CHECK(datagrams[i].size() == (i + 1 < segments ? segmentSize : segmentSize - 500));
+            CHECK(datagrams[i].front() == i);
+            CHECK(datagrams[i].back() == i);
+        }
+    }
+
+    // too many segments for one send
+    std::vector<uint8_t> large(100 * 10);
+    std::vector<UDPMessage> outgoing{{.buffer = large, .peer = *client, .segmentSize = 10}};
+    CHECK(socket1.sendBatch(outgoing) == -1);
+}
+
+TEST_CASE("Test reliable UDP") {
+
+    const auto serverPort = getAvailablePort(8000, 9000);
+    const auto clientPort = getAvailablePort(8000, 9000, {*serverPort});
+
+    REQUIRE(serverPort);
+    REQUIRE(clientPort);
+
+    std::mutex m;
+    std::vector<std::vector<uint8_t>> unordered;
+
+    ReliableUDPOptions options;
+    options.simulatedLoss = 0.2;
+    options.minRto = std::chrono::milliseconds(5);
+    options.onMessage = [&](UDPDelivery delivery, std::span<const uint8_t> message) {
+        if (delivery == UDPDelivery::ReliableUnordered) {
+            std::lock_guard lck(m);
+            unordered.emplace_back(message.begin(), message.end());
+        }
+    };
+
+    ReliableUDPConnection server(*serverPort, *UDPEndpoint::parse("127.0.0.1", *clientPort), options);
+    ReliableUDPConnection client(*clientPort, *UDPEndpoint::parse("127.0.0.1", *serverPort), options);
+
+    SECTION("Ordered stream survives loss") {
+        // several datagrams per write
+        std::vector<uint8_t> data(100000);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<uint8_t>(i * 7);
+        }
+
+        std::thread writer([&] {
+            CHECK(client.write(data));
+        });
+
+        std::vector<uint8_t> received(data.size());
+        REQUIRE(server.readExact(received));
+        CHECK(received == data);
+        writer.join();
+
+        // and back
+        const std::string reply = "Thanks";
+        REQUIRE(server.write(reply));
+        std::string buffer(reply.size(), '\0');
+        REQUIRE(client.readExact(buffer));
+        CHECK(buffer == reply);
+    }
+
+    SECTION("Unordered messages survive loss") {
+        constexpr uint8_t count = 50;
+        for (uint8_t i = 0; i < count; ++i) {
+            const std::vector<uint8_t> message{i};
+            REQUIRE(client.send(message, UDPDelivery::ReliableUnordered));
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard lck(m);
+                if (unordered.size() == count) break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        std::lock_guard lck(m);
+        REQUIRE(unordered.size() == count);
+        std::vector<bool> seen(count);
+        for (const auto& message : unordered) {
+            REQUIRE(message.size() == 1);
+            seen[message[0]] = true;
+        }
+        CHECK(std::all_of(seen.begin(), seen.end(), [](bool b) { return b; }));
+
+        const std::vector<uint8_t> tooLarge(options.maxPayload + 1);
+        CHECK_FALSE(client.send(tooLarge, UDPDelivery::Unreliable));
+    }
+
+    SECTION("Close is seen by the peer") {
+        client.close();
+        std::vector<uint8_t> buffer(16);
+        CHECK(server.read(buffer) == -1);
+        CHECK_FALSE(client.write(std::string("late")));
+    }
+}
+
+TEST_CASE("Test reliable UDP closed from onMessage") {
+
+    const auto serverPort = getAvailablePort(8000, 9000);
+    const auto clientPort = getAvailablePort(8000, 9000, {*serverPort});
+
+    REQUIRE(serverPort);
+    REQUIRE(clientPort);
+
+    std::unique_ptr<ReliableUDPConnection> server;
+    std::promise<void> closed;
+
+    ReliableUDPOptions options;
+    options.onMessage = [&](UDPDelivery, std::span<const uint8_t>) {
+        server->close();
+        closed.set_value();
+        // still on the receive thread when the connection is destroyed
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    };
+    server = std::make_unique<ReliableUDPConnection>(*serverPort, *UDPEndpoint::parse("127.0.0.1", *clientPort), options);
+    ReliableUDPConnection client(*clientPort, *UDPEndpoint::parse("127.0.0.1", *serverPort));
+
+    const std::vector<uint8_t> message{1};
+    REQUIRE(client.send(message, UDPDelivery::ReliableUnordered));
+    REQUIRE(closed.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+    std::thread([&] { server.reset(); }).join();
+    CHECK_FALSE(server);
+    // a receive thread left running would now touch the freed connection
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+TEST_CASE("Test UDP multicast") {
+
+    const auto groupPort = getAvailablePort(8000, 9000);
+    const auto senderPort = getAvailablePort(8000, 9000, {*groupPort});
+
+    REQUIRE(groupPort);
+    REQUIRE(senderPort);
+
+    const std::string group = "239.255.42.99";
+
+    // two members on the same port
+    UDPSocket member1(*groupPort, false, true);
+    UDPSocket member2(*groupPort, false, true);
+    UDPSocket sender(*senderPort);
+
+    if (!member1.joinGroup(group) || !member2.joinGroup(group)) {
+        return;// no multicast capable interface
+    }
+    CHECK_FALSE(member1.joinGroup("not a group"));
+    CHECK_FALSE(member1.joinGroup("ff02::1"));// an IPv6 group on an IPv4 socket
+
+    REQUIRE(sender.setMulticastTtl(1));
+    REQUIRE(sender.setMulticastLoopback(true));
+    CHECK_FALSE(sender.setMulticastTtl(256));
+
+    const auto destination = UDPEndpoint::parse(group, *groupPort);
+    REQUIRE(destination);
+
+    const std::vector<uint8_t> message{'f', 'e', 'e', 'd'};
+    if (!sender.sendTo(*destination, message)) {
+        return;// no route for multicast
+    }
+
+    for (auto* member : {&member1, &member2}) {
+        std::vector<uint8_t> buffer(16);
+        const auto [size, from] = member->recvFrom(buffer);
+        REQUIRE(size == message.size());
+        CHECK(std::equal(message.begin(), message.end(), buffer.begin()));
+        CHECK(from.port() == *senderPort);
+    }
+
+    CHECK(member1.leaveGroup(group));
+    CHECK_FALSE(member1.leaveGroup(group));
+}
@@ -1,9 +1,18 @@
 
 #include "simple_socket/UnixDomainSocket.hpp"
 
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <thread>
 #include <vector>
 
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 #include <catch2/catch_test_macros.hpp>
 
 using namespace simple_socket;
@@ -113,3 +122,154 @@ TEST_CASE("UNIX Domain Socket readexact/write") {
     server.close();
     serverThread.join();
 }
+
+TEST_CASE("UNIX Domain Socket sendFile") {
+
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_un_sendfile.bin").string();
+    std::string content(200000, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i * 13);
+    }
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << content;
+    }
+
+    UnixDomainServer server(domain);
+
+    std::thread serverThread([&] {
+        const auto conn = server.accept();
+        CHECK(conn->sendFile(path, 5));
+    });
+
+    UnixDomainClientContext client;
+    const auto conn = client.connect(domain);
+    REQUIRE(conn);
+
+    std::string received(content.size() - 5, '\0');
+    REQUIRE(conn->readExact(received));
+    CHECK(received == content.substr(5));
+
+    serverThread.join();
+    server.close();
+    std::filesystem::remove(path);
+}
+
+#ifdef __linux__
+TEST_CASE("UNIX Domain Socket SOCK_SEQPACKET") {
+
+    UnixDomainServer server(domain, UnixSocketType::SeqPacket);
+
+    const std::vector<std::string> messages{"a", "message", std::string(5000, 'x')};
+
+    std::thread serverThread([&] {
+        const auto conn = server.accept();
+        for (const auto& message : messages) {
+            CHECK(conn->write(message));
+        }
+    });
+
+    UnixDomainClientContext client(UnixSocketType::SeqPacket);
+    const auto conn = client.connect(domain);
+    REQUIRE(conn);
+
+    // one read per message, however large the buffer
+    std::vector<uint8_t> buffer(10000);
+    for (const auto& message : messages) {
+        const auto n = conn->read(buffer);
+        REQUIRE(n == message.size());
+        CHECK(std::string(buffer.begin(), buffer.begin() + n) == message);
+    }
+
+    serverThread.join();
+    server.close();
+}
+#endif
+
+#ifndef _WIN32
+TEST_CASE("UNIX Domain Socket passes file descriptors") {
+
+    UnixDomainServer server(domain);
+
+    int pipeFds[2];
+    REQUIRE(pipe(pipeFds) == 0);
+
+    std::thread serverThread([&] {
+        const auto conn = server.accept();
+        const std::string header = "pipe";
+        const int fds[] = {pipeFds[0]};
+        CHECK(writeWithFds(*conn, std::span(reinterpret_cast<const uint8_t*>(header.data()), header.size()), fds));
+
+        CHECK_FALSE(writeWithFds(*conn, {}, fds));
+        std::vector<int> tooMany(maxPassedFds + 1, pipeFds[0]);
+        CHECK_FALSE(writeWithFds(*conn, std::span(reinterpret_cast<const uint8_t*>(header.data()), header.size()), tooMany));
+    });
+
+    UnixDomainClientContext client;
+    const auto conn = client.connect(domain);
+    REQUIRE(conn);
+
+    std::vector<uint8_t> buffer(4);
+    std::vector<int> fds;
+    REQUIRE(readWithFds(*conn, buffer, fds) == 4);
+    CHECK(std::string(buffer.begin(), buffer.end()) == "pipe");
+    REQUIRE(fds.size() == 1);
+    CHECK(fds[0] != pipeFds[0]);
+
+    // the received descriptor is the read end of the same pipe
+    const char message[] = "through the pipe";
+    REQUIRE(::write(pipeFds[1], message, sizeof(message)) == sizeof(message));
+    char received[sizeof(message)]{};
+    REQUIRE(::read(fds[0], received, sizeof(received)) == sizeof(message));
+    CHECK(std::string(received) == message);
+
+    serverThread.join();
+    server.close();
+    ::close(fds[0]);
+    ::close(pipeFds[0]);
+    ::close(pipeFds[1]);
+}
+
+TEST_CASE("UNIX Domain Socket rejects more descriptors than fit") {
+
+    UnixDomainServer server(domain);
+
+    // a peer not bound by maxPassedFds
+    const int sock = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(sock >= 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, domain.c_str(), sizeof(address.sun_path) - 1);
+    REQUIRE(::connect(sock, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+    const auto conn = server.accept();
+    REQUIRE(conn);
+
+    constexpr size_t count = maxPassedFds + 1;
+    std::vector<int> sent(count, sock);
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * count)]{};
+    char byte = 'x';
+    iovec iov{&byte, 1};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    const auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    std::memcpy(CMSG_DATA(cmsg), sent.data(), sizeof(int) * count);
+    REQUIRE(::sendmsg(sock, &msg, 0) == 1);
+
+    std::vector<uint8_t> buffer(1);
+    std::vector<int> fds;
+    CHECK(readWithFds(*conn, buffer, fds) == -1);
+    CHECK(fds.empty());
+
+    // writing to the peer that went away fails rather than raising SIGPIPE
+    ::close(sock);
+    CHECK_FALSE(writeWithFds(*conn, buffer, {}));
+
+    server.close();
+}
+#endif
@@ -0,0 +1,300 @@
+
+#include "simple_socket/TCPSocket.hpp"
+#include "simple_socket/UnixDomainSocket.hpp"
+#include "simple_socket/WireTrace.hpp"
+
+#include "simple_socket/util/port_query.hpp"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+namespace {
+
+    struct Block {
+        uint32_t type;
+        std::vector<uint8_t> body;
+    };
+
+    // The blocks of a pcapng file written in host byte order
+    std::vector<Block> readBlocks(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        const std::vector<uint8_t> file{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+        std::vector<Block> blocks;
+        for (size_t pos = 0; pos + 12 <= file.size();) {
+            uint32_t type;
+            uint32_t length;
+            std::memcpy(&type, &file[pos], 4);
+            std::memcpy(&length, &file[pos + 4], 4);
+            REQUIRE(length % 4 == 0);
+            REQUIRE(pos + length <= file.size());
+            blocks.push_back({type, std::vector<uint8_t>(file.begin() + pos + 8, file.begin() + pos + length - 4)});
+            pos += length;
+        }
+        return blocks;
+    }
+
+    uint32_t u32(const std::vector<uint8_t>& body, size_t at) {
+        uint32_t v;
+        std::memcpy(&v, &body[at], 4);
+        return v;
+    }
+
+    uint16_t be16(const uint8_t* p) {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    uint32_t be32(const uint8_t* p) {
+        return (static_cast<uint32_t>(be16(p)) << 16) | be16(p + 2);
+    }
+
+    // A captured segment, parsed from an enhanced packet block
+    struct Segment {
+        uint16_t srcPort;
+        uint16_t dstPort;
+        uint32_t seq;
+        uint8_t flags;
+        std::string payload;
+        uint32_t originalLength;// of the payload
+    };
+
+    std::vector<Segment> segments(const std::vector<Block>& blocks) {
+        std::vector<Segment> result;
+        for (const auto& block : blocks) {
+            if (block.type != 6) continue;
+            const auto captured = u32(block.body, 12);
+            const auto original = u32(block.body, 16);
+            const auto packet = block.body.data() + 20;
+            REQUIRE(packet[0] == 0x45);// IPv4, no options
+            REQUIRE(packet[9] == 6);   // TCP
+            const auto tcp = packet + 20;
+            result.push_back({be16(tcp), be16(tcp + 2), be32(tcp + 4), tcp[13],
+                              std::string(reinterpret_cast<const char*>(tcp + 20), captured - 40), original - 40});
+        }
+        return result;
+    }
+
+}// namespace
+
+TEST_CASE("WireTrace captures TCP traffic into pcapng") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_trace.pcapng").string();
+
+    TCPServer server(*port);
+    TCPClientContext ctx;
+    auto client = ctx.connect("127.0.0.1", *port);
+    REQUIRE(client);
+    auto conn = server.accept();
+    REQUIRE(conn);
+
+    std::array<uint8_t, 5000> buffer{};
+    REQUIRE(client->write(std::string("untraced")));
+    REQUIRE(conn->readExact(buffer.data(), 8));
+
+    WireTraceOptions options;
+    options.snapLength = 100;
+    WireTrace trace(path, options);
+    CHECK_THROWS_AS(WireTrace(path + ".other"), std::runtime_error);
+
+    REQUIRE(client->write(std::string("hello")));
+    REQUIRE(conn->readExact(buffer.data(), 5));
+    const std::array<std::span<const uint8_t>, 2> parts{
+            std::span(reinterpret_cast<const uint8_t*>("wor"), 3),
+            std::span(reinterpret_cast<const uint8_t*>("ld"), 2)};
+    REQUIRE(conn->writev(parts));
+    REQUIRE(client->readExact(buffer.data(), 5));
+    std::vector<uint8_t> large(5000, 'x');
+    REQUIRE(client->write(large));
+    REQUIRE(conn->readExact(buffer.data(), large.size()));
+
+    trace.stop();
+    REQUIRE(client->write(std::string("after")));
+    REQUIRE(conn->readExact(buffer.data(), 5));
+
+    const auto blocks = readBlocks(path);
+    REQUIRE(blocks.size() >= 2);
+    CHECK(blocks[0].type == 0x0A0D0D0A);
+    CHECK(u32(blocks[0].body, 0) == 0x1A2B3C4D);
+    CHECK(blocks[1].type == 1);
+    CHECK((u32(blocks[1].body, 0) & 0xFFFF) == 101);// LINKTYPE_RAW
+
+    const auto captured = segments(blocks);
+    CHECK(captured.size() == trace.stats().frames);
+    CHECK(trace.stats().dropped == 0);
+
+    // the client's and the accepted connection's view of each exchange, every one towards or from the server port
+    size_t hello = 0;
+    size_t world = 0;
+    uint64_t largeBytes = 0;
+    for (const auto& segment : captured) {
+        CHECK((segment.dstPort == *port || segment.srcPort == *port));
+        CHECK(segment.payload.find("untraced") == std::string::npos);
+        CHECK(segment.payload.find("after") == std::string::npos);
+        if (segment.payload == "hello") {
+            CHECK(segment.dstPort == *port);
+            CHECK(segment.seq == 1);
+            ++hello;
+        } else if (segment.payload == "world") {
+            CHECK(segment.srcPort == *port);
+            ++world;
+        } else if (segment.dstPort == *port && segment.seq > 1) {
+            // the large write, cut at the snap length but counted in full by the sequence numbers
+            CHECK(segment.payload.size() <= 100);
+            CHECK(segment.payload.size() <= segment.originalLength);
+            largeBytes += segment.originalLength;
+        }
+    }
+    CHECK(hello == 2);
+    CHECK(world == 2);
+    CHECK(largeBytes == 2 * large.size());
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("WireTrace drops what does not fit its ring") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_trace_drops.pcapng").string();
+
+    TCPServer server(*port);
+    TCPClientContext ctx;
+    auto client = ctx.connect("127.0.0.1", *port);
+    REQUIRE(client);
+    auto conn = server.accept();
+    REQUIRE(conn);
+
+    WireTraceOptions options;
+    options.ringSize = 4096;
+    options.flushInterval = std::chrono::seconds(60);
+    WireTrace trace(path, options);
+
+    uint8_t byte = 0;
+    for (int i = 0; i < 200; ++i) {
+        REQUIRE(client->write(&byte, 1));
+    }
+    trace.stop();
+
+    const auto stats = trace.stats();
+    CHECK(stats.dropped > 0);
+    CHECK(stats.frames > 0);
+    CHECK(stats.frames + stats.dropped == 200);
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("WireTrace records sendFile and closed connections") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_trace_file.pcapng").string();
+    const auto filePath = (std::filesystem::temp_directory_path() / "simple_socket_trace_file.bin").string();
+
+    std::string content(10000, '\0');
+    for (size_t i = 0; i < content.size(); ++i) content[i] = static_cast<char>('a' + i % 26);
+    {
+        std::ofstream file(filePath, std::ios::binary);
+        file << content;
+    }
+
+    TCPServer server(*port);
+    TCPClientContext ctx;
+    auto client = ctx.connect("127.0.0.1", *port);
+    REQUIRE(client);
+    auto conn = server.accept();
+    REQUIRE(conn);
+
+    WireTrace trace(path);
+
+    REQUIRE(conn->sendFile(filePath));
+    REQUIRE(conn->write(std::string("tail")));
+    std::vector<uint8_t> buffer(content.size() + 4);
+    REQUIRE(client->readExact(buffer));
+    client.reset();
+    conn.reset();
+
+    trace.stop();
+
+    const auto captured = segments(readBlocks(path));
+    CHECK(trace.stats().dropped == 0);
+
+    // the file and what follows it count into the same sequence, then both ends closing ends the streams
+    constexpr uint8_t finAck = 0x11;
+    size_t file = 0;
+    size_t tail = 0;
+    size_t fins = 0;
+    for (const auto& segment : captured) {
+        if (segment.srcPort == *port && segment.originalLength == content.size()) {
+            CHECK(segment.seq == 1);
+            CHECK(!segment.payload.empty());
+            CHECK(content.starts_with(segment.payload));
+            ++file;
+        } else if (segment.payload == "tail") {
+            CHECK(segment.seq == 1 + content.size());
+            ++tail;
+        } else if (segment.flags == finAck) {
+            CHECK(segment.seq == (segment.srcPort == *port ? 1 + content.size() + 4 : 1));
+            ++fins;
+        }
+    }
+    CHECK(file >= 1);
+    CHECK(tail >= 1);
+    CHECK(fins == 2);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(filePath);
+}
+
+#ifndef _WIN32
+TEST_CASE("WireTrace records descriptor passing") {
+
+    const std::string domain{"/tmp/simple_socket_trace_unix"};
+    const auto path = (std::filesystem::temp_directory_path() / "simple_socket_trace_fds.pcapng").string();
+
+    UnixDomainServer server(domain);
+    UnixDomainClientContext ctx;
+    const auto client = ctx.connect(domain);
+    REQUIRE(client);
+    const auto conn = server.accept();
+    REQUIRE(conn);
+
+    int pipeFds[2];
+    REQUIRE(pipe(pipeFds) == 0);
+
+    WireTrace trace(path);
+    const std::string message = "with a pipe";
+    REQUIRE(writeWithFds(*client, std::span(reinterpret_cast<const uint8_t*>(message.data()), message.size()), std::span(pipeFds, 1)));
+    std::vector<uint8_t> buffer(message.size());
+    std::vector<int> fds;
+    REQUIRE(readWithFds(*conn, buffer, fds) == static_cast<int>(message.size()));
+    trace.stop();
+
+    // written by one end, read by the other
+    size_t recorded = 0;
+    for (const auto& segment : segments(readBlocks(path))) {
+        if (segment.payload == message) ++recorded;
+    }
+    CHECK(recorded == 2);
+
+    for (const auto fd : fds) ::close(fd);
+    ::close(pipeFds[0]);
+    ::close(pipeFds[1]);
+    server.close();
+    std::filesystem::remove(path);
+}
+#endif
@@ -1,16 +1,40 @@
 
+#include "simple_socket/TCPSocket.hpp"
 #include "simple_socket/WebSocket.hpp"
 #include "simple_socket/util/port_query.hpp"
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <catch2/catch_test_macros.hpp>
 
 using namespace simple_socket;
 
+namespace {
+
+    const std::string upgradeRequest = "GET / HTTP/1.1\r\n"
+                                       "Host: 127.0.0.1\r\n"
+                                       "Upgrade: websocket\r\n"
+                                       "Connection: Upgrade\r\n"
+                                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                       "Sec-WebSocket-Version: 13\r\n\r\n";
+
+    // The head of the server's response, or what arrived of it until the connection closed
+    std::string readResponse(SimpleConnection& conn) {
+        std::string response;
+        char c;
+        while (response.find("\r\n\r\n") == std::string::npos && conn.read(reinterpret_cast<uint8_t*>(&c), 1) == 1) {
+            response += c;
+        }
+        return response;
+    }
+
+}// namespace
+
 TEST_CASE("test Websocket") {
 
     const auto port = getAvailablePort(8000, 9000);
@@ -92,3 +116,473 @@ TEST_CASE("test Websocket") {
     CHECK(servermsg == "Hello from client!");
     CHECK(clientmsg == "Hello from server!");
 }
+
+TEST_CASE("test Websocket binary messages") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::vector<uint8_t> payload(100000);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<uint8_t>(i);
+    }
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<uint8_t> received;
+    std::atomic_bool textReceived{false};
+
+    WebSocket ws(*port);
+    ws.onBinaryMessage = [](auto c, std::span<const uint8_t> data) {
+        c->sendBinary(data);// echo
+    };
+    ws.onMessage = [&](auto, const auto&) {
+        textReceived = true;
+    };
+    ws.start();
+
+    WebSocketClient client;
+    client.onBinaryMessage = [&](auto, std::span<const uint8_t> data) {
+        std::lock_guard lock(m);
+        received.assign(data.begin(), data.end());
+        cv.notify_one();
+    };
+    client.connect("ws://127.0.0.1:" + std::to_string(*port));
+    client.sendBinary(payload);
+
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return !received.empty(); });
+    }
+
+    client.close();
+    ws.stop();
+
+    CHECK(received == payload);
+    CHECK_FALSE(textReceived);
+}
+
+TEST_CASE("test Websocket broadcast and topics") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::mutex m;
+    std::condition_variable cv;
+    int subscribed = 0;
+
+    WebSocket ws(*port);
+    ws.onMessage = [&](auto c, const std::string& topic) {
+        ws.subscribe(c, topic);
+        std::lock_guard lock(m);
+        ++subscribed;
+        cv.notify_all();
+    };
+    ws.start();
+
+    const int numClients = 3;
+    std::vector<std::unique_ptr<WebSocketClient>> clients;
+    std::vector<std::vector<std::string>> received(numClients);
+    for (int i = 0; i < numClients; ++i) {
+        auto& client = clients.emplace_back(std::make_unique<WebSocketClient>());
+        client->onMessage = [&, i](auto, const std::string& msg) {
+            std::lock_guard lock(m);
+            received[i].push_back(msg);
+            cv.notify_all();
+        };
+        client->connect("ws://127.0.0.1:" + std::to_string(*port));
+        client->send(i < 2 ? "sensors" : "alarms");
+    }
+
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return subscribed == numClients; });
+    }
+
+    CHECK(ws.broadcast("all") == numClients);
+    CHECK(ws.publish("sensors", "sensor update") == 2);
+    CHECK(ws.publish("nobody", "none") == 0);
+
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return received[0].size() == 2 && received[1].size() == 2 && received[2].size() == 1; });
+    }
+
+    CHECK(received[0] == std::vector<std::string>{"all", "sensor update"});
+    CHECK(received[1] == std::vector<std::string>{"all", "sensor update"});
+    CHECK(received[2] == std::vector<std::string>{"all"});
+
+    for (auto& client : clients) {
+        client->close();
+    }
+    ws.stop();
+}
+
+TEST_CASE("Websocket server queues messages for slow clients") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::mutex m;
+    std::condition_variable cv;
+    WebSocketConnection* server = nullptr;
+
+    WebSocket ws(*port);
+    ws.sendQueue.flushDelay = std::chrono::milliseconds(5);
+    ws.onOpen = [&](auto c) {
+        std::lock_guard lock(m);
+        server = c;
+        cv.notify_all();
+    };
+    ws.start();
+
+    // a client that does not read until everything is sent
+    TCPClientContext ctx;
+    const auto conn = ctx.connect("127.0.0.1", *port);
+    REQUIRE(conn);
+    REQUIRE(conn->write(upgradeRequest));
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return server != nullptr; });
+    }
+
+    // far more than the socket buffers hold, sending must not wait for the client
+    const int count = 4000;
+    std::vector<uint8_t> payload(4096);
+    for (int i = 0; i < count; ++i) {
+        payload[0] = static_cast<uint8_t>(i);
+        server->sendBinary(payload);
+    }
+
+    std::string response;
+    uint8_t c;
+    while (response.find("\r\n\r\n") == std::string::npos && conn->read(&c, 1) == 1) {
+        response += static_cast<char>(c);
+    }
+    REQUIRE(response.starts_with("HTTP/1.1 101"));
+
+    // every frame arrives, in order
+    std::vector<uint8_t> frame(4 + payload.size());
+    for (int i = 0; i < count; ++i) {
+        REQUIRE(conn->readExact(frame));
+        REQUIRE(frame[0] == 0x82);
+        REQUIRE(frame[1] == 126);
+        REQUIRE(((frame[2] << 8) | frame[3]) == 4096);
+        REQUIRE(frame[4] == static_cast<uint8_t>(i));
+    }
+
+    conn->close();
+    ws.stop();
+}
+
+TEST_CASE("Websocket server disconnects clients that fall behind") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::mutex m;
+    std::condition_variable cv;
+    int open = 0;
+    bool closed = false;
+
+    WebSocket ws(*port);
+    ws.sendQueue.highWatermark = 1024 * 1024;
+    ws.onOpen = [&](auto) {
+        std::lock_guard lock(m);
+        ++open;
+        cv.notify_all();
+    };
+    ws.onClose = [&](auto) {
+        std::lock_guard lock(m);
+        closed = true;
+        cv.notify_all();
+    };
+    ws.start();
+
+    // never reads
+    TCPClientContext ctx;
+    const auto stalled = ctx.connect("127.0.0.1", *port);
+    REQUIRE(stalled);
+    REQUIRE(stalled->write(upgradeRequest));
+
+    std::atomic_int received{0};
+    WebSocketClient healthy;
+    healthy.onBinaryMessage = [&](auto, auto) { ++received; };
+    healthy.connect("ws://127.0.0.1:" + std::to_string(*port));
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return open == 2; });
+    }
+
+    const std::vector<uint8_t> payload(4096);
+    int sent = 0;
+    while (sent < 10000) {
+        ws.broadcastBinary(payload);
+        // at a rate the healthy client keeps up with
+        if (++sent % 16 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard lock(m);
+        if (closed) break;
+    }
+    {
+        std::unique_lock lock(m);
+        CHECK(cv.wait_for(lock, std::chrono::seconds(5), [&] { return closed; }));
+    }
+
+    // the healthy client gets every message
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (received < sent && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    CHECK(received == sent);
+    CHECK(sent < 10000);
+
+    healthy.close();
+    stalled->close();
+    ws.stop();
+}
+
+TEST_CASE("Websocket server addresses connections by id") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::vector<uint64_t> opened;
+    int closed = 0;
+
+    WebSocket ws(*port);
+    ws.onOpen = [&](WebSocketConnection* c) {
+        std::lock_guard lock(m);
+        opened.push_back(c->id());
+        cv.notify_all();
+    };
+    ws.onClose = [&](auto) {
+        std::lock_guard lock(m);
+        ++closed;
+        cv.notify_all();
+    };
+    ws.start();
+
+    const auto connect = [&](std::vector<std::string>& received) {
+        auto client = std::make_unique<WebSocketClient>();
+        client->onMessage = [&](auto, const std::string& msg) {
+            std::lock_guard lock(m);
+            received.push_back(msg);
+            cv.notify_all();
+        };
+        const auto count = opened.size();
+        client->connect("ws://127.0.0.1:" + std::to_string(*port));
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return opened.size() == count + 1; });
+        return client;
+    };
+
+    std::vector<std::string> receivedA, receivedB, receivedC;
+    const auto a = connect(receivedA);
+    const auto b = connect(receivedB);
+    const auto idA = opened[0];
+    const auto idB = opened[1];
+    CHECK(idA != idB);
+    CHECK(ws.connectionCount() == 2);
+
+    CHECK(ws.send(idA, "to a"));
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return !receivedA.empty(); });
+    }
+    CHECK(receivedA == std::vector<std::string>{"to a"});
+    CHECK(receivedB.empty());
+
+    CHECK(ws.disconnect(idB));
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return closed == 1; });
+    }
+    CHECK(ws.connectionCount() == 1);
+    CHECK_FALSE(ws.send(idB, "gone"));
+    CHECK_FALSE(ws.disconnect(idB));
+
+    // the slot is reused, the id is not
+    const auto c = connect(receivedC);
+    CHECK(opened[2] != idB);
+    CHECK(ws.send(opened[2], "to c"));
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return !receivedC.empty(); });
+    }
+    CHECK(receivedC == std::vector<std::string>{"to c"});
+
+    a->close();
+    b->close();
+    c->close();
+    ws.stop();
+}
+
+TEST_CASE("Websocket server handshake") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::atomic_int opened{0};
+    std::string subprotocol;
+
+    WebSocket ws(*port);
+    ws.subprotocols = {"v2.example", "v1.example"};
+    ws.handshakeTimeout = std::chrono::milliseconds(200);
+    ws.onOpen = [&](WebSocketConnection* c) {
+        subprotocol = c->subprotocol();
+        ++opened;
+    };
+    ws.start();
+
+    TCPClientContext ctx;
+
+    SECTION("headers in any case, split across writes") {
+        const auto conn = ctx.connect("127.0.0.1", *port);
+        REQUIRE(conn);
+
+        const std::string request = "GET /chat HTTP/1.1\r\n"
+                                    "host: 127.0.0.1\r\n"
+                                    "Cookie: " + std::string(4000, 'c') + "\r\n"
+                                    "UPGRADE: WebSocket\r\n"
+                                    "connection: keep-alive, Upgrade\r\n"
+                                    "sec-websocket-key:dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                    "Sec-WebSocket-Protocol: v0.example, v1.example, v2.example\r\n"
+                                    "sec-websocket-version: 13\r\n\r\n";
+        for (size_t i = 0; i < request.size(); i += 1000) {
+            REQUIRE(conn->write(request.substr(i, 1000)));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+
+        const auto response = readResponse(*conn);
+        CHECK(response.starts_with("HTTP/1.1 101 Switching Protocols\r\n"));
+        CHECK(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+        // the server's preference wins
+        CHECK(response.find("Sec-WebSocket-Protocol: v2.example\r\n") != std::string::npos);
+
+        // still open after the timeout
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        CHECK(ws.connectionCount() == 1);
+        CHECK(opened == 1);
+        CHECK(subprotocol == "v2.example");
+        conn->close();
+    }
+
+    SECTION("unsupported version") {
+        const auto conn = ctx.connect("127.0.0.1", *port);
+        REQUIRE(conn);
+
+        auto request = upgradeRequest;
+        request.replace(request.find("13"), 2, "8");
+        REQUIRE(conn->write(request));
+        CHECK(readResponse(*conn).starts_with("HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: 13\r\n"));
+    }
+
+    SECTION("not an upgrade") {
+        const auto conn = ctx.connect("127.0.0.1", *port);
+        REQUIRE(conn);
+
+        REQUIRE(conn->write(std::string("GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n")));
+        CHECK(readResponse(*conn).starts_with("HTTP/1.1 400 Bad Request\r\n"));
+    }
+
+    SECTION("silent clients time out") {
+        const auto conn = ctx.connect("127.0.0.1", *port);
+        REQUIRE(conn);
+        REQUIRE(conn->write(std::string("GET / HTTP/1.1\r\n")));
+
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(readResponse(*conn).empty());
+        CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(150));
+    }
+
+    CHECK(opened == 1);
+    ws.stop();
+}
+
+TEST_CASE("Websocket heartbeat") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::mutex m;
+    std::condition_variable cv;
+    int closed = 0;
+
+    WebSocket ws(*port);
+    ws.heartbeat.pingInterval = std::chrono::milliseconds(100);
+    ws.heartbeat.pongTimeout = std::chrono::milliseconds(100);
+    ws.onClose = [&](auto) {
+        std::lock_guard lock(m);
+        ++closed;
+        cv.notify_all();
+    };
+    ws.start();
+
+    // answers pings, as any client does
+    WebSocketClient healthy;
+    healthy.connect("ws://127.0.0.1:" + std::to_string(*port));
+
+    // never answers
+    TCPClientContext ctx;
+    const auto silent = ctx.connect("127.0.0.1", *port);
+    REQUIRE(silent);
+    REQUIRE(silent->write(upgradeRequest));
+    CHECK(readResponse(*silent).starts_with("HTTP/1.1 101"));
+
+    const auto start = std::chrono::steady_clock::now();
+    uint8_t ping[2] = {};
+    REQUIRE(silent->read(ping, 2) == 2);
+    CHECK(ping[0] == 0x89);// final ping
+    CHECK(ping[1] == 0x00);
+    {
+        std::unique_lock lock(m);
+        CHECK(cv.wait_for(lock, std::chrono::seconds(5), [&] { return closed == 1; }));
+    }
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(100));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CHECK(ws.connectionCount() == 1);
+
+    healthy.close();
+    silent->close();
+    ws.stop();
+}
+
+TEST_CASE("Websocket client heartbeat") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    // completes the handshake, then ignores the client
+    TCPServer server(*port);
+    std::thread peer([&] {
+        const auto conn = server.accept();
+        readResponse(*conn);
+        conn->write(std::string("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n\r\n"));
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+    });
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool closed = false;
+
+    WebSocketClient client;
+    client.heartbeat.pingInterval = std::chrono::milliseconds(200);
+    client.heartbeat.pongTimeout = std::chrono::milliseconds(200);
+    client.onClose = [&](auto) {
+        std::lock_guard lock(m);
+        closed = true;
+        cv.notify_all();
+    };
+    client.connect("ws://127.0.0.1:" + std::to_string(*port));
+    {
+        std::unique_lock lock(m);
+        CHECK(cv.wait_for(lock, std::chrono::seconds(1), [&] { return closed; }));
+    }
+
+    client.close();
+    peer.join();
+    server.close();
+}
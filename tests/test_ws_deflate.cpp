@@ -0,0 +1,155 @@
+
+#include "simple_socket/WebSocket.hpp"
+#include "simple_socket/util/port_query.hpp"
+#include "simple_socket/ws/PerMessageDeflate.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+TEST_CASE("permessage-deflate negotiation") {
+
+    PerMessageDeflateOptions options;
+    options.enabled = true;
+
+    SECTION("default offer") {
+        const auto params = negotiateDeflate(deflateOffer(options), options);
+        REQUIRE(params);
+        CHECK(params->serverMaxWindowBits == 15);
+        CHECK(params->clientMaxWindowBits == 15);
+        CHECK_FALSE(params->serverNoContextTakeover);
+        CHECK(deflateResponse(*params) == "permessage-deflate");
+    }
+
+    SECTION("window bits and context takeover") {
+        const auto params = negotiateDeflate("x-webkit-deflate-frame, permessage-deflate; server_max_window_bits=10; client_max_window_bits; server_no_context_takeover", options);
+        REQUIRE(params);
+        CHECK(params->serverMaxWindowBits == 10);
+        CHECK(params->clientMaxWindowBits == 15);
+        CHECK(params->serverNoContextTakeover);
+        CHECK(deflateResponse(*params) == "permessage-deflate; server_no_context_takeover; server_max_window_bits=10");
+
+        const auto accepted = parseDeflateResponse(deflateResponse(*params), options);
+        REQUIRE(accepted);
+        CHECK(accepted->serverMaxWindowBits == 10);
+        CHECK(accepted->serverNoContextTakeover);
+    }
+
+    SECTION("server limits the client window") {
+        PerMessageDeflateOptions server = options;
+        server.clientMaxWindowBits = 12;
+        server.clientNoContextTakeover = true;
+
+        const auto params = negotiateDeflate("permessage-deflate; client_max_window_bits", server);
+        REQUIRE(params);
+        CHECK(params->clientMaxWindowBits == 12);
+        CHECK(deflateResponse(*params) == "permessage-deflate; client_no_context_takeover; client_max_window_bits=12");
+
+        // not allowed unless offered
+        CHECK(negotiateDeflate("permessage-deflate", server)->clientMaxWindowBits == 15);
+    }
+
+    SECTION("invalid offers are declined") {
+        CHECK_FALSE(negotiateDeflate("permessage-deflate; server_max_window_bits=16", options));
+        CHECK_FALSE(negotiateDeflate("permessage-deflate; server_max_window_bits=8", options));
+        CHECK_FALSE(negotiateDeflate("permessage-deflate; unknown_param", options));
+        CHECK_FALSE(negotiateDeflate("permessage-deflate; server_no_context_takeover; server_no_context_takeover", options));
+        CHECK_FALSE(negotiateDeflate("", options));
+        REQUIRE_THROWS(parseDeflateResponse("permessage-deflate; client_max_window_bits", options));
+        REQUIRE_THROWS(parseDeflateResponse("x-other", options));
+    }
+
+    SECTION("header lookup is case insensitive") {
+        const std::string request = "GET / HTTP/1.1\r\nHost: x\r\nsec-websocket-extensions: permessage-deflate\r\n"
+                                    "Sec-WebSocket-Extensions: x-other\r\n\r\n";
+        CHECK(extensionsHeader(request) == "permessage-deflate, x-other");
+    }
+}
+
+#ifdef SIMPLE_SOCKET_WITH_ZLIB
+
+TEST_CASE("permessage-deflate round trip") {
+
+    PerMessageDeflateOptions options;
+    options.enabled = true;
+    options.minCompressSize = 0;
+
+    for (const bool noContextTakeover : {false, true}) {
+        DeflateParams params;
+        params.serverNoContextTakeover = params.clientNoContextTakeover = noContextTakeover;
+        params.serverMaxWindowBits = 10;
+
+        PerMessageDeflate server(params, true, options);
+        PerMessageDeflate client(params, false, options);
+
+        std::string json;
+        for (int i = 0; i < 200; ++i) json += R"({"sensor":"temperature","value":)" + std::to_string(20 + i % 5) + "},";
+
+        std::vector<uint8_t> compressed;
+        std::string decompressed;
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(server.compress(reinterpret_cast<const uint8_t*>(json.data()), json.size(), compressed));
+            CHECK(compressed.size() * 5 < json.size());
+            REQUIRE(client.decompress(compressed.data(), compressed.size(), decompressed, 1 << 20) == PerMessageDeflate::Result::Ok);
+            CHECK(decompressed == json);
+        }
+
+        REQUIRE(server.compress(reinterpret_cast<const uint8_t*>(json.data()), json.size(), compressed));
+        CHECK(client.decompress(compressed.data(), compressed.size(), decompressed, 100) == PerMessageDeflate::Result::TooLarge);
+    }
+}
+
+TEST_CASE("WebSocket with permessage-deflate") {
+
+    const auto port = getAvailablePort(8000, 9000);
+    REQUIRE(port);
+
+    std::string message;
+    for (int i = 0; i < 1000; ++i) message += R"({"id":)" + std::to_string(i) + R"(,"status":"ok"})";
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::string serverReceived;
+    std::string clientReceived;
+
+    WebSocket ws(*port);
+    ws.perMessageDeflate.enabled = true;
+    ws.onMessage = [&](auto c, const auto& msg) {
+        {
+            std::lock_guard lock(m);
+            serverReceived = msg;
+        }
+        c->send(msg);
+        cv.notify_all();
+    };
+    ws.start();
+
+    WebSocketClient client;
+    client.perMessageDeflate.enabled = true;
+    client.perMessageDeflate.clientNoContextTakeover = true;
+    client.onMessage = [&](auto, const auto& msg) {
+        std::lock_guard lock(m);
+        clientReceived = msg;
+        cv.notify_all();
+    };
+    client.connect("ws://127.0.0.1:" + std::to_string(*port));
+    client.send(message);
+
+    {
+        std::unique_lock lock(m);
+        cv.wait(lock, [&] { return !serverReceived.empty() && !clientReceived.empty(); });
+    }
+
+    client.close();
+    ws.stop();
+
+    CHECK(serverReceived == message);
+    CHECK(clientReceived == message);
+}
+
+#endif
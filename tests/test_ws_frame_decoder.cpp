@@ -0,0 +1,161 @@
+
+#include "simple_socket/ws/WebSocketFrameDecoder.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace simple_socket;
+
+namespace {
+
+    std::vector<uint8_t> makeFrame(uint8_t opcode, const std::string& payload, bool fin = true, bool masked = true) {
+        std::vector<uint8_t> frame;
+        frame.push_back((fin ? 0x80 : 0x00) | opcode);
+
+        const uint8_t maskBit = masked ? 0x80 : 0x00;
+        const uint64_t len = payload.size();
+        if (len <= 125) {
+            frame.push_back(static_cast<uint8_t>(len) | maskBit);
+        } else if (len <= 65535) {
+            frame.push_back(126 | maskBit);
+            frame.push_back(len >> 8);
+            frame.push_back(len & 0xFF);
+        } else {
+            frame.push_back(127 | maskBit);
+            for (int i = 7; i >= 0; --i) frame.push_back((len >> (i * 8)) & 0xFF);
+        }
+
+        const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+        if (masked) frame.insert(frame.end(), mask, mask + 4);
+        for (size_t i = 0; i < payload.size(); ++i) {
+            frame.push_back(masked ? payload[i] ^ mask[i % 4] : payload[i]);
+        }
+        return frame;
+    }
+
+    using Messages = std::vector<std::pair<uint8_t, std::string>>;
+
+    WebSocketFrameDecoder::Result feed(WebSocketFrameDecoder& decoder, const std::vector<uint8_t>& data, Messages& out, size_t chunkSize) {
+        auto result = WebSocketFrameDecoder::Result::Ok;
+        for (size_t pos = 0; pos < data.size() && result == WebSocketFrameDecoder::Result::Ok; pos += chunkSize) {
+            result = decoder.feed(data.data() + pos, std::min(chunkSize, data.size() - pos), [&](uint8_t opcode, const std::string& payload, bool) {
+                out.emplace_back(opcode, payload);
+                return true;
+            });
+        }
+        return result;
+    }
+
+}// namespace
+
+TEST_CASE("WebSocket frame decoder coalesced and partial frames") {
+
+    const std::string large(70000, 'x');// needs a 64-bit length
+
+    std::vector<uint8_t> stream;
+    for (const auto& frame : {makeFrame(ws::Text, "first"), makeFrame(ws::Text, std::string(300, 'y')),
+                              makeFrame(ws::Binary, large, true, false), makeFrame(ws::Text, "")}) {
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    for (const size_t chunkSize : {stream.size(), size_t(1), size_t(7), size_t(4096)}) {
+        WebSocketFrameDecoder decoder;
+        Messages messages;
+        REQUIRE(feed(decoder, stream, messages, chunkSize) == WebSocketFrameDecoder::Result::Ok);
+
+        REQUIRE(messages.size() == 4);
+        CHECK(messages[0] == std::make_pair(uint8_t(ws::Text), std::string("first")));
+        CHECK(messages[1].second == std::string(300, 'y'));
+        CHECK(messages[2].first == ws::Binary);
+        CHECK(messages[2].second == large);
+        CHECK(messages[3].second.empty());
+    }
+}
+
+TEST_CASE("WebSocket frame decoder fragmentation") {
+
+    std::vector<uint8_t> stream;
+    for (const auto& frame : {makeFrame(ws::Text, "Hello, ", false), makeFrame(ws::Ping, "ping"),
+                              makeFrame(ws::Continuation, "fragmented ", false), makeFrame(ws::Continuation, "world")}) {
+        stream.insert(stream.end(), frame.begin(), frame.end());
+    }
+
+    WebSocketFrameDecoder decoder;
+    Messages messages;
+    REQUIRE(feed(decoder, stream, messages, 3) == WebSocketFrameDecoder::Result::Ok);
+
+    REQUIRE(messages.size() == 2);
+    CHECK(messages[0] == std::make_pair(uint8_t(ws::Ping), std::string("ping")));
+    CHECK(messages[1] == std::make_pair(uint8_t(ws::Text), std::string("Hello, fragmented world")));
+    CHECK_FALSE(decoder.fragmented());
+}
+
+TEST_CASE("WebSocket frame decoder protocol errors") {
+
+    Messages messages;
+
+    SECTION("continuation without a message") {
+        WebSocketFrameDecoder decoder;
+        CHECK(feed(decoder, makeFrame(ws::Continuation, "x"), messages, 64) == WebSocketFrameDecoder::Result::ProtocolError);
+    }
+
+    SECTION("new message while fragmented") {
+        WebSocketFrameDecoder decoder;
+        auto stream = makeFrame(ws::Text, "a", false);
+        const auto second = makeFrame(ws::Text, "b");
+        stream.insert(stream.end(), second.begin(), second.end());
+        CHECK(feed(decoder, stream, messages, 64) == WebSocketFrameDecoder::Result::ProtocolError);
+    }
+
+    SECTION("fragmented control frame") {
+        WebSocketFrameDecoder decoder;
+        CHECK(feed(decoder, makeFrame(ws::Ping, "x", false), messages, 64) == WebSocketFrameDecoder::Result::ProtocolError);
+    }
+
+    SECTION("masking does not match the role") {
+        WebSocketFrameDecoder server;
+        server.setMaskPolicy(WebSocketFrameDecoder::MaskPolicy::Required);
+        CHECK(feed(server, makeFrame(ws::Text, "x", true, false), messages, 64) == WebSocketFrameDecoder::Result::ProtocolError);
+
+        WebSocketFrameDecoder client;
+        client.setMaskPolicy(WebSocketFrameDecoder::MaskPolicy::Forbidden);
+        CHECK(feed(client, makeFrame(ws::Text, "x", true, true), messages, 64) == WebSocketFrameDecoder::Result::ProtocolError);
+    }
+
+    SECTION("message too large") {
+        WebSocketFrameDecoder decoder(16);
+        CHECK(feed(decoder, makeFrame(ws::Text, std::string(17, 'z')), messages, 64) == WebSocketFrameDecoder::Result::TooLarge);
+    }
+
+    CHECK(messages.empty());
+}
+
+TEST_CASE("WebSocket mask kernel") {
+
+    INFO("kernel: " << ws::maskKernel());
+
+    const uint8_t mask[4] = {0xA1, 0xB2, 0xC3, 0xD4};
+    std::vector<uint8_t> input(1029);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = static_cast<uint8_t>(i * 7);
+
+    // cover every tail length, misaligned starts and mask offsets
+    for (size_t start : {0, 1, 3}) {
+        for (size_t size : {0, 1, 5, 31, 32, 33, 64, 100, 1024}) {
+            for (size_t offset : {0, 1, 2, 3, 6}) {
+                std::vector<uint8_t> expected(size);
+                for (size_t i = 0; i < size; ++i) expected[i] = input[start + i] ^ mask[(offset + i) % 4];
+
+                std::vector<uint8_t> out(size);
+                ws::applyMask(out.data(), input.data() + start, size, mask, offset);
+                CHECK(out == expected);
+
+                std::vector<uint8_t> inPlace(input.begin() + start, input.begin() + start + size);
+                ws::applyMask(inPlace.data(), inPlace.data(), size, mask, offset);
+                CHECK(inPlace == expected);
+            }
+        }
+    }
+}